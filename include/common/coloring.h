@@ -0,0 +1,59 @@
+#pragma once
+/**
+ * Graph coloring for solving constraints in parallel.  Constraints that
+ * share an item (e.g. a particle) get different colors, so every
+ * constraint of one color can be solved at the same time without two
+ * threads writing to the same item
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define COLORING_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define COLORING_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define COLORING_ERROR_ALLOC -3
+
+/**
+ * Marks a constraint member that doesn't refer to any item, e.g. a
+ * particle that never moves and so is never written to
+ */
+#define COLORING_NO_ITEM UINT32_MAX
+
+/**
+ * @brief Colors a set of constraints so that no two constraints of the
+ * same color share an item.  Colors are handed out greedily, lowest first
+ * @param members The items each constraint touches, one array per member:
+ * constraint i touches members[0][i] through members[member_count - 1][i]
+ * @param member_count The number of items each constraint touches
+ * @param count The number of constraints
+ * @param item_count One more than the largest item index
+ * @param colors Populated with each constraint's color
+ * @param color_count Populated with the number of colors used
+ * @return COLORING_SUCCESS on success, or an error code on failure
+ */
+int coloring_color(const uint32_t *const *members, size_t member_count, size_t count, size_t item_count,
+    uint32_t *colors, size_t *color_count);
+
+/**
+ * @brief Groups constraints by color
+ * @param colors Each constraint's color, from coloring_color()
+ * @param count The number of constraints
+ * @param color_count The number of colors
+ * @param order Populated with every constraint, sorted by color.  Within
+ * a color, constraints keep their original order
+ * @param color_starts Populated with where each color starts in order,
+ * plus one more entry for where the last color ends (color_count + 1 total)
+ * @return COLORING_SUCCESS on success, or an error code on failure
+ */
+int coloring_sort(const uint32_t *colors, size_t count, size_t color_count, uint32_t *order, uint32_t *color_starts);
@@ -0,0 +1,79 @@
+#pragma once
+/**
+ * Runtime detection of the CPU's vector instruction sets.  Everything
+ * is compiled for the baseline ISA, but hot kernels also carry AVX2 and
+ * AVX-512 versions (compiled with CPU_TARGET_AVX2 and CPU_TARGET_AVX512)
+ * and pick one with cpu_get_isa() each time they are called.
+ *
+ * The ISA can be capped for testing, either with cpu_force_isa() or by
+ * setting the PHY_FORCE_ISA environment variable to one of "baseline",
+ * "sse4", "avx2" or "avx512" before the first kernel runs.  Forcing an
+ * ISA the CPU doesn't support falls back to the best one it does
+ */
+
+#include <stdbool.h>
+
+/**
+ * The instruction sets kernels can be dispatched to, from narrowest to widest
+ */
+enum CpuIsa {
+    /**
+     * Whatever the build targets: SSE2 on x86-64, NEON on ARM, or plain C
+     */
+    CPU_ISA_BASELINE,
+    CPU_ISA_SSE4,
+    /**
+     * AVX2 and FMA: 8 floats per instruction
+     */
+    CPU_ISA_AVX2,
+    /**
+     * AVX-512F: 16 floats per instruction
+     */
+    CPU_ISA_AVX512,
+};
+typedef enum CpuIsa cpu_isa_t;
+
+/**
+ * Set if this compiler and target can build the x86 kernel variants
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CPU_X86_DISPATCH 1
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+
+/**
+ * @brief Gets the widest instruction set kernels should use: the best
+ * the CPU supports, capped by cpu_force_isa() or PHY_FORCE_ISA
+ * @return The instruction set
+ */
+cpu_isa_t cpu_get_isa(void);
+
+/**
+ * @brief Gets the widest instruction set the CPU supports, ignoring any
+ * cap
+ * @return The instruction set
+ */
+cpu_isa_t cpu_get_supported_isa(void);
+
+/**
+ * @brief Caps the instruction set kernels use, overriding PHY_FORCE_ISA.
+ * Takes effect on the next kernel call
+ * @param isa The widest instruction set to use
+ */
+void cpu_force_isa(cpu_isa_t isa);
+
+/**
+ * @brief Parses the name of an instruction set, as used by PHY_FORCE_ISA
+ * @param name The name to parse
+ * @param isa Where to store the instruction set
+ * @return true on success, or false if the name isn't recognized
+ */
+bool cpu_isa_from_name(const char *name, cpu_isa_t *isa);
+
+/**
+ * @brief Gets the name of an instruction set
+ * @param isa The instruction set
+ * @return The name, as accepted by PHY_FORCE_ISA
+ */
+const char *cpu_isa_name(cpu_isa_t isa);
@@ -44,6 +44,11 @@ static inline noreturn int ___abort_with_msg(const char * restrict msg) {
  */
 #define PHYSICS_EPSILON 1.0e-6
 
+/**
+ * Pi, since strict C doesn't provide M_PI
+ */
+#define PHYSICS_PI 3.14159265358979323846
+
 /**
  * Indicates that a function should not be used outside of the file
  * it was defined in.  In C, marking a function static tells the
@@ -0,0 +1,188 @@
+#pragma once
+/**
+ * Vectorized approximations of sin, cos, 1/sqrt and atan2, for kernels
+ * that would otherwise call into libm once per lane.  Each function
+ * takes a precision: FASTMATH_PRECISION_ACCURATE is within a few float
+ * ulps of libm, while FASTMATH_PRECISION_FAST trades accuracy for fewer
+ * instructions, which is fine for anything that is only drawn.
+ *
+ * Error bounds (absolute for sin, cos and atan2; relative for rsqrt):
+ *
+ *  | function      | ACCURATE | FAST    |
+ *  |---------------|----------|---------|
+ *  | sin, cos      | 1e-7     | 4e-4    |
+ *  | rsqrt (SSE)   | 5e-7     | 4e-4    |
+ *  | rsqrt (NEON)  | 5e-7     | 2e-5    |
+ *  | atan2         | 4e-7     | 2e-3    |
+ *
+ * sin and cos hold those bounds for |x| up to about 100.  Past that the
+ * argument reduction slowly loses precision, to about 1e-6 at |x| = 10^5.
+ * Without SIMD, rsqrt falls back to 1/sqrtf() at either precision
+ */
+
+#include <float.h>
+#include "common/defines.h"
+#include "common/simd.h"
+
+/**
+ * How accurate an approximation needs to be
+ */
+enum FastmathPrecision {
+    FASTMATH_PRECISION_ACCURATE,
+    FASTMATH_PRECISION_FAST,
+};
+typedef enum FastmathPrecision fastmath_precision_t;
+
+/**
+ * [internal] pi/2 split into three parts, so that multiplying each part
+ * by a whole number of quadrants is exact (Cody-Waite reduction)
+ */
+#define _FASTMATH_PI_2_HIGH 1.5703125f
+#define _FASTMATH_PI_2_MID  4.837512969970703125e-4f
+#define _FASTMATH_PI_2_LOW  7.54978995489188216e-8f
+
+/**
+ * @brief Calculates the sine and cosine of every lane at once
+ * @param x The angles, in radians
+ * @param sin_out Where to store the sines
+ * @param cos_out Where to store the cosines
+ * @param precision How accurate the results need to be
+ */
+static inline void simd4f_sincos(simd4f_t x, simd4f_t *sin_out, simd4f_t *cos_out, fastmath_precision_t precision) {
+    // x = r + quadrant * pi/2, with r in [-pi/4, pi/4]
+    simd4f_t quadrant = simd4f_round(simd4f_mul(x, simd4f_set1((float)(2 / PHYSICS_PI))));
+    simd4f_t r = simd4f_sub(x, simd4f_mul(quadrant, simd4f_set1(_FASTMATH_PI_2_HIGH)));
+    r = simd4f_sub(r, simd4f_mul(quadrant, simd4f_set1(_FASTMATH_PI_2_MID)));
+    r = simd4f_sub(r, simd4f_mul(quadrant, simd4f_set1(_FASTMATH_PI_2_LOW)));
+    simd4f_t r2 = simd4f_mul(r, r);
+
+    simd4f_t sin_r, cos_r;
+    if (precision == FASTMATH_PRECISION_FAST) {
+        // Taylor series, to r^5 and r^4
+        sin_r = simd4f_mul(r2, simd4f_set1(1.0f / 120));
+        sin_r = simd4f_mul(r2, simd4f_add(sin_r, simd4f_set1(-1.0f / 6)));
+        sin_r = simd4f_add(r, simd4f_mul(r, sin_r));
+
+        cos_r = simd4f_mul(r2, simd4f_set1(1.0f / 24));
+        cos_r = simd4f_mul(r2, simd4f_add(cos_r, simd4f_set1(-0.5f)));
+        cos_r = simd4f_add(simd4f_set1(1), cos_r);
+    }
+    else {
+        // minimax polynomials from Cephes' sinf() and cosf()
+        sin_r = simd4f_mul(r2, simd4f_set1(-1.9515295891e-4f));
+        sin_r = simd4f_mul(r2, simd4f_add(sin_r, simd4f_set1(8.3321608736e-3f)));
+        sin_r = simd4f_mul(r2, simd4f_add(sin_r, simd4f_set1(-1.6666654611e-1f)));
+        sin_r = simd4f_add(r, simd4f_mul(r, sin_r));
+
+        cos_r = simd4f_mul(r2, simd4f_set1(2.443315711809948e-5f));
+        cos_r = simd4f_mul(r2, simd4f_add(cos_r, simd4f_set1(-1.388731625493765e-3f)));
+        cos_r = simd4f_mul(r2, simd4f_add(cos_r, simd4f_set1(4.166664568298827e-2f)));
+        cos_r = simd4f_mul(r2, simd4f_add(cos_r, simd4f_set1(-0.5f)));
+        cos_r = simd4f_add(simd4f_set1(1), cos_r);
+    }
+
+    // quadrant mod 4 picks which of sin(r), cos(r) and their negations each result is;
+    // all of these are whole numbers, so rounding stands in for floor()
+    simd4f_t quarter = simd4f_round(simd4f_sub(simd4f_mul(quadrant, simd4f_set1(0.25f)), simd4f_set1(0.375f)));
+    simd4f_t mod4 = simd4f_sub(quadrant, simd4f_mul(quarter, simd4f_set1(4)));
+    simd4f_t half = simd4f_round(simd4f_sub(simd4f_mul(mod4, simd4f_set1(0.5f)), simd4f_set1(0.25f)));
+    simd4f_t odd = simd4f_sub(mod4, simd4f_mul(half, simd4f_set1(2)));
+
+    simd4f_t swap = simd4f_greater_equal(odd, simd4f_set1(0.5f));
+    simd4f_t negate_sin = simd4f_greater_equal(mod4, simd4f_set1(1.5f));
+    simd4f_t negate_cos = simd4f_and(
+        simd4f_greater_equal(mod4, simd4f_set1(0.5f)),
+        simd4f_less_equal(mod4, simd4f_set1(2.5f)));
+
+    simd4f_t result_sin = simd4f_select(swap, cos_r, sin_r);
+    simd4f_t result_cos = simd4f_select(swap, sin_r, cos_r);
+    *sin_out = simd4f_mul(result_sin, simd4f_select(negate_sin, simd4f_set1(-1), simd4f_set1(1)));
+    *cos_out = simd4f_mul(result_cos, simd4f_select(negate_cos, simd4f_set1(-1), simd4f_set1(1)));
+}
+
+/**
+ * @brief Calculates the sine of every lane
+ */
+static inline simd4f_t simd4f_sin(simd4f_t x, fastmath_precision_t precision) {
+    simd4f_t sin_x, cos_x;
+    simd4f_sincos(x, &sin_x, &cos_x, precision);
+    return sin_x;
+}
+
+/**
+ * @brief Calculates the cosine of every lane
+ */
+static inline simd4f_t simd4f_cos(simd4f_t x, fastmath_precision_t precision) {
+    simd4f_t sin_x, cos_x;
+    simd4f_sincos(x, &sin_x, &cos_x, precision);
+    return cos_x;
+}
+
+/**
+ * @brief Calculates 1/sqrt(x) for every lane.  Every lane must be
+ * positive; zero gives an unspecified result
+ */
+static inline simd4f_t simd4f_rsqrt(simd4f_t x, fastmath_precision_t precision) {
+#if defined(SIMD_USE_SSE)
+    simd4f_t estimate = _mm_rsqrt_ps(x);
+    if (precision == FASTMATH_PRECISION_FAST) {
+        return estimate;
+    }
+    // one Newton-Raphson step: e * (1.5 - 0.5 * x * e^2)
+    simd4f_t half_x_e2 = simd4f_mul(simd4f_mul(simd4f_set1(0.5f), x), simd4f_mul(estimate, estimate));
+    return simd4f_mul(estimate, simd4f_sub(simd4f_set1(1.5f), half_x_e2));
+#elif defined(SIMD_USE_NEON)
+    // vrsqrtsq_f32() does the Newton-Raphson step for us
+    float32x4_t estimate = vrsqrteq_f32(x);
+    estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(x, estimate), estimate));
+    if (precision == FASTMATH_PRECISION_ACCURATE) {
+        estimate = vmulq_f32(estimate, vrsqrtsq_f32(vmulq_f32(x, estimate), estimate));
+    }
+    return estimate;
+#else
+    (void)precision;
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, 1.0f / sqrtf(x.lane[i]));
+    return result;
+#endif
+}
+
+/**
+ * @brief Calculates atan2(y, x) for every lane: the angle from the
+ * positive X-axis to (x, y), in [-pi, pi].  Signed zeros are treated
+ * as positive, so atan2(0, 0) is 0
+ */
+static inline simd4f_t simd4f_atan2(simd4f_t y, simd4f_t x, fastmath_precision_t precision) {
+    simd4f_t zero = simd4f_set1(0);
+    simd4f_t abs_x = simd4f_max(x, simd4f_sub(zero, x));
+    simd4f_t abs_y = simd4f_max(y, simd4f_sub(zero, y));
+
+    // work out the angle in the first octant, a = atan(small / big), then mirror it into place;
+    // FLT_MIN keeps 0 / 0 from producing a NaN
+    simd4f_t a = simd4f_div(simd4f_min(abs_x, abs_y), simd4f_max(simd4f_max(abs_x, abs_y), simd4f_set1(FLT_MIN)));
+    simd4f_t angle;
+    if (precision == FASTMATH_PRECISION_FAST) {
+        // pi/4 a - a (a - 1) (0.2447 + 0.0663 a), from Rajan et al.
+        simd4f_t correction = simd4f_add(simd4f_set1(0.2447f), simd4f_mul(a, simd4f_set1(0.0663f)));
+        correction = simd4f_mul(simd4f_mul(a, simd4f_sub(a, simd4f_set1(1))), correction);
+        angle = simd4f_sub(simd4f_mul(a, simd4f_set1((float)(PHYSICS_PI / 4))), correction);
+    }
+    else {
+        // fold a > tan(pi/8) down with atan(a) = pi/4 + atan((a - 1) / (a + 1)),
+        // then use the minimax polynomial from Cephes' atanf()
+        simd4f_t fold = simd4f_greater_equal(a, simd4f_set1(0.4142135623730950f));
+        simd4f_t one = simd4f_set1(1);
+        simd4f_t t = simd4f_select(fold, simd4f_div(simd4f_sub(a, one), simd4f_add(a, one)), a);
+        simd4f_t z = simd4f_mul(t, t);
+        simd4f_t poly = simd4f_mul(z, simd4f_set1(8.05374449538e-2f));
+        poly = simd4f_mul(z, simd4f_add(poly, simd4f_set1(-1.38776856032e-1f)));
+        poly = simd4f_mul(z, simd4f_add(poly, simd4f_set1(1.99777106478e-1f)));
+        poly = simd4f_mul(z, simd4f_add(poly, simd4f_set1(-3.33329491539e-1f)));
+        angle = simd4f_add(t, simd4f_mul(t, poly));
+        angle = simd4f_add(angle, simd4f_select(fold, simd4f_set1((float)(PHYSICS_PI / 4)), zero));
+    }
+
+    angle = simd4f_select(simd4f_greater_equal(abs_x, abs_y), angle, simd4f_sub(simd4f_set1((float)(PHYSICS_PI / 2)), angle));
+    angle = simd4f_select(simd4f_greater_equal(x, zero), angle, simd4f_sub(simd4f_set1((float)PHYSICS_PI), angle));
+    return simd4f_select(simd4f_greater_equal(y, zero), angle, simd4f_sub(zero, angle));
+}
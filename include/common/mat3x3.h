@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * Utilities and defines for a 3x3 Matrix, mostly used for rotations and
+ * inertia tensors
+ */
+
+#include <stdbool.h>
+#include "common/defines.h"
+#include "common/vec3.h"
+#include "common/vec4.h"
+
+/**
+ * A Matrix with 3 rows and 3 columns
+ */
+typedef phy_real_t mat3x3_t[3][3];
+
+/**
+ * The identity 3x3 matrix. Any matrix multiplied by this will remain
+ * unchanged.
+ */
+#define MAT3x3_IDENTITY {  { 1, 0, 0 }, \
+                           { 0, 1, 0 }, \
+                           { 0, 0, 1 }  }
+
+/**
+ * Populates the given matrix with the 3x3 identity matrix
+ */
+void mat3x3_make_identity(mat3x3_t matrix);
+
+/**
+ * Populates the given matrix with a diagonal matrix, whose diagonal is
+ * the given vector
+ */
+void mat3x3_make_diagonal(mat3x3_t matrix, vec3_t diagonal);
+
+/**
+ * Populates the given matrix with the rotation a unit quaternion
+ * represents, so that multiplying a vector by the matrix rotates it the
+ * same way vec3_rotate_by_quaternion() would
+ */
+void mat3x3_from_quaternion(mat3x3_t matrix, quaternion_t q);
+
+/**
+ * Copies a matrix
+ */
+void mat3x3_copy(mat3x3_t dest, mat3x3_t source);
+
+/**
+ * Multiplies matrix A by matrix B, storing the result (AxB) into dest
+ */
+void mat3x3_times_mat3x3(mat3x3_t dest, mat3x3_t a, mat3x3_t b);
+
+/**
+ * Stores the transpose of a matrix into dest.  For a rotation matrix,
+ * this is the inverse rotation
+ */
+void mat3x3_transpose(mat3x3_t dest, mat3x3_t source);
+
+/**
+ * @brief Inverts a matrix
+ * @param dest Where to store the inverse
+ * @param source The matrix to invert
+ * @return true on success, or false if the matrix has no inverse (dest is unchanged)
+ */
+bool mat3x3_invert(mat3x3_t dest, mat3x3_t source);
+
+/**
+ * Multiplies a matrix by a vector
+ */
+vec3_t mat3x3_times_vec3(mat3x3_t matrix, vec3_t vec);
+
+/**
+ * Multiplies the transpose of a matrix by a vector.  For a rotation
+ * matrix, this undoes mat3x3_times_vec3()
+ */
+vec3_t mat3x3_transpose_times_vec3(mat3x3_t matrix, vec3_t vec);
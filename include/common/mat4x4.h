@@ -1,9 +1,13 @@
 #pragma once
 
 /**
- * Utilities and defines for a 4x4 Matrix
+ * Utilities and defines for a 4x4 Matrix.  Matrices are row-major
+ * (matrix[row][column]), so pass GL_TRUE for transpose when uploading
+ * one with glUniformMatrix4fv()
  */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "common/defines.h"
 #include "common/vec3.h"
 #include "common/vec4.h"
@@ -23,10 +27,43 @@ typedef phy_real_t mat4x4_t[4][4];
                            { 0, 0, 0, 1 }  }
 
 /**
- * Multiplies matrix A by matrix B, storing the result (AxB) into dest
+ * Multiplies matrix A by matrix B, storing the result (AxB) into dest.
+ * dest may be the same matrix as A or B
  */
 void mat4x4_times_mat4x4(mat4x4_t dest, mat4x4_t a, mat4x4_t b);
 
+/**
+ * @brief Inverts a matrix
+ * @param dest Where to store the inverse.  May be the same matrix as source
+ * @param source The matrix to invert
+ * @return true on success, or false (leaving dest unchanged) if the
+ * matrix is singular
+ */
+bool mat4x4_invert(mat4x4_t dest, mat4x4_t source);
+
+/**
+ * @brief Builds a model matrix that scales, then rotates, then
+ * translates, without multiplying any matrices together
+ * @param dest Where to store the matrix
+ * @param position The translation
+ * @param rotation The rotation, as a unit quaternion
+ * @param scale The scale along each of the model's axes
+ */
+void mat4x4_compose(mat4x4_t dest, vec3_t position, quaternion_t rotation, vec3_t scale);
+
+/**
+ * @brief Builds many model matrices at once, just like calling
+ * mat4x4_compose() on each instance.  Instances are processed SIMD_WIDTH
+ * at a time
+ * @param dest Where to store the matrices (count of them)
+ * @param positions Each instance's translation
+ * @param rotations Each instance's rotation, as a unit quaternion
+ * @param scales Each instance's scale, or NULL to leave every instance unscaled
+ * @param count The number of instances
+ */
+void mat4x4_batch_compose(mat4x4_t *dest, const vec3_t *positions, const quaternion_t *rotations,
+    const vec3_t *scales, size_t count);
+
 /**
  * Populates the given matrix with the 4x4 identity matrix
  */
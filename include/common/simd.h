@@ -0,0 +1,398 @@
+#pragma once
+/**
+ * A thin wrapper around 4-wide single-precision SIMD instructions.
+ * Uses SSE on x86, NEON on ARM, and plain arrays everywhere else, so
+ * kernels can be written once and still compile on any target.
+ *
+ * Everything here is static inline so the wrappers compile down to
+ * the underlying instructions.
+ */
+
+#include <stdint.h>
+#include <math.h>
+#include "common/defines.h"
+#include "common/vec3.h"
+
+#if defined(__SSE2__)
+#define SIMD_USE_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * The number of floats held by a single simd4f_t
+ */
+#define SIMD_WIDTH 4
+
+/**
+ * Four single-precision floats, operated on together.  Comparisons
+ * produce masks of the same type, with every bit of a lane set if the
+ * comparison was true for that lane
+ */
+#if defined(SIMD_USE_SSE)
+typedef __m128 simd4f_t;
+#elif defined(SIMD_USE_NEON)
+typedef float32x4_t simd4f_t;
+#else
+typedef union {
+    float lane[SIMD_WIDTH];
+    uint32_t bits[SIMD_WIDTH];
+} simd4f_t;
+#endif
+
+/**
+ * [internal] applies an expression to every lane of a scalar simd4f_t
+ */
+#define _SIMD_SCALAR_MAP(result, expr) \
+    for (size_t i = 0; i < SIMD_WIDTH; i++) { result.lane[i] = (expr); }
+/**
+ * [internal] sets every lane of a scalar mask based on a condition
+ */
+#define _SIMD_SCALAR_MASK(result, cond) \
+    for (size_t i = 0; i < SIMD_WIDTH; i++) { result.bits[i] = (cond) ? UINT32_MAX : 0; }
+
+/**
+ * Loads four floats from memory.  The pointer does not need to be aligned
+ */
+static inline simd4f_t simd4f_load(const float *src) {
+#if defined(SIMD_USE_SSE)
+    return _mm_loadu_ps(src);
+#elif defined(SIMD_USE_NEON)
+    return vld1q_f32(src);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, src[i]);
+    return result;
+#endif
+}
+
+/**
+ * Stores four floats to memory.  The pointer does not need to be aligned
+ */
+static inline void simd4f_store(float *dest, simd4f_t value) {
+#if defined(SIMD_USE_SSE)
+    _mm_storeu_ps(dest, value);
+#elif defined(SIMD_USE_NEON)
+    vst1q_f32(dest, value);
+#else
+    for (size_t i = 0; i < SIMD_WIDTH; i++) {
+        dest[i] = value.lane[i];
+    }
+#endif
+}
+
+/**
+ * Loads four unsigned 16-bit integers from memory and converts them to floats
+ */
+static inline simd4f_t simd4f_load_u16(const uint16_t *src) {
+#if defined(SIMD_USE_SSE)
+    __m128i packed = _mm_loadl_epi64((const __m128i *)src);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+#elif defined(SIMD_USE_NEON)
+    return vcvtq_f32_u32(vmovl_u16(vld1_u16(src)));
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, src[i]);
+    return result;
+#endif
+}
+
+/**
+ * Sets all four lanes to the same value
+ */
+static inline simd4f_t simd4f_set1(float value) {
+#if defined(SIMD_USE_SSE)
+    return _mm_set1_ps(value);
+#elif defined(SIMD_USE_NEON)
+    return vdupq_n_f32(value);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, value);
+    return result;
+#endif
+}
+
+/**
+ * Sets the four lanes, in order
+ */
+static inline simd4f_t simd4f_set(float x, float y, float z, float w) {
+#if defined(SIMD_USE_SSE)
+    return _mm_setr_ps(x, y, z, w);
+#else
+    const float lanes[SIMD_WIDTH] = { x, y, z, w };
+    return simd4f_load(lanes);
+#endif
+}
+
+/**
+ * Swaps each even lane with the odd lane after it: (x, y, z, w) becomes
+ * (y, x, w, z)
+ */
+static inline simd4f_t simd4f_swap_pairs(simd4f_t value) {
+#if defined(SIMD_USE_SSE)
+    return _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+#elif defined(SIMD_USE_NEON)
+    return vrev64q_f32(value);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, value.lane[i ^ 1]);
+    return result;
+#endif
+}
+
+/**
+ * Swaps the low two lanes with the high two: (x, y, z, w) becomes
+ * (z, w, x, y)
+ */
+static inline simd4f_t simd4f_swap_halves(simd4f_t value) {
+#if defined(SIMD_USE_SSE)
+    return _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2));
+#elif defined(SIMD_USE_NEON)
+    return vextq_f32(value, value, 2);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, value.lane[i ^ 2]);
+    return result;
+#endif
+}
+
+/**
+ * Reverses the lanes: (x, y, z, w) becomes (w, z, y, x)
+ */
+static inline simd4f_t simd4f_reverse(simd4f_t value) {
+#if defined(SIMD_USE_SSE)
+    return _mm_shuffle_ps(value, value, _MM_SHUFFLE(0, 1, 2, 3));
+#elif defined(SIMD_USE_NEON)
+    return vrev64q_f32(vextq_f32(value, value, 2));
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, value.lane[i ^ 3]);
+    return result;
+#endif
+}
+
+static inline simd4f_t simd4f_add(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_add_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vaddq_f32(a, b);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, a.lane[i] + b.lane[i]);
+    return result;
+#endif
+}
+
+static inline simd4f_t simd4f_sub(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_sub_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vsubq_f32(a, b);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, a.lane[i] - b.lane[i]);
+    return result;
+#endif
+}
+
+static inline simd4f_t simd4f_mul(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_mul_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vmulq_f32(a, b);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, a.lane[i] * b.lane[i]);
+    return result;
+#endif
+}
+
+static inline simd4f_t simd4f_div(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_div_ps(a, b);
+#elif defined(SIMD_USE_NEON) && defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    float lanes_a[SIMD_WIDTH], lanes_b[SIMD_WIDTH];
+    simd4f_store(lanes_a, a);
+    simd4f_store(lanes_b, b);
+    for (size_t i = 0; i < SIMD_WIDTH; i++) {
+        lanes_a[i] /= lanes_b[i];
+    }
+    return simd4f_load(lanes_a);
+#endif
+}
+
+/**
+ * Adds up all four lanes, leaving the total in every lane
+ */
+static inline simd4f_t simd4f_sum(simd4f_t value) {
+    value = simd4f_add(value, simd4f_swap_pairs(value));
+    return simd4f_add(value, simd4f_swap_halves(value));
+}
+
+static inline simd4f_t simd4f_sqrt(simd4f_t value) {
+#if defined(SIMD_USE_SSE)
+    return _mm_sqrt_ps(value);
+#elif defined(SIMD_USE_NEON) && defined(__aarch64__)
+    return vsqrtq_f32(value);
+#else
+    float lanes[SIMD_WIDTH];
+    simd4f_store(lanes, value);
+    for (size_t i = 0; i < SIMD_WIDTH; i++) {
+        lanes[i] = sqrtf(lanes[i]);
+    }
+    return simd4f_load(lanes);
+#endif
+}
+
+static inline simd4f_t simd4f_min(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_min_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vminq_f32(a, b);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, a.lane[i] < b.lane[i] ? a.lane[i] : b.lane[i]);
+    return result;
+#endif
+}
+
+static inline simd4f_t simd4f_max(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_max_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vmaxq_f32(a, b);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, a.lane[i] > b.lane[i] ? a.lane[i] : b.lane[i]);
+    return result;
+#endif
+}
+
+/**
+ * Rounds each lane to the nearest integer, with ties going to the even
+ * integer.  Only exact for values within about +-2^22
+ */
+static inline simd4f_t simd4f_round(simd4f_t value) {
+#if defined(SIMD_USE_SSE)
+    return _mm_cvtepi32_ps(_mm_cvtps_epi32(value));
+#elif defined(SIMD_USE_NEON) && defined(__aarch64__)
+    return vrndnq_f32(value);
+#elif defined(SIMD_USE_NEON)
+    // adding 1.5 * 2^23 pushes the fraction bits out of the float
+    float32x4_t magic = vdupq_n_f32(12582912.0f);
+    return vsubq_f32(vaddq_f32(value, magic), magic);
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MAP(result, nearbyintf(value.lane[i]));
+    return result;
+#endif
+}
+
+/**
+ * Compares each lane of a and b, producing a mask of lanes where a <= b
+ */
+static inline simd4f_t simd4f_less_equal(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_cmple_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vreinterpretq_f32_u32(vcleq_f32(a, b));
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MASK(result, a.lane[i] <= b.lane[i]);
+    return result;
+#endif
+}
+
+/**
+ * Compares each lane of a and b, producing a mask of lanes where a >= b
+ */
+static inline simd4f_t simd4f_greater_equal(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_cmpge_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vreinterpretq_f32_u32(vcgeq_f32(a, b));
+#else
+    simd4f_t result;
+    _SIMD_SCALAR_MASK(result, a.lane[i] >= b.lane[i]);
+    return result;
+#endif
+}
+
+/**
+ * Combines two masks, keeping only lanes set in both
+ */
+static inline simd4f_t simd4f_and(simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_and_ps(a, b);
+#elif defined(SIMD_USE_NEON)
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+    simd4f_t result;
+    for (size_t i = 0; i < SIMD_WIDTH; i++) {
+        result.bits[i] = a.bits[i] & b.bits[i];
+    }
+    return result;
+#endif
+}
+
+/**
+ * Picks lanes from a where the mask is set, and from b everywhere else
+ */
+static inline simd4f_t simd4f_select(simd4f_t mask, simd4f_t a, simd4f_t b) {
+#if defined(SIMD_USE_SSE)
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+#elif defined(SIMD_USE_NEON)
+    return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+#else
+    simd4f_t result;
+    for (size_t i = 0; i < SIMD_WIDTH; i++) {
+        result.bits[i] = (mask.bits[i] & a.bits[i]) | (~mask.bits[i] & b.bits[i]);
+    }
+    return result;
+#endif
+}
+
+/**
+ * Converts a mask into an integer, where bit i is set if lane i is set
+ */
+static inline uint32_t simd4f_mask_bits(simd4f_t mask) {
+#if defined(SIMD_USE_SSE)
+    return _mm_movemask_ps(mask);
+#elif defined(SIMD_USE_NEON)
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+    return vgetq_lane_u32(bits, 0) |
+        (vgetq_lane_u32(bits, 1) << 1) |
+        (vgetq_lane_u32(bits, 2) << 2) |
+        (vgetq_lane_u32(bits, 3) << 3);
+#else
+    uint32_t result = 0;
+    for (size_t i = 0; i < SIMD_WIDTH; i++) {
+        result |= (mask.bits[i] >> 31) << i;
+    }
+    return result;
+#endif
+}
+
+/**
+ * Checks four boxes against a single box at once, returning a bitmask
+ * with bit i set if box i overlaps the single box.  Each set of four
+ * boxes is given one axis at a time
+ */
+static inline uint32_t simd4f_overlap_mask(
+        simd4f_t min_x, simd4f_t min_y, simd4f_t min_z,
+        simd4f_t max_x, simd4f_t max_y, simd4f_t max_z,
+        vec3_t box_min, vec3_t box_max)
+{
+    simd4f_t overlap = simd4f_and(
+        simd4f_less_equal(min_x, simd4f_set1(box_max.x)),
+        simd4f_greater_equal(max_x, simd4f_set1(box_min.x)));
+    overlap = simd4f_and(overlap, simd4f_less_equal(min_y, simd4f_set1(box_max.y)));
+    overlap = simd4f_and(overlap, simd4f_greater_equal(max_y, simd4f_set1(box_min.y)));
+    overlap = simd4f_and(overlap, simd4f_less_equal(min_z, simd4f_set1(box_max.z)));
+    overlap = simd4f_and(overlap, simd4f_greater_equal(max_z, simd4f_set1(box_min.z)));
+    return simd4f_mask_bits(overlap);
+}
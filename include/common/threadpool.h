@@ -0,0 +1,104 @@
+#pragma once
+/**
+ * A simple pool of worker threads for splitting loops across cores.
+ * Work is handed out in chunks, and the calling thread helps out
+ * rather than sitting idle while it waits
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * The most threads a pool can have, including the calling thread
+ */
+#define THREADPOOL_MAX_THREADS 64
+
+/**
+ * Processes a range of items from a parallel loop
+ * @param context Whatever was passed to threadpool_parallel_for()
+ * @param begin The first item to process
+ * @param end One past the last item to process
+ * @param thread_index Which thread is running this range, from 0 to
+ * threadpool_get_thread_count() - 1.  No two threads share an index, so
+ * it can be used to pick per-thread scratch space
+ */
+typedef void (*threadpool_task_t)(void *context, size_t begin, size_t end, size_t thread_index);
+
+struct ThreadPool;
+
+/**
+ * What each worker thread needs to know about itself
+ */
+struct ThreadPoolWorker {
+    struct ThreadPool *pool;
+    size_t thread_index;
+};
+typedef struct ThreadPoolWorker threadpool_worker_t;
+
+/**
+ * A set of worker threads, waiting for loops to run
+ */
+struct ThreadPool {
+    pthread_t *threads;
+    threadpool_worker_t *workers;
+    /**
+     * The number of threads that run each loop, including the calling thread
+     */
+    size_t thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    /**
+     * Counts up every time a loop starts, so workers can tell a new
+     * loop from one they already finished
+     */
+    uint64_t generation;
+    size_t busy_workers;
+    bool stopping;
+
+    /**
+     * The loop currently running
+     */
+    threadpool_task_t task;
+    void *context;
+    size_t item_count;
+    size_t chunk_size;
+    atomic_size_t next_item;
+};
+typedef struct ThreadPool threadpool_t;
+
+/**
+ * @brief Creates a thread pool
+ * @param thread_count How many threads should run each loop, including
+ * the calling thread.  0 uses one thread per processor
+ * @return A pointer to the pool on success, or NULL on failure
+ */
+threadpool_t *threadpool_create(size_t thread_count);
+
+/**
+ * Gets the number of threads that run each loop, including the
+ * calling thread.  A NULL pool runs everything on the calling thread
+ */
+size_t threadpool_get_thread_count(const threadpool_t *pool);
+
+/**
+ * @brief Runs a loop across every thread in the pool, returning once
+ * every item has been processed
+ * @param pool The pool to use.  If NULL, the loop runs on the calling thread
+ * @param item_count The number of items in the loop
+ * @param chunk_size How many items a thread takes at a time.  Larger
+ * chunks have less overhead, smaller chunks balance better
+ * @param task Called for each chunk of items
+ * @param context Passed to every call of task
+ */
+void threadpool_parallel_for(threadpool_t *pool, size_t item_count, size_t chunk_size, threadpool_task_t task, void *context);
+
+/**
+ * @brief Stops and frees a thread pool
+ * @param pool The pool to free
+ */
+void threadpool_destroy(threadpool_t *pool);
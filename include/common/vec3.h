@@ -1,8 +1,14 @@
 #pragma once
 /**
- * Definition and functions for three-dimensional vectors
+ * Definition and functions for three-dimensional vectors.  The basic
+ * arithmetic is static inline, since it runs in nearly every hot loop,
+ * and doesn't check its pointers for NULL; the vec3_batch_*() functions
+ * apply it to whole arrays at once
  */
 
+#include <assert.h>
+#include <stddef.h>
+#include <math.h>
 #include "common/defines.h"
 
 union Vec3 {
@@ -31,43 +37,90 @@ typedef union Vec3 vec3_t;
  * Adds a source vector (multiplied by a factor) into a destination
  * vector
  */
-void vec3_add_to(vec3_t *dest, vec3_t source, phy_real_t factor);
+static inline void vec3_add_to(vec3_t *dest, vec3_t source, phy_real_t factor) {
+    dest->x += source.x * factor;
+    dest->y += source.y * factor;
+    dest->z += source.z * factor;
+}
 
 /**
  * Multiplies a vector by a scalar factor
  */
-void vec3_multiply_by(vec3_t *dest, phy_real_t factor);
+static inline void vec3_multiply_by(vec3_t *dest, phy_real_t factor) {
+    dest->x *= factor;
+    dest->y *= factor;
+    dest->z *= factor;
+}
 
 /**
  * Resets a vector to (0,0,0)
  */
-void vec3_clear(vec3_t *vec);
+static inline void vec3_clear(vec3_t *vec) {
+    vec->x = 0;
+    vec->y = 0;
+    vec->z = 0;
+}
 
 /**
  * Calculates the distance between two vectors
  */
-phy_real_t vec3_distance_to(vec3_t from, vec3_t to);
+static inline phy_real_t vec3_distance_to(vec3_t from, vec3_t to) {
+    phy_real_t dx = to.x - from.x;
+    phy_real_t dy = to.y - from.y;
+    phy_real_t dz = to.z - from.z;
+    return sqrtf(
+        (dx * dx) +
+        (dy * dy) +
+        (dz * dz)
+    );
+}
 
 /**
  * Calculates the square of the distance between two vectors
  */
-phy_real_t vec3_distance_sqr(vec3_t from, vec3_t to);
+static inline phy_real_t vec3_distance_sqr(vec3_t from, vec3_t to) {
+    phy_real_t dx = to.x - from.x;
+    phy_real_t dy = to.y - from.y;
+    phy_real_t dz = to.z - from.z;
+    return
+        (dx * dx) +
+        (dy * dy) +
+        (dz * dz);
+}
 
 /**
  * Calculates the square of a vector's magnitude (x^2 + y^2 + z^2)
  */
-phy_real_t vec3_magnitude_sqr(vec3_t vec);
+static inline phy_real_t vec3_magnitude_sqr(vec3_t vec) {
+    return
+        (vec.x * vec.x) +
+        (vec.y * vec.y) +
+        (vec.z * vec.z);
+}
 
 /**
  * Calculates a vector's magnitude (sqrt(x^2 + y^2 + z^2))
  */
-phy_real_t vec3_magnitude(vec3_t vec);
+static inline phy_real_t vec3_magnitude(vec3_t vec) {
+    return sqrtf(
+        (vec.x * vec.x) +
+        (vec.y * vec.y) +
+        (vec.z * vec.z)
+    );
+}
 
 /**
  * Converts a vector into a unit vector, which has a magnitude of 1,
  * with the same direction as the original vector
  */
-void vec3_unit(vec3_t *vec);
+static inline void vec3_unit(vec3_t *vec) {
+    phy_real_t magnitude = vec3_magnitude(*vec);
+    if (magnitude != 0) {
+        // ensure that we aren't dividing by zero --
+        // we don't want the unit vector to be full of NaNs
+        vec3_multiply_by(vec, 1.0 / magnitude);
+    }
+}
 
 /**
  * Rotates a vector around the X-axis.
@@ -97,13 +150,22 @@ void vec3_rotate(vec3_t *vec, phy_real_t xrot, phy_real_t yrot, phy_real_t zrot)
  * Calculates the cross product of a and b (a x b) and stores the result
  * in the destination vector
  */
-void vec3_cross_product(vec3_t *dest, vec3_t a, vec3_t b);
+static inline void vec3_cross_product(vec3_t *dest, vec3_t a, vec3_t b) {
+    dest->x = (a.y * b.z) - (a.z * b.y);
+    dest->y = (a.z * b.x) - (a.x * b.z);
+    dest->z = (a.x * b.y) - (a.y * b.x);
+}
 
 /**
  * Calculates the dot product of a and b (a * b),
  * equivalent to ||a|| * ||b|| * cos(angle between a and b)
  */
-phy_real_t vec3_dot_product(vec3_t a, vec3_t b);
+static inline phy_real_t vec3_dot_product(vec3_t a, vec3_t b) {
+    return
+        (a.x * b.x) +
+        (a.y * b.y) +
+        (a.z * b.z);
+}
 
 /**
  * Gets the portion of a given vector
@@ -114,6 +176,53 @@ phy_real_t vec3_dot_product(vec3_t a, vec3_t b);
  */
 void vec3_get_portion_in_direction(vec3_t *result, vec3_t original, vec3_t direction);
 
+/**
+ * @brief Adds each source vector (multiplied by a factor) into the
+ * matching destination vector, like vec3_add_to()
+ * @param dest The vectors to add to
+ * @param source The vectors to add
+ * @param factor What to multiply each source vector by
+ * @param count The number of vectors in each array
+ */
+void vec3_batch_add_to(vec3_t *dest, const vec3_t *source, phy_real_t factor, size_t count);
+
+/**
+ * @brief Multiplies every vector in an array by a scalar factor
+ * @param dest The vectors to multiply
+ * @param factor The factor to multiply by
+ * @param count The number of vectors
+ */
+void vec3_batch_multiply_by(vec3_t *dest, phy_real_t factor, size_t count);
+
+/**
+ * @brief Calculates the dot product of each pair of vectors
+ * @param dest Where to store each dot product
+ * @param a The first vector of each pair
+ * @param b The second vector of each pair
+ * @param count The number of pairs
+ */
+void vec3_batch_dot_product(phy_real_t *dest, const vec3_t *a, const vec3_t *b, size_t count);
+
+/**
+ * @brief Rotates each vector around the Z-, Y-, then X-axes, like
+ * vec3_rotate(), using the approximations in common/fastmath.h
+ * @param vecs The vectors to rotate
+ * @param xrot Each vector's rotation around the X-axis, in radians
+ * @param yrot Each vector's rotation around the Y-axis, in radians
+ * @param zrot Each vector's rotation around the Z-axis, in radians
+ * @param count The number of vectors
+ */
+void vec3_batch_rotate(vec3_t *vecs, const phy_real_t *xrot, const phy_real_t *yrot, const phy_real_t *zrot, size_t count);
+
+/**
+ * @brief Converts every vector in an array into a unit vector, like
+ * vec3_unit(), using the approximations in common/fastmath.h.  Vectors
+ * too short to normalize are left unchanged
+ * @param vecs The vectors to convert
+ * @param count The number of vectors
+ */
+void vec3_batch_unit(vec3_t *vecs, size_t count);
+
 #ifdef _STDIO_H
 
 /**
@@ -1,9 +1,12 @@
 #pragma once
 /**
  * Definitions and utility functions for 4-dimensional vectors and
- * quaternions
+ * quaternions.  Like vec3.h, the basic arithmetic is static inline.
+ * SIMD-backed versions of the quaternion math are in vec4a.h
  */
 
+#include <assert.h>
+#include <stddef.h>
 #include <math.h>
 #include "common/defines.h"
 #include "common/vec3.h"
@@ -37,27 +40,59 @@ typedef union Vec4 quaternion_t;
  * Adds a source vector (multiplied by a factor) into a destination
  * vector
  */
-void vec4_add_to(vec4_t *dest, vec4_t source, phy_real_t factor);
+static inline void vec4_add_to(vec4_t *dest, vec4_t source, phy_real_t factor) {
+    dest->x += source.x * factor;
+    dest->y += source.y * factor;
+    dest->z += source.z * factor;
+    dest->w += source.w * factor;
+}
 
 /**
  * Multiplies a vector by a scalar factor
  */
-void vec4_multiply_by(vec4_t *vec, phy_real_t factor);
+static inline void vec4_multiply_by(vec4_t *vec, phy_real_t factor) {
+    vec->x *= factor;
+    vec->y *= factor;
+    vec->z *= factor;
+    vec->w *= factor;
+}
 
 /**
  * Resets a vector to (0,0,0,0)
  */
-void vec4_clear(vec4_t *vec);
+static inline void vec4_clear(vec4_t *vec) {
+    vec->x = 0;
+    vec->y = 0;
+    vec->z = 0;
+    vec->w = 0;
+}
 
 /**
  * Calculates the distance between two vectors
  */
-phy_real_t vec4_distance_to(vec4_t from, vec4_t to);
+static inline phy_real_t vec4_distance_to(vec4_t from, vec4_t to) {
+    phy_real_t dx = to.x - from.x;
+    phy_real_t dy = to.y - from.y;
+    phy_real_t dz = to.z - from.z;
+    phy_real_t dw = to.w - from.w;
+    return sqrtf(
+        (dx * dx) +
+        (dy * dy) +
+        (dz * dz) +
+        (dw * dw)
+    );
+}
 
 /**
  * Calculates the square of a vector's magnitude (x^2 + y^2 + z^2 + w^2)
  */
-phy_real_t vec4_magnitude_sqr(vec4_t vec);
+static inline phy_real_t vec4_magnitude_sqr(vec4_t vec) {
+    return
+        (vec.x * vec.x) +
+        (vec.y * vec.y) +
+        (vec.z * vec.z) +
+        (vec.w * vec.w);
+}
 
 /**
  * Calculates the square of a quaternion's magnitude
@@ -68,7 +103,14 @@ phy_real_t vec4_magnitude_sqr(vec4_t vec);
 /**
  * Calculates a vector's magnitude (sqrt(x^2 + y^2 + z^2 + w^2))
  */
-phy_real_t vec4_magnitude(vec4_t vec);
+static inline phy_real_t vec4_magnitude(vec4_t vec) {
+    return sqrtf(
+        (vec.x * vec.x) +
+        (vec.y * vec.y) +
+        (vec.z * vec.z) +
+        (vec.w * vec.w)
+    );
+}
 
 /**
  * Calculates a quaternion's magnitude (sqrt(x^2 + y^2 + z^2 + w^2))
@@ -79,22 +121,46 @@ phy_real_t vec4_magnitude(vec4_t vec);
  * Converts a vector into a unit vector, which has a magnitude of 1,
  * with the same direction as the original vector
  */
-void vec4_unit(vec4_t *vec);
+static inline void vec4_unit(vec4_t *vec) {
+    phy_real_t magnitude = vec4_magnitude(*vec);
+    vec4_multiply_by(vec, 1 / magnitude);
+}
 
 /**
  * Calculates the cross product of a and b (a x b) and stores the result
  * in the destination vector
  */
-void vec4_cross_product(vec4_t *dest, vec4_t a, vec4_t b);
+static inline void vec4_cross_product(vec4_t *dest, vec4_t a, vec4_t b) {
+    // w is the scalar part, to match quaternion_make()
+    phy_real_t x =
+        (a.w * b.x) + (a.x * b.w) + (a.y * b.z) - (a.z * b.y);
+    phy_real_t y =
+        (a.w * b.y) - (a.x * b.z) + (a.y * b.w) + (a.z * b.x);
+    phy_real_t z =
+        (a.w * b.z) + (a.x * b.y) - (a.y * b.x) + (a.z * b.w);
+    phy_real_t w =
+        (a.w * b.w) - (a.x * b.x) - (a.y * b.y) - (a.z * b.z);
+    dest->x = x;
+    dest->y = y;
+    dest->z = z;
+    dest->w = w;
+}
 
 /**
  * Calculates the dot product of a and b (a * b)
  */
-phy_real_t vec4_dot_product(vec4_t a, vec4_t b);
+static inline phy_real_t vec4_dot_product(vec4_t a, vec4_t b) {
+    return
+        (a.x * b.x) +
+        (a.y * b.y) +
+        (a.z * b.z) +
+        (a.w * b.w);
+}
 
 /**
  * Calculates the product of a and b (a x b) and stores the result
- * in the destination vector
+ * in the destination vector.  The resulting rotation is the same as
+ * rotating by b, then by a
  */
 #define quaternion_product(dest, a, b) vec4_cross_product(dest, a, b)
 
@@ -105,7 +171,24 @@ phy_real_t vec4_dot_product(vec4_t a, vec4_t b);
 void quaternion_conjugate(quaternion_t *q);
 
 /**
- * Rotates a vector using a quaternion.
+ * Calculates the inverse of a unit quaternion, which is just its
+ * conjugate.  Unlike quaternion_conjugate(), this skips dividing by the
+ * magnitude, so it's only correct for unit quaternions (which every
+ * rotation should be)
+ */
+static inline quaternion_t quaternion_unit_inverse(quaternion_t q) {
+    return vec4_make(-q.x, -q.y, -q.z, q.w);
+}
+
+/**
+ * Creates a quaternion from a set of euler angles (in radians).
+ * The rotation is applied around the x-axis first, then the y-axis,
+ * then the z-axis
+ */
+quaternion_t quaternion_from_euler(vec3_t angles);
+
+/**
+ * Rotates a vector using a unit quaternion.
  * This variant adhieres closest to the mathmatical definition,
  * but is slower.
  */
@@ -115,9 +198,49 @@ void vec3_rotate_by_quaternion_pure(vec3_t *dest, vec3_t vec, quaternion_t q);
  * Rotates a vector by a quaternion.
  * This variant uses math tricks to be faster.
  */
-void vec3_rotate_by_quaternion_fast(vec3_t *dest, vec3_t source, quaternion_t q);
+static inline void vec3_rotate_by_quaternion_fast(vec3_t *dest, vec3_t source, quaternion_t q) {
+    // Extract the vector part of the quaternion
+    vec3_t q_vec = vec3_make(q.x, q.y, q.z);
+
+    // Extract the scalar part of the quaternion
+    phy_real_t scalar = q.w;
+
+    // calculate dot products
+    phy_real_t dot_q_s = vec3_dot_product(q_vec, source);
+    phy_real_t dot_q_q = vec3_dot_product(q_vec, q_vec);
+
+    // calculate cross products
+    vec3_t cross_q_s;
+    vec3_cross_product(&cross_q_s, q_vec, source);
+
+    // Do the math
+    /// vprime = 2.0f * dot(q_vec, source) * q_vec
+    ///        + (scalar*scalar - dot(q_vec, q_vec)) * source
+    ///        + 2.0f * scalar * cross(q_vec, source);
+
+    /// vprime = 2.0f * dot(q_vec, source) * q_vec
+    *dest = q_vec;
+    vec3_multiply_by(dest, 2.0 * dot_q_s);
+
+    ///        + (scalar*scalar - dot(q_vec, q_vec)) * source
+    vec3_add_to(dest, source, scalar * scalar - dot_q_q);
+
+    ///        + 2.0f * scalar * cross(q_vec, source);
+    vec3_add_to(dest, cross_q_s, 2.0 * scalar);
+}
 
 /**
  * Rotates a vector by a quaternion
  */
 #define vec3_rotate_by_quaternion(dest, source, q) vec3_rotate_by_quaternion_fast(dest, source, q)
+
+/**
+ * @brief Rotates every vector in an array by the same unit quaternion.
+ * The quaternion is turned into a matrix once, so this is much cheaper
+ * per vector than vec3_rotate_by_quaternion()
+ * @param dest Where to store the rotated vectors (can be the same as source)
+ * @param source The vectors to rotate
+ * @param count The number of vectors
+ * @param q The rotation
+ */
+void vec3_batch_rotate_by_quaternion(vec3_t *dest, const vec3_t *source, size_t count, quaternion_t q);
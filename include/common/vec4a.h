@@ -0,0 +1,115 @@
+#pragma once
+/**
+ * Aligned, SIMD-backed counterparts to vec4_t and quaternion_t, for code
+ * that does quaternion math on every step.  A vec4a_t holds all four
+ * components in one simd4f_t, so a quaternion product is four multiplies
+ * and three adds on whole registers instead of sixteen scalar multiplies.
+ * vec4_t itself stays a plain array, since bodies, articulations and the
+ * viewer's cglm calls depend on its layout; convert with vec4a_from_vec4()
+ * and vec4a_to_vec4() at the edges of a calculation
+ */
+
+#include "common/defines.h"
+#include "common/simd.h"
+#include "common/vec3.h"
+#include "common/vec4.h"
+
+union Vec4a {
+    simd4f_t simd;
+    _Alignas(16) phy_real_t raw[4];
+    struct {
+        phy_real_t x;
+        phy_real_t y;
+        phy_real_t z;
+        phy_real_t w;
+    };
+};
+typedef union Vec4a vec4a_t;
+
+/**
+ * A quaternion in a single simd4f_t, with w as the real part (just like
+ * quaternion_t)
+ */
+typedef union Vec4a quaternion_a_t;
+
+static inline vec4a_t vec4a_make(phy_real_t x, phy_real_t y, phy_real_t z, phy_real_t w) {
+    return (vec4a_t){ .simd = simd4f_set(x, y, z, w) };
+}
+
+static inline vec4a_t vec4a_from_vec4(vec4_t vec) {
+    return (vec4a_t){ .simd = simd4f_load(vec.raw) };
+}
+
+static inline vec4_t vec4a_to_vec4(vec4a_t vec) {
+    vec4_t result;
+    simd4f_store(result.raw, vec.simd);
+    return result;
+}
+
+static inline vec4a_t vec4a_add(vec4a_t a, vec4a_t b) {
+    return (vec4a_t){ .simd = simd4f_add(a.simd, b.simd) };
+}
+
+static inline vec4a_t vec4a_sub(vec4a_t a, vec4a_t b) {
+    return (vec4a_t){ .simd = simd4f_sub(a.simd, b.simd) };
+}
+
+static inline vec4a_t vec4a_scale(vec4a_t vec, phy_real_t factor) {
+    return (vec4a_t){ .simd = simd4f_mul(vec.simd, simd4f_set1(factor)) };
+}
+
+/**
+ * Calculates a + b * factor, like vec4_add_to()
+ */
+static inline vec4a_t vec4a_add_scaled(vec4a_t a, vec4a_t b, phy_real_t factor) {
+    return (vec4a_t){ .simd = simd4f_add(a.simd, simd4f_mul(b.simd, simd4f_set1(factor))) };
+}
+
+static inline phy_real_t vec4a_dot_product(vec4a_t a, vec4a_t b) {
+    vec4a_t sum = { .simd = simd4f_sum(simd4f_mul(a.simd, b.simd)) };
+    return sum.x;
+}
+
+/**
+ * Scales a vector to a magnitude of 1, without leaving the registers
+ */
+static inline vec4a_t vec4a_unit(vec4a_t vec) {
+    simd4f_t magnitude = simd4f_sqrt(simd4f_sum(simd4f_mul(vec.simd, vec.simd)));
+    return (vec4a_t){ .simd = simd4f_div(vec.simd, magnitude) };
+}
+
+/**
+ * Calculates the product of a and b, like quaternion_product().  Each
+ * lane adds up the same terms in the same order, so the result matches
+ * quaternion_product() exactly
+ */
+static inline quaternion_a_t quaternion_a_product(quaternion_a_t a, quaternion_a_t b) {
+    // b's components, reordered and signed to line up with a.x, a.y and a.z
+    simd4f_t b_for_x = simd4f_mul(simd4f_reverse(b.simd), simd4f_set(1, -1, 1, -1));
+    simd4f_t b_for_y = simd4f_mul(simd4f_swap_halves(b.simd), simd4f_set(1, 1, -1, -1));
+    simd4f_t b_for_z = simd4f_mul(simd4f_swap_pairs(b.simd), simd4f_set(-1, 1, 1, -1));
+
+    simd4f_t result = simd4f_mul(simd4f_set1(a.w), b.simd);
+    result = simd4f_add(result, simd4f_mul(simd4f_set1(a.x), b_for_x));
+    result = simd4f_add(result, simd4f_mul(simd4f_set1(a.y), b_for_y));
+    result = simd4f_add(result, simd4f_mul(simd4f_set1(a.z), b_for_z));
+    return (quaternion_a_t){ .simd = result };
+}
+
+/**
+ * Calculates the inverse of a unit quaternion, like
+ * quaternion_unit_inverse()
+ */
+static inline quaternion_a_t quaternion_a_unit_inverse(quaternion_a_t q) {
+    return (quaternion_a_t){ .simd = simd4f_mul(q.simd, simd4f_set(-1, -1, -1, 1)) };
+}
+
+/**
+ * Rotates a vector by a unit quaternion (q * v * q^-1), with two
+ * SIMD products
+ */
+static inline vec3_t vec3_rotate_by_quaternion_a(vec3_t vec, quaternion_a_t q) {
+    quaternion_a_t rotated = quaternion_a_product(q, vec4a_make(vec.x, vec.y, vec.z, 0));
+    rotated = quaternion_a_product(rotated, quaternion_a_unit_inverse(q));
+    return vec3_make(rotated.x, rotated.y, rotated.z);
+}
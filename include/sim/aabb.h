@@ -69,6 +69,18 @@ bool bbox_is_point_inside(bbox_t box, vec3_t point);
  */
 bool bbox_is_bbox_inside(bbox_t boxA, bbox_t boxB);
 
+/**
+ * Gets the corner of the AABB with the smallest x, y, and z values,
+ * in world space
+ */
+vec3_t bbox_get_min(bbox_t box);
+
+/**
+ * Gets the corner of the AABB with the largest x, y, and z values,
+ * in world space
+ */
+vec3_t bbox_get_max(bbox_t box);
+
 /**
  * 'Clamps' a point to the closest point within the bounds of the AABB
  */
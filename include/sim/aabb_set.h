@@ -0,0 +1,142 @@
+#pragma once
+/**
+ * A flat set of world-space AABBs, stored as one array per bound
+ * (structure of arrays), for broadphases.  Unlike bbox_t, whose bounds
+ * are relative to a position, each box is just its min and max corner,
+ * so overlap tests are nothing but comparisons.  One box is tested
+ * against 4, 8 or 16 of the set's boxes per instruction (see
+ * common/cpu.h), and the results come back as bitmasks
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define BBOX_SET_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define BBOX_SET_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define BBOX_SET_ERROR_ALLOC -3
+
+/**
+ * The number of boxes the arrays are padded to a multiple of, so the
+ * widest kernel never needs a scalar tail.  Padding boxes have NaN
+ * bounds, so they never overlap anything, even a box with infinite bounds
+ */
+#define BBOX_SET_ALIGNMENT 16
+
+/**
+ * Overlap masks are arrays of these; bit j % BBOX_SET_MASK_BITS of word
+ * j / BBOX_SET_MASK_BITS is set if box j overlaps
+ */
+typedef uint32_t bbox_set_mask_t;
+#define BBOX_SET_MASK_BITS 32
+
+/**
+ * @brief The number of mask words needed to hold one bit per box
+ */
+#define bbox_set_mask_words(box_count) (((box_count) + BBOX_SET_MASK_BITS - 1) / BBOX_SET_MASK_BITS)
+
+/**
+ * A set of AABBs.  Box i spans (min_x[i], min_y[i], min_z[i]) to
+ * (max_x[i], max_y[i], max_z[i])
+ */
+struct BoundingBoxSet {
+    size_t count;
+    size_t capacity;
+    phy_real_t *min_x;
+    phy_real_t *min_y;
+    phy_real_t *min_z;
+    phy_real_t *max_x;
+    phy_real_t *max_y;
+    phy_real_t *max_z;
+};
+typedef struct BoundingBoxSet bbox_set_t;
+
+/**
+ * A pair of overlapping boxes, by index, with a < b
+ */
+struct BoundingBoxPair {
+    uint32_t a;
+    uint32_t b;
+};
+typedef struct BoundingBoxPair bbox_pair_t;
+
+/**
+ * @brief Creates an empty set of boxes
+ * @param capacity The number of boxes to make room for.  More room is
+ * made as needed, so this is only a hint
+ * @return A pointer to the set on success, or NULL on failure
+ */
+bbox_set_t *bbox_set_create(size_t capacity);
+
+/**
+ * @brief Adds a box to a set.  The box's index is the number of boxes
+ * added before it
+ * @param set The set to add to
+ * @param min The box's corner with the smallest x, y and z values
+ * @param max The box's corner with the largest x, y and z values
+ * @return BBOX_SET_SUCCESS on success, or an error code on failure
+ */
+int bbox_set_add(bbox_set_t *set, vec3_t min, vec3_t max);
+
+/**
+ * @brief Adds the world-space bounds of a bbox_t to a set
+ * @param set The set to add to
+ * @param box The box to add
+ * @return BBOX_SET_SUCCESS on success, or an error code on failure
+ */
+int bbox_set_add_bbox(bbox_set_t *set, bbox_t box);
+
+/**
+ * @brief Moves one of a set's boxes
+ * @param set The set the box is in
+ * @param index The box's index
+ * @param min The box's new min corner
+ * @param max The box's new max corner
+ * @return BBOX_SET_SUCCESS on success, or an error code on failure
+ */
+int bbox_set_update(bbox_set_t *set, size_t index, vec3_t min, vec3_t max);
+
+/**
+ * @brief Removes every box from a set, keeping its memory
+ * @param set The set to clear
+ */
+void bbox_set_clear(bbox_set_t *set);
+
+/**
+ * @brief Finds which of a set's boxes overlap a query box.  Touching
+ * boxes count as overlapping, just like bbox_is_bbox_inside()
+ * @param set The set to search
+ * @param min The query box's min corner
+ * @param max The query box's max corner
+ * @param mask Where to store the result, bbox_set_mask_words(set->count) words long
+ */
+void bbox_set_query_mask(const bbox_set_t *set, vec3_t min, vec3_t max, bbox_set_mask_t *mask);
+
+/**
+ * @brief Finds every pair of overlapping boxes in a set
+ * @param set The set to search
+ * @param pairs Where to store the pairs (can be null if max_pairs is 0).
+ * Pairs are ordered by a, then b
+ * @param max_pairs The number of pairs there is room for
+ * @return The number of overlapping pairs.  If this is more than
+ * max_pairs, only the first max_pairs were stored
+ */
+size_t bbox_set_find_pairs(const bbox_set_t *set, bbox_pair_t *pairs, size_t max_pairs);
+
+/**
+ * @brief Frees a set of boxes
+ * @param set The set to free
+ */
+void bbox_set_destroy(bbox_set_t *set);
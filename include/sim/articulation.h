@@ -0,0 +1,231 @@
+#pragma once
+/**
+ * Reduced-coordinate articulations (robot arms, ragdolls, ...): trees of
+ * links connected by joints, stepped with Featherstone's articulated-body
+ * algorithm.  Rather than simulating every link as a free body and
+ * holding the joints together with stiff springs, each link only stores
+ * the coordinates its joint allows it to move in, so joints can never
+ * pull apart however long the step, and each step costs O(n) in the
+ * number of links.
+ *
+ * Each link has its own frame, with its origin at the joint connecting
+ * it to its parent.  At rest, a link's frame has the same orientation as
+ * its parent's; joint axes, centers of mass and inertias are all given
+ * in the link's frame
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common/vec3.h"
+#include "common/vec4.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define ARTICULATION_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define ARTICULATION_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define ARTICULATION_ERROR_ALLOC -3
+
+/**
+ * The parent of a link attached to the world instead of another link
+ */
+#define ARTICULATION_NO_PARENT (-1)
+
+/**
+ * The most coordinates (degrees of freedom) a joint can have
+ */
+#define ARTICULATION_MAX_JOINT_DOF 6
+
+/**
+ * How a link can move relative to its parent
+ */
+enum ArticulationJointKind {
+    /**
+     * Rotates around an axis; one coordinate, the angle
+     */
+    ARTICULATION_JOINT_REVOLUTE,
+    /**
+     * Slides along an axis; one coordinate, the distance
+     */
+    ARTICULATION_JOINT_PRISMATIC,
+    /**
+     * Rotates freely around the joint (a ball-and-socket joint); the
+     * velocity is the link's angular velocity, in the link's frame
+     */
+    ARTICULATION_JOINT_SPHERICAL,
+    /**
+     * Moves freely, for the root of a ragdoll.  The velocity is the
+     * link's angular velocity then its linear velocity, both in the
+     * link's frame
+     */
+    ARTICULATION_JOINT_FLOATING,
+};
+typedef enum ArticulationJointKind articulation_joint_kind_t;
+
+/**
+ * A single link of an articulation, and the joint attaching it to its parent
+ */
+struct ArticulationLink {
+    /**
+     * The index of the link's parent, or ARTICULATION_NO_PARENT.
+     * A link's parent always comes before it
+     */
+    int32_t parent;
+    articulation_joint_kind_t joint_kind;
+    /**
+     * Where the joint is, in the parent's frame (or the world, if the
+     * link has no parent)
+     */
+    vec3_t joint_position;
+    /**
+     * The unit axis a revolute or prismatic joint moves along
+     */
+    vec3_t axis;
+
+    phy_real_t mass;
+    vec3_t center_of_mass;
+    /**
+     * The moments of inertia around the center of mass, along the link's axes
+     */
+    vec3_t inertia;
+
+    /**
+     * The joint's coordinate, for revolute and prismatic joints
+     */
+    phy_real_t coordinate;
+    /**
+     * How far the joint has moved the link from the joint's position.
+     * Only floating and prismatic joints translate
+     */
+    vec3_t translation;
+    /**
+     * How far the joint has rotated the link
+     */
+    quaternion_t rotation;
+    /**
+     * The rate each of the joint's coordinates is changing
+     */
+    phy_real_t velocity[ARTICULATION_MAX_JOINT_DOF];
+    /**
+     * The force (or torque) a motor applies along each of the joint's
+     * coordinates.  Kept between steps
+     */
+    phy_real_t joint_force[ARTICULATION_MAX_JOINT_DOF];
+    /**
+     * Resists the joint's motion, in force per unit of velocity.  Damping
+     * is applied implicitly, so any amount of it is stable
+     */
+    phy_real_t damping;
+
+    /**
+     * Forces and torques on the link's center of mass, in world space.
+     * Just like a body's, these are cleared after each step
+     */
+    vec3_t net_force;
+    vec3_t net_torque;
+
+    /**
+     * The link's frame, in world space, as of the end of the last step
+     */
+    vec3_t world_position;
+    quaternion_t world_rotation;
+};
+typedef struct ArticulationLink articulation_link_t;
+
+/**
+ * A tree of links
+ */
+struct Articulation {
+    articulation_link_t *links;
+    size_t link_count;
+    size_t link_capacity;
+    vec3_t gravity;
+    /**
+     * [internal] values used while stepping, one per link
+     */
+    struct ArticulationWorkspace *workspace;
+};
+typedef struct Articulation articulation_t;
+
+/**
+ * @brief Creates an articulation with no links
+ * @param gravity The acceleration due to gravity
+ * @return A pointer to the articulation on success, or NULL on failure
+ */
+articulation_t *articulation_create(vec3_t gravity);
+
+/**
+ * @brief Adds a link to an articulation, with its joint at rest.  The
+ * link's index is the number of links added before it
+ * @param articulation The articulation to add to
+ * @param parent The index of the link's parent, or ARTICULATION_NO_PARENT
+ * @param joint_kind How the link can move relative to its parent
+ * @param joint_position Where the joint is, in the parent's frame
+ * @param axis The axis a revolute or prismatic joint moves along (ignored otherwise)
+ * @param mass The link's mass.  Must be positive
+ * @param center_of_mass The link's center of mass, relative to the joint
+ * @param inertia The moments of inertia around the center of mass
+ * @return ARTICULATION_SUCCESS on success, or an error code on failure
+ */
+int articulation_add_link(articulation_t *articulation, int32_t parent, articulation_joint_kind_t joint_kind,
+    vec3_t joint_position, vec3_t axis, phy_real_t mass, vec3_t center_of_mass, vec3_t inertia);
+
+/**
+ * @brief Gets the number of coordinates a kind of joint has
+ * @param joint_kind The kind of joint
+ * @return The number of coordinates, or 0 if the kind is invalid
+ */
+size_t articulation_joint_dof(articulation_joint_kind_t joint_kind);
+
+/**
+ * @brief Steps every link of an articulation forward in time, then
+ * clears the links' forces and torques.  Joints are integrated
+ * explicitly, so a chain whose links swing faster than about once per
+ * substep (long chains of short, light links) needs more substeps to
+ * stay stable; the articulated-body algorithm is O(n), so substeps are cheap
+ * @param articulation The articulation to step
+ * @param dt The length of the step
+ * @param substep_count How many substeps to split the step into
+ * @return ARTICULATION_SUCCESS on success, or an error code on failure.
+ * On failure, the links are left as of the last substep that succeeded
+ */
+int articulation_step(articulation_t *articulation, phy_real_t dt, size_t substep_count);
+
+/**
+ * @brief Recalculates every link's world_position and world_rotation
+ * from its joint, e.g. after setting joint coordinates by hand.  Stepping
+ * does this automatically
+ * @param articulation The articulation to update
+ */
+void articulation_update_transforms(articulation_t *articulation);
+
+/**
+ * @brief Sets a revolute or prismatic joint's coordinate, keeping its
+ * rotation and translation in sync
+ * @param articulation The articulation the link is in
+ * @param link The index of the link
+ * @param coordinate The joint's new angle or distance
+ * @return ARTICULATION_SUCCESS on success, or an error code on failure
+ */
+int articulation_set_coordinate(articulation_t *articulation, size_t link, phy_real_t coordinate);
+
+/**
+ * @brief Calculates the kinetic energy of every link combined
+ * @param articulation The articulation to measure
+ * @return The kinetic energy
+ */
+phy_real_t articulation_kinetic_energy(const articulation_t *articulation);
+
+/**
+ * @brief Frees an articulation
+ * @param articulation The articulation to free
+ */
+void articulation_destroy(articulation_t *articulation);
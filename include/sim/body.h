@@ -3,7 +3,24 @@
  * Definitions and utility functions for a rigidbody/particle
  */
 
+ #include <stdint.h>
+ #include <stdbool.h>
  #include "common/vec3.h"
+ #include "common/vec4.h"
+ #include "common/mat3x3.h"
+ #include "sim/potential.h"
+ #include "sim/periodic.h"
+
+/**
+ * The gravitational constant used by every gravity function
+ */
+#define PHY_GRAVITATIONAL_CONSTANT 1 /* 6.67430E-11 */
+
+/**
+ * Marks a body as fast-moving, so it is swept along its path each step
+ * instead of jumping straight to its new position (see sim/ccd.h)
+ */
+#define BODY_FLAG_CONTINUOUS (1u << 0)
 
 /**
  * Represents a dynamic element of the physics engine--something that
@@ -11,26 +28,96 @@
  */
 struct Body {
     vec3_t position;
-    vec3_t rotation;
+    /**
+     * The body's orientation, as a unit quaternion.  Use
+     * body_set_rotation() to change it, so rotation_matrix stays in sync
+     */
+    quaternion_t rotation;
     vec3_t velocity;
+    /**
+     * The body's angular velocity, in world space
+     */
     vec3_t angular_velocity;
     phy_real_t mass;
+    /**
+     * The body's inertia tensor around its center of mass, and its
+     * inverse, in the body's own (unrotated) frame.  Use
+     * body_set_inertia() to change them
+     */
+    mat3x3_t inertia;
+    mat3x3_t inverse_inertia;
+    /**
+     * rotation, as a matrix that takes directions from the body's frame
+     * into world space.  Updated whenever the body is stepped, so
+     * collision, solvers and rendering can share it rather than each
+     * converting rotation themselves
+     */
+    mat3x3_t rotation_matrix;
     phy_real_t static_friction;
     phy_real_t kinetic_friction;
     vec3_t net_force;
     vec3_t net_torque;
+    /**
+     * Any combination of the BODY_FLAG_* values
+     */
+    uint32_t flags;
 };
 typedef struct Body body_t;
 
 /**
- * Constructs a body from its component parts
+ * Constructs a body from its component parts.  The body's inertia tensor
+ * starts out as mass times the identity; use body_set_inertia() to give
+ * it its shape's actual inertia
  */
 void body_make(body_t *body,
- vec3_t position, vec3_t rotation,
+ vec3_t position, quaternion_t rotation,
  vec3_t velocity, vec3_t angular_velocity,
  phy_real_t mass,
  phy_real_t static_friction, phy_real_t kinetic_friction);
 
+/**
+ * @brief Sets a body's orientation, and updates its rotation matrix
+ * @param body The body to rotate
+ * @param rotation The body's new orientation.  Normalized before it is stored
+ */
+void body_set_rotation(body_t *body, quaternion_t rotation);
+
+/**
+ * @brief Recalculates a body's rotation matrix from its rotation.  Only
+ * needed if rotation is changed directly
+ * @param body The body to update
+ */
+void body_update_rotation_matrix(body_t *body);
+
+/**
+ * @brief Sets a body's inertia tensor
+ * @param body The body to change
+ * @param inertia The inertia tensor around the body's center of mass, in
+ * the body's own frame
+ * @return true on success, or false if the tensor can't be inverted (the
+ * body is unchanged)
+ */
+bool body_set_inertia(body_t *body, mat3x3_t inertia);
+
+/**
+ * @brief Multiplies a vector by a body's inverse inertia tensor, in world
+ * space, to find the angular acceleration a torque would cause
+ * @param body The body the torque is applied to
+ * @param torque The torque, in world space
+ * @return The angular acceleration, in world space
+ */
+vec3_t phy_body_get_angular_acceleration(const body_t *body, vec3_t torque);
+
+/**
+ * @brief Applies a torque to a body's angular velocity over dt, then
+ * turns its orientation by the new angular velocity and updates its
+ * rotation matrix
+ * @param body The body to rotate
+ * @param torque The torque, in world space
+ * @param dt The length of the step
+ */
+void phy_body_integrate_rotation(body_t *body, vec3_t torque, phy_real_t dt);
+
 /**
  * Adds a force to the body.
  * Forces must be added every physics step they are affecting the body
@@ -57,6 +144,25 @@ void phy_body_add_force_and_torque(body_t *body, vec3_t force, vec3_t applied_at
  */
 void phy_body_add_gravity_force(body_t *a, body_t *b);
 
+/**
+ * Like phy_body_add_gravity_force(), but the bodies pull on each
+ * other's nearest images in a periodic box (can be null)
+ */
+void phy_body_add_gravity_force_periodic(body_t *a, body_t *b, const periodic_box_t *box);
+
+/**
+ * Calculates the force a pair potential exerts between two bodies,
+ * then adds that force to both of them.  Does nothing if the bodies
+ * are further apart than the potential's cutoff
+ */
+void phy_body_add_pair_force(body_t *a, body_t *b, const pair_potential_t *potential);
+
+/**
+ * Like phy_body_add_pair_force(), but the bodies interact with each
+ * other's nearest images in a periodic box (can be null)
+ */
+void phy_body_add_pair_force_periodic(body_t *a, body_t *b, const pair_potential_t *potential, const periodic_box_t *box);
+
 /**
  * Given a normal force by a on b,
  * adds collision-based forces on both a and b
@@ -83,3 +189,9 @@ void phy_body_add_drag_force(body_t *body, phy_real_t drag_coefficient);
  * step they are active
  */
 void phy_body_step(body_t *body);
+
+/**
+ * Steps a body like phy_body_step(), then wraps it back inside a
+ * periodic box if it left through one of the box's faces
+ */
+void phy_body_step_periodic(body_t *body, const periodic_box_t *box);
@@ -0,0 +1,156 @@
+#pragma once
+/**
+ * A Bounding Volume Hierarchy (BVH): a tree of bounding boxes used to
+ * quickly find which items overlap a given region.  Each node holds
+ * the bounds of up to BVH_WIDTH children side-by-side, so a whole node
+ * can be tested at once
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/defines.h"
+#include "sim/aabb.h"
+
+/**
+ * The number of children each BVH node holds
+ */
+#define BVH_WIDTH 4
+
+/**
+ * The most items a single leaf of the tree will hold
+ */
+#define BVH_LEAF_SIZE 4
+
+/**
+ * The deepest a BVH can get.  Since the tree is built from median
+ * splits, it won't come anywhere near this
+ */
+#define BVH_MAX_DEPTH 64
+
+/**
+ * Marks a child slot in a node as unused
+ */
+#define BVH_EMPTY UINT32_MAX
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define BVH_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define BVH_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define BVH_ERROR_ALLOC -3
+
+/**
+ * A single node of a BVH.  Bounds are stored per-axis so that all
+ * of a node's children can be checked together
+ */
+struct BvhNode {
+    phy_real_t min_x[BVH_WIDTH];
+    phy_real_t min_y[BVH_WIDTH];
+    phy_real_t min_z[BVH_WIDTH];
+    phy_real_t max_x[BVH_WIDTH];
+    phy_real_t max_y[BVH_WIDTH];
+    phy_real_t max_z[BVH_WIDTH];
+    /**
+     * For an inner child, the index of its node.  For a leaf, the
+     * index of its first item in the BVH's item array.  BVH_EMPTY if
+     * the slot is unused
+     */
+    uint32_t child[BVH_WIDTH];
+    /**
+     * The number of items in a leaf, or 0 if the child is a node
+     */
+    uint8_t item_count[BVH_WIDTH];
+};
+typedef struct BvhNode bvh_node_t;
+
+/**
+ * A 4-wide Bounding Volume Hierarchy over a set of items
+ */
+struct BoundingVolumeHierarchy {
+    /**
+     * The tree's nodes.  The root is always the first node, and every
+     * node comes before its children
+     */
+    bvh_node_t *nodes;
+    size_t node_count;
+    size_t node_capacity;
+    /**
+     * The indices of the items the tree was built from, reordered so
+     * that each leaf covers a contiguous range
+     */
+    uint32_t *items;
+    size_t item_count;
+};
+typedef struct BoundingVolumeHierarchy bvh_t;
+
+/**
+ * Called for each leaf found while walking a BVH
+ * @param context Whatever was passed along with the visitor
+ * @param items The indices of the items in the leaf
+ * @param item_count The number of items in the leaf
+ */
+typedef void (*bvh_leaf_visitor_t)(void *context, const uint32_t *items, size_t item_count);
+
+/**
+ * @brief Builds a BVH over a set of items
+ * @param bounds The bounding box of each item
+ * @param count The number of items
+ * @return A pointer to the BVH on success, or NULL on failure
+ */
+bvh_t *bvh_create(const bbox_t *bounds, size_t count);
+
+/**
+ * @brief Updates the bounds stored in the tree without changing its
+ * structure.  Much cheaper than rebuilding, but the tree gets less
+ * efficient the further items move from where they were when it was built
+ * @param bvh The tree to update
+ * @param bounds The new bounding box of each item, in the same order as
+ * when the tree was built
+ */
+void bvh_refit(bvh_t *bvh, const bbox_t *bounds);
+
+/**
+ * @brief Finds every item that could overlap a given box.  Bounds are only
+ * stored per-leaf, so every item in an overlapping leaf is included, even
+ * if its own bounds don't overlap the box
+ * @param bvh The tree to search
+ * @param box The region to search
+ * @param items Populated with the indices of the candidate items
+ * @param max_items The most items that will be written to items
+ * @return The number of candidate items.  If this is larger than
+ * max_items, only the first max_items were written
+ */
+size_t bvh_query_bbox(const bvh_t *bvh, bbox_t box, uint32_t *items, size_t max_items);
+
+/**
+ * @brief Walks the tree, calling visit for every leaf that could overlap
+ * a given box.  Unlike bvh_query_bbox(), nothing needs to be collected
+ * into a buffer first
+ * @param bvh The tree to search
+ * @param box The region to search
+ * @param visit Called for each leaf overlapping the box
+ * @param context Passed to every call of visit
+ */
+void bvh_visit_bbox(const bvh_t *bvh, bbox_t box, bvh_leaf_visitor_t visit, void *context);
+
+/**
+ * @brief Gets the bounds of every item in the tree
+ * @param bvh The tree to use
+ * @param box Populated with the bounding box
+ */
+void bvh_get_bounds(const bvh_t *bvh, bbox_t *box);
+
+/**
+ * @brief Frees a BVH
+ * @param bvh The BVH to free
+ */
+void bvh_destroy(bvh_t *bvh);
@@ -0,0 +1,80 @@
+#pragma once
+/**
+ * Definitions and utility functions for a capsule collider
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+#include "sim/sphere.h"
+#include "sim/cube.h"
+#include "sim/segment.h"
+
+/**
+ * A capsule: every point within a given radius of a line segment.
+ * A single capsule can stand in for a chain of spheres along the
+ * same segment
+ */
+struct CapsuleCollider {
+    vec3_t start; // one end of the capsule's core segment
+    vec3_t end; // the other end of the capsule's core segment
+    phy_real_t radius;
+};
+typedef struct CapsuleCollider ccapsule_t;
+
+/**
+ * Creates a capsule of the given radius around the segment from
+ * start to end
+ */
+#define ccapsule_make(_start, _end, _radius) \
+    ((ccapsule_t){ .start = _start, .end = _end, .radius = _radius })
+
+/**
+ * Gets the segment running through the middle of a capsule
+ */
+#define ccapsule_get_segment(capsule) segment_make((capsule).start, (capsule).end)
+
+/**
+ * Checks if a point is inside the given capsule
+ */
+bool ccapsule_is_point_inside(ccapsule_t capsule, vec3_t point);
+
+/**
+ * Clamps a point within the bounds of the given capsule
+ */
+void ccapsule_clamp_point_within_capsule(ccapsule_t capsule, vec3_t *point);
+
+/**
+ * Checks if a sphere and a capsule are overlapping
+ */
+bool ccapsule_is_csphere_inside(ccapsule_t capsule, csphere_t sphere);
+
+/**
+ * Checks if two capsules are overlapping
+ */
+bool ccapsule_is_ccapsule_inside(ccapsule_t a, ccapsule_t b);
+
+/**
+ * Checks if an Axis-Aligned Bounding Box (AABB) and a capsule are
+ * overlapping
+ */
+bool ccapsule_is_bbox_inside(ccapsule_t capsule, bbox_t box);
+
+/**
+ * Checks if a cube and a capsule are overlapping
+ */
+bool ccapsule_is_ccube_inside(ccapsule_t capsule, ccube_t cube);
+
+/**
+ * @brief Calculates the smallest AABB containing the whole capsule
+ * @param capsule The capsule to bound
+ * @param box Populated with the bounding box
+ */
+void ccapsule_get_bounds(ccapsule_t capsule, bbox_t *box);
+
+/**
+ * Given a contact point on the surface of a capsule, gets the normal
+ * of that point
+ */
+vec3_t ccapsule_get_surface_normal(ccapsule_t capsule, vec3_t point_on_surface);
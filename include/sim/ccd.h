@@ -0,0 +1,81 @@
+#pragma once
+/**
+ * Continuous collision detection (CCD): sweeping shapes along their path
+ * to find when they first touch something, rather than only checking
+ * where they end up.  Keeps fast bodies from tunneling through thin
+ * geometry without shrinking every body's step
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/body.h"
+#include "sim/collider.h"
+#include "sim/contact.h"
+
+/**
+ * The most times a sweep will advance before giving up.  A sweep that
+ * runs out of iterations before the shapes touch reports a hit where it
+ * stopped, which is always before the real contact
+ */
+#define CCD_MAX_ITERATIONS 32
+
+/**
+ * How close two shapes have to get to count as touching
+ */
+#define CCD_TOLERANCE 1e-4
+
+/**
+ * @brief Finds how far apart two colliders are.  The result is never
+ * more than the true distance, so it is safe to move either collider
+ * that far toward the other without them overlapping
+ * @param a The first collider
+ * @param b The second collider
+ * @return The separation between the colliders; zero or negative if
+ * they are overlapping
+ */
+phy_real_t ccd_separation(collider_t a, collider_t b);
+
+/**
+ * @brief Sweeps a shape in a straight line, finding when it first
+ * touches a target (conservative advancement)
+ * @param shape The shape to sweep, at the start of its path
+ * @param displacement How far the shape moves over the whole sweep
+ * @param target The collider to sweep against
+ * @param toi Populated with the time of impact, from 0 at the start of
+ * the path to 1 at its end (can be null)
+ * @param contact Populated with the contact at the time of impact,
+ * pushing the shape away from the target (can be null)
+ * @return true if the shape hits the target while moving toward it
+ */
+bool ccd_cast_collider(collider_t shape, vec3_t displacement, collider_t target, phy_real_t *toi, contact_t *contact);
+
+/**
+ * @brief Sweeps a shape in a straight line, finding the first of several
+ * targets it touches
+ * @param shape The shape to sweep, at the start of its path
+ * @param displacement How far the shape moves over the whole sweep
+ * @param targets The colliders to sweep against
+ * @param target_count The number of targets
+ * @param toi Populated with the earliest time of impact (can be null)
+ * @param hit_target Populated with the index of the target hit first (can be null)
+ * @param contact Populated with the first contact, pushing the shape
+ * away from the target (can be null)
+ * @return true if the shape hits any target
+ */
+bool ccd_cast_colliders(collider_t shape, vec3_t displacement, const collider_t *targets, size_t target_count,
+    phy_real_t *toi, size_t *hit_target, contact_t *contact);
+
+/**
+ * @brief Steps a body like phy_body_step().  If the body is flagged with
+ * BODY_FLAG_CONTINUOUS, its shape is swept along the step and the body
+ * stops where it first touches an obstacle.  Its velocity is left alone,
+ * so collision forces can respond to the contact as usual
+ * @param body The body to step
+ * @param shape The body's collider, in world space.  Moved along with the body
+ * @param obstacles The colliders the body can hit
+ * @param obstacle_count The number of obstacles
+ * @param contact Populated with the contact if the body was stopped (can be null)
+ * @return true if the body was stopped by an obstacle
+ */
+bool phy_body_step_continuous(body_t *body, collider_t *shape, const collider_t *obstacles, size_t obstacle_count, contact_t *contact);
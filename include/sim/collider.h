@@ -0,0 +1,103 @@
+#pragma once
+/**
+ * A generic collider that can hold any of the engine's shapes, so
+ * code that works with shapes doesn't need to know which one it has
+ */
+
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/vec4.h"
+#include "sim/aabb.h"
+#include "sim/sphere.h"
+#include "sim/cube.h"
+#include "sim/capsule.h"
+
+/**
+ * The kinds of shape a collider can hold
+ */
+enum ColliderKind {
+    COLLIDER_BBOX,
+    COLLIDER_SPHERE,
+    COLLIDER_CUBE,
+    COLLIDER_CAPSULE,
+};
+typedef enum ColliderKind collider_kind_t;
+
+/**
+ * Holds a single shape of any kind
+ */
+struct Collider {
+    collider_kind_t kind;
+    union {
+        bbox_t bbox;
+        csphere_t sphere;
+        ccube_t cube;
+        ccapsule_t capsule;
+    };
+};
+typedef struct Collider collider_t;
+
+/**
+ * Wraps a shape in a collider
+ */
+#define collider_from_bbox(_box) ((collider_t){ .kind = COLLIDER_BBOX, .bbox = _box })
+#define collider_from_sphere(_sphere) ((collider_t){ .kind = COLLIDER_SPHERE, .sphere = _sphere })
+#define collider_from_cube(_cube) ((collider_t){ .kind = COLLIDER_CUBE, .cube = _cube })
+#define collider_from_capsule(_capsule) ((collider_t){ .kind = COLLIDER_CAPSULE, .capsule = _capsule })
+
+/**
+ * Checks if a point is inside the given collider
+ */
+bool collider_is_point_inside(collider_t collider, vec3_t point);
+
+/**
+ * Checks if two colliders are overlapping
+ */
+bool collider_is_collider_inside(collider_t a, collider_t b);
+
+/**
+ * @brief Calculates the smallest AABB containing the whole collider
+ * @param collider The collider to bound
+ * @param box Populated with the bounding box
+ */
+void collider_get_bounds(collider_t collider, bbox_t *box);
+
+/**
+ * @brief Moves a collider from some local space into world space
+ * @param collider The collider to move
+ * @param position Where the local space's origin is in world space
+ * @param rotation How the local space is rotated in world space
+ * @note An AABB can't stay axis-aligned when rotated, so bounding boxes
+ * are turned into cubes
+ */
+void collider_transform(collider_t *collider, vec3_t position, quaternion_t rotation);
+
+/**
+ * Gets the position of a collider's center
+ */
+vec3_t collider_get_center(collider_t collider);
+
+/**
+ * @brief Finds how far a point is from the surface of a collider
+ * @param collider The collider to measure from
+ * @param point The point to measure
+ * @return The distance to the collider's surface; negative if the
+ * point is inside the collider
+ */
+phy_real_t collider_signed_distance(collider_t collider, vec3_t point);
+
+/**
+ * @brief Moves a collider without rotating it.  Unlike
+ * collider_transform(), bounding boxes stay bounding boxes
+ * @param collider The collider to move
+ * @param offset How far to move the collider
+ */
+void collider_translate(collider_t *collider, vec3_t offset);
+
+/**
+ * @brief Finds the point on a collider furthest in a given direction
+ * @param collider The collider to use
+ * @param direction The direction to search in (does not need to be a unit vector)
+ * @return The point on the collider's surface furthest along direction
+ */
+vec3_t collider_get_support_point(collider_t collider, vec3_t direction);
@@ -0,0 +1,155 @@
+#pragma once
+/**
+ * Definitions and utility functions for a compound collider: several
+ * shapes that move together as a single rigid object
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/vec4.h"
+#include "sim/aabb.h"
+#include "sim/body.h"
+#include "sim/bvh.h"
+#include "sim/collider.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define COMPOUND_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define COMPOUND_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define COMPOUND_ERROR_ALLOC -3
+
+/**
+ * The capacity of a compound collider created using compound_make()
+ */
+#define COMPOUND_DEFAULT_CAPACITY 4
+
+/**
+ * A collider made up of several child shapes.  The children are stored
+ * relative to the compound, along with a BVH over their bounds, so
+ * neither needs updating when the compound moves
+ */
+struct CompoundCollider {
+    /**
+     * The children, in the compound's model space
+     */
+    collider_t *local_children;
+    /**
+     * The children, in world space.  Updated by compound_set_transform()
+     */
+    collider_t *world_children;
+    size_t child_count;
+    size_t child_capacity;
+    /**
+     * A BVH over the children's bounds in model space.  NULL until
+     * compound_build() is called
+     */
+    bvh_t *bvh;
+    /**
+     * Where the compound's origin is in world space
+     */
+    vec3_t position;
+    /**
+     * How the compound is rotated in world space
+     */
+    quaternion_t rotation;
+};
+typedef struct CompoundCollider compound_t;
+
+/**
+ * @brief Creates an empty compound collider
+ * @param initial_capacity How many children there is space for initially
+ * @return A pointer to the compound on success, or NULL on failure
+ */
+compound_t *compound_create(size_t initial_capacity);
+
+/**
+ * Creates a compound collider with the default initial capacity
+ */
+#define compound_make() compound_create(COMPOUND_DEFAULT_CAPACITY)
+
+/**
+ * @brief Adds a child shape to the compound.  compound_build() must be
+ * called after all children are added
+ * @param compound The compound to add to
+ * @param shape The shape to add
+ * @param local_position Where the shape is, relative to the compound's origin
+ * @param local_rotation How the shape is rotated, relative to the compound
+ * @return 0 on success, or a negative error code on failure
+ */
+int compound_add_child(compound_t *compound, collider_t shape, vec3_t local_position, quaternion_t local_rotation);
+
+/**
+ * @brief (Re)builds the compound's BVH.  Must be called after children are
+ * added and before the compound is used for collisions
+ * @param compound The compound to build
+ * @return 0 on success, or a negative error code on failure
+ */
+int compound_build(compound_t *compound);
+
+/**
+ * @brief Moves a compound, updating the world-space copies of its children
+ * @param compound The compound to move
+ * @param position Where the compound's origin is in world space
+ * @param rotation How the compound is rotated in world space
+ */
+void compound_set_transform(compound_t *compound, vec3_t position, quaternion_t rotation);
+
+/**
+ * Moves a compound to match the position and rotation of a body
+ */
+void compound_set_transform_from_body(compound_t *compound, const body_t *body);
+
+/**
+ * @brief Calculates a bounding box containing every child, in world space
+ * @param compound The compound to bound
+ * @param box Populated with the bounding box
+ */
+void compound_get_bounds(const compound_t *compound, bbox_t *box);
+
+/**
+ * @brief Finds every child that could overlap a box in world space
+ * (see bvh_query_bbox())
+ * @param compound The compound to search
+ * @param box The region to search, in world space
+ * @param children Populated with the indices of the candidate children
+ * @param max_children The most indices that will be written to children
+ * @return The number of candidate children.  If this is larger than
+ * max_children, only the first max_children were written
+ */
+size_t compound_query_bbox(const compound_t *compound, bbox_t box, uint32_t *children, size_t max_children);
+
+/**
+ * @brief Checks if a collider is overlapping any of a compound's children
+ * @param compound The compound to check
+ * @param other The collider to check, in world space
+ * @param hit_child Populated with the index of the first overlapping child (can be null)
+ * @return true if the collider overlaps a child
+ */
+bool compound_is_collider_inside(const compound_t *compound, collider_t other, size_t *hit_child);
+
+/**
+ * @brief Checks if two compounds are overlapping
+ * @param a The first compound
+ * @param b The second compound
+ * @param hit_a Populated with the index of the overlapping child in a (can be null)
+ * @param hit_b Populated with the index of the overlapping child in b (can be null)
+ * @return true if any child of a overlaps any child of b
+ */
+bool compound_is_compound_inside(const compound_t *a, const compound_t *b, size_t *hit_a, size_t *hit_b);
+
+/**
+ * @brief Frees a compound collider
+ * @param compound The compound to free
+ */
+void compound_destroy(compound_t *compound);
@@ -5,6 +5,7 @@
  */
 
 #include "sim/body.h"
+#include "sim/periodic.h"
 
 /**
  * Represents a spring connecting two rigidbodies
@@ -32,3 +33,9 @@ void spring_create(spring_t *spring, body_t *a, vec3_t a_endpoint, body_t *b, ve
  * Applies the spring force & torque to the attached rigidbodies
  */
 void spring_apply_constraint(spring_t spring);
+
+/**
+ * Like spring_apply_constraint(), but the spring connects the nearest
+ * images of its endpoints in a periodic box (can be null)
+ */
+void spring_apply_constraint_periodic(spring_t spring, const periodic_box_t *box);
@@ -0,0 +1,33 @@
+#pragma once
+/**
+ * Definitions for contacts: the information a collision response needs
+ * about where and how deeply two shapes overlap
+ */
+
+#include "common/vec3.h"
+
+/**
+ * A single point of contact between two shapes
+ */
+struct Contact {
+    /**
+     * Where the shapes touch, in world space
+     */
+    vec3_t point;
+    /**
+     * The unit direction the second shape must move to separate from
+     * the first.  Static geometry is always the first shape
+     */
+    vec3_t normal;
+    /**
+     * How far the second shape must move along normal to separate
+     */
+    phy_real_t depth;
+};
+typedef struct Contact contact_t;
+
+/**
+ * Creates a contact at a given point
+ */
+#define contact_make(_point, _normal, _depth) \
+    ((contact_t){ .point = _point, .normal = _normal, .depth = _depth })
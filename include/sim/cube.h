@@ -4,28 +4,120 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <math.h>
 #include "common/vec3.h"
 #include "common/vec4.h"
+#include "common/mat3x3.h"
 #include "sim/aabb.h"
 #include "sim/sphere.h"
 
 
 struct CubeCollider {
     vec3_t position; // the position of the cube's center
+    /**
+     * Takes points from world space into the cube's model space (the
+     * opposite of a body's rotation).  Use ccube_set_rotation() or
+     * ccube_set_body_rotation() to change it, so rotation_matrix stays in sync
+     */
     quaternion_t rotation;
+    /**
+     * The inverse of rotation, as a matrix that takes directions from the
+     * cube's model space into world space: the same thing a body's
+     * rotation_matrix holds, so a body's cached matrix can be used as is
+     */
+    mat3x3_t rotation_matrix;
     phy_real_t length;
     phy_real_t width;
     phy_real_t height;
 };
 typedef struct CubeCollider ccube_t;
 
+/**
+ * How often the overlap tests were settled by comparing bounding
+ * spheres, without transforming anything into a cube's model space.
+ * Only counted if USE_CUBE_STATS is defined
+ */
+struct CubeColliderStats {
+    /**
+     * The number of cube-cube, cube-sphere and cube-AABB tests run
+     */
+    uint64_t tests;
+    /**
+     * The number of those tests that the bounding spheres rejected
+     */
+    uint64_t early_rejections;
+};
+typedef struct CubeColliderStats ccube_stats_t;
+
+/**
+ * Calculates the bounding radius of a cube with the given dimensions
+ */
+static inline phy_real_t ccube_calculate_bounding_radius(phy_real_t length, phy_real_t width, phy_real_t height) {
+    return 0.5f * sqrtf(length * length + width * width + height * height);
+}
+
+/**
+ * Sets a cube's rotation (world space into model space), and works out
+ * the matching rotation_matrix
+ */
+static inline void ccube_set_rotation(ccube_t *cube, quaternion_t rotation) {
+    cube->rotation = rotation;
+    mat3x3_from_quaternion(cube->rotation_matrix, quaternion_unit_inverse(rotation));
+}
+
+/**
+ * Sets a cube's rotation to match a body's, whose rotation goes the
+ * other way (model space into world space).  The body's cached matrix
+ * is copied, rather than worked out again
+ * @param cube The cube to rotate
+ * @param rotation The body's rotation
+ * @param rotation_matrix The body's rotation_matrix
+ */
+static inline void ccube_set_body_rotation(ccube_t *cube, quaternion_t rotation, mat3x3_t rotation_matrix) {
+    cube->rotation = quaternion_unit_inverse(rotation);
+    mat3x3_copy(cube->rotation_matrix, rotation_matrix);
+}
+
 /**
  * Creates a cube with the given length, width, height, and rotation,
  * centered at the provided position
  */
-#define ccube_make(_position, _rotation, _length, _width, _height) \
-    ((ccube_t){ .position = _position, .rotation = _rotation, .length = _length, .width = _width, .height = _height })
+static inline ccube_t ccube_make(vec3_t position, quaternion_t rotation, phy_real_t length, phy_real_t width, phy_real_t height) {
+    ccube_t cube = {
+        .position = position,
+        .length = length,
+        .width = width,
+        .height = height,
+    };
+    ccube_set_rotation(&cube, rotation);
+    return cube;
+}
+
+/**
+ * Gets a cube's bounding radius: half of its diagonal, so the radius of
+ * the smallest sphere around its center that holds the whole cube,
+ * however it's rotated.  Worked out from the dimensions every time
+ * (one sqrt), so it can't go stale when they change
+ */
+static inline phy_real_t ccube_get_bounding_radius(ccube_t cube) {
+    return ccube_calculate_bounding_radius(cube.length, cube.width, cube.height);
+}
+
+/**
+ * Given a vector in world space, translates and rotates it
+ * so that it is in the cube's model space.
+ * Allows the point to treat the cube like an AABB centered at
+ * the origin.
+ */
+void ccube_apply_cube_transformations(ccube_t cube, vec3_t *point);
+
+/**
+ * Given a vector in the cube's model space, translates and rotates it
+ * so that it is in world space.
+ */
+void ccube_undo_cube_transformations(ccube_t cube, vec3_t *point);
 
 /**
  * Checks if a point is inside the given cube
@@ -53,6 +145,20 @@ bool ccube_is_sphere_inside(ccube_t cube, csphere_t sphere);
  */
 bool ccube_is_ccube_inside(ccube_t a, ccube_t b);
 
+/**
+ * @brief Gets how many overlap tests have run, and how many were
+ * rejected early, since the last ccube_reset_stats().  Always zero
+ * unless USE_CUBE_STATS is defined, so the tests don't pay for shared
+ * counters by default
+ * @return The counts
+ */
+ccube_stats_t ccube_get_stats(void);
+
+/**
+ * @brief Sets the overlap test counts back to zero
+ */
+void ccube_reset_stats(void);
+
 /**
  * @brief Gets the surface normal of a point on a given cube
  * @param cube The cube to get the surface normal of
@@ -0,0 +1,222 @@
+#pragma once
+/**
+ * A discrete element method (DEM) solver, for granular flows made of
+ * millions of spheres.  Instead of full bodies, particles are stored
+ * per-field (position x, position y, ...), found with a uniform grid,
+ * and pushed apart with spring-dashpot contacts.  Friction comes from
+ * a tangential spring per contact, which remembers how far the contact
+ * has sheared since it formed, so piles can stand still at an angle
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+#include "sim/aabb.h"
+#include "sim/sphere.h"
+#include "sim/particle_grid.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define DEM_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define DEM_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define DEM_ERROR_ALLOC -3
+
+/**
+ * How particles push on each other (and on the container's walls)
+ * while they overlap
+ */
+struct DemMaterial {
+    /**
+     * The force per unit of overlap pushing particles apart
+     */
+    phy_real_t normal_stiffness;
+    /**
+     * The force per unit of approach speed resisting particles moving
+     * together (or apart).  Controls how bouncy collisions are
+     */
+    phy_real_t normal_damping;
+    /**
+     * The force per unit of shear resisting particles sliding past each other
+     */
+    phy_real_t tangential_stiffness;
+    /**
+     * The force per unit of sliding speed resisting particles sliding
+     */
+    phy_real_t tangential_damping;
+    /**
+     * The Coulomb friction coefficient; the tangential force is never
+     * more than this times the normal force
+     */
+    phy_real_t friction;
+};
+typedef struct DemMaterial dem_material_t;
+
+/**
+ * Creates a new DEM material
+ */
+#define dem_material_make(_normal_stiffness, _normal_damping, _tangential_stiffness, _tangential_damping, _friction) \
+    ((dem_material_t){ .normal_stiffness = _normal_stiffness, .normal_damping = _normal_damping, \
+        .tangential_stiffness = _tangential_stiffness, .tangential_damping = _tangential_damping, .friction = _friction })
+
+/**
+ * A set of spherical particles.  Each field is its own array, indexed
+ * by particle, so they can be read (or written) directly; e.g. particle
+ * i is at (position_x[i], position_y[i], position_z[i])
+ */
+struct DemSystem {
+    size_t particle_count;
+    size_t particle_capacity;
+
+    phy_real_t *position_x;
+    phy_real_t *position_y;
+    phy_real_t *position_z;
+    phy_real_t *velocity_x;
+    phy_real_t *velocity_y;
+    phy_real_t *velocity_z;
+    phy_real_t *angular_velocity_x;
+    phy_real_t *angular_velocity_y;
+    phy_real_t *angular_velocity_z;
+    /**
+     * The forces and torques from the last step
+     */
+    phy_real_t *force_x;
+    phy_real_t *force_y;
+    phy_real_t *force_z;
+    phy_real_t *torque_x;
+    phy_real_t *torque_y;
+    phy_real_t *torque_z;
+    phy_real_t *radius;
+    /**
+     * Zero for particles that never move
+     */
+    phy_real_t *inverse_mass;
+    phy_real_t *inverse_inertia;
+    /**
+     * The index each particle had when it was added.  Particles keep their
+     * index unless dem_system_sort() moves them
+     */
+    uint32_t *ids;
+    /**
+     * The largest radius of any particle, which sets the grid's cell size
+     */
+    phy_real_t max_radius;
+
+    dem_material_t material;
+    vec3_t gravity;
+    /**
+     * If has_bounds is set, particles are kept inside these bounds by
+     * walls made of the same material
+     */
+    bbox_t bounds;
+    bool has_bounds;
+
+    /**
+     * Finds the particles that might be touching, rebuilt every step
+     */
+    particle_grid_t *grid;
+
+    /**
+     * Every contact from the last step, in compressed sparse row (CSR)
+     * form: particle i touches contact_others[contact_offsets[i]] through
+     * contact_others[contact_offsets[i + 1] - 1], sorted by index.  Each
+     * contact is stored under both particles, each with its own copy of
+     * the contact's shear (which always point in opposite directions)
+     */
+    uint32_t *contact_offsets;
+    uint32_t *contact_others;
+    phy_real_t *contact_shear_x;
+    phy_real_t *contact_shear_y;
+    phy_real_t *contact_shear_z;
+    size_t contact_count;
+    size_t contact_capacity;
+    /**
+     * The contacts from the step before, for carrying over shear
+     */
+    uint32_t *previous_offsets;
+    uint32_t *previous_others;
+    phy_real_t *previous_shear_x;
+    phy_real_t *previous_shear_y;
+    phy_real_t *previous_shear_z;
+    size_t previous_particle_count;
+    size_t previous_capacity;
+};
+typedef struct DemSystem dem_system_t;
+
+/**
+ * @brief Creates an empty DEM system
+ * @param capacity The number of particles to make room for.  More room
+ * is made as needed, so this is only a hint
+ * @param material How the particles interact
+ * @param gravity The acceleration applied to every particle
+ * @return A pointer to the system on success, or NULL on failure
+ */
+dem_system_t *dem_system_create(size_t capacity, dem_material_t material, vec3_t gravity);
+
+/**
+ * @brief Adds a particle to a DEM system
+ * @param system The system to add to
+ * @param sphere The particle's shape and position
+ * @param density The particle's mass per unit of volume, or zero for
+ * a particle that never moves
+ * @param velocity The particle's starting velocity
+ * @return DEM_SUCCESS on success, or an error code on failure
+ */
+int dem_system_add_sphere(dem_system_t *system, csphere_t sphere, phy_real_t density, vec3_t velocity);
+
+/**
+ * @brief Gets the current shape and position of a particle
+ * @param system The system the particle is in
+ * @param index The particle's index
+ * @return The particle as a sphere
+ */
+csphere_t dem_system_get_sphere(const dem_system_t *system, size_t index);
+
+/**
+ * @brief Keeps every particle inside a box
+ * @param system The system to update
+ * @param bounds The box to keep particles in, or NULL to remove the walls.
+ * The box is copied
+ */
+void dem_system_set_bounds(dem_system_t *system, const bbox_t *bounds);
+
+/**
+ * @brief Reorders a system's particles so that particles near each other
+ * are stored near each other.  Steps run much faster on sorted particles,
+ * but as they mix the benefit wears off, so this should be called every
+ * so often (e.g. every hundred steps).  Use ids to keep track of particles
+ * once they've been sorted
+ * @param system The system to sort
+ * @param pool The threads to split the sort across (can be null)
+ * @return DEM_SUCCESS on success, or an error code on failure.  On
+ * failure, the particles aren't moved
+ */
+int dem_system_sort(dem_system_t *system, threadpool_t *pool);
+
+/**
+ * @brief Advances a DEM system by one step: finds contacts, applies
+ * contact forces and gravity, then moves every particle
+ * @param system The system to step
+ * @param dt The length of the step.  Must be well under the contact
+ * time, roughly sqrt(mass / normal_stiffness), to stay stable
+ * @param pool The threads to split the step across (can be null)
+ * @return DEM_SUCCESS on success, or an error code on failure.  On
+ * failure, the particles aren't moved
+ */
+int dem_system_step(dem_system_t *system, phy_real_t dt, threadpool_t *pool);
+
+/**
+ * @brief Frees a DEM system
+ * @param system The system to free
+ */
+void dem_system_destroy(dem_system_t *system);
@@ -0,0 +1,220 @@
+#pragma once
+/**
+ * Forces that act on everything at once (gravity near a planet's
+ * surface, air resistance, wind, whirlpools, forces baked into a grid),
+ * registered once and applied to a whole world in one pass per step.
+ * Rather than calling a function per body per field, each block of
+ * SIMD_WIDTH bodies is loaded once, every enabled field's force is added
+ * up in registers, and the total is added to the bodies' net forces.
+ * Uniform accelerations and linear drags are folded together before the
+ * pass, so any number of them costs the same as one
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/body.h"
+#include "sim/particles.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define FORCE_FIELD_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define FORCE_FIELD_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define FORCE_FIELD_ERROR_ALLOC -3
+
+/**
+ * The kinds of force field there are
+ */
+enum ForceFieldKind {
+    /**
+     * The same acceleration everywhere: a force of mass * acceleration
+     */
+    FORCE_FIELD_UNIFORM,
+    /**
+     * A force of -coefficient * (velocity - flow_velocity), like
+     * phy_body_add_drag_force() in a moving fluid (wind, a current, ...).
+     * Bodies also get the same torque of -coefficient * angular_velocity
+     * that phy_body_add_drag_force() adds; particles don't spin
+     */
+    FORCE_FIELD_LINEAR_DRAG,
+    /**
+     * A force of -coefficient * |v| * v, where v = velocity - flow_velocity.
+     * What fast objects in air actually feel
+     */
+    FORCE_FIELD_QUADRATIC_DRAG,
+    /**
+     * An acceleration of strength / (r^2 + core_radius^2) around a line,
+     * times r in the direction of rotation (right-handed around the
+     * axis), where r is the distance from the line.  This spins
+     * everything near the line like a solid body, and falls off as 1/r
+     * far from it
+     */
+    FORCE_FIELD_VORTEX,
+    /**
+     * An acceleration sampled on a grid, and trilinearly interpolated
+     * between samples.  Nothing outside the grid is affected
+     */
+    FORCE_FIELD_GRID,
+};
+typedef enum ForceFieldKind force_field_kind_t;
+
+/**
+ * One force field.  Only the member matching kind is used
+ */
+struct ForceField {
+    force_field_kind_t kind;
+    /**
+     * Disabled fields stay registered, but apply no force
+     */
+    bool enabled;
+    union {
+        struct {
+            vec3_t acceleration;
+        } uniform;
+        /**
+         * Used by both linear and quadratic drag
+         */
+        struct {
+            phy_real_t coefficient;
+            vec3_t flow_velocity;
+        } drag;
+        struct {
+            vec3_t center;
+            /**
+             * The direction of the vortex's line.  Made unit length when added
+             */
+            vec3_t axis;
+            phy_real_t strength;
+            phy_real_t core_radius;
+        } vortex;
+        /**
+         * Sample (i, j, k) is at origin + cell_size * (i, j, k), and its
+         * acceleration is (x[n], y[n], z[n]), n = i + size_x * (j + size_y * k).
+         * The samples are not copied, and must outlive the field
+         */
+        struct {
+            vec3_t origin;
+            phy_real_t cell_size;
+            size_t size_x;
+            size_t size_y;
+            size_t size_z;
+            const phy_real_t *x;
+            const phy_real_t *y;
+            const phy_real_t *z;
+        } grid;
+    };
+};
+typedef struct ForceField force_field_t;
+
+/**
+ * Creates an enabled force field of each kind
+ */
+#define force_field_make_uniform(_acceleration) \
+    ((force_field_t){ .kind = FORCE_FIELD_UNIFORM, .enabled = true, .uniform = { .acceleration = _acceleration } })
+#define force_field_make_linear_drag(_coefficient, _flow_velocity) \
+    ((force_field_t){ .kind = FORCE_FIELD_LINEAR_DRAG, .enabled = true, \
+        .drag = { .coefficient = _coefficient, .flow_velocity = _flow_velocity } })
+#define force_field_make_quadratic_drag(_coefficient, _flow_velocity) \
+    ((force_field_t){ .kind = FORCE_FIELD_QUADRATIC_DRAG, .enabled = true, \
+        .drag = { .coefficient = _coefficient, .flow_velocity = _flow_velocity } })
+#define force_field_make_vortex(_center, _axis, _strength, _core_radius) \
+    ((force_field_t){ .kind = FORCE_FIELD_VORTEX, .enabled = true, \
+        .vortex = { .center = _center, .axis = _axis, .strength = _strength, .core_radius = _core_radius } })
+#define force_field_make_grid(_origin, _cell_size, _size_x, _size_y, _size_z, _x, _y, _z) \
+    ((force_field_t){ .kind = FORCE_FIELD_GRID, .enabled = true, \
+        .grid = { .origin = _origin, .cell_size = _cell_size, .size_x = _size_x, .size_y = _size_y, .size_z = _size_z, \
+            .x = _x, .y = _y, .z = _z } })
+
+/**
+ * Every force field acting on a world
+ */
+struct ForceFieldRegistry {
+    force_field_t *fields;
+    size_t count;
+    size_t capacity;
+};
+typedef struct ForceFieldRegistry force_field_registry_t;
+
+/**
+ * @brief Creates a registry with no fields
+ * @return A pointer to the registry on success, or NULL on failure
+ */
+force_field_registry_t *force_field_registry_create(void);
+
+/**
+ * @brief Registers a force field
+ * @param registry The registry to add to
+ * @param field The field to add
+ * @param index Where to store the field's index, which it keeps for as
+ * long as the registry exists (can be null)
+ * @return FORCE_FIELD_SUCCESS on success, or an error code on failure
+ */
+int force_field_registry_add(force_field_registry_t *registry, force_field_t field, size_t *index);
+
+/**
+ * @brief Gets a registered field.  Change it with
+ * force_field_registry_set(), which checks it like
+ * force_field_registry_add() does
+ * @param registry The registry the field is in
+ * @param index The field's index
+ * @return The field, or NULL if there is no such field
+ */
+const force_field_t *force_field_registry_get(const force_field_registry_t *registry, size_t index);
+
+/**
+ * @brief Replaces a registered field, e.g. to change it between steps.
+ * The field is checked, and its vortex axis normalized, like
+ * force_field_registry_add() does
+ * @param registry The registry the field is in
+ * @param index The field's index
+ * @param field The field to replace it with
+ * @return FORCE_FIELD_SUCCESS on success, or an error code on failure
+ * (in which case the old field is kept)
+ */
+int force_field_registry_set(force_field_registry_t *registry, size_t index, force_field_t field);
+
+/**
+ * @brief Enables or disables a registered field.  Disabled fields keep
+ * their index, but apply no force
+ * @param registry The registry the field is in
+ * @param index The field's index
+ * @param enabled Whether the field should apply its force
+ * @return FORCE_FIELD_SUCCESS on success, or an error code on failure
+ */
+int force_field_registry_set_enabled(force_field_registry_t *registry, size_t index, bool enabled);
+
+/**
+ * @brief Adds every enabled field's force to each body's net force (and
+ * linear drag's torque to its net torque).  Call once per step, before
+ * stepping the bodies
+ * @param registry The fields to apply
+ * @param bodies The bodies to push
+ * @param count The number of bodies
+ * @return FORCE_FIELD_SUCCESS on success, or an error code on failure
+ */
+int force_field_registry_apply(const force_field_registry_t *registry, body_t *bodies, size_t count);
+
+/**
+ * @brief Adds every enabled field's force to each particle's force, like
+ * force_field_registry_apply().  Particles are already stored per-field,
+ * so nothing needs to be copied
+ * @param registry The fields to apply
+ * @param particles The particles to push
+ * @return FORCE_FIELD_SUCCESS on success, or an error code on failure
+ */
+int force_field_registry_apply_particles(const force_field_registry_t *registry, particle_system_t *particles);
+
+/**
+ * @brief Frees a registry
+ * @param registry The registry to free
+ */
+void force_field_registry_destroy(force_field_registry_t *registry);
@@ -0,0 +1,53 @@
+#pragma once
+/**
+ * All-pairs (direct sum) Newtonian gravity over arrays of point masses.
+ * The kernel works on one array per component so it can compare a
+ * point against SIMD_WIDTH (or, when the CPU supports it, 8 or 16)
+ * others at once; see common/cpu.h for how the width is chosen
+ */
+
+#include <stddef.h>
+#include "common/defines.h"
+#include "sim/body.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define GRAVITY_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define GRAVITY_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define GRAVITY_ERROR_ALLOC -3
+
+/**
+ * @brief Adds the gravitational pull of every point on every other
+ * point to the points' forces.  Matches calling
+ * phy_body_add_gravity_force() on each pair, to within rounding, except
+ * that points in exactly the same place don't pull on each other
+ * @param x Each point's x coordinate
+ * @param y Each point's y coordinate
+ * @param z Each point's z coordinate
+ * @param mass Each point's mass
+ * @param count The number of points
+ * @param force_x The x component of each point's net force, added to
+ * @param force_y The y component of each point's net force, added to
+ * @param force_z The z component of each point's net force, added to
+ */
+void gravity_add_forces(const phy_real_t *x, const phy_real_t *y, const phy_real_t *z, const phy_real_t *mass,
+    size_t count, phy_real_t *force_x, phy_real_t *force_y, phy_real_t *force_z);
+
+/**
+ * @brief Applies gravity between every pair of bodies with
+ * gravity_add_forces()
+ * @param bodies The bodies to pull on each other
+ * @param count The number of bodies
+ * @return GRAVITY_SUCCESS on success, or an error code on failure.  On
+ * failure, no forces are applied
+ */
+int phy_bodies_add_gravity_forces(body_t *bodies, size_t count);
@@ -0,0 +1,121 @@
+#pragma once
+/**
+ * A heightfield terrain collider: a regular grid of heights over the
+ * xz-plane.  Any region maps straight to the grid cells under it, so
+ * collisions cost the same no matter how large the terrain is
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+#include "sim/collider.h"
+#include "sim/contact.h"
+#include "sim/triangle.h"
+
+/**
+ * The number of triangles each grid cell is split into
+ */
+#define HEIGHTFIELD_CELL_TRIANGLES 2
+
+/**
+ * A grid of heights.  Sample (column, row) sits at
+ * origin + (column * cell_size, height, row * cell_size)
+ */
+struct Heightfield {
+    /**
+     * One height per sample, stored row by row
+     */
+    phy_real_t *heights;
+    /**
+     * The number of samples along the x-axis
+     */
+    size_t columns;
+    /**
+     * The number of samples along the z-axis
+     */
+    size_t rows;
+    /**
+     * The position of the first sample, before its height is added
+     */
+    vec3_t origin;
+    /**
+     * The distance between neighboring samples
+     */
+    phy_real_t cell_size;
+    phy_real_t min_height;
+    phy_real_t max_height;
+};
+typedef struct Heightfield heightfield_t;
+
+/**
+ * @brief Creates a heightfield.  The heights are copied, so they
+ * can be freed afterward
+ * @param heights The height of each sample, stored row by row
+ * @param columns The number of samples along the x-axis (at least 2)
+ * @param rows The number of samples along the z-axis (at least 2)
+ * @param origin The position of the first sample, before its height is added
+ * @param cell_size The distance between neighboring samples
+ * @return A pointer to the heightfield on success, or NULL on failure
+ */
+heightfield_t *heightfield_create(const phy_real_t *heights, size_t columns, size_t rows, vec3_t origin, phy_real_t cell_size);
+
+/**
+ * Gets the height of a single sample
+ */
+#define heightfield_get_height(field, column, row) ((field)->heights[(row) * (field)->columns + (column)])
+
+/**
+ * Changes the height of a single sample
+ */
+void heightfield_set_height(heightfield_t *field, size_t column, size_t row, phy_real_t height);
+
+/**
+ * Gets the position of a single sample in world space
+ */
+vec3_t heightfield_get_point(const heightfield_t *field, size_t column, size_t row);
+
+/**
+ * @brief Gets the triangles covering a single grid cell
+ * @param field The heightfield to use
+ * @param column The column of the cell's first corner (less than columns - 1)
+ * @param row The row of the cell's first corner (less than rows - 1)
+ * @param triangles Populated with the cell's triangles, facing upward
+ */
+void heightfield_get_cell_triangles(const heightfield_t *field, size_t column, size_t row, triangle_t triangles[HEIGHTFIELD_CELL_TRIANGLES]);
+
+/**
+ * @brief Finds the height of the terrain's surface at a point on the xz-plane
+ * @param field The heightfield to use
+ * @param x The x coordinate, in world space
+ * @param z The z coordinate, in world space
+ * @param height Populated with the surface's y coordinate, in world space
+ * @return false if the point is outside the heightfield
+ */
+bool heightfield_sample_height(const heightfield_t *field, phy_real_t x, phy_real_t z, phy_real_t *height);
+
+/**
+ * @brief Calculates the smallest AABB containing the whole heightfield
+ * @param field The heightfield to bound
+ * @param box Populated with the bounding box
+ */
+void heightfield_get_bounds(const heightfield_t *field, bbox_t *box);
+
+/**
+ * @brief Generates a contact for every triangle a collider is touching.
+ * Only the cells under the collider's bounds are checked
+ * @param field The heightfield to check
+ * @param collider The collider to check
+ * @param contacts Populated with the contacts, each pushing the
+ * collider away from the terrain
+ * @param max_contacts The most contacts that will be written to contacts
+ * @return The number of contacts.  If this is larger than max_contacts,
+ * only the first max_contacts were written
+ */
+size_t heightfield_collide_collider(const heightfield_t *field, collider_t collider, contact_t *contacts, size_t max_contacts);
+
+/**
+ * @brief Frees a heightfield
+ * @param field The heightfield to free
+ */
+void heightfield_destroy(heightfield_t *field);
@@ -0,0 +1,160 @@
+#pragma once
+/**
+ * Backward (implicit) Euler integration for networks of springs.  Stiff
+ * springs stepped explicitly (spring_apply_constraint() followed by
+ * phy_body_step()) blow up unless the step is far shorter than the
+ * springs' period.  Solving for the velocities at the end of the step
+ * instead stays stable at any step, so stiff materials can take steps
+ * orders of magnitude longer.
+ *
+ * Each step linearizes the springs around the current positions and
+ * solves (M - dt^2 K) dv = dt (f + dt K v), where K is the Jacobian of
+ * the spring forces, stored as 3x3 blocks in compressed sparse row
+ * (block-CSR) form, using a block-Jacobi preconditioned conjugate
+ * gradient whose matrix products are split across a thread pool
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/threadpool.h"
+#include "sim/body.h"
+#include "sim/constraints.h"
+#include "sim/periodic.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define IMPLICIT_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define IMPLICIT_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define IMPLICIT_ERROR_ALLOC -3
+
+/**
+ * The number of values in each 3x3 block of the matrix
+ */
+#define IMPLICIT_BLOCK_SIZE 9
+
+/**
+ * A set of springs, and the matrix used to step the bodies they connect.
+ * Bodies with a mass of zero (or infinity) are treated as fixed: springs
+ * pull on them, but they aren't moved
+ */
+struct ImplicitSpringSystem {
+    const spring_t *springs;
+    size_t spring_count;
+    /**
+     * Every body any spring is attached to.  Body i's velocity change is
+     * row i of the matrix
+     */
+    body_t **bodies;
+    size_t body_count;
+    /**
+     * Wraps spring lengths and body positions, if periodic is set
+     */
+    bool periodic;
+    periodic_box_t periodic_box;
+
+    /**
+     * The matrix, in block-CSR form: row i is made of blocks
+     * row_starts[i] through row_starts[i + 1] - 1, where block j is in
+     * column columns[j] and its values (row-major) are
+     * blocks[j * IMPLICIT_BLOCK_SIZE] onwards
+     */
+    uint32_t *row_starts;
+    uint32_t *columns;
+    phy_real_t *blocks;
+    /**
+     * The inverse of each row's diagonal block, for preconditioning
+     */
+    phy_real_t *inverse_diagonals;
+
+    /**
+     * The springs attached to each body: body i is attached to springs
+     * attached_springs[attached_starts[i]] through
+     * attached_springs[attached_starts[i + 1] - 1], with the matching
+     * entry of attached_blocks being the block that couples it to the
+     * spring's other body
+     */
+    uint32_t *attached_starts;
+    uint32_t *attached_springs;
+    uint32_t *attached_blocks;
+    /**
+     * Which body (row) each end of each spring is attached to
+     */
+    uint32_t *spring_rows_a;
+    uint32_t *spring_rows_b;
+
+    /**
+     * Each spring's force on its a body, and the Jacobian of that force,
+     * as of the current step
+     */
+    phy_real_t *spring_forces;
+    phy_real_t *spring_jacobians;
+
+    /**
+     * The solver's vectors, three values per body
+     */
+    phy_real_t *rhs;
+    phy_real_t *velocity_changes;
+    phy_real_t *residuals;
+    phy_real_t *preconditioned;
+    phy_real_t *directions;
+    phy_real_t *products;
+    phy_real_t *torques;
+    /**
+     * Partial sums for dot products, one per chunk, so the result doesn't
+     * depend on how chunks are split between threads
+     */
+    phy_real_t *partial_sums;
+
+    /**
+     * The solver stops once the residual is this fraction of where it started
+     */
+    phy_real_t tolerance;
+    size_t max_iterations;
+    /**
+     * How many iterations the last step took
+     */
+    size_t iterations;
+};
+typedef struct ImplicitSpringSystem implicit_spring_system_t;
+
+/**
+ * @brief Sets up implicit stepping for a set of springs.  The springs
+ * (and the bodies they're attached to) are not copied, and must outlive
+ * the system.  Springs' constants and lengths can change between steps,
+ * but if any spring is attached to a different body, the system must be
+ * recreated
+ * @param springs The springs to step
+ * @param spring_count The number of springs
+ * @param box The periodic box the springs are in (can be null).  The box
+ * is copied, so it doesn't need to outlive the system
+ * @return A pointer to the system on success, or NULL on failure
+ */
+implicit_spring_system_t *implicit_springs_create(const spring_t *springs, size_t spring_count, const periodic_box_t *box);
+
+/**
+ * @brief Steps every body attached to a system's springs, in place of
+ * phy_body_step().  Any forces and torques already added to the bodies
+ * (gravity, drag, ...) are applied along with the springs, then cleared.
+ * Torques from the springs are applied explicitly
+ * @param system The system to step
+ * @param dt The length of the step; 1 matches phy_body_step()
+ * @param pool The threads to split the step across (can be null)
+ * @return IMPLICIT_SUCCESS on success, or an error code on failure
+ */
+int implicit_springs_step(implicit_spring_system_t *system, phy_real_t dt, threadpool_t *pool);
+
+/**
+ * @brief Frees an implicit spring system.  The springs and bodies are not freed
+ * @param system The system to free
+ */
+void implicit_springs_destroy(implicit_spring_system_t *system);
@@ -0,0 +1,189 @@
+#pragma once
+/**
+ * A kd-tree over a set of points (usually body positions), for finding
+ * the nearest points to a location or every point within some distance
+ * of it.  Every node stores the bounds of the points under it, so the
+ * tree can be refit to moved points without being rebuilt
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+#include "sim/periodic.h"
+
+/**
+ * The most points a leaf of the tree will hold
+ */
+#define KDTREE_LEAF_SIZE 8
+
+/**
+ * The deepest a kd-tree can get.  Since the tree is built from median
+ * splits, it won't come anywhere near this
+ */
+#define KDTREE_MAX_DEPTH 64
+
+/**
+ * Marks a node as a leaf, in place of its children
+ */
+#define KDTREE_LEAF UINT32_MAX
+
+/**
+ * A single node of a kd-tree, covering a contiguous range of points
+ */
+struct KdTreeNode {
+    vec3_t bounds_min;
+    vec3_t bounds_max;
+    /**
+     * The range of points (in tree order) under this node
+     */
+    uint32_t begin;
+    uint32_t end;
+    /**
+     * The indices of this node's children, or KDTREE_LEAF for a leaf
+     */
+    uint32_t left;
+    uint32_t right;
+};
+typedef struct KdTreeNode kdtree_node_t;
+
+/**
+ * A kd-tree over a fixed number of points
+ */
+struct KdTree {
+    /**
+     * The points' coordinates, stored per-axis and reordered so that
+     * each node covers a contiguous range
+     */
+    phy_real_t *x;
+    phy_real_t *y;
+    phy_real_t *z;
+    /**
+     * The index each point had when it was passed in, in tree order
+     */
+    uint32_t *indices;
+    size_t point_count;
+    /**
+     * The tree's nodes.  The root is always the first node, and every
+     * node comes before its children
+     */
+    kdtree_node_t *nodes;
+    _Atomic uint32_t node_count;
+    size_t node_capacity;
+    /**
+     * If periodic is set, points are wrapped into the periodic box,
+     * and queries find points through the box's faces
+     */
+    periodic_box_t periodic_box;
+    bool periodic;
+};
+typedef struct KdTree kdtree_t;
+
+/**
+ * @brief Builds a kd-tree over a set of points
+ * @param positions The first point.  Points don't have to be packed
+ * together, so a tree can be built straight from the positions of an
+ * array of bodies
+ * @param count The number of points
+ * @param stride The number of bytes from one point to the next; e.g.
+ * (sizeof (vec3_t)) for an array of points, or (sizeof (body_t)) for
+ * &bodies[0].position
+ * @param pool The threads to split the build across (can be null)
+ * @return A pointer to the tree on success, or NULL on failure
+ */
+kdtree_t *kdtree_create(const vec3_t *positions, size_t count, size_t stride, threadpool_t *pool);
+
+/**
+ * @brief Rebuilds a tree over new positions for the same number of points,
+ * reusing its memory.  Queries run as fast as on a brand new tree
+ * @param tree The tree to rebuild
+ * @param positions The first point, like kdtree_create()
+ * @param stride The number of bytes from one point to the next
+ * @param pool The threads to split the build across (can be null)
+ */
+void kdtree_rebuild(kdtree_t *tree, const vec3_t *positions, size_t stride, threadpool_t *pool);
+
+/**
+ * @brief Moves the tree's points without changing its structure.  Much
+ * cheaper than rebuilding, and queries stay exact, but they slow down the
+ * further points move from where they were when the tree was built
+ * @param tree The tree to update
+ * @param positions The first point, in the same order as when the tree was built
+ * @param stride The number of bytes from one point to the next
+ */
+void kdtree_refit(kdtree_t *tree, const vec3_t *positions, size_t stride);
+
+/**
+ * @brief Makes a tree periodic, so that points wrap around a periodic
+ * box and queries reach through its faces (the minimum image convention).
+ * Each point is only found once per query, so searches must not reach
+ * more than half the box's size
+ * @param tree The tree to update
+ * @param box The periodic box to use, or NULL to make the tree non-periodic.
+ * The box is copied
+ */
+void kdtree_set_periodic_box(kdtree_t *tree, const periodic_box_t *box);
+
+/**
+ * @brief Finds the k points nearest to a location
+ * @param tree The tree to search
+ * @param point The location to search around
+ * @param k The number of points to find
+ * @param indices Populated with the indices of the nearest points,
+ * nearest first.  Must have room for k indices
+ * @param distances_sqr Populated with the squared distance to each of the
+ * nearest points.  Must have room for k distances
+ * @return The number of points found; k, unless the tree has fewer points
+ */
+size_t kdtree_query_nearest(const kdtree_t *tree, vec3_t point, size_t k, uint32_t *indices, phy_real_t *distances_sqr);
+
+/**
+ * @brief Finds every point within a given distance of a location
+ * @param tree The tree to search
+ * @param point The location to search around
+ * @param radius How far from the location to search
+ * @param indices Populated with the indices of the points found, in no
+ * particular order
+ * @param max_indices The most indices that will be written to indices
+ * @return The number of points found.  If this is larger than
+ * max_indices, only the first max_indices were written
+ */
+size_t kdtree_query_radius(const kdtree_t *tree, vec3_t point, phy_real_t radius, uint32_t *indices, size_t max_indices);
+
+/**
+ * @brief Runs kdtree_query_nearest() for a batch of locations
+ * @param tree The tree to search
+ * @param points The locations to search around
+ * @param count The number of locations
+ * @param k The number of points to find around each location
+ * @param indices Populated with the nearest points to each location.
+ * Location i's results start at indices[i * k]
+ * @param distances_sqr Populated with the squared distances, laid out like indices
+ * @param pool The threads to split the batch across (can be null)
+ * @return The number of points found around each location
+ */
+size_t kdtree_query_nearest_batch(const kdtree_t *tree, const vec3_t *points, size_t count, size_t k,
+    uint32_t *indices, phy_real_t *distances_sqr, threadpool_t *pool);
+
+/**
+ * @brief Runs kdtree_query_radius() for a batch of locations
+ * @param tree The tree to search
+ * @param points The locations to search around
+ * @param count The number of locations
+ * @param radius How far from each location to search
+ * @param indices Populated with the points found around each location.
+ * Location i's results start at indices[i * max_indices]
+ * @param max_indices The most indices that will be written for each location
+ * @param index_counts Populated with the number of points found around
+ * each location, like kdtree_query_radius() returns
+ * @param pool The threads to split the batch across (can be null)
+ */
+void kdtree_query_radius_batch(const kdtree_t *tree, const vec3_t *points, size_t count, phy_real_t radius,
+    uint32_t *indices, size_t max_indices, size_t *index_counts, threadpool_t *pool);
+
+/**
+ * @brief Frees a kd-tree
+ * @param tree The tree to free
+ */
+void kdtree_destroy(kdtree_t *tree);
@@ -0,0 +1,140 @@
+#pragma once
+/**
+ * Verlet neighbor lists: every pair of points within a cutoff distance,
+ * plus a margin called the skin.  Since nothing outside the list can
+ * come within the cutoff until some point has moved half the skin, one
+ * list can be reused for many steps of short-range pair forces
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/body.h"
+#include "sim/kdtree.h"
+#include "sim/potential.h"
+#include "sim/periodic.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define NEIGHBOR_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define NEIGHBOR_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define NEIGHBOR_ERROR_ALLOC -3
+
+/**
+ * A neighbor list over a fixed number of points.  Pairs are stored in
+ * compressed sparse row (CSR) form: point i's neighbors are
+ * neighbors[offsets[i]] through neighbors[offsets[i + 1] - 1].  Each
+ * pair is only stored once, under the point with the smaller index
+ */
+struct NeighborList {
+    phy_real_t cutoff;
+    phy_real_t skin;
+    size_t point_count;
+
+    uint32_t *offsets;
+    uint32_t *neighbors;
+    size_t neighbor_count;
+    size_t neighbor_capacity;
+
+    /**
+     * Where each point was when the list was last built
+     */
+    vec3_t *reference_positions;
+    /**
+     * The number of times the list has been built, for
+     * checking how well the skin is working
+     */
+    size_t build_count;
+
+    /**
+     * If periodic is set, pairs are found and measured through the
+     * periodic box's faces
+     */
+    periodic_box_t periodic_box;
+    bool periodic;
+
+    kdtree_t *tree;
+    uint32_t *scratch;
+    size_t scratch_capacity;
+};
+typedef struct NeighborList neighbor_list_t;
+
+/**
+ * @brief Creates a neighbor list, and builds it for the given points
+ * @param positions The first point.  Like kdtree_create(), points don't
+ * have to be packed together
+ * @param count The number of points
+ * @param stride The number of bytes from one point to the next
+ * @param cutoff The furthest apart two points can be and still interact
+ * @param skin The extra margin included in the list.  Larger skins
+ * rebuild less often, but store (and check) more pairs
+ * @return A pointer to the list on success, or NULL on failure
+ */
+neighbor_list_t *neighbor_list_create(const vec3_t *positions, size_t count, size_t stride, phy_real_t cutoff, phy_real_t skin);
+
+/**
+ * @brief Makes a neighbor list periodic, so pairs are found across the
+ * faces of a periodic box using the minimum image convention.  The
+ * cutoff plus the skin must be less than half the box's size.  The list
+ * is rebuilt on its next update
+ * @param list The list to update
+ * @param box The periodic box to use, or NULL to make the list non-periodic.
+ * The box is copied
+ */
+void neighbor_list_set_periodic_box(neighbor_list_t *list, const periodic_box_t *box);
+
+/**
+ * @brief Checks if any point has moved far enough since the list was
+ * built that the list might be missing a pair
+ * @param list The list to check
+ * @param positions The first point, in the same order as when the list was created
+ * @param stride The number of bytes from one point to the next
+ * @return true if the list must be rebuilt
+ */
+bool neighbor_list_needs_rebuild(const neighbor_list_t *list, const vec3_t *positions, size_t stride);
+
+/**
+ * @brief Rebuilds a neighbor list from scratch
+ * @param list The list to rebuild
+ * @param positions The first point, in the same order as when the list was created
+ * @param stride The number of bytes from one point to the next
+ * @return NEIGHBOR_SUCCESS on success, or an error code on failure.
+ * On failure, the list is left empty
+ */
+int neighbor_list_rebuild(neighbor_list_t *list, const vec3_t *positions, size_t stride);
+
+/**
+ * @brief Rebuilds a neighbor list, but only if it needs it.  Call this
+ * once per step, before using the list
+ * @param list The list to update
+ * @param positions The first point, in the same order as when the list was created
+ * @param stride The number of bytes from one point to the next
+ * @return NEIGHBOR_SUCCESS on success, or an error code on failure
+ */
+int neighbor_list_update(neighbor_list_t *list, const vec3_t *positions, size_t stride);
+
+/**
+ * @brief Adds the forces from a pair potential to every pair of bodies
+ * in a neighbor list
+ * @param bodies The bodies the list was built from
+ * @param list The list of pairs to use.  Should be up to date
+ * @param potential The potential to apply.  Its cutoff should be no more
+ * than the list's cutoff, or some pairs will be missed
+ */
+void phy_bodies_add_pair_forces(body_t *bodies, const neighbor_list_t *list, const pair_potential_t *potential);
+
+/**
+ * @brief Frees a neighbor list
+ * @param list The list to free
+ */
+void neighbor_list_destroy(neighbor_list_t *list);
@@ -0,0 +1,104 @@
+#pragma once
+/**
+ * A uniform grid for finding particles near each other.  The grid is fit
+ * around the particles each time it's built, and particles are sorted by
+ * cell, so every particle near a point can be found in a handful of
+ * contiguous runs
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define PARTICLE_GRID_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define PARTICLE_GRID_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define PARTICLE_GRID_ERROR_ALLOC -3
+
+/**
+ * The most runs of particles around a point; one per row of neighboring cells
+ */
+#define PARTICLE_GRID_MAX_RUNS 9
+
+/**
+ * A grid over a set of particles.  The particles in cell c are
+ * cell_particles[cell_starts[c]] through cell_particles[cell_starts[c + 1] - 1],
+ * and cells are numbered x-first, then y, then z
+ */
+struct ParticleGrid {
+    /**
+     * The width of each cell.  At least the size asked for, but may
+     * be larger if the particles are spread out
+     */
+    phy_real_t cell_size;
+    /**
+     * The lowest corner of the first cell
+     */
+    vec3_t origin;
+    size_t size_x;
+    size_t size_y;
+    size_t size_z;
+    /**
+     * The cell each particle is in
+     */
+    uint32_t *cell_keys;
+    uint32_t *cell_starts;
+    /**
+     * Every particle, sorted by cell
+     */
+    uint32_t *cell_particles;
+    size_t particle_count;
+    size_t particle_capacity;
+    size_t cell_capacity;
+};
+typedef struct ParticleGrid particle_grid_t;
+
+/**
+ * @brief Creates an empty grid
+ * @return A pointer to the grid on success, or NULL on failure
+ */
+particle_grid_t *particle_grid_create(void);
+
+/**
+ * @brief Sorts a set of particles into a grid, replacing whatever it held
+ * @param grid The grid to build
+ * @param x The x coordinate of each particle
+ * @param y The y coordinate of each particle
+ * @param z The z coordinate of each particle
+ * @param count The number of particles
+ * @param min_cell_size The smallest the cells can be.  Particles closer
+ * than this are always in the same or neighboring cells
+ * @param pool The threads to split the build across (can be null)
+ * @return PARTICLE_GRID_SUCCESS on success, or an error code on failure
+ */
+int particle_grid_build(particle_grid_t *grid, const phy_real_t *x, const phy_real_t *y, const phy_real_t *z,
+    size_t count, phy_real_t min_cell_size, threadpool_t *pool);
+
+/**
+ * @brief Finds the particles that could be within one cell of a point.
+ * Points outside the grid are treated as if they were in the nearest cell
+ * @param grid The grid to search
+ * @param point The point to search around
+ * @param run_begins Populated with where each run starts in cell_particles
+ * @param run_ends Populated with where each run ends in cell_particles
+ * @return The number of runs
+ */
+size_t particle_grid_get_neighbor_runs(const particle_grid_t *grid, vec3_t point,
+    uint32_t run_begins[PARTICLE_GRID_MAX_RUNS], uint32_t run_ends[PARTICLE_GRID_MAX_RUNS]);
+
+/**
+ * @brief Frees a grid
+ * @param grid The grid to free
+ */
+void particle_grid_destroy(particle_grid_t *grid);
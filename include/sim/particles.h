@@ -0,0 +1,163 @@
+#pragma once
+/**
+ * Point masses, for runs (gravity, springs, dust, ...) that never need
+ * a body's rotation, inertia or friction.  A particle is nothing but a
+ * position, velocity, mass and net force, and each of those is its own
+ * array, so a particle takes 40 bytes instead of the hundreds a body_t
+ * does, and stepping a large system is limited by memory bandwidth
+ * rather than by pointer chasing.  Forces work like they do for bodies:
+ * add them every step, then step, which clears them
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common/vec3.h"
+#include "sim/body.h"
+#include "sim/periodic.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define PARTICLES_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define PARTICLES_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define PARTICLES_ERROR_ALLOC -3
+
+/**
+ * The number of particles the arrays are padded to a multiple of, so
+ * kernels never need a scalar tail.  Padding particles sit at the
+ * origin with a mass of one and never move
+ */
+#define PARTICLES_ALIGNMENT 16
+
+/**
+ * A set of particles.  Each field is its own array, indexed by
+ * particle, so they can be read (or written) directly; e.g. particle i
+ * is at (position_x[i], position_y[i], position_z[i])
+ */
+struct ParticleSystem {
+    size_t count;
+    size_t capacity;
+
+    phy_real_t *position_x;
+    phy_real_t *position_y;
+    phy_real_t *position_z;
+    phy_real_t *velocity_x;
+    phy_real_t *velocity_y;
+    phy_real_t *velocity_z;
+    /**
+     * Must be positive, just like a body's
+     */
+    phy_real_t *mass;
+    /**
+     * The forces added since the last step
+     */
+    phy_real_t *force_x;
+    phy_real_t *force_y;
+    phy_real_t *force_z;
+};
+typedef struct ParticleSystem particle_system_t;
+
+/**
+ * @brief Creates an empty set of particles
+ * @param capacity The number of particles to make room for.  More room
+ * is made as needed, so this is only a hint
+ * @return A pointer to the system on success, or NULL on failure
+ */
+particle_system_t *particle_system_create(size_t capacity);
+
+/**
+ * @brief Adds a particle to a system.  The particle's index is the
+ * number of particles added before it
+ * @param system The system to add to
+ * @param position The particle's position
+ * @param velocity The particle's velocity
+ * @param mass The particle's mass
+ * @return PARTICLES_SUCCESS on success, or an error code on failure
+ */
+int particle_system_add(particle_system_t *system, vec3_t position, vec3_t velocity, phy_real_t mass);
+
+/**
+ * @brief Adds a particle with a body's position, velocity and mass.
+ * Anything else about the body (including the forces on it) is ignored
+ * @param system The system to add to
+ * @param body The body to copy
+ * @return PARTICLES_SUCCESS on success, or an error code on failure
+ */
+int particle_system_add_body(particle_system_t *system, const body_t *body);
+
+/**
+ * @brief Gets a particle's position
+ */
+static inline vec3_t particle_system_get_position(const particle_system_t *system, size_t index) {
+    return vec3_make(system->position_x[index], system->position_y[index], system->position_z[index]);
+}
+
+/**
+ * @brief Gets a particle's velocity
+ */
+static inline vec3_t particle_system_get_velocity(const particle_system_t *system, size_t index) {
+    return vec3_make(system->velocity_x[index], system->velocity_y[index], system->velocity_z[index]);
+}
+
+/**
+ * @brief Adds a force to a particle, like phy_body_add_force()
+ * @param system The system the particle is in
+ * @param index The particle's index
+ * @param force The force to add
+ */
+void particle_system_add_force(particle_system_t *system, size_t index, vec3_t force);
+
+/**
+ * @brief Applies gravity between every pair of particles with
+ * gravity_add_forces().  Unlike phy_bodies_add_gravity_forces(), nothing
+ * needs to be copied first
+ * @param system The particles to pull on each other
+ */
+void particle_system_add_gravity_forces(particle_system_t *system);
+
+/**
+ * @brief Applies a linear drag force to every particle, like calling
+ * phy_body_add_drag_force() on each one
+ * @param system The particles to slow down
+ * @param drag_coefficient The drag coefficient
+ */
+void particle_system_add_drag_force(particle_system_t *system, phy_real_t drag_coefficient);
+
+/**
+ * @brief Applies the forces on every particle over a step, then clears
+ * them.  The velocity is updated first, then the position (semi-implicit
+ * Euler), just like phy_body_step()
+ * @param system The particles to step
+ * @param dt The length of the step; 1 matches phy_body_step()
+ */
+void particle_system_step(particle_system_t *system, phy_real_t dt);
+
+/**
+ * @brief Steps every particle like particle_system_step(), then wraps
+ * each one back inside a periodic box if it left through one of the
+ * box's faces, like phy_body_step_periodic()
+ * @param system The particles to step
+ * @param dt The length of the step
+ * @param box The periodic box the particles are in
+ */
+void particle_system_step_periodic(particle_system_t *system, phy_real_t dt, const periodic_box_t *box);
+
+/**
+ * @brief Removes every particle from a system, keeping its memory
+ * @param system The system to clear
+ */
+void particle_system_clear(particle_system_t *system);
+
+/**
+ * @brief Frees a set of particles
+ * @param system The system to free
+ */
+void particle_system_destroy(particle_system_t *system);
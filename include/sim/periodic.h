@@ -0,0 +1,70 @@
+#pragma once
+/**
+ * Periodic boundary conditions: a box whose opposite faces are joined,
+ * so anything leaving one side comes back in the other.  A small
+ * periodic box stands in for an effectively infinite system, with
+ * bodies interacting through whichever copy (image) of each other is
+ * nearest -- the minimum image convention
+ */
+
+#include <stddef.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+
+/**
+ * The most images of a region periodic_box_get_images() will find;
+ * one per combination of shifts along each axis
+ */
+#define PERIODIC_MAX_IMAGES 27
+
+/**
+ * A periodic box.  Distances are only meaningful if nothing interacts
+ * over more than half of the box's size along any periodic axis
+ */
+struct PeriodicBox {
+    /**
+     * The box's lowest corner
+     */
+    vec3_t origin;
+    /**
+     * The size of the box along each axis.  Axes with a size of zero
+     * aren't periodic, so e.g. a slab can repeat along x and z only
+     */
+    vec3_t size;
+};
+typedef struct PeriodicBox periodic_box_t;
+
+/**
+ * Creates a periodic box
+ */
+#define periodic_box_make(_origin, _size) ((periodic_box_t){ .origin = _origin, .size = _size })
+
+/**
+ * @brief Moves a point back inside the box, along every periodic axis
+ * @param box The box to use
+ * @param point The point to move
+ * @return The point's image inside the box
+ */
+vec3_t periodic_box_wrap(const periodic_box_t *box, vec3_t point);
+
+/**
+ * @brief Finds the shortest offset from one point to any image of another
+ * @param box The box to use.  If NULL, nothing is periodic and this is
+ * just to - from
+ * @param from The point to measure from
+ * @param to The point to measure to
+ * @return The offset from from to the nearest image of to
+ */
+vec3_t periodic_box_get_displacement(const periodic_box_t *box, vec3_t from, vec3_t to);
+
+/**
+ * @brief Finds every way a region has to be shifted so that it covers
+ * everything it overlaps across the box's faces.  A region entirely
+ * inside the box just gets the zero shift
+ * @param box The box to use
+ * @param bounds The region to find images of
+ * @param shifts Populated with the offsets of every image, starting
+ * with the region itself (a zero offset)
+ * @return The number of shifts
+ */
+size_t periodic_box_get_images(const periodic_box_t *box, bbox_t bounds, vec3_t shifts[PERIODIC_MAX_IMAGES]);
@@ -0,0 +1,96 @@
+#pragma once
+/**
+ * Short-range pair potentials: forces between two bodies that only
+ * depend on how far apart they are, and vanish past a cutoff distance
+ * (soft repulsion, Lennard-Jones, cohesion, etc.)
+ */
+
+#include "common/defines.h"
+
+/**
+ * Calculates the force between two bodies a given distance apart
+ * @param params The potential's parameters
+ * @param distance_sqr The squared distance between the bodies; always
+ * less than the potential's squared cutoff, and greater than zero
+ * @return The magnitude of the force, divided by the distance.  Positive
+ * values push the bodies apart, negative values pull them together.
+ * Dividing by the distance lets most potentials skip a square root
+ */
+typedef phy_real_t (*pair_potential_func_t)(const void *params, phy_real_t distance_sqr);
+
+/**
+ * A pair potential, along with its parameters
+ */
+struct PairPotential {
+    pair_potential_func_t force;
+    const void *params;
+    /**
+     * Bodies further apart than this don't affect each other
+     */
+    phy_real_t cutoff;
+};
+typedef struct PairPotential pair_potential_t;
+
+/**
+ * Creates a pair potential.  params must outlive the potential
+ */
+#define pair_potential_make(_force, _params, _cutoff) \
+    ((pair_potential_t){ .force = _force, .params = _params, .cutoff = _cutoff })
+
+/**
+ * Parameters for pair_potential_lennard_jones()
+ */
+struct LennardJonesParams {
+    /**
+     * How deep the potential's well is
+     */
+    phy_real_t epsilon;
+    /**
+     * The distance at which the potential is zero.  Bodies settle at
+     * about 1.12 times this distance
+     */
+    phy_real_t sigma;
+};
+typedef struct LennardJonesParams lennard_jones_params_t;
+
+/**
+ * Parameters for pair_potential_soft_repulsion()
+ */
+struct SoftRepulsionParams {
+    phy_real_t stiffness;
+    /**
+     * Bodies closer than this are pushed apart
+     */
+    phy_real_t range;
+};
+typedef struct SoftRepulsionParams soft_repulsion_params_t;
+
+/**
+ * Parameters for pair_potential_cohesion()
+ */
+struct CohesionParams {
+    phy_real_t stiffness;
+    /**
+     * The distance bodies are pulled toward (or pushed away from)
+     */
+    phy_real_t rest_distance;
+};
+typedef struct CohesionParams cohesion_params_t;
+
+/**
+ * The 12-6 Lennard-Jones potential; strong repulsion up close, with a
+ * weak attraction further out.  params is a lennard_jones_params_t
+ */
+phy_real_t pair_potential_lennard_jones(const void *params, phy_real_t distance_sqr);
+
+/**
+ * A harmonic repulsion that only acts on bodies closer than a given
+ * range.  params is a soft_repulsion_params_t
+ */
+phy_real_t pair_potential_soft_repulsion(const void *params, phy_real_t distance_sqr);
+
+/**
+ * A harmonic spring toward a rest distance, acting on any two bodies
+ * within the potential's cutoff.  params is a cohesion_params_t
+ */
+phy_real_t pair_potential_cohesion(const void *params, phy_real_t distance_sqr);
@@ -0,0 +1,127 @@
+#pragma once
+/**
+ * Batched scene queries: casting many rays, or checking many shapes for
+ * overlaps, against a fixed set of colliders at once.  Rays are grouped
+ * into packets that walk the scene's BVH together, and batches can be
+ * split across a thread pool.  Nothing is allocated while querying;
+ * results go straight into the caller's buffers
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+#include "sim/bvh.h"
+#include "sim/collider.h"
+#include "sim/periodic.h"
+#include "sim/ray.h"
+
+/**
+ * The number of rays that walk the BVH together
+ */
+#define QUERY_PACKET_SIZE 4
+
+/**
+ * Marks a ray that didn't hit anything
+ */
+#define QUERY_NO_HIT UINT32_MAX
+
+/**
+ * A set of colliders that can be queried
+ */
+struct QueryScene {
+    collider_t *colliders;
+    bbox_t *bounds;
+    size_t collider_count;
+    bvh_t *bvh;
+    /**
+     * If periodic is set, overlap queries also find colliders
+     * through the periodic box's faces
+     */
+    periodic_box_t periodic_box;
+    bool periodic;
+};
+typedef struct QueryScene query_scene_t;
+
+/**
+ * Where a ray first hit the scene
+ */
+struct RayHit {
+    /**
+     * The index of the collider that was hit, or QUERY_NO_HIT if
+     * the ray didn't hit anything.  The rest of the hit is only
+     * filled in if something was hit
+     */
+    uint32_t collider;
+    phy_real_t distance;
+    vec3_t point;
+    vec3_t normal;
+};
+typedef struct RayHit ray_hit_t;
+
+/**
+ * @brief Creates a scene to run queries against
+ * @param colliders The colliders in the scene.  These are copied, so
+ * the array doesn't need to outlive the scene
+ * @param count The number of colliders
+ * @return A pointer to the scene on success, or NULL on failure
+ */
+query_scene_t *query_scene_create(const collider_t *colliders, size_t count);
+
+/**
+ * @brief Moves the scene's colliders.  The scene's BVH is refit rather
+ * than rebuilt, so this is cheap enough to call every frame
+ * @param scene The scene to update
+ * @param colliders The new state of every collider, in the same order
+ * as when the scene was created
+ */
+void query_scene_update(query_scene_t *scene, const collider_t *colliders);
+
+/**
+ * @brief Makes a scene periodic, so that overlap queries find colliders
+ * on the far side of a periodic box's faces.  The scene's colliders
+ * should be inside the box, and each query shape is expected to be
+ * smaller than half the box.  Ray casts aren't affected
+ * @param scene The scene to update
+ * @param box The periodic box to use, or NULL to make the scene
+ * non-periodic.  The box is copied
+ */
+void query_scene_set_periodic_box(query_scene_t *scene, const periodic_box_t *box);
+
+/**
+ * @brief Finds where each of a batch of rays first hits the scene.
+ * Consecutive rays are grouped into packets of QUERY_PACKET_SIZE, so
+ * batches run fastest when neighboring rays start near each other and
+ * point in similar directions (e.g. rays from one sensor, in order)
+ * @param scene The scene to cast against
+ * @param rays The rays to cast
+ * @param count The number of rays
+ * @param hits Populated with where each ray first hit the scene
+ * @param pool The threads to split the batch across (can be null)
+ */
+void query_scene_cast_rays(const query_scene_t *scene, const ray_t *rays, size_t count, ray_hit_t *hits, threadpool_t *pool);
+
+/**
+ * @brief Finds which of the scene's colliders each of a batch of shapes
+ * overlaps
+ * @param scene The scene to search
+ * @param shapes The shapes to check
+ * @param count The number of shapes
+ * @param results Populated with the indices of the colliders each shape
+ * overlaps.  Shape i's results start at results[i * max_results], and
+ * at most max_results are written per shape
+ * @param max_results The most results that will be written for each shape
+ * @param result_counts Populated with the number of colliders each shape
+ * overlaps.  If this is larger than max_results, only the first
+ * max_results were written
+ * @param pool The threads to split the batch across (can be null)
+ */
+void query_scene_overlap_colliders(const query_scene_t *scene, const collider_t *shapes, size_t count,
+    uint32_t *results, size_t max_results, size_t *result_counts, threadpool_t *pool);
+
+/**
+ * @brief Frees a query scene
+ * @param scene The scene to free
+ */
+void query_scene_destroy(query_scene_t *scene);
@@ -0,0 +1,46 @@
+#pragma once
+/**
+ * Rays, and how to find where they first hit each kind of collider
+ */
+
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/collider.h"
+
+/**
+ * A half-line starting at an origin, limited to a maximum distance
+ */
+struct Ray {
+    vec3_t origin;
+    /**
+     * The direction the ray travels in.  Must be a unit vector
+     */
+    vec3_t direction;
+    /**
+     * How far along the ray hits are searched for
+     */
+    phy_real_t max_distance;
+};
+typedef struct Ray ray_t;
+
+/**
+ * Creates a ray.  The direction must already be a unit vector
+ */
+#define ray_make(_origin, _direction, _max_distance) \
+    ((ray_t){ .origin = _origin, .direction = _direction, .max_distance = _max_distance })
+
+/**
+ * Gets the point a given distance along a ray
+ */
+vec3_t ray_point_at(ray_t ray, phy_real_t distance);
+
+/**
+ * @brief Finds where a ray first hits a collider
+ * @param ray The ray to cast.  Rays that start inside a collider hit it
+ * immediately, at distance 0, with a normal pointing back along the ray
+ * @param collider The collider to cast against
+ * @param distance Populated with how far along the ray the hit is (can be null)
+ * @param normal Populated with the collider's surface normal at the hit (can be null)
+ * @return true if the ray hits the collider within its maximum distance
+ */
+bool ray_intersects_collider(ray_t ray, collider_t collider, phy_real_t *distance, vec3_t *normal);
@@ -0,0 +1,155 @@
+#pragma once
+/**
+ * A signed distance field (SDF) collider, for intricate static geometry
+ * like machinery or caves.  The distance to the geometry's surface is
+ * precomputed on a grid, so checking a particle or sphere against it
+ * costs a single lookup no matter how complex the geometry is
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+#include "sim/sphere.h"
+#include "sim/collider.h"
+#include "sim/contact.h"
+#include "sim/trimesh.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define SDF_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define SDF_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define SDF_ERROR_ALLOC -3
+
+/**
+ * The largest magnitude a quantized distance can have
+ */
+#define SDF_QUANTIZED_MAX INT16_MAX
+
+/**
+ * A grid of distances to the surface of some geometry.  Distances are
+ * stored as 16-bit fractions of max_distance to keep the grid compact;
+ * anything further from the surface than that is clamped
+ */
+struct SignedDistanceField {
+    /**
+     * One quantized distance per sample, stored x-first, then y, then z.
+     * Negative distances are inside the geometry
+     */
+    int16_t *distances;
+    size_t size_x;
+    size_t size_y;
+    size_t size_z;
+    /**
+     * The position of the first sample
+     */
+    vec3_t origin;
+    /**
+     * The distance between neighboring samples
+     */
+    phy_real_t cell_size;
+    /**
+     * The largest distance the field stores
+     */
+    phy_real_t max_distance;
+};
+typedef struct SignedDistanceField sdf_t;
+
+/**
+ * @brief Creates an empty distance field, where every sample is as
+ * far from the surface as can be stored.  Geometry is added to it with
+ * sdf_add_collider() and sdf_add_trimesh()
+ * @param origin The position of the first sample
+ * @param size_x The number of samples along the x-axis (at least 2)
+ * @param size_y The number of samples along the y-axis (at least 2)
+ * @param size_z The number of samples along the z-axis (at least 2)
+ * @param cell_size The distance between neighboring samples
+ * @param max_distance The largest distance the field will store
+ * @return A pointer to the field on success, or NULL on failure
+ */
+sdf_t *sdf_create(vec3_t origin, size_t size_x, size_t size_y, size_t size_z, phy_real_t cell_size, phy_real_t max_distance);
+
+/**
+ * @brief Adds a shape to a distance field
+ * @param field The field to add to
+ * @param collider The shape to add
+ * @return 0 on success, or a negative error code on failure
+ */
+int sdf_add_collider(sdf_t *field, collider_t collider);
+
+/**
+ * @brief Adds a triangle mesh to a distance field.  The mesh must be
+ * closed, since whether a sample is inside it is decided by counting
+ * how many triangles a ray from the sample crosses
+ * @param field The field to add to
+ * @param mesh The mesh to add
+ * @return 0 on success, or a negative error code on failure
+ */
+int sdf_add_trimesh(sdf_t *field, const trimesh_t *mesh);
+
+/**
+ * @brief Finds the distance from a point to the field's surface,
+ * interpolated between the nearest samples.  Points outside the grid
+ * are treated as at least as far away as the grid's edge
+ * @param field The field to sample
+ * @param point The point to measure
+ * @return The distance to the surface; negative inside the geometry
+ */
+phy_real_t sdf_sample(const sdf_t *field, vec3_t point);
+
+/**
+ * @brief Finds the direction in which the distance to the field's surface
+ * grows fastest; at the surface, this is its normal
+ * @param field The field to sample
+ * @param point The point to use
+ * @return A unit vector, or a zero vector if the field is flat there
+ */
+vec3_t sdf_get_gradient(const sdf_t *field, vec3_t point);
+
+/**
+ * @brief Generates a contact between a distance field and a sphere
+ * @param field The field to check
+ * @param sphere The sphere to check
+ * @param contact Populated with the contact, pushing the sphere away
+ * from the surface, if there is one (can be null)
+ * @return true if the sphere touches the surface
+ */
+bool sdf_collide_csphere(const sdf_t *field, csphere_t sphere, contact_t *contact);
+
+/**
+ * @brief Checks many equally-sized particles against a distance field
+ * @param field The field to check
+ * @param positions The center of each particle
+ * @param count The number of particles
+ * @param radius The radius of every particle
+ * @param contacts Populated with a contact for each particle touching the surface
+ * @param particles Populated with the index of the particle each contact belongs to
+ * @param max_contacts The most contacts that will be written
+ * @return The number of contacts.  If this is larger than max_contacts,
+ * only the first max_contacts were written
+ */
+size_t sdf_collide_particles(const sdf_t *field, const vec3_t *positions, size_t count, phy_real_t radius,
+    contact_t *contacts, uint32_t *particles, size_t max_contacts);
+
+/**
+ * @brief Calculates the AABB covered by a distance field's grid
+ * @param field The field to bound
+ * @param box Populated with the bounding box
+ */
+void sdf_get_bounds(const sdf_t *field, bbox_t *box);
+
+/**
+ * @brief Frees a distance field
+ * @param field The field to free
+ */
+void sdf_destroy(sdf_t *field);
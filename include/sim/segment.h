@@ -0,0 +1,71 @@
+#pragma once
+/**
+ * Definitions and closest-point utilities for line segments.
+ * These are the core kernels behind the capsule collider
+ */
+
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+
+/**
+ * A line segment; every point between start and end
+ */
+struct Segment {
+    vec3_t start;
+    vec3_t end;
+};
+typedef struct Segment segment_t;
+
+/**
+ * Creates a segment going from start to end
+ */
+#define segment_make(_start, _end) ((segment_t){ .start = _start, .end = _end })
+
+/**
+ * Gets the point on the segment at a given parameter, where 0 is the
+ * segment's start and 1 is its end
+ */
+vec3_t segment_point_at(segment_t segment, phy_real_t t);
+
+/**
+ * Finds the parameter (0 at start, 1 at end) of the point on the
+ * segment closest to a given point
+ */
+phy_real_t segment_closest_parameter(segment_t segment, vec3_t point);
+
+/**
+ * 'Clamps' a point to the closest point on the segment
+ */
+void segment_clamp_point(segment_t segment, vec3_t *point);
+
+/**
+ * @brief Finds the closest pair of points between two segments
+ * @param a The first segment
+ * @param b The second segment
+ * @param on_a Populated with the point on a closest to b (can be null)
+ * @param on_b Populated with the point on b closest to a (can be null)
+ * @return The square of the distance between the two points
+ */
+phy_real_t segment_closest_points_segment(segment_t a, segment_t b, vec3_t *on_a, vec3_t *on_b);
+
+/**
+ * @brief Checks if a segment passes through an AABB
+ * @param segment The segment to check
+ * @param box The AABB to check
+ * @param t_enter Populated with the parameter where the segment
+ * enters the box (can be null)
+ * @return true if the segment touches the box
+ */
+bool segment_intersects_bbox(segment_t segment, bbox_t box, phy_real_t *t_enter);
+
+/**
+ * @brief Finds the closest pair of points between a segment and an AABB.
+ * If the segment passes through the box, both points are where it enters
+ * @param segment The segment to use
+ * @param box The AABB to use
+ * @param on_segment Populated with the point on the segment closest to the box (can be null)
+ * @param on_box Populated with the point on the box closest to the segment (can be null)
+ * @return The square of the distance between the two points
+ */
+phy_real_t segment_closest_points_bbox(segment_t segment, bbox_t box, vec3_t *on_segment, vec3_t *on_box);
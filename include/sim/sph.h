@@ -0,0 +1,199 @@
+#pragma once
+/**
+ * A smoothed particle hydrodynamics (SPH) fluid.  The fluid is made of
+ * particles, each carrying a bit of mass; density is found by summing
+ * each particle's neighbors, and pressure comes from how much denser the
+ * fluid is than it wants to be (weakly compressible SPH).  Particles are
+ * stored per-field and re-sorted by grid cell every step, so each
+ * particle's neighbors sit in a few contiguous runs that can be read
+ * SIMD_WIDTH at a time
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+#include "sim/aabb.h"
+#include "sim/body.h"
+#include "sim/query.h"
+#include "sim/particle_grid.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define SPH_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define SPH_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define SPH_ERROR_ALLOC -3
+
+/**
+ * The most colliders a single particle can be pushed by in one step
+ */
+#define SPH_MAX_COLLIDERS_PER_PARTICLE 4
+
+/**
+ * The properties of a fluid
+ */
+struct SphParams {
+    /**
+     * How far apart particles are when the fluid is at rest.  Particles
+     * interact with everything within twice this distance
+     */
+    phy_real_t particle_spacing;
+    /**
+     * The fluid's density at rest
+     */
+    phy_real_t rest_density;
+    /**
+     * How fast pressure waves move through the fluid, which sets how
+     * stiff it is.  Around ten times the fastest flow keeps the density
+     * within about one percent of rest
+     */
+    phy_real_t speed_of_sound;
+    /**
+     * The fluid's dynamic viscosity
+     */
+    phy_real_t viscosity;
+};
+typedef struct SphParams sph_params_t;
+
+/**
+ * Creates a new set of fluid properties
+ */
+#define sph_params_make(_particle_spacing, _rest_density, _speed_of_sound, _viscosity) \
+    ((sph_params_t){ .particle_spacing = _particle_spacing, .rest_density = _rest_density, \
+        .speed_of_sound = _speed_of_sound, .viscosity = _viscosity })
+
+/**
+ * Bodies for a fluid to push on (and be pushed by), found through a
+ * query scene.  The scene's collider i is the shape of bodies[i]
+ */
+struct SphCoupling {
+    const query_scene_t *scene;
+    /**
+     * The bodies the scene's colliders belong to, or NULL if they're
+     * all static geometry that the fluid can't move
+     */
+    body_t *bodies;
+    /**
+     * The acceleration per unit of depth pushing particles out of colliders
+     */
+    phy_real_t stiffness;
+    /**
+     * The acceleration per unit of speed resisting particles moving into colliders
+     */
+    phy_real_t damping;
+};
+typedef struct SphCoupling sph_coupling_t;
+
+/**
+ * A fluid.  Each field is its own array, indexed by particle.  Particles
+ * are reordered every step, so use ids to keep track of them
+ */
+struct SphFluid {
+    size_t particle_count;
+    size_t particle_capacity;
+
+    phy_real_t *position_x;
+    phy_real_t *position_y;
+    phy_real_t *position_z;
+    phy_real_t *velocity_x;
+    phy_real_t *velocity_y;
+    phy_real_t *velocity_z;
+    /**
+     * The index each particle had when it was added
+     */
+    uint32_t *ids;
+    /**
+     * The density, pressure, and acceleration of each particle as of
+     * the last step
+     */
+    phy_real_t *density;
+    phy_real_t *pressure;
+    phy_real_t *acceleration_x;
+    phy_real_t *acceleration_y;
+    phy_real_t *acceleration_z;
+
+    sph_params_t params;
+    /**
+     * How far particles reach; twice the particle spacing
+     */
+    phy_real_t smoothing_length;
+    phy_real_t particle_mass;
+    vec3_t gravity;
+    /**
+     * If has_bounds is set, particles are kept inside these bounds
+     */
+    bbox_t bounds;
+    bool has_bounds;
+
+    particle_grid_t *grid;
+    /**
+     * Room for reordering particles, and for finding which colliders
+     * each particle touches
+     */
+    void *scratch;
+    collider_t *coupling_shapes;
+    uint32_t *coupling_results;
+    size_t *coupling_counts;
+};
+typedef struct SphFluid sph_fluid_t;
+
+/**
+ * @brief Creates an empty fluid
+ * @param params The fluid's properties
+ * @param gravity The acceleration applied to every particle
+ * @return A pointer to the fluid on success, or NULL on failure
+ */
+sph_fluid_t *sph_fluid_create(sph_params_t params, vec3_t gravity);
+
+/**
+ * @brief Adds a particle to a fluid.  Particles should be spaced about
+ * params.particle_spacing apart, or the fluid will start out compressed
+ * @param fluid The fluid to add to
+ * @param position The particle's position
+ * @param velocity The particle's velocity
+ * @return SPH_SUCCESS on success, or an error code on failure
+ */
+int sph_fluid_add_particle(sph_fluid_t *fluid, vec3_t position, vec3_t velocity);
+
+/**
+ * @brief Keeps every particle inside a box
+ * @param fluid The fluid to update
+ * @param bounds The box to keep particles in, or NULL to remove it.
+ * The box is copied
+ */
+void sph_fluid_set_bounds(sph_fluid_t *fluid, const bbox_t *bounds);
+
+/**
+ * @brief Finds the longest step a fluid can take and stay stable
+ * @param fluid The fluid to check
+ * @return The largest stable step
+ */
+phy_real_t sph_fluid_get_max_step(const sph_fluid_t *fluid);
+
+/**
+ * @brief Advances a fluid by one step
+ * @param fluid The fluid to step
+ * @param dt The length of the step; see sph_fluid_get_max_step()
+ * @param coupling The bodies the fluid interacts with (can be null).
+ * The fluid's forces are added to each body, for phy_body_step() to use
+ * @param pool The threads to split the step across (can be null)
+ * @return SPH_SUCCESS on success, or an error code on failure.  On
+ * failure, the particles aren't moved
+ */
+int sph_fluid_step(sph_fluid_t *fluid, phy_real_t dt, const sph_coupling_t *coupling, threadpool_t *pool);
+
+/**
+ * @brief Frees a fluid
+ * @param fluid The fluid to free
+ */
+void sph_fluid_destroy(sph_fluid_t *fluid);
@@ -18,7 +18,7 @@ typedef struct SphereCollider csphere_t;
  * Creates a new sphere with the specified radius
  * centered at a given point
  */
-#define csphere_make(center, radius) ((csphere_t){ .center = center, .radius = radius })
+#define csphere_make(_center, _radius) ((csphere_t){ .center = _center, .radius = _radius })
 
 /**
  * Checks if a point is inside the given sphere
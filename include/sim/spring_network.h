@@ -0,0 +1,138 @@
+#pragma once
+/**
+ * A container for large numbers of springs (ropes, meshes, ...) between
+ * bodies in one array.  Unlike spring_t, springs refer to their bodies by
+ * index and are stored per-field, so forces can be evaluated SIMD_WIDTH
+ * springs at a time.  Springs are graph colored so that no two springs of
+ * the same color share a body, which lets each color add its forces to
+ * the bodies in parallel without any locking
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+#include "sim/body.h"
+#include "sim/constraints.h"
+#include "sim/periodic.h"
+#include "sim/particles.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define SPRING_NETWORK_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define SPRING_NETWORK_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define SPRING_NETWORK_ERROR_ALLOC -3
+
+/**
+ * A set of springs.  Spring i connects bodies[body_a[i]] and
+ * bodies[body_b[i]], with endpoints (relative to each body's position)
+ * (a_endpoint_x[i], ...) and (b_endpoint_x[i], ...), and behaves like a
+ * spring_t with the same values.  After forces are applied, springs are
+ * sorted by color: springs color_starts[c] through color_starts[c + 1] - 1
+ * have color c
+ */
+struct SpringNetwork {
+    size_t spring_count;
+    size_t spring_capacity;
+
+    uint32_t *body_a;
+    uint32_t *body_b;
+    phy_real_t *a_endpoint_x;
+    phy_real_t *a_endpoint_y;
+    phy_real_t *a_endpoint_z;
+    phy_real_t *b_endpoint_x;
+    phy_real_t *b_endpoint_y;
+    phy_real_t *b_endpoint_z;
+    phy_real_t *spring_constant;
+    phy_real_t *equilibrium_distance;
+    /**
+     * The largest body index any spring refers to, checked against the
+     * number of bodies every time forces are applied
+     */
+    uint32_t max_body_index;
+
+    uint32_t *color_starts;
+    size_t color_count;
+    /**
+     * Set when springs have been added since the network was last colored
+     */
+    bool needs_coloring;
+};
+typedef struct SpringNetwork spring_network_t;
+
+/**
+ * @brief Creates an empty spring network
+ * @param capacity The number of springs to make room for.  More room is
+ * made as needed, so this is only a hint
+ * @return A pointer to the network on success, or NULL on failure
+ */
+spring_network_t *spring_network_create(size_t capacity);
+
+/**
+ * @brief Adds a spring to a network.  The spring's index is the number
+ * of springs added before it, until forces are next applied (which
+ * sorts the springs by color)
+ * @param network The network to add to
+ * @param a The index of the first body
+ * @param a_endpoint Where the spring attaches, relative to the first body's position
+ * @param b The index of the second body
+ * @param b_endpoint Where the spring attaches, relative to the second body's position
+ * @param spring_constant The spring's stiffness
+ * @param equilibrium_distance The spring's length at rest
+ * @return SPRING_NETWORK_SUCCESS on success, or an error code on failure
+ */
+int spring_network_add(spring_network_t *network, uint32_t a, vec3_t a_endpoint, uint32_t b, vec3_t b_endpoint,
+    phy_real_t spring_constant, phy_real_t equilibrium_distance);
+
+/**
+ * @brief Adds a copy of a spring_t to a network
+ * @param network The network to add to
+ * @param spring The spring to copy.  Both of its bodies must be in bodies
+ * @param bodies The array the network's body indices refer to
+ * @param body_count The number of bodies in the array
+ * @return SPRING_NETWORK_SUCCESS on success, or an error code on failure
+ */
+int spring_network_add_spring(spring_network_t *network, spring_t spring, const body_t *bodies, size_t body_count);
+
+/**
+ * @brief Adds every spring's force and torque to the bodies it connects,
+ * just like calling spring_apply_constraint_periodic() on each spring
+ * @param network The springs to apply
+ * @param bodies The bodies the springs' indices refer to
+ * @param body_count The number of bodies
+ * @param box The periodic box the bodies are in (can be null)
+ * @param pool The threads to split each color of springs across (can be null)
+ * @return SPRING_NETWORK_SUCCESS on success, or an error code on failure.
+ * On failure, no forces are applied
+ */
+int spring_network_apply(spring_network_t *network, body_t *bodies, size_t body_count, const periodic_box_t *box, threadpool_t *pool);
+
+/**
+ * @brief Adds every spring's force to the particles it connects, like
+ * spring_network_apply().  Body indices refer to particles instead, and
+ * since particles don't rotate, endpoints are plain offsets from their
+ * positions and no torque is applied
+ * @param network The springs to apply
+ * @param particles The particles the springs' indices refer to
+ * @param box The periodic box the particles are in (can be null)
+ * @param pool The threads to split each color of springs across (can be null)
+ * @return SPRING_NETWORK_SUCCESS on success, or an error code on failure.
+ * On failure, no forces are applied
+ */
+int spring_network_apply_particles(spring_network_t *network, particle_system_t *particles, const periodic_box_t *box, threadpool_t *pool);
+
+/**
+ * @brief Frees a spring network
+ * @param network The network to free
+ */
+void spring_network_destroy(spring_network_t *network);
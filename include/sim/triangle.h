@@ -0,0 +1,124 @@
+#pragma once
+/**
+ * Definitions and collision utilities for single triangles.
+ * These are the core kernels behind the triangle mesh collider
+ */
+
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+#include "sim/sphere.h"
+#include "sim/cube.h"
+#include "sim/capsule.h"
+#include "sim/segment.h"
+#include "sim/collider.h"
+#include "sim/contact.h"
+
+/**
+ * A triangle.  The front face is the side from which a, b, c
+ * appear counterclockwise
+ */
+struct Triangle {
+    vec3_t a;
+    vec3_t b;
+    vec3_t c;
+};
+typedef struct Triangle triangle_t;
+
+/**
+ * Creates a triangle from its three corners
+ */
+#define triangle_make(_a, _b, _c) ((triangle_t){ .a = _a, .b = _b, .c = _c })
+
+/**
+ * Gets the unit normal of a triangle's front face.  Degenerate
+ * triangles have a zero normal
+ */
+vec3_t triangle_get_normal(triangle_t triangle);
+
+/**
+ * 'Clamps' a point to the closest point on the triangle
+ */
+void triangle_clamp_point(triangle_t triangle, vec3_t *point);
+
+/**
+ * @brief Checks if a segment passes through a triangle, from either side
+ * @param triangle The triangle to check
+ * @param segment The segment to check
+ * @param t Populated with the parameter along the segment where it
+ * passes through the triangle (can be null)
+ * @return true if the segment touches the triangle
+ */
+bool triangle_intersects_segment(triangle_t triangle, segment_t segment, phy_real_t *t);
+
+/**
+ * @brief Finds the closest pair of points between a triangle and a segment.
+ * If the segment passes through the triangle, both points are where it does
+ * @param triangle The triangle to use
+ * @param segment The segment to use
+ * @param on_triangle Populated with the point on the triangle closest to the segment (can be null)
+ * @param on_segment Populated with the point on the segment closest to the triangle (can be null)
+ * @return The square of the distance between the two points
+ */
+phy_real_t triangle_closest_points_segment(triangle_t triangle, segment_t segment, vec3_t *on_triangle, vec3_t *on_segment);
+
+/**
+ * @brief Calculates the smallest AABB containing the whole triangle
+ * @param triangle The triangle to bound
+ * @param box Populated with the bounding box
+ */
+void triangle_get_bounds(triangle_t triangle, bbox_t *box);
+
+/**
+ * @brief Generates a contact between a triangle and a sphere
+ * @param triangle The triangle to check
+ * @param sphere The sphere to check
+ * @param contact Populated with the contact, pushing the sphere away
+ * from the triangle, if there is one (can be null)
+ * @return true if the sphere touches the triangle
+ */
+bool triangle_collide_csphere(triangle_t triangle, csphere_t sphere, contact_t *contact);
+
+/**
+ * @brief Generates a contact between a triangle and a capsule.  A capsule
+ * passing all the way through the triangle is pushed out whichever side
+ * its core segment is mostly on
+ * @param triangle The triangle to check
+ * @param capsule The capsule to check
+ * @param contact Populated with the contact, pushing the capsule away
+ * from the triangle, if there is one (can be null)
+ * @return true if the capsule touches the triangle
+ */
+bool triangle_collide_ccapsule(triangle_t triangle, ccapsule_t capsule, contact_t *contact);
+
+/**
+ * @brief Generates a contact between a triangle and an AABB using the
+ * separating axis test
+ * @param triangle The triangle to check
+ * @param box The AABB to check
+ * @param contact Populated with the contact, pushing the box away
+ * from the triangle, if there is one (can be null)
+ * @return true if the box touches the triangle
+ */
+bool triangle_collide_bbox(triangle_t triangle, bbox_t box, contact_t *contact);
+
+/**
+ * @brief Generates a contact between a triangle and a cube using the
+ * separating axis test
+ * @param triangle The triangle to check
+ * @param cube The cube to check
+ * @param contact Populated with the contact, pushing the cube away
+ * from the triangle, if there is one (can be null)
+ * @return true if the cube touches the triangle
+ */
+bool triangle_collide_ccube(triangle_t triangle, ccube_t cube, contact_t *contact);
+
+/**
+ * @brief Generates a contact between a triangle and any kind of collider
+ * @param triangle The triangle to check
+ * @param collider The collider to check
+ * @param contact Populated with the contact, pushing the collider away
+ * from the triangle, if there is one (can be null)
+ * @return true if the collider touches the triangle
+ */
+bool triangle_collide_collider(triangle_t triangle, collider_t collider, contact_t *contact);
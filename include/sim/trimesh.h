@@ -0,0 +1,126 @@
+#pragma once
+/**
+ * A static triangle mesh collider, for level geometry and other large
+ * environments that never move.  Meshes are queried directly against
+ * moving shapes, so they never need to be put in a broadphase
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common/vec3.h"
+#include "sim/aabb.h"
+#include "sim/bvh.h"
+#include "sim/collider.h"
+#include "sim/contact.h"
+#include "sim/triangle.h"
+
+/**
+ * The largest value a quantized coordinate can have
+ */
+#define TRIMESH_QUANTIZED_MAX UINT16_MAX
+
+/**
+ * A single node of a mesh's BVH.  Like bvh_node_t, but bounds are
+ * stored as 16-bit offsets from the mesh's bounds, less than
+ * half the size
+ */
+struct TriangleMeshNode {
+    uint16_t min_x[BVH_WIDTH];
+    uint16_t min_y[BVH_WIDTH];
+    uint16_t min_z[BVH_WIDTH];
+    uint16_t max_x[BVH_WIDTH];
+    uint16_t max_y[BVH_WIDTH];
+    uint16_t max_z[BVH_WIDTH];
+    /**
+     * For an inner child, the index of its node.  For a leaf, the
+     * index of its first triangle.  BVH_EMPTY if the slot is unused
+     */
+    uint32_t child[BVH_WIDTH];
+    /**
+     * The number of triangles in a leaf, or 0 if the child is a node
+     */
+    uint8_t triangle_count[BVH_WIDTH];
+};
+typedef struct TriangleMeshNode trimesh_node_t;
+
+/**
+ * A static mesh of triangles, along with a BVH over them.
+ * Triangles are reordered when the mesh is created so that each
+ * leaf of the tree covers a contiguous range
+ */
+struct TriangleMesh {
+    vec3_t *vertices;
+    size_t vertex_count;
+    /**
+     * Three vertex indices per triangle
+     */
+    uint32_t *indices;
+    size_t triangle_count;
+
+    trimesh_node_t *nodes;
+    size_t node_count;
+
+    /**
+     * The exact bounds of every triangle in the mesh
+     */
+    bbox_t bounds;
+    /**
+     * A quantized coordinate q corresponds to origin + q * scale
+     */
+    vec3_t origin;
+    vec3_t scale;
+};
+typedef struct TriangleMesh trimesh_t;
+
+/**
+ * @brief Creates a mesh and builds its BVH.  The vertices and
+ * indices are copied, so they can be freed afterward
+ * @param vertices The mesh's vertices, in world space
+ * @param vertex_count The number of vertices
+ * @param indices Three indices into vertices per triangle
+ * @param triangle_count The number of triangles
+ * @return A pointer to the mesh on success, or NULL on failure
+ */
+trimesh_t *trimesh_create(const vec3_t *vertices, size_t vertex_count, const uint32_t *indices, size_t triangle_count);
+
+/**
+ * Gets a single triangle of a mesh.  Note that triangles are
+ * reordered when the mesh is created
+ */
+triangle_t trimesh_get_triangle(const trimesh_t *mesh, size_t index);
+
+/**
+ * @brief Calculates a bounding box containing the whole mesh
+ * @param mesh The mesh to bound
+ * @param box Populated with the bounding box
+ */
+void trimesh_get_bounds(const trimesh_t *mesh, bbox_t *box);
+
+/**
+ * @brief Finds every triangle that could overlap a box (see bvh_query_bbox())
+ * @param mesh The mesh to search
+ * @param box The region to search
+ * @param triangles Populated with the indices of the candidate triangles
+ * @param max_triangles The most indices that will be written to triangles
+ * @return The number of candidate triangles.  If this is larger than
+ * max_triangles, only the first max_triangles were written
+ */
+size_t trimesh_query_bbox(const trimesh_t *mesh, bbox_t box, uint32_t *triangles, size_t max_triangles);
+
+/**
+ * @brief Generates a contact for every triangle a collider is touching
+ * @param mesh The mesh to check
+ * @param collider The collider to check
+ * @param contacts Populated with the contacts, each pushing the
+ * collider away from the mesh
+ * @param max_contacts The most contacts that will be written to contacts
+ * @return The number of contacts.  If this is larger than max_contacts,
+ * only the first max_contacts were written
+ */
+size_t trimesh_collide_collider(const trimesh_t *mesh, collider_t collider, contact_t *contacts, size_t max_contacts);
+
+/**
+ * @brief Frees a mesh
+ * @param mesh The mesh to free
+ */
+void trimesh_destroy(trimesh_t *mesh);
@@ -0,0 +1,191 @@
+#pragma once
+/**
+ * An extended position-based dynamics (XPBD) solver, for cloth and soft
+ * bodies.  Rather than turning constraints into forces (which blow up
+ * once they get stiff enough for the step), XPBD moves particles
+ * straight back to where the constraints want them.  Each constraint has
+ * a compliance (the inverse of its stiffness) which, unlike PBD, means
+ * the same thing regardless of the step or how many iterations are run.
+ *
+ * Constraints are stored per-field in sets of one kind each.  Each set
+ * is graph colored, so constraints of the same color never share a
+ * particle and can be solved in parallel
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/vec3.h"
+#include "common/threadpool.h"
+
+/**
+ * The value returned if any of these functions successfully execute
+ */
+#define XPBD_SUCCESS 0
+
+/**
+ * The value returned if any of these functions recieves invalid input
+ */
+#define XPBD_ERROR_PARAMS -1
+
+/**
+ * The value returned if any of these functions encounters an allocator error
+ */
+#define XPBD_ERROR_ALLOC -3
+
+/**
+ * The most particles a constraint can act on
+ */
+#define XPBD_MAX_CONSTRAINT_PARTICLES 4
+
+/**
+ * A set of constraints of the same kind.  Constraint i acts on particles
+ * particles[0][i] through particles[particle_count - 1][i], and is
+ * satisfied when the value it measures (a distance, angle, or volume)
+ * equals rest_value[i].  After a step, constraints are sorted by color:
+ * constraints color_starts[c] through color_starts[c + 1] - 1 have color c
+ */
+struct XpbdConstraintSet {
+    /**
+     * The number of particles each constraint acts on
+     */
+    size_t particle_count;
+    uint32_t *particles[XPBD_MAX_CONSTRAINT_PARTICLES];
+    phy_real_t *rest_value;
+    /**
+     * How far the constraint gives per unit of force; zero is perfectly rigid
+     */
+    phy_real_t *compliance;
+    /**
+     * The total force (Lagrange multiplier) each constraint has applied so
+     * far this substep
+     */
+    phy_real_t *lambda;
+    size_t count;
+    size_t capacity;
+
+    uint32_t *color_starts;
+    size_t color_count;
+    /**
+     * Set when constraints have been added since the set was last colored
+     */
+    bool needs_coloring;
+};
+typedef struct XpbdConstraintSet xpbd_constraint_set_t;
+
+/**
+ * A set of particles and the constraints between them.  Each field is its
+ * own array, indexed by particle, so they can be read (or written) directly
+ */
+struct XpbdSystem {
+    size_t particle_count;
+    size_t particle_capacity;
+
+    phy_real_t *position_x;
+    phy_real_t *position_y;
+    phy_real_t *position_z;
+    /**
+     * Where each particle was at the start of the current substep
+     */
+    phy_real_t *previous_x;
+    phy_real_t *previous_y;
+    phy_real_t *previous_z;
+    phy_real_t *velocity_x;
+    phy_real_t *velocity_y;
+    phy_real_t *velocity_z;
+    /**
+     * Zero for particles that never move (e.g. the pinned corners of a cloth)
+     */
+    phy_real_t *inverse_mass;
+
+    vec3_t gravity;
+
+    /**
+     * Keeps two particles a set distance apart
+     */
+    xpbd_constraint_set_t distance;
+    /**
+     * Keeps the angle between two triangles sharing an edge.  Particles
+     * 0 and 1 are the shared edge, and 2 and 3 are the triangles' other corners
+     */
+    xpbd_constraint_set_t bending;
+    /**
+     * Keeps the volume of a tetrahedron
+     */
+    xpbd_constraint_set_t volume;
+};
+typedef struct XpbdSystem xpbd_system_t;
+
+/**
+ * @brief Creates an empty XPBD system
+ * @param gravity The acceleration applied to every particle
+ * @return A pointer to the system on success, or NULL on failure
+ */
+xpbd_system_t *xpbd_system_create(vec3_t gravity);
+
+/**
+ * @brief Adds a particle to an XPBD system.  The particle's index is the
+ * number of particles added before it
+ * @param system The system to add to
+ * @param position The particle's position
+ * @param mass The particle's mass, or zero for a particle that never moves
+ * @return XPBD_SUCCESS on success, or an error code on failure
+ */
+int xpbd_system_add_particle(xpbd_system_t *system, vec3_t position, phy_real_t mass);
+
+/**
+ * @brief Adds a distance constraint, which keeps two particles as far
+ * apart as they are now
+ * @param system The system to add to
+ * @param a The first particle
+ * @param b The second particle
+ * @param compliance How much the constraint stretches per unit of force
+ * @return XPBD_SUCCESS on success, or an error code on failure
+ */
+int xpbd_system_add_distance(xpbd_system_t *system, uint32_t a, uint32_t b, phy_real_t compliance);
+
+/**
+ * @brief Adds a bending constraint, which keeps the two triangles
+ * (a, b, c) and (b, a, d) at the angle they're at now
+ * @param system The system to add to
+ * @param a One end of the shared edge
+ * @param b The other end of the shared edge
+ * @param c The first triangle's other corner
+ * @param d The second triangle's other corner
+ * @param compliance How much the constraint bends per unit of torque
+ * @return XPBD_SUCCESS on success, or an error code on failure
+ */
+int xpbd_system_add_bending(xpbd_system_t *system, uint32_t a, uint32_t b, uint32_t c, uint32_t d, phy_real_t compliance);
+
+/**
+ * @brief Adds a volume constraint, which keeps a tetrahedron's volume
+ * what it is now
+ * @param system The system to add to
+ * @param a The tetrahedron's first corner
+ * @param b The tetrahedron's second corner
+ * @param c The tetrahedron's third corner
+ * @param d The tetrahedron's fourth corner
+ * @param compliance How much the constraint gives per unit of pressure
+ * @return XPBD_SUCCESS on success, or an error code on failure
+ */
+int xpbd_system_add_volume(xpbd_system_t *system, uint32_t a, uint32_t b, uint32_t c, uint32_t d, phy_real_t compliance);
+
+/**
+ * @brief Advances an XPBD system by one step.  The step is split into
+ * substeps, each of which moves the particles and then solves every
+ * constraint once; more substeps is both stiffer and more accurate than
+ * more iterations
+ * @param system The system to step
+ * @param dt The length of the step
+ * @param substep_count How many substeps to split the step into
+ * @param pool The threads to split each color of constraints across (can be null)
+ * @return XPBD_SUCCESS on success, or an error code on failure.  On
+ * failure, the particles aren't moved
+ */
+int xpbd_system_step(xpbd_system_t *system, phy_real_t dt, size_t substep_count, threadpool_t *pool);
+
+/**
+ * @brief Frees an XPBD system
+ * @param system The system to free
+ */
+void xpbd_system_destroy(xpbd_system_t *system);
@@ -0,0 +1,53 @@
+#pragma once
+
+/**
+ * Utilities for rendering a capsule
+ */
+
+#include <gl_includes.h>
+#include <cglm/cglm.h>
+#include "sim/capsule.h"
+
+/**
+ * How many vertices make up each ring around the capsule's core
+ */
+#define CCAPSULE_RING_SEGMENTS 12
+
+/**
+ * How many rings make up each of the capsule's hemispherical caps
+ * (not counting the vertex at each pole)
+ */
+#define CCAPSULE_HEMISPHERE_RINGS 4
+
+/**
+ * The number of vertices in a capsule mesh
+ */
+#define CCAPSULE_VERTEX_COUNT (2 * CCAPSULE_HEMISPHERE_RINGS * CCAPSULE_RING_SEGMENTS + 2)
+
+/**
+ * The minimum size a vertex array has to be to contain all
+ * the vertices in a capsule
+ */
+#define CCAPSULE_VERTEX_ARRAY_SIZE (CCAPSULE_VERTEX_COUNT * 3)
+
+/**
+ * The minimum size an index array has to be to contain all
+ * the indices in a capsule
+ */
+#define CCAPSULE_INDEX_ARRAY_SIZE (12 * CCAPSULE_HEMISPHERE_RINGS * CCAPSULE_RING_SEGMENTS)
+
+/**
+ * Creates a transformation matrix for a capsule.  The capsule's
+ * vertices run along the y-axis, so this rotates them to lie
+ * along the capsule's core segment
+ */
+void ccapsule_make_transform(ccapsule_t capsule, mat4 transform);
+
+/**
+ * Generates both the vertex array and index array for
+ * a capsule.  The vertex array must have as much
+ * space as required by CCAPSULE_VERTEX_ARRAY_SIZE, and the
+ * index array must have as much space as required by
+ * CCAPSULE_INDEX_ARRAY_SIZE
+ */
+void ccapsule_gen_vertices(ccapsule_t capsule, GLfloat vertices[CCAPSULE_VERTEX_ARRAY_SIZE], GLuint indices[CCAPSULE_INDEX_ARRAY_SIZE]);
@@ -0,0 +1,39 @@
+#pragma once
+
+/**
+ * Utilities for rendering a heightfield.  The whole terrain is drawn
+ * as a single indexed grid mesh, sharing one vertex per sample
+ */
+
+#include <gl_includes.h>
+#include <cglm/cglm.h>
+#include "sim/heightfield.h"
+
+/**
+ * The minimum size a vertex array has to be to contain all
+ * the vertices in a heightfield
+ */
+#define HEIGHTFIELD_VERTEX_ARRAY_SIZE(field) ((field)->columns * (field)->rows * 3)
+
+/**
+ * The minimum size an index array has to be to contain all
+ * the indices in a heightfield
+ */
+#define HEIGHTFIELD_INDEX_ARRAY_SIZE(field) \
+    (((field)->columns - 1) * ((field)->rows - 1) * HEIGHTFIELD_CELL_TRIANGLES * 3)
+
+/**
+ * Creates a transformation matrix for a heightfield.  Heightfield
+ * vertices are already in world space, so this is the identity
+ */
+void heightfield_make_transform(const heightfield_t *field, mat4 transform);
+
+/**
+ * Generates both the vertex array and index array for
+ * a heightfield.  The vertex array must have as much
+ * space as required by HEIGHTFIELD_VERTEX_ARRAY_SIZE, and the
+ * index array must have as much space as required by
+ * HEIGHTFIELD_INDEX_ARRAY_SIZE.  The triangles match the ones
+ * used for collisions
+ */
+void heightfield_gen_vertices(const heightfield_t *field, GLfloat *vertices, GLuint *indices);
@@ -68,6 +68,13 @@ void transform_scale(transform_t *transform, vec3_t scale);
 void transform_set_scale(transform_t *transform, vec3_t scale);
 
 /**
- * Generates a transformation matrix
+ * Generates a transformation matrix, which scales, then rotates, then
+ * translates
  */
 void transform_gen_matrix(transform_t transform, mat4x4_t dest);
+
+/**
+ * Generates the transformation matrix of every transform in an array,
+ * several at a time (e.g. for instanced rendering)
+ */
+void transform_gen_matrices(const transform_t *transforms, size_t count, mat4x4_t *dest);
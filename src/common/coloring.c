@@ -0,0 +1,105 @@
+#include "common/coloring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "common/defines.h"
+
+/**
+ * The number of colors tried in each pass; one per bit of a mask
+ */
+#define COLORING_COLORS_PER_PASS 64
+
+/**
+ * Marks a constraint that hasn't been colored yet
+ */
+#define COLORING_UNCOLORED UINT32_MAX
+
+int coloring_color(const uint32_t *const *members, size_t member_count, size_t count, size_t item_count,
+    uint32_t *colors, size_t *color_count)
+{
+    safe_assert((members != NULL && colors != NULL) || count == 0, COLORING_ERROR_PARAMS);
+    safe_assert(color_count != NULL && count < UINT32_MAX, COLORING_ERROR_PARAMS);
+
+    // each item remembers which of this pass's colors its constraints
+    // already have.  Constraints that can't fit in any of them wait for
+    // the next pass, which starts over with the next set of colors
+    uint64_t *used = malloc((item_count + 1) * (sizeof *used));
+    if (used == NULL) {
+        return COLORING_ERROR_ALLOC;
+    }
+    for (size_t i = 0; i < count; i++) {
+        colors[i] = COLORING_UNCOLORED;
+    }
+
+    size_t remaining = count;
+    uint32_t first_color = 0;
+    *color_count = 0;
+    while (remaining > 0) {
+        memset(used, 0, (item_count + 1) * (sizeof *used));
+        for (size_t i = 0; i < count; i++) {
+            if (colors[i] != COLORING_UNCOLORED) {
+                continue;
+            }
+
+            uint64_t taken = 0;
+            for (size_t m = 0; m < member_count; m++) {
+                uint32_t item = members[m][i];
+                if (item != COLORING_NO_ITEM && item < item_count) {
+                    taken |= used[item];
+                }
+            }
+            if (taken == UINT64_MAX) {
+                continue;
+            }
+
+            // the lowest free color is the lowest clear bit
+            uint32_t color = 0;
+            while (taken & ((uint64_t)1 << color)) {
+                color++;
+            }
+            for (size_t m = 0; m < member_count; m++) {
+                uint32_t item = members[m][i];
+                if (item != COLORING_NO_ITEM && item < item_count) {
+                    used[item] |= (uint64_t)1 << color;
+                }
+            }
+            colors[i] = first_color + color;
+            if (colors[i] + 1 > *color_count) {
+                *color_count = colors[i] + 1;
+            }
+            remaining--;
+        }
+        first_color += COLORING_COLORS_PER_PASS;
+    }
+
+    free(used);
+    return COLORING_SUCCESS;
+}
+
+int coloring_sort(const uint32_t *colors, size_t count, size_t color_count, uint32_t *order, uint32_t *color_starts) {
+    safe_assert((colors != NULL && order != NULL) || count == 0, COLORING_ERROR_PARAMS);
+    safe_assert(color_starts != NULL && count < UINT32_MAX, COLORING_ERROR_PARAMS);
+
+    // counting sort: count each color, turn the counts into where each
+    // color starts, then place every constraint after the ones before it
+    memset(color_starts, 0, (color_count + 1) * (sizeof *color_starts));
+    for (size_t i = 0; i < count; i++) {
+        if (colors[i] >= color_count) {
+            return COLORING_ERROR_PARAMS;
+        }
+        color_starts[colors[i] + 1]++;
+    }
+    for (size_t color = 0; color < color_count; color++) {
+        color_starts[color + 1] += color_starts[color];
+    }
+    for (size_t i = 0; i < count; i++) {
+        order[color_starts[colors[i]]++] = i;
+    }
+    // placing constraints moved every start to where the next color
+    // starts, so shift them all back
+    for (size_t color = color_count; color > 0; color--) {
+        color_starts[color] = color_starts[color - 1];
+    }
+    color_starts[0] = 0;
+    return COLORING_SUCCESS;
+}
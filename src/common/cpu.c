@@ -0,0 +1,90 @@
+#include "common/cpu.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/defines.h"
+
+/**
+ * The value of detected_isa and forced_isa before they are first set
+ */
+#define CPU_ISA_UNKNOWN (-1)
+
+static _Atomic int detected_isa = CPU_ISA_UNKNOWN;
+static _Atomic int forced_isa = CPU_ISA_UNKNOWN;
+
+static const char *const isa_names[] = {
+    [CPU_ISA_BASELINE] = "baseline",
+    [CPU_ISA_SSE4] = "sse4",
+    [CPU_ISA_AVX2] = "avx2",
+    [CPU_ISA_AVX512] = "avx512",
+};
+
+PRIVATE_FUNC cpu_isa_t cpu_detect_isa(void) {
+#if defined(CPU_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CPU_ISA_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CPU_ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return CPU_ISA_SSE4;
+    }
+#endif
+    return CPU_ISA_BASELINE;
+}
+
+cpu_isa_t cpu_get_supported_isa(void) {
+    // acquire pairs with the release below, so whoever sees the detected
+    // ISA also sees the cap from PHY_FORCE_ISA
+    int isa = atomic_load_explicit(&detected_isa, memory_order_acquire);
+    if (isa == CPU_ISA_UNKNOWN) {
+        // racing threads all detect the same thing, so there's no need to
+        // lock, but the cap has to be in place before the ISA is published
+        cpu_isa_t from_environment;
+        const char *name = getenv("PHY_FORCE_ISA");
+        if (name != NULL && cpu_isa_from_name(name, &from_environment)) {
+            int unset = CPU_ISA_UNKNOWN;
+            atomic_compare_exchange_strong(&forced_isa, &unset, from_environment);
+        }
+
+        isa = cpu_detect_isa();
+        atomic_store_explicit(&detected_isa, isa, memory_order_release);
+    }
+    return isa;
+}
+
+cpu_isa_t cpu_get_isa(void) {
+    cpu_isa_t supported = cpu_get_supported_isa();
+    int forced = atomic_load_explicit(&forced_isa, memory_order_relaxed);
+    if (forced != CPU_ISA_UNKNOWN && (cpu_isa_t)forced < supported) {
+        return forced;
+    }
+    return supported;
+}
+
+void cpu_force_isa(cpu_isa_t isa) {
+    // detect first, so PHY_FORCE_ISA can't overwrite this later
+    cpu_get_supported_isa();
+    atomic_store_explicit(&forced_isa, isa, memory_order_relaxed);
+}
+
+bool cpu_isa_from_name(const char *name, cpu_isa_t *isa) {
+    safe_assert(name != NULL && isa != NULL, false);
+    for (size_t i = 0; i < sizeof isa_names / sizeof isa_names[0]; i++) {
+        if (strcmp(name, isa_names[i]) == 0) {
+            *isa = (cpu_isa_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *cpu_isa_name(cpu_isa_t isa) {
+    if ((size_t)isa >= sizeof isa_names / sizeof isa_names[0]) {
+        return "unknown";
+    }
+    return isa_names[isa];
+}
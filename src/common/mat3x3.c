@@ -0,0 +1,103 @@
+#include "common/mat3x3.h"
+
+#include <math.h>
+#include <string.h>
+
+void mat3x3_make_identity(mat3x3_t matrix) {
+    mat3x3_make_diagonal(matrix, vec3_make(1, 1, 1));
+}
+
+void mat3x3_make_diagonal(mat3x3_t matrix, vec3_t diagonal) {
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            matrix[row][column] = row == column ? diagonal.raw[row] : 0;
+        }
+    }
+}
+
+void mat3x3_from_quaternion(mat3x3_t matrix, quaternion_t q) {
+    phy_real_t xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    phy_real_t xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    phy_real_t wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    matrix[0][0] = 1 - 2 * (yy + zz);
+    matrix[0][1] = 2 * (xy - wz);
+    matrix[0][2] = 2 * (xz + wy);
+
+    matrix[1][0] = 2 * (xy + wz);
+    matrix[1][1] = 1 - 2 * (xx + zz);
+    matrix[1][2] = 2 * (yz - wx);
+
+    matrix[2][0] = 2 * (xz - wy);
+    matrix[2][1] = 2 * (yz + wx);
+    matrix[2][2] = 1 - 2 * (xx + yy);
+}
+
+void mat3x3_copy(mat3x3_t dest, mat3x3_t source) {
+    memmove(dest, source, (sizeof (mat3x3_t)));
+}
+
+void mat3x3_times_mat3x3(mat3x3_t dest, mat3x3_t a, mat3x3_t b) {
+    mat3x3_t result;
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            phy_real_t tmp = 0;
+            for (size_t common = 0; common < 3; common++) {
+                tmp += a[row][common] * b[common][column];
+            }
+            result[row][column] = tmp;
+        }
+    }
+    mat3x3_copy(dest, result);
+}
+
+void mat3x3_transpose(mat3x3_t dest, mat3x3_t source) {
+    mat3x3_t result;
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            result[row][column] = source[column][row];
+        }
+    }
+    mat3x3_copy(dest, result);
+}
+
+bool mat3x3_invert(mat3x3_t dest, mat3x3_t source) {
+    // the inverse is the transpose of the cofactor matrix, over the determinant
+    mat3x3_t cofactors;
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            size_t r0 = (row + 1) % 3, r1 = (row + 2) % 3;
+            size_t c0 = (column + 1) % 3, c1 = (column + 2) % 3;
+            cofactors[row][column] = source[r0][c0] * source[r1][c1] - source[r0][c1] * source[r1][c0];
+        }
+    }
+    phy_real_t determinant =
+        source[0][0] * cofactors[0][0] +
+        source[0][1] * cofactors[0][1] +
+        source[0][2] * cofactors[0][2];
+    if (!(fabs(determinant) > 0) || !isfinite(determinant)) {
+        return false;
+    }
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            dest[row][column] = cofactors[column][row] / determinant;
+        }
+    }
+    return true;
+}
+
+vec3_t mat3x3_times_vec3(mat3x3_t matrix, vec3_t vec) {
+    return vec3_make(
+        matrix[0][0] * vec.x + matrix[0][1] * vec.y + matrix[0][2] * vec.z,
+        matrix[1][0] * vec.x + matrix[1][1] * vec.y + matrix[1][2] * vec.z,
+        matrix[2][0] * vec.x + matrix[2][1] * vec.y + matrix[2][2] * vec.z
+    );
+}
+
+vec3_t mat3x3_transpose_times_vec3(mat3x3_t matrix, vec3_t vec) {
+    return vec3_make(
+        matrix[0][0] * vec.x + matrix[1][0] * vec.y + matrix[2][0] * vec.z,
+        matrix[0][1] * vec.x + matrix[1][1] * vec.y + matrix[2][1] * vec.z,
+        matrix[0][2] * vec.x + matrix[1][2] * vec.y + matrix[2][2] * vec.z
+    );
+}
@@ -1,22 +1,278 @@
 #include "common/mat4x4.h"
 
+#include <math.h>
 #include <stdio.h>
+#include "common/cpu.h"
+#include "common/simd.h"
+
+#if defined(CPU_X86_DISPATCH)
+#include <immintrin.h>
+#endif
 
 void mat4x4_times_mat4x4(mat4x4_t dest, mat4x4_t a, mat4x4_t b) {
-    mat4x4_t result = {0};
+    // each row of AxB is the rows of B, weighted by the same row of A
+    simd4f_t b_rows[4];
     for (size_t row = 0; row < 4; row++) {
-        for (size_t column = 0; column < 4; column++) {
-            phy_real_t tmp = 0;
-            for (size_t common = 0; common < 4; common++) {
-                tmp += a[row][common] * b[common][column];
-            }
-            result[row][column] = tmp;
+        b_rows[row] = simd4f_load(b[row]);
+    }
+    simd4f_t result[4];
+    for (size_t row = 0; row < 4; row++) {
+        simd4f_t sum = simd4f_mul(simd4f_set1(a[row][0]), b_rows[0]);
+        for (size_t common = 1; common < 4; common++) {
+            sum = simd4f_add(sum, simd4f_mul(simd4f_set1(a[row][common]), b_rows[common]));
         }
+        result[row] = sum;
     }
+    // A and B are fully read before anything is stored, so dest can alias either
     for (size_t row = 0; row < 4; row++) {
-        for (size_t column = 0; column < 4; column++) {
-            dest[row][column] = result[row][column];
+        simd4f_store(dest[row], result[row]);
+    }
+}
+
+/**
+ * [internal] calculates a * x - b * y + c * z on every lane
+ */
+PRIVATE_FUNC simd4f_t mat4x4_cofactor_row(
+        const float a[SIMD_WIDTH], const float x[SIMD_WIDTH],
+        const float b[SIMD_WIDTH], const float y[SIMD_WIDTH],
+        const float c[SIMD_WIDTH], const float z[SIMD_WIDTH]) {
+    simd4f_t result = simd4f_mul(simd4f_load(a), simd4f_load(x));
+    result = simd4f_sub(result, simd4f_mul(simd4f_load(b), simd4f_load(y)));
+    return simd4f_add(result, simd4f_mul(simd4f_load(c), simd4f_load(z)));
+}
+
+bool mat4x4_invert(mat4x4_t dest, mat4x4_t source) {
+    // the 2x2 determinants of the top two rows (s) and the bottom two rows (c),
+    // which every cofactor is built from
+    phy_real_t (*m)[4] = source;
+    phy_real_t s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+    phy_real_t s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+    phy_real_t s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+    phy_real_t s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+    phy_real_t s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+    phy_real_t s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+    phy_real_t c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+    phy_real_t c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    phy_real_t c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    phy_real_t c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    phy_real_t c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    phy_real_t c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+
+    phy_real_t determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (!(fabs(determinant) > 0) || !isfinite(determinant)) {
+        return false;
+    }
+
+    // each row of the inverse is three products of 4 lanes each
+    const float row0_a[] = { m[1][1], -m[0][1], m[3][1], -m[2][1] };
+    const float row0_b[] = { m[1][2], -m[0][2], m[3][2], -m[2][2] };
+    const float row0_c[] = { m[1][3], -m[0][3], m[3][3], -m[2][3] };
+    const float row0_x[] = { c5, c5, s5, s5 };
+    const float row0_y[] = { c4, c4, s4, s4 };
+    const float row0_z[] = { c3, c3, s3, s3 };
+
+    const float row1_a[] = { -m[1][0], m[0][0], -m[3][0], m[2][0] };
+    const float row1_b[] = { -m[1][2], m[0][2], -m[3][2], m[2][2] };
+    const float row1_c[] = { -m[1][3], m[0][3], -m[3][3], m[2][3] };
+    const float row1_x[] = { c5, c5, s5, s5 };
+    const float row1_y[] = { c2, c2, s2, s2 };
+    const float row1_z[] = { c1, c1, s1, s1 };
+
+    const float row2_a[] = { m[1][0], -m[0][0], m[3][0], -m[2][0] };
+    const float row2_b[] = { m[1][1], -m[0][1], m[3][1], -m[2][1] };
+    const float row2_c[] = { m[1][3], -m[0][3], m[3][3], -m[2][3] };
+    const float row2_x[] = { c4, c4, s4, s4 };
+    const float row2_y[] = { c2, c2, s2, s2 };
+    const float row2_z[] = { c0, c0, s0, s0 };
+
+    const float row3_a[] = { -m[1][0], m[0][0], -m[3][0], m[2][0] };
+    const float row3_b[] = { -m[1][1], m[0][1], -m[3][1], m[2][1] };
+    const float row3_c[] = { -m[1][2], m[0][2], -m[3][2], m[2][2] };
+    const float row3_x[] = { c3, c3, s3, s3 };
+    const float row3_y[] = { c1, c1, s1, s1 };
+    const float row3_z[] = { c0, c0, s0, s0 };
+
+    simd4f_t inverse_determinant = simd4f_set1(1.0f / determinant);
+    simd4f_t rows[4] = {
+        mat4x4_cofactor_row(row0_a, row0_x, row0_b, row0_y, row0_c, row0_z),
+        mat4x4_cofactor_row(row1_a, row1_x, row1_b, row1_y, row1_c, row1_z),
+        mat4x4_cofactor_row(row2_a, row2_x, row2_b, row2_y, row2_c, row2_z),
+        mat4x4_cofactor_row(row3_a, row3_x, row3_b, row3_y, row3_c, row3_z),
+    };
+    for (size_t row = 0; row < 4; row++) {
+        simd4f_store(dest[row], simd4f_mul(rows[row], inverse_determinant));
+    }
+    return true;
+}
+
+void mat4x4_compose(mat4x4_t dest, vec3_t position, quaternion_t rotation, vec3_t scale) {
+    mat4x4_batch_compose((mat4x4_t *)dest, &position, &rotation, &scale, 1);
+}
+
+/**
+ * [internal] writes the translation column and bottom row of a model
+ * matrix whose rotation and scale are already filled in
+ */
+PRIVATE_FUNC void mat4x4_finish_compose(mat4x4_t matrix, vec3_t position) {
+    for (size_t row = 0; row < 3; row++) {
+        matrix[row][3] = position.raw[row];
+    }
+    matrix[3][0] = 0;
+    matrix[3][1] = 0;
+    matrix[3][2] = 0;
+    matrix[3][3] = 1;
+}
+
+PRIVATE_FUNC void mat4x4_batch_compose_baseline(mat4x4_t *dest, const vec3_t *positions, const quaternion_t *rotations,
+        const vec3_t *scales, size_t count) {
+    for (size_t start = 0; start < count; start += SIMD_WIDTH) {
+        size_t lanes = count - start < SIMD_WIDTH ? count - start : SIMD_WIDTH;
+
+        // transpose a block of instances so each simd4f_t holds one component of all of them;
+        // unused lanes get an identity transform
+        float qx[SIMD_WIDTH] = {0}, qy[SIMD_WIDTH] = {0}, qz[SIMD_WIDTH] = {0}, qw[SIMD_WIDTH] = {0};
+        float sx[SIMD_WIDTH] = {0}, sy[SIMD_WIDTH] = {0}, sz[SIMD_WIDTH] = {0};
+        for (size_t lane = 0; lane < lanes; lane++) {
+            quaternion_t q = rotations[start + lane];
+            vec3_t scale = scales != NULL ? scales[start + lane] : VEC3_ONE;
+            qx[lane] = q.x;
+            qy[lane] = q.y;
+            qz[lane] = q.z;
+            qw[lane] = q.w;
+            sx[lane] = scale.x;
+            sy[lane] = scale.y;
+            sz[lane] = scale.z;
+        }
+        simd4f_t x = simd4f_load(qx), y = simd4f_load(qy), z = simd4f_load(qz), w = simd4f_load(qw);
+        simd4f_t one = simd4f_set1(1), two = simd4f_set1(2);
+
+        simd4f_t xx = simd4f_mul(x, x), yy = simd4f_mul(y, y), zz = simd4f_mul(z, z);
+        simd4f_t xy = simd4f_mul(x, y), xz = simd4f_mul(x, z), yz = simd4f_mul(y, z);
+        simd4f_t wx = simd4f_mul(w, x), wy = simd4f_mul(w, y), wz = simd4f_mul(w, z);
+
+        // the same rotation matrix as mat3x3_from_quaternion(), with each column scaled
+        simd4f_t scale_x = simd4f_load(sx), scale_y = simd4f_load(sy), scale_z = simd4f_load(sz);
+        simd4f_t entries[3][3] = {
+            {
+                simd4f_mul(simd4f_sub(one, simd4f_mul(two, simd4f_add(yy, zz))), scale_x),
+                simd4f_mul(simd4f_mul(two, simd4f_sub(xy, wz)), scale_y),
+                simd4f_mul(simd4f_mul(two, simd4f_add(xz, wy)), scale_z),
+            },
+            {
+                simd4f_mul(simd4f_mul(two, simd4f_add(xy, wz)), scale_x),
+                simd4f_mul(simd4f_sub(one, simd4f_mul(two, simd4f_add(xx, zz))), scale_y),
+                simd4f_mul(simd4f_mul(two, simd4f_sub(yz, wx)), scale_z),
+            },
+            {
+                simd4f_mul(simd4f_mul(two, simd4f_sub(xz, wy)), scale_x),
+                simd4f_mul(simd4f_mul(two, simd4f_add(yz, wx)), scale_y),
+                simd4f_mul(simd4f_sub(one, simd4f_mul(two, simd4f_add(xx, yy))), scale_z),
+            },
+        };
+
+        float values[3][3][SIMD_WIDTH];
+        for (size_t row = 0; row < 3; row++) {
+            for (size_t column = 0; column < 3; column++) {
+                simd4f_store(values[row][column], entries[row][column]);
+            }
+        }
+        for (size_t lane = 0; lane < lanes; lane++) {
+            phy_real_t (*matrix)[4] = dest[start + lane];
+            for (size_t row = 0; row < 3; row++) {
+                matrix[row][0] = values[row][0][lane];
+                matrix[row][1] = values[row][1][lane];
+                matrix[row][2] = values[row][2][lane];
+            }
+            mat4x4_finish_compose(matrix, positions[start + lane]);
+        }
+    }
+}
+
+#if defined(CPU_X86_DISPATCH)
+
+/**
+ * [internal] mat4x4_batch_compose_baseline(), 8 instances at a time.
+ * AVX-512 uses this too, since transposing instances in and out of
+ * registers costs more than the math at 16 lanes
+ */
+PRIVATE_FUNC CPU_TARGET_AVX2 void mat4x4_batch_compose_avx2(mat4x4_t *dest, const vec3_t *positions, const quaternion_t *rotations,
+        const vec3_t *scales, size_t count) {
+    size_t start = 0;
+    for (; start + 8 <= count; start += 8) {
+        float qx[8], qy[8], qz[8], qw[8], sx[8], sy[8], sz[8];
+        for (size_t lane = 0; lane < 8; lane++) {
+            quaternion_t q = rotations[start + lane];
+            vec3_t scale = scales != NULL ? scales[start + lane] : VEC3_ONE;
+            qx[lane] = q.x;
+            qy[lane] = q.y;
+            qz[lane] = q.z;
+            qw[lane] = q.w;
+            sx[lane] = scale.x;
+            sy[lane] = scale.y;
+            sz[lane] = scale.z;
         }
+        __m256 x = _mm256_loadu_ps(qx), y = _mm256_loadu_ps(qy), z = _mm256_loadu_ps(qz), w = _mm256_loadu_ps(qw);
+        __m256 one = _mm256_set1_ps(1), two = _mm256_set1_ps(2);
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        __m256 scale_x = _mm256_loadu_ps(sx), scale_y = _mm256_loadu_ps(sy), scale_z = _mm256_loadu_ps(sz);
+        __m256 entries[3][3] = {
+            {
+                _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), scale_x),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), scale_y),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), scale_z),
+            },
+            {
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), scale_x),
+                _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), scale_y),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), scale_z),
+            },
+            {
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), scale_x),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), scale_y),
+                _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), scale_z),
+            },
+        };
+
+        float values[3][3][8];
+        for (size_t row = 0; row < 3; row++) {
+            for (size_t column = 0; column < 3; column++) {
+                _mm256_storeu_ps(values[row][column], entries[row][column]);
+            }
+        }
+        for (size_t lane = 0; lane < 8; lane++) {
+            phy_real_t (*matrix)[4] = dest[start + lane];
+            for (size_t row = 0; row < 3; row++) {
+                matrix[row][0] = values[row][0][lane];
+                matrix[row][1] = values[row][1][lane];
+                matrix[row][2] = values[row][2][lane];
+            }
+            mat4x4_finish_compose(matrix, positions[start + lane]);
+        }
+    }
+    mat4x4_batch_compose_baseline(dest + start, positions + start, rotations + start,
+        scales != NULL ? scales + start : NULL, count - start);
+}
+
+#endif
+
+void mat4x4_batch_compose(mat4x4_t *dest, const vec3_t *positions, const quaternion_t *rotations,
+        const vec3_t *scales, size_t count) {
+    safe_assert(dest != NULL && positions != NULL && rotations != NULL,);
+
+    switch (cpu_get_isa()) {
+#if defined(CPU_X86_DISPATCH)
+        case CPU_ISA_AVX512:
+        case CPU_ISA_AVX2:
+            mat4x4_batch_compose_avx2(dest, positions, rotations, scales, count);
+            return;
+#endif
+        default:
+            mat4x4_batch_compose_baseline(dest, positions, rotations, scales, count);
+            return;
     }
 }
 
@@ -0,0 +1,153 @@
+#include "common/threadpool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "common/defines.h"
+
+/**
+ * Takes chunks of the current loop until there are none left
+ */
+PRIVATE_FUNC void threadpool_run_chunks(threadpool_t *pool, size_t thread_index) {
+    while (true) {
+        size_t begin = atomic_fetch_add(&pool->next_item, pool->chunk_size);
+        if (begin >= pool->item_count) {
+            return;
+        }
+        size_t end = begin + pool->chunk_size;
+        if (end > pool->item_count) {
+            end = pool->item_count;
+        }
+        pool->task(pool->context, begin, end, thread_index);
+    }
+}
+
+PRIVATE_FUNC void *threadpool_worker_main(void *arg) {
+    threadpool_worker_t *worker = arg;
+    threadpool_t *pool = worker->pool;
+
+    uint64_t finished_generation = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->stopping && pool->generation == finished_generation) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        finished_generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        threadpool_run_chunks(pool, worker->thread_index);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->busy_workers--;
+        if (pool->busy_workers == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+threadpool_t *threadpool_create(size_t thread_count) {
+    if (thread_count == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = processors > 0 ? (size_t)processors : 1;
+    }
+    if (thread_count > THREADPOOL_MAX_THREADS) {
+        thread_count = THREADPOOL_MAX_THREADS;
+    }
+
+    threadpool_t *pool = calloc(1, (sizeof *pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    // the calling thread is thread 0, so it doesn't need a worker
+    size_t worker_count = thread_count - 1;
+    pool->threads = calloc(worker_count > 0 ? worker_count : 1, (sizeof *pool->threads));
+    pool->workers = calloc(worker_count > 0 ? worker_count : 1, (sizeof *pool->workers));
+    if (pool->threads == NULL || pool->workers == NULL) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    atomic_init(&pool->next_item, 0);
+
+    // start with just the calling thread, and only count workers
+    // once they've actually started
+    pool->thread_count = 1;
+    for (size_t i = 0; i < worker_count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].thread_index = i + 1;
+        if (pthread_create(&pool->threads[i], NULL, threadpool_worker_main, &pool->workers[i]) != 0) {
+            threadpool_destroy(pool);
+            return NULL;
+        }
+        pool->thread_count++;
+    }
+
+    return pool;
+}
+
+size_t threadpool_get_thread_count(const threadpool_t *pool) {
+    return pool != NULL ? pool->thread_count : 1;
+}
+
+void threadpool_parallel_for(threadpool_t *pool, size_t item_count, size_t chunk_size, threadpool_task_t task, void *context) {
+    safe_assert(task != NULL,);
+    if (chunk_size == 0) {
+        chunk_size = 1;
+    }
+
+    // not worth waking anyone up for a single chunk
+    if (pool == NULL || pool->thread_count == 1 || item_count <= chunk_size) {
+        if (item_count > 0) {
+            task(context, 0, item_count, 0);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->item_count = item_count;
+    pool->chunk_size = chunk_size;
+    atomic_store(&pool->next_item, 0);
+    pool->busy_workers = pool->thread_count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    threadpool_run_chunks(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy_workers > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void threadpool_destroy(threadpool_t *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i + 1 < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
@@ -3,102 +3,35 @@
 #include <assert.h>
 #include <stddef.h>
 #include <math.h>
+#include <float.h>
+#include "common/cpu.h"
+#include "common/fastmath.h"
+#include "common/simd.h"
 
-void vec3_add_to(vec3_t *dest, vec3_t source, phy_real_t factor) {
-    assert(dest != NULL); // so that nullptr crashes in debug
-    if (dest == NULL) {
-        return; // so that nullptr is ignored in release
-    }
-    dest->x += source.x * factor;
-    dest->y += source.y * factor;
-    dest->z += source.z * factor;
-}
-
-void vec3_multiply_by(vec3_t *dest, phy_real_t factor) {
-    assert(dest != NULL);
-    if (dest == NULL) {
-        return;
-    }
-    dest->x *= factor;
-    dest->y *= factor;
-    dest->z *= factor;
-}
+#if defined(CPU_X86_DISPATCH)
+#include <immintrin.h>
+#endif
 
-void vec3_clear(vec3_t *vec) {
-    assert(vec != NULL);
-    if (vec == NULL) {
-        return;
-    }
-    vec->x = 0;
-    vec->y = 0;
-    vec->z = 0;
-}
-
-phy_real_t vec3_distance_to(vec3_t from, vec3_t to) {
-    phy_real_t dx = to.x - from.x;
-    phy_real_t dy = to.y - from.y;
-    phy_real_t dz = to.z - from.z;
-    return sqrt(
-        (dx * dx) +
-        (dy * dy) +
-        (dz * dz)
-    );
-}
-
-phy_real_t vec3_distance_sqr(vec3_t from, vec3_t to) {
-    phy_real_t dx = to.x - from.x;
-    phy_real_t dy = to.y - from.y;
-    phy_real_t dz = to.z - from.z;
-    return
-        (dx * dx) +
-        (dy * dy) +
-        (dz * dz);
-}
-
-phy_real_t vec3_magnitude_sqr(vec3_t vec) {
-    return
-        (vec.x * vec.x) +
-        (vec.y * vec.y) +
-        (vec.z * vec.z);
-}
-
-phy_real_t vec3_magnitude(vec3_t vec) {
-    return sqrt(
-        (vec.x * vec.x) +
-        (vec.y * vec.y) +
-        (vec.z * vec.z)
-    );
-}
-
-void vec3_unit(vec3_t *vec) {
+void vec3_rotate_x(vec3_t *vec, phy_real_t xrot) {
     assert(vec != NULL);
     if (vec == NULL) {
         return;
     }
-    phy_real_t magnitude = vec3_magnitude(*vec);
-    if (magnitude != 0) {
-        // ensure that we aren't dividing by zero --
-        // we don't want the unit vector to be full of NaNs
-        vec3_multiply_by(vec, 1.0 / magnitude);
-    }
+    vec3_t copy = *vec;
+    phy_real_t sin_x = sinf(xrot), cos_x = cosf(xrot);
+    vec->y = copy.y * cos_x + copy.z * sin_x;
+    vec->z = -copy.y * sin_x + copy.z * cos_x;
 }
 
-void vec3_rotate_x(vec3_t *vec, phy_real_t xrot) {
+void vec3_rotate_y(vec3_t *vec, phy_real_t yrot) {
     assert(vec != NULL);
     if (vec == NULL) {
         return;
     }
     vec3_t copy = *vec;
-    vec->x = copy.x * 1 + copy.y * 0 + copy.z * 0;
-    vec->y = copy.x * 0 + copy.y * cos(xrot) + copy.z * sin(xrot);
-    vec->z = copy.x * 0 - copy.y * sin(xrot) + copy.z * cos(xrot);
-}
-
-void vec3_rotate_y(vec3_t *vec, phy_real_t yrot) {
-    vec3_t copy = *vec;
-    vec->x = copy.x * cos(yrot) + copy.y * 0 - copy.z * sin(yrot);
-    vec->y = copy.x * 0 + copy.y * 1 + copy.z * 0;
-    vec->z = copy.x * sin(yrot) + copy.y * 0 + copy.z * cos(yrot);
+    phy_real_t sin_y = sinf(yrot), cos_y = cosf(yrot);
+    vec->x = copy.x * cos_y - copy.z * sin_y;
+    vec->z = copy.x * sin_y + copy.z * cos_y;
 }
 
 void vec3_rotate_z(vec3_t *vec, phy_real_t zrot) {
@@ -107,9 +40,9 @@ void vec3_rotate_z(vec3_t *vec, phy_real_t zrot) {
         return;
     }
     vec3_t copy = *vec;
-    vec->x = copy.x * cos(zrot) + copy.y * sin(zrot) + copy.z * 0;
-    vec->y = copy.x * -sin(zrot) + copy.y * cos(zrot) + copy.z * 0;
-    vec->z = copy.x * 0 + copy.y * 0 + copy.z * 1;
+    phy_real_t sin_z = sinf(zrot), cos_z = cosf(zrot);
+    vec->x = copy.x * cos_z + copy.y * sin_z;
+    vec->y = -copy.x * sin_z + copy.y * cos_z;
 }
 
 void vec3_rotate(vec3_t *vec, phy_real_t xrot, phy_real_t yrot, phy_real_t zrot) {
@@ -122,23 +55,6 @@ void vec3_rotate(vec3_t *vec, phy_real_t xrot, phy_real_t yrot, phy_real_t zrot)
     vec3_rotate_x(vec, xrot);
 }
 
-void vec3_cross_product(vec3_t *dest, vec3_t a, vec3_t b) {
-    assert(dest != NULL);
-    if (dest == NULL) {
-        return;
-    }
-    dest->x = (a.y * b.z) - (a.z * b.y);
-    dest->y = (a.z * b.x) - (a.x * b.z);
-    dest->z = (a.x * b.y) - (a.y * b.x);
-}
-
-phy_real_t vec3_dot_product(vec3_t a, vec3_t b) {
-    return
-        (a.x * b.x) +
-        (a.y * b.y) +
-        (a.z * b.z);
-}
-
 /**
  * Gets the portion of a given vector
  * 'in the same direction' as another
@@ -165,3 +81,208 @@ void vec3_get_portion_in_direction(vec3_t *result, vec3_t original, vec3_t direc
     *result = dir_unit;
     vec3_multiply_by(result, orig_magnitude * dot_units);
 }
+
+/**
+ * [internal] calculates to[i] += from[i] * factor over flat arrays of floats
+ */
+PRIVATE_FUNC void vec3_add_floats(phy_real_t *to, const phy_real_t *from, phy_real_t factor, size_t count) {
+    const simd4f_t scale = simd4f_set1(factor);
+    size_t i = 0;
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        simd4f_store(&to[i], simd4f_add(simd4f_load(&to[i]), simd4f_mul(simd4f_load(&from[i]), scale)));
+    }
+    for (; i < count; i++) {
+        to[i] += from[i] * factor;
+    }
+}
+
+/**
+ * [internal] calculates to[i] *= factor over a flat array of floats
+ */
+PRIVATE_FUNC void vec3_multiply_floats(phy_real_t *to, phy_real_t factor, size_t count) {
+    const simd4f_t scale = simd4f_set1(factor);
+    size_t i = 0;
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        simd4f_store(&to[i], simd4f_mul(simd4f_load(&to[i]), scale));
+    }
+    for (; i < count; i++) {
+        to[i] *= factor;
+    }
+}
+
+#if defined(CPU_X86_DISPATCH)
+
+PRIVATE_FUNC CPU_TARGET_AVX2 void vec3_add_floats_avx2(phy_real_t *to, const phy_real_t *from, phy_real_t factor, size_t count) {
+    const __m256 scale = _mm256_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(&to[i], _mm256_fmadd_ps(_mm256_loadu_ps(&from[i]), scale, _mm256_loadu_ps(&to[i])));
+    }
+    vec3_add_floats(&to[i], &from[i], factor, count - i);
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX512 void vec3_add_floats_avx512(phy_real_t *to, const phy_real_t *from, phy_real_t factor, size_t count) {
+    const __m512 scale = _mm512_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(&to[i], _mm512_fmadd_ps(_mm512_loadu_ps(&from[i]), scale, _mm512_loadu_ps(&to[i])));
+    }
+    vec3_add_floats_avx2(&to[i], &from[i], factor, count - i);
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX2 void vec3_multiply_floats_avx2(phy_real_t *to, phy_real_t factor, size_t count) {
+    const __m256 scale = _mm256_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(&to[i], _mm256_mul_ps(_mm256_loadu_ps(&to[i]), scale));
+    }
+    vec3_multiply_floats(&to[i], factor, count - i);
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX512 void vec3_multiply_floats_avx512(phy_real_t *to, phy_real_t factor, size_t count) {
+    const __m512 scale = _mm512_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(&to[i], _mm512_mul_ps(_mm512_loadu_ps(&to[i]), scale));
+    }
+    vec3_multiply_floats_avx2(&to[i], factor, count - i);
+}
+
+#endif
+
+void vec3_batch_add_to(vec3_t *dest, const vec3_t *source, phy_real_t factor, size_t count) {
+    assert(dest != NULL && source != NULL);
+    if (dest == NULL || source == NULL) {
+        return;
+    }
+    // the arrays are just 3 * count floats in a row, so they can be
+    // added a full vector register at a time regardless of where each vector starts
+    switch (cpu_get_isa()) {
+#if defined(CPU_X86_DISPATCH)
+        case CPU_ISA_AVX512:
+            vec3_add_floats_avx512(dest->raw, source->raw, factor, 3 * count);
+            return;
+        case CPU_ISA_AVX2:
+            vec3_add_floats_avx2(dest->raw, source->raw, factor, 3 * count);
+            return;
+#endif
+        default:
+            vec3_add_floats(dest->raw, source->raw, factor, 3 * count);
+            return;
+    }
+}
+
+void vec3_batch_multiply_by(vec3_t *dest, phy_real_t factor, size_t count) {
+    assert(dest != NULL);
+    if (dest == NULL) {
+        return;
+    }
+    switch (cpu_get_isa()) {
+#if defined(CPU_X86_DISPATCH)
+        case CPU_ISA_AVX512:
+            vec3_multiply_floats_avx512(dest->raw, factor, 3 * count);
+            return;
+        case CPU_ISA_AVX2:
+            vec3_multiply_floats_avx2(dest->raw, factor, 3 * count);
+            return;
+#endif
+        default:
+            vec3_multiply_floats(dest->raw, factor, 3 * count);
+            return;
+    }
+}
+
+void vec3_batch_dot_product(phy_real_t *dest, const vec3_t *a, const vec3_t *b, size_t count) {
+    assert(dest != NULL && a != NULL && b != NULL);
+    if (dest == NULL || a == NULL || b == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = vec3_dot_product(a[i], b[i]);
+    }
+}
+
+/**
+ * [internal] copies up to SIMD_WIDTH vectors into one array per axis,
+ * padding the unused lanes with zeros
+ */
+PRIVATE_FUNC void vec3_gather_lanes(const vec3_t *source, size_t lanes,
+        float x[SIMD_WIDTH], float y[SIMD_WIDTH], float z[SIMD_WIDTH]) {
+    for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+        vec3_t vec = lane < lanes ? source[lane] : VEC3_ZERO;
+        x[lane] = vec.x;
+        y[lane] = vec.y;
+        z[lane] = vec.z;
+    }
+}
+
+/**
+ * [internal] the inverse of vec3_gather_lanes()
+ */
+PRIVATE_FUNC void vec3_scatter_lanes(vec3_t *dest, size_t lanes, simd4f_t x, simd4f_t y, simd4f_t z) {
+    float lane_x[SIMD_WIDTH], lane_y[SIMD_WIDTH], lane_z[SIMD_WIDTH];
+    simd4f_store(lane_x, x);
+    simd4f_store(lane_y, y);
+    simd4f_store(lane_z, z);
+    for (size_t lane = 0; lane < lanes; lane++) {
+        dest[lane] = vec3_make(lane_x[lane], lane_y[lane], lane_z[lane]);
+    }
+}
+
+void vec3_batch_rotate(vec3_t *vecs, const phy_real_t *xrot, const phy_real_t *yrot, const phy_real_t *zrot, size_t count) {
+    assert(vecs != NULL && xrot != NULL && yrot != NULL && zrot != NULL);
+    if (vecs == NULL || xrot == NULL || yrot == NULL || zrot == NULL) {
+        return;
+    }
+    for (size_t start = 0; start < count; start += SIMD_WIDTH) {
+        size_t lanes = count - start < SIMD_WIDTH ? count - start : SIMD_WIDTH;
+        float lane_x[SIMD_WIDTH], lane_y[SIMD_WIDTH], lane_z[SIMD_WIDTH];
+        float angle_x[SIMD_WIDTH] = {0}, angle_y[SIMD_WIDTH] = {0}, angle_z[SIMD_WIDTH] = {0};
+        vec3_gather_lanes(&vecs[start], lanes, lane_x, lane_y, lane_z);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            angle_x[lane] = xrot[start + lane];
+            angle_y[lane] = yrot[start + lane];
+            angle_z[lane] = zrot[start + lane];
+        }
+        simd4f_t x = simd4f_load(lane_x), y = simd4f_load(lane_y), z = simd4f_load(lane_z);
+        simd4f_t sin_a, cos_a, rotated;
+
+        // the same order and signs as vec3_rotate(): Z, then Y, then X
+        simd4f_sincos(simd4f_load(angle_z), &sin_a, &cos_a, FASTMATH_PRECISION_ACCURATE);
+        rotated = simd4f_add(simd4f_mul(x, cos_a), simd4f_mul(y, sin_a));
+        y = simd4f_sub(simd4f_mul(y, cos_a), simd4f_mul(x, sin_a));
+        x = rotated;
+
+        simd4f_sincos(simd4f_load(angle_y), &sin_a, &cos_a, FASTMATH_PRECISION_ACCURATE);
+        rotated = simd4f_sub(simd4f_mul(x, cos_a), simd4f_mul(z, sin_a));
+        z = simd4f_add(simd4f_mul(x, sin_a), simd4f_mul(z, cos_a));
+        x = rotated;
+
+        simd4f_sincos(simd4f_load(angle_x), &sin_a, &cos_a, FASTMATH_PRECISION_ACCURATE);
+        rotated = simd4f_add(simd4f_mul(y, cos_a), simd4f_mul(z, sin_a));
+        z = simd4f_sub(simd4f_mul(z, cos_a), simd4f_mul(y, sin_a));
+        y = rotated;
+
+        vec3_scatter_lanes(&vecs[start], lanes, x, y, z);
+    }
+}
+
+void vec3_batch_unit(vec3_t *vecs, size_t count) {
+    assert(vecs != NULL);
+    if (vecs == NULL) {
+        return;
+    }
+    for (size_t start = 0; start < count; start += SIMD_WIDTH) {
+        size_t lanes = count - start < SIMD_WIDTH ? count - start : SIMD_WIDTH;
+        float lane_x[SIMD_WIDTH], lane_y[SIMD_WIDTH], lane_z[SIMD_WIDTH];
+        vec3_gather_lanes(&vecs[start], lanes, lane_x, lane_y, lane_z);
+        simd4f_t x = simd4f_load(lane_x), y = simd4f_load(lane_y), z = simd4f_load(lane_z);
+        simd4f_t magnitude_sqr = simd4f_add(simd4f_add(simd4f_mul(x, x), simd4f_mul(y, y)), simd4f_mul(z, z));
+
+        // like vec3_unit(), leave zero vectors alone instead of filling them with NaNs
+        simd4f_t nonzero = simd4f_greater_equal(magnitude_sqr, simd4f_set1(FLT_MIN));
+        simd4f_t safe_sqr = simd4f_select(nonzero, magnitude_sqr, simd4f_set1(1));
+        simd4f_t scale = simd4f_rsqrt(safe_sqr, FASTMATH_PRECISION_ACCURATE);
+        vec3_scatter_lanes(&vecs[start], lanes, simd4f_mul(x, scale), simd4f_mul(y, scale), simd4f_mul(z, scale));
+    }
+}
@@ -49,8 +49,8 @@ int graphic_main(void) {
     ccube_t cube1 = ccube_make(VEC3_ZERO, QUATERNION_NOROTATION, 3, 3, 3);
     ccube_t cube2 = ccube_make(VEC3_ZERO, QUATERNION_NOROTATION, 2, 2, 2);
     body_t body1, body2;
-    body_make(&body1, vec3_make(1, -5, 0), VEC3_ZERO, vec3_make(0, 1, 0), VEC3_ZERO, 1, 0, 0);
-    body_make(&body2, vec3_make(0, 5, 0), VEC3_ZERO, vec3_make(0, -1, 0), VEC3_ZERO, 1, 0, 0);
+    body_make(&body1, vec3_make(1, -5, 0), QUATERNION_NOROTATION, vec3_make(0, 1, 0), VEC3_ZERO, 1, 0, 0);
+    body_make(&body2, vec3_make(0, 5, 0), QUATERNION_NOROTATION, vec3_make(0, -1, 0), VEC3_ZERO, 1, 0, 0);
     ccube_gen_vertices(cube1, cube1_vertices, cube1_indices);
     ccube_gen_vertices(cube2, cube2_vertices, cube2_indices);
 
@@ -157,10 +157,11 @@ int graphic_main(void) {
             phy_body_step(&body2);
         }
 
+        // the bodies' cached matrices are shared with their colliders
         cube1.position = body1.position;
-        glm_euler_xyz_quat(vec3_to_cglm(body1.rotation), vec4_to_cglm(cube1.rotation));
+        ccube_set_body_rotation(&cube1, body1.rotation, body1.rotation_matrix);
         cube2.position = body2.position;
-        glm_euler_xyz_quat(vec3_to_cglm(body2.rotation), vec4_to_cglm(cube2.rotation));
+        ccube_set_body_rotation(&cube2, body2.rotation, body2.rotation_matrix);
 
         // move camera up and down
         if (window_is_key_down(window, GLFW_KEY_E)) {
@@ -20,13 +20,13 @@
      body_t a, b;
      bbox_t a_box, b_box;
      body_make(&a,
-         VEC3_ZERO, VEC3_ZERO,
+         VEC3_ZERO, QUATERNION_NOROTATION,
          VEC3_ZERO, VEC3_ZERO,
          350.0,
          0.0, 0.0);
      bbox_make(&a_box, 0, 0, 0, 2, 3, 5);
      body_make(&b,
-         vec3_make(10.0,50.0,30.0), VEC3_ZERO,
+         vec3_make(10.0,50.0,30.0), QUATERNION_NOROTATION,
          vec3_make(1.0,3.0,-6.0), VEC3_ZERO,
          5.0,
          0.0, 0.0);
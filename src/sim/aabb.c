@@ -38,6 +38,22 @@ bool bbox_is_bbox_inside(bbox_t boxA, bbox_t boxB) {
         (boxA.front + boxA.position.z) >= (boxB.back + boxB.position.z);
 }
 
+vec3_t bbox_get_min(bbox_t box) {
+    return vec3_make(
+        box.position.x + box.left,
+        box.position.y + box.bottom,
+        box.position.z + box.back
+    );
+}
+
+vec3_t bbox_get_max(bbox_t box) {
+    return vec3_make(
+        box.position.x + box.right,
+        box.position.y + box.top,
+        box.position.z + box.front
+    );
+}
+
 void bbox_clamp_point_within_bounds(bbox_t box, vec3_t *point) {
     point->x = clamp(point->x, box.position.x + box.left, box.position.x + box.right);
     point->y = clamp(point->y, box.position.y + box.bottom, box.position.y + box.top);
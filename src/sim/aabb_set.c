@@ -0,0 +1,298 @@
+#include "sim/aabb_set.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/defines.h"
+#include "common/cpu.h"
+#include "common/simd.h"
+
+#if defined(CPU_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+/**
+ * How many mask words bbox_set_find_pairs() fills in at a time
+ */
+#define BBOX_SET_PAIR_CHUNK_WORDS 64
+
+/**
+ * The number of the set's boxes (real or padding) the kernels test
+ */
+#define bbox_set_padded_count(set) \
+    (((set)->count + BBOX_SET_ALIGNMENT - 1) / BBOX_SET_ALIGNMENT * BBOX_SET_ALIGNMENT)
+
+/**
+ * [internal] turns boxes begin through end - 1 into padding.  Every
+ * bound is NaN, since every comparison with NaN is false: an empty box
+ * (min = +infinity, max = -infinity) would still overlap a query box
+ * with infinite bounds
+ */
+PRIVATE_FUNC void bbox_set_empty_range(bbox_set_t *set, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        set->min_x[i] = NAN;
+        set->min_y[i] = NAN;
+        set->min_z[i] = NAN;
+        set->max_x[i] = NAN;
+        set->max_y[i] = NAN;
+        set->max_z[i] = NAN;
+    }
+}
+
+/**
+ * [internal] points the set's arrays into one block of memory.  The
+ * capacity is a multiple of BBOX_SET_ALIGNMENT, so every array stays
+ * as aligned as the block
+ */
+PRIVATE_FUNC void bbox_set_split_block(bbox_set_t *set, phy_real_t *block, size_t capacity) {
+    set->min_x = block;
+    set->min_y = block + capacity;
+    set->min_z = block + 2 * capacity;
+    set->max_x = block + 3 * capacity;
+    set->max_y = block + 4 * capacity;
+    set->max_z = block + 5 * capacity;
+    set->capacity = capacity;
+}
+
+PRIVATE_FUNC int bbox_set_reserve(bbox_set_t *set, size_t capacity) {
+    if (capacity <= set->capacity) {
+        return BBOX_SET_SUCCESS;
+    }
+    size_t new_capacity = set->capacity > 0 ? set->capacity : BBOX_SET_ALIGNMENT;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    phy_real_t *block = aligned_alloc(64, 6 * new_capacity * sizeof (phy_real_t));
+    if (block == NULL) {
+        return BBOX_SET_ERROR_ALLOC;
+    }
+
+    phy_real_t *old_block = set->min_x;
+    size_t old_capacity = set->capacity;
+    bbox_set_split_block(set, block, new_capacity);
+    for (size_t array = 0; array < 6; array++) {
+        if (old_block != NULL) {
+            memcpy(block + array * new_capacity, old_block + array * old_capacity, set->count * sizeof (phy_real_t));
+        }
+    }
+    bbox_set_empty_range(set, set->count, new_capacity);
+    free(old_block);
+    return BBOX_SET_SUCCESS;
+}
+
+bbox_set_t *bbox_set_create(size_t capacity) {
+    bbox_set_t *set = calloc(1, sizeof (bbox_set_t));
+    if (set == NULL) {
+        return NULL;
+    }
+    if (bbox_set_reserve(set, capacity > 0 ? capacity : 1) != BBOX_SET_SUCCESS) {
+        free(set);
+        return NULL;
+    }
+    return set;
+}
+
+int bbox_set_add(bbox_set_t *set, vec3_t min, vec3_t max) {
+    safe_assert(set != NULL, BBOX_SET_ERROR_PARAMS);
+    safe_assert(set->count < UINT32_MAX, BBOX_SET_ERROR_PARAMS);
+
+    int result = bbox_set_reserve(set, set->count + 1);
+    if (result != BBOX_SET_SUCCESS) {
+        return result;
+    }
+    set->count++;
+    return bbox_set_update(set, set->count - 1, min, max);
+}
+
+int bbox_set_add_bbox(bbox_set_t *set, bbox_t box) {
+    return bbox_set_add(set, bbox_get_min(box), bbox_get_max(box));
+}
+
+int bbox_set_update(bbox_set_t *set, size_t index, vec3_t min, vec3_t max) {
+    safe_assert(set != NULL && index < set->count, BBOX_SET_ERROR_PARAMS);
+
+    set->min_x[index] = min.x;
+    set->min_y[index] = min.y;
+    set->min_z[index] = min.z;
+    set->max_x[index] = max.x;
+    set->max_y[index] = max.y;
+    set->max_z[index] = max.z;
+    return BBOX_SET_SUCCESS;
+}
+
+void bbox_set_clear(bbox_set_t *set) {
+    safe_assert(set != NULL,);
+    bbox_set_empty_range(set, 0, set->count);
+    set->count = 0;
+}
+
+/**
+ * [internal] fills in mask words first_word through end_word - 1 (stored
+ * from mask[0]), 4 boxes at a time
+ */
+PRIVATE_FUNC void bbox_set_overlap_words_baseline(const bbox_set_t *set, vec3_t min, vec3_t max,
+        size_t first_word, size_t end_word, bbox_set_mask_t *mask) {
+    size_t padded_count = bbox_set_padded_count(set);
+    for (size_t word = first_word; word < end_word; word++) {
+        bbox_set_mask_t bits = 0;
+        for (size_t offset = 0; offset < BBOX_SET_MASK_BITS; offset += SIMD_WIDTH) {
+            size_t box = word * BBOX_SET_MASK_BITS + offset;
+            if (box >= padded_count) {
+                break;
+            }
+            bbox_set_mask_t overlapping = simd4f_overlap_mask(
+                simd4f_load(&set->min_x[box]), simd4f_load(&set->min_y[box]), simd4f_load(&set->min_z[box]),
+                simd4f_load(&set->max_x[box]), simd4f_load(&set->max_y[box]), simd4f_load(&set->max_z[box]),
+                min, max);
+            bits |= overlapping << offset;
+        }
+        mask[word - first_word] = bits;
+    }
+}
+
+#if defined(CPU_X86_DISPATCH)
+
+PRIVATE_FUNC CPU_TARGET_AVX2 void bbox_set_overlap_words_avx2(const bbox_set_t *set, vec3_t min, vec3_t max,
+        size_t first_word, size_t end_word, bbox_set_mask_t *mask) {
+    const __m256 query_min_x = _mm256_set1_ps(min.x), query_min_y = _mm256_set1_ps(min.y), query_min_z = _mm256_set1_ps(min.z);
+    const __m256 query_max_x = _mm256_set1_ps(max.x), query_max_y = _mm256_set1_ps(max.y), query_max_z = _mm256_set1_ps(max.z);
+    size_t padded_count = bbox_set_padded_count(set);
+    for (size_t word = first_word; word < end_word; word++) {
+        bbox_set_mask_t bits = 0;
+        for (size_t offset = 0; offset < BBOX_SET_MASK_BITS; offset += 8) {
+            size_t box = word * BBOX_SET_MASK_BITS + offset;
+            if (box >= padded_count) {
+                break;
+            }
+            __m256 overlap = _mm256_and_ps(
+                _mm256_cmp_ps(_mm256_loadu_ps(&set->min_x[box]), query_max_x, _CMP_LE_OQ),
+                _mm256_cmp_ps(_mm256_loadu_ps(&set->max_x[box]), query_min_x, _CMP_GE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&set->min_y[box]), query_max_y, _CMP_LE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&set->max_y[box]), query_min_y, _CMP_GE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&set->min_z[box]), query_max_z, _CMP_LE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&set->max_z[box]), query_min_z, _CMP_GE_OQ));
+            bits |= (bbox_set_mask_t)_mm256_movemask_ps(overlap) << offset;
+        }
+        mask[word - first_word] = bits;
+    }
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX512 void bbox_set_overlap_words_avx512(const bbox_set_t *set, vec3_t min, vec3_t max,
+        size_t first_word, size_t end_word, bbox_set_mask_t *mask) {
+    const __m512 query_min_x = _mm512_set1_ps(min.x), query_min_y = _mm512_set1_ps(min.y), query_min_z = _mm512_set1_ps(min.z);
+    const __m512 query_max_x = _mm512_set1_ps(max.x), query_max_y = _mm512_set1_ps(max.y), query_max_z = _mm512_set1_ps(max.z);
+    size_t padded_count = bbox_set_padded_count(set);
+    for (size_t word = first_word; word < end_word; word++) {
+        bbox_set_mask_t bits = 0;
+        for (size_t offset = 0; offset < BBOX_SET_MASK_BITS; offset += 16) {
+            size_t box = word * BBOX_SET_MASK_BITS + offset;
+            if (box >= padded_count) {
+                break;
+            }
+            // each comparison only runs on the lanes every earlier one passed
+            __mmask16 overlap = _mm512_cmp_ps_mask(_mm512_loadu_ps(&set->min_x[box]), query_max_x, _CMP_LE_OQ);
+            overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(&set->max_x[box]), query_min_x, _CMP_GE_OQ);
+            overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(&set->min_y[box]), query_max_y, _CMP_LE_OQ);
+            overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(&set->max_y[box]), query_min_y, _CMP_GE_OQ);
+            overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(&set->min_z[box]), query_max_z, _CMP_LE_OQ);
+            overlap = _mm512_mask_cmp_ps_mask(overlap, _mm512_loadu_ps(&set->max_z[box]), query_min_z, _CMP_GE_OQ);
+            bits |= (bbox_set_mask_t)overlap << offset;
+        }
+        mask[word - first_word] = bits;
+    }
+}
+
+#endif
+
+/**
+ * [internal] fills in mask words first_word through end_word - 1,
+ * storing them from mask[0], with the widest kernel the CPU supports
+ */
+PRIVATE_FUNC void bbox_set_overlap_words(const bbox_set_t *set, vec3_t min, vec3_t max,
+        size_t first_word, size_t end_word, bbox_set_mask_t *mask) {
+    switch (cpu_get_isa()) {
+#if defined(CPU_X86_DISPATCH)
+        case CPU_ISA_AVX512:
+            bbox_set_overlap_words_avx512(set, min, max, first_word, end_word, mask);
+            break;
+        case CPU_ISA_AVX2:
+            bbox_set_overlap_words_avx2(set, min, max, first_word, end_word, mask);
+            break;
+#endif
+        default:
+            bbox_set_overlap_words_baseline(set, min, max, first_word, end_word, mask);
+            break;
+    }
+    // padding never compares as overlapping, but a NaN-unaware build
+    // (e.g. -ffast-math) could still set its bits, and callers index
+    // the set with every bit they find
+    size_t last_bits = set->count % BBOX_SET_MASK_BITS;
+    if (end_word > first_word && end_word == bbox_set_mask_words(set->count) && last_bits != 0) {
+        mask[end_word - 1 - first_word] &= ((bbox_set_mask_t)1 << last_bits) - 1;
+    }
+}
+
+void bbox_set_query_mask(const bbox_set_t *set, vec3_t min, vec3_t max, bbox_set_mask_t *mask) {
+    safe_assert(set != NULL && (mask != NULL || set->count == 0),);
+    bbox_set_overlap_words(set, min, max, 0, bbox_set_mask_words(set->count), mask);
+}
+
+/**
+ * [internal] finds the index of the lowest set bit of a nonzero mask word
+ */
+PRIVATE_FUNC size_t bbox_set_lowest_bit(bbox_set_mask_t bits) {
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctz(bits);
+#else
+    size_t index = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+size_t bbox_set_find_pairs(const bbox_set_t *set, bbox_pair_t *pairs, size_t max_pairs) {
+    safe_assert(set != NULL && (pairs != NULL || max_pairs == 0), 0);
+
+    size_t pair_count = 0;
+    size_t word_count = bbox_set_mask_words(set->count);
+    bbox_set_mask_t mask[BBOX_SET_PAIR_CHUNK_WORDS];
+    for (size_t a = 0; a < set->count; a++) {
+        vec3_t min = vec3_make(set->min_x[a], set->min_y[a], set->min_z[a]);
+        vec3_t max = vec3_make(set->max_x[a], set->max_y[a], set->max_z[a]);
+
+        // only test boxes after a, so each pair is found once
+        size_t first_word = (a + 1) / BBOX_SET_MASK_BITS;
+        for (size_t chunk = first_word; chunk < word_count; chunk += BBOX_SET_PAIR_CHUNK_WORDS) {
+            size_t end_word = chunk + BBOX_SET_PAIR_CHUNK_WORDS < word_count ? chunk + BBOX_SET_PAIR_CHUNK_WORDS : word_count;
+            bbox_set_overlap_words(set, min, max, chunk, end_word, mask);
+            if (chunk == first_word) {
+                size_t skip = (a + 1) % BBOX_SET_MASK_BITS;
+                mask[0] &= skip == 0 ? ~(bbox_set_mask_t)0 : ~(bbox_set_mask_t)0 << skip;
+            }
+
+            for (size_t word = chunk; word < end_word; word++) {
+                bbox_set_mask_t bits = mask[word - chunk];
+                while (bits != 0) {
+                    size_t b = word * BBOX_SET_MASK_BITS + bbox_set_lowest_bit(bits);
+                    bits &= bits - 1;
+                    if (pair_count < max_pairs) {
+                        pairs[pair_count] = (bbox_pair_t){ (uint32_t)a, (uint32_t)b };
+                    }
+                    pair_count++;
+                }
+            }
+        }
+    }
+    return pair_count;
+}
+
+void bbox_set_destroy(bbox_set_t *set) {
+    if (set == NULL) {
+        return;
+    }
+    free(set->min_x);
+    free(set);
+}
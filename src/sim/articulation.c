@@ -0,0 +1,681 @@
+#include "sim/articulation.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/mat3x3.h"
+#include "common/vec4a.h"
+
+/**
+ * How many links an articulation starts out with room for
+ */
+#define ARTICULATION_DEFAULT_CAPACITY 16
+
+/**
+ * Joints whose inertia along any coordinate is smaller than this can't
+ * be accelerated, so the articulation can't be stepped
+ */
+#define ARTICULATION_MIN_PIVOT 1e-12
+
+/**
+ * A spatial (six-dimensional) vector: an angular part then a linear part.
+ * Velocities and accelerations are motion vectors (angular velocity, then
+ * the velocity of the frame's origin); forces are force vectors (torque
+ * around the frame's origin, then force)
+ */
+typedef phy_real_t spatial_vector_t[6];
+
+/**
+ * A 6x6 matrix acting on spatial vectors
+ */
+typedef phy_real_t spatial_matrix_t[6][6];
+
+/**
+ * Moves spatial vectors from a parent's frame into a child's frame,
+ * whose origin is at translation (in the parent's frame), and which
+ * converts parent coordinates to child coordinates with rotation
+ */
+struct SpatialTransform {
+    mat3x3_t rotation;
+    vec3_t translation;
+};
+typedef struct SpatialTransform spatial_transform_t;
+
+/**
+ * Everything the articulated-body algorithm needs for a single link,
+ * all in the link's frame
+ */
+struct ArticulationWorkspace {
+    spatial_transform_t parent_to_link;
+    /**
+     * The joint's motion subspace: column j is the motion caused by its
+     * jth coordinate
+     */
+    spatial_matrix_t subspace;
+    size_t dof;
+    spatial_vector_t velocity;
+    /**
+     * The acceleration caused by the link's velocity alone (the velocity
+     * product term)
+     */
+    spatial_vector_t bias_acceleration;
+    /**
+     * The inertia and bias force of the link and every link after it,
+     * treating the joint as free
+     */
+    spatial_matrix_t articulated_inertia;
+    spatial_vector_t bias_force;
+    /**
+     * articulated_inertia * subspace, the inverse of subspace^T * that,
+     * and the joint forces left after the bias force
+     */
+    spatial_matrix_t inertia_subspace;
+    spatial_matrix_t inverse_joint_inertia;
+    spatial_vector_t joint_forces;
+    spatial_vector_t acceleration;
+    spatial_vector_t joint_accelerations;
+};
+typedef struct ArticulationWorkspace articulation_workspace_t;
+
+/**
+ * Splits a spatial vector into its angular and linear parts
+ */
+#define spatial_vector_top(v) vec3_make((v)[0], (v)[1], (v)[2])
+#define spatial_vector_bottom(v) vec3_make((v)[3], (v)[4], (v)[5])
+
+PRIVATE_FUNC void spatial_vector_set(spatial_vector_t dest, vec3_t top, vec3_t bottom) {
+    dest[0] = top.x;
+    dest[1] = top.y;
+    dest[2] = top.z;
+    dest[3] = bottom.x;
+    dest[4] = bottom.y;
+    dest[5] = bottom.z;
+}
+
+/**
+ * Moves a motion vector from the parent's frame to the child's
+ */
+PRIVATE_FUNC void spatial_transform_motion(spatial_vector_t dest, spatial_transform_t *transform, const spatial_vector_t motion) {
+    vec3_t angular = spatial_vector_top(motion);
+    vec3_t linear = spatial_vector_bottom(motion);
+    vec3_t moment;
+    vec3_cross_product(&moment, transform->translation, angular);
+    vec3_add_to(&linear, moment, -1);
+    spatial_vector_set(dest, mat3x3_times_vec3(transform->rotation, angular), mat3x3_times_vec3(transform->rotation, linear));
+}
+
+/**
+ * Moves a force vector from the child's frame back to the parent's
+ */
+PRIVATE_FUNC void spatial_transform_force_back(spatial_vector_t dest, spatial_transform_t *transform, const spatial_vector_t force) {
+    vec3_t torque = mat3x3_transpose_times_vec3(transform->rotation, spatial_vector_top(force));
+    vec3_t linear = mat3x3_transpose_times_vec3(transform->rotation, spatial_vector_bottom(force));
+    vec3_t moment;
+    vec3_cross_product(&moment, transform->translation, linear);
+    vec3_add_to(&torque, moment, 1);
+    spatial_vector_set(dest, torque, linear);
+}
+
+/**
+ * Writes out a transform as a matrix acting on motion vectors
+ */
+PRIVATE_FUNC void spatial_transform_to_matrix(spatial_matrix_t dest, spatial_transform_t *transform) {
+    memset(dest, 0, (sizeof (spatial_matrix_t)));
+    const vec3_t r = transform->translation;
+    const mat3x3_t skew = {
+        { 0, -r.z, r.y },
+        { r.z, 0, -r.x },
+        { -r.y, r.x, 0 },
+    };
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            dest[i][j] = transform->rotation[i][j];
+            dest[i + 3][j + 3] = transform->rotation[i][j];
+            phy_real_t moment = 0;
+            for (size_t k = 0; k < 3; k++) {
+                moment += transform->rotation[i][k] * skew[k][j];
+            }
+            dest[i + 3][j] = -moment;
+        }
+    }
+}
+
+/**
+ * Calculates v x m, for motion vectors v and m
+ */
+PRIVATE_FUNC void spatial_cross_motion(spatial_vector_t dest, const spatial_vector_t v, const spatial_vector_t m) {
+    vec3_t angular, linear, moment;
+    vec3_cross_product(&angular, spatial_vector_top(v), spatial_vector_top(m));
+    vec3_cross_product(&linear, spatial_vector_top(v), spatial_vector_bottom(m));
+    vec3_cross_product(&moment, spatial_vector_bottom(v), spatial_vector_top(m));
+    vec3_add_to(&linear, moment, 1);
+    spatial_vector_set(dest, angular, linear);
+}
+
+/**
+ * Calculates v x f, for a motion vector v and force vector f
+ */
+PRIVATE_FUNC void spatial_cross_force(spatial_vector_t dest, const spatial_vector_t v, const spatial_vector_t f) {
+    vec3_t torque, linear, moment;
+    vec3_cross_product(&torque, spatial_vector_top(v), spatial_vector_top(f));
+    vec3_cross_product(&moment, spatial_vector_bottom(v), spatial_vector_bottom(f));
+    vec3_add_to(&torque, moment, 1);
+    vec3_cross_product(&linear, spatial_vector_top(v), spatial_vector_bottom(f));
+    spatial_vector_set(dest, torque, linear);
+}
+
+PRIVATE_FUNC void spatial_matrix_apply(spatial_vector_t dest, spatial_matrix_t matrix, const spatial_vector_t vec) {
+    for (size_t i = 0; i < 6; i++) {
+        phy_real_t sum = 0;
+        for (size_t j = 0; j < 6; j++) {
+            sum += matrix[i][j] * vec[j];
+        }
+        dest[i] = sum;
+    }
+}
+
+/**
+ * Calculates the spatial inertia of a link around its frame's origin
+ */
+PRIVATE_FUNC void articulation_link_inertia(spatial_matrix_t dest, const articulation_link_t *link) {
+    memset(dest, 0, (sizeof (spatial_matrix_t)));
+    const vec3_t c = link->center_of_mass;
+    const phy_real_t m = link->mass;
+    const mat3x3_t skew = {
+        { 0, -c.z, c.y },
+        { c.z, 0, -c.x },
+        { -c.y, c.x, 0 },
+    };
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            // I_c + m c c^T, moved from the center of mass to the origin
+            phy_real_t parallel_axis = 0;
+            for (size_t k = 0; k < 3; k++) {
+                parallel_axis -= skew[i][k] * skew[k][j];
+            }
+            dest[i][j] = m * parallel_axis;
+            dest[i][j + 3] = m * skew[i][j];
+            dest[i + 3][j] = -m * skew[i][j];
+        }
+        dest[i][i] += link->inertia.raw[i];
+        dest[i + 3][i + 3] = m;
+    }
+}
+
+/**
+ * Inverts the top-left size x size corner of a matrix
+ * @return true on success, or false if the matrix is singular
+ */
+PRIVATE_FUNC bool articulation_invert(spatial_matrix_t dest, spatial_matrix_t matrix, size_t size) {
+    spatial_matrix_t work;
+    memcpy(work, matrix, (sizeof work));
+    memset(dest, 0, (sizeof (spatial_matrix_t)));
+    for (size_t i = 0; i < size; i++) {
+        dest[i][i] = 1;
+    }
+    for (size_t column = 0; column < size; column++) {
+        size_t pivot = column;
+        for (size_t row = column + 1; row < size; row++) {
+            if (fabs(work[row][column]) > fabs(work[pivot][column])) {
+                pivot = row;
+            }
+        }
+        if (fabs(work[pivot][column]) < ARTICULATION_MIN_PIVOT) {
+            return false;
+        }
+        for (size_t j = 0; j < size; j++) {
+            phy_real_t swap = work[column][j];
+            work[column][j] = work[pivot][j];
+            work[pivot][j] = swap;
+            swap = dest[column][j];
+            dest[column][j] = dest[pivot][j];
+            dest[pivot][j] = swap;
+        }
+        phy_real_t scale = 1 / work[column][column];
+        for (size_t j = 0; j < size; j++) {
+            work[column][j] *= scale;
+            dest[column][j] *= scale;
+        }
+        for (size_t row = 0; row < size; row++) {
+            if (row == column) {
+                continue;
+            }
+            phy_real_t factor = work[row][column];
+            for (size_t j = 0; j < size; j++) {
+                work[row][j] -= factor * work[column][j];
+                dest[row][j] -= factor * dest[column][j];
+            }
+        }
+    }
+    return true;
+}
+
+size_t articulation_joint_dof(articulation_joint_kind_t joint_kind) {
+    switch (joint_kind) {
+        case ARTICULATION_JOINT_REVOLUTE:
+        case ARTICULATION_JOINT_PRISMATIC:
+            return 1;
+        case ARTICULATION_JOINT_SPHERICAL:
+            return 3;
+        case ARTICULATION_JOINT_FLOATING:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+articulation_t *articulation_create(vec3_t gravity) {
+    articulation_t *articulation = calloc(1, (sizeof *articulation));
+    if (articulation == NULL) {
+        return NULL;
+    }
+    articulation->gravity = gravity;
+    return articulation;
+}
+
+int articulation_add_link(articulation_t *articulation, int32_t parent, articulation_joint_kind_t joint_kind,
+    vec3_t joint_position, vec3_t axis, phy_real_t mass, vec3_t center_of_mass, vec3_t inertia) {
+    safe_assert(articulation != NULL, ARTICULATION_ERROR_PARAMS);
+    safe_assert(parent >= ARTICULATION_NO_PARENT && (parent == ARTICULATION_NO_PARENT || (size_t)parent < articulation->link_count),
+        ARTICULATION_ERROR_PARAMS);
+    safe_assert(articulation_joint_dof(joint_kind) > 0, ARTICULATION_ERROR_PARAMS);
+    safe_assert(mass > 0 && inertia.x >= 0 && inertia.y >= 0 && inertia.z >= 0, ARTICULATION_ERROR_PARAMS);
+
+    if (joint_kind == ARTICULATION_JOINT_REVOLUTE || joint_kind == ARTICULATION_JOINT_PRISMATIC) {
+        phy_real_t length = vec3_magnitude(axis);
+        safe_assert(length > PHYSICS_EPSILON, ARTICULATION_ERROR_PARAMS);
+        vec3_multiply_by(&axis, 1 / length);
+    }
+
+    if (articulation->link_count >= articulation->link_capacity) {
+        size_t capacity = articulation->link_capacity > 0 ? articulation->link_capacity * 2 : ARTICULATION_DEFAULT_CAPACITY;
+        articulation_link_t *links = reallocarray(articulation->links, capacity, (sizeof *links));
+        if (links == NULL) {
+            return ARTICULATION_ERROR_ALLOC;
+        }
+        articulation->links = links;
+        articulation_workspace_t *workspace = reallocarray(articulation->workspace, capacity, (sizeof *workspace));
+        if (workspace == NULL) {
+            return ARTICULATION_ERROR_ALLOC;
+        }
+        articulation->workspace = workspace;
+        articulation->link_capacity = capacity;
+    }
+
+    articulation_link_t *link = &articulation->links[articulation->link_count];
+    memset(link, 0, (sizeof *link));
+    link->parent = parent;
+    link->joint_kind = joint_kind;
+    link->joint_position = joint_position;
+    link->axis = axis;
+    link->mass = mass;
+    link->center_of_mass = center_of_mass;
+    link->inertia = inertia;
+    link->translation = VEC3_ZERO;
+    link->rotation = QUATERNION_NOROTATION;
+    articulation->link_count++;
+    articulation_update_transforms(articulation);
+    return ARTICULATION_SUCCESS;
+}
+
+int articulation_set_coordinate(articulation_t *articulation, size_t link_index, phy_real_t coordinate) {
+    safe_assert(articulation != NULL && link_index < articulation->link_count, ARTICULATION_ERROR_PARAMS);
+    articulation_link_t *link = &articulation->links[link_index];
+    switch (link->joint_kind) {
+        case ARTICULATION_JOINT_REVOLUTE:
+            link->rotation = quaternion_make(link->axis.x, link->axis.y, link->axis.z, coordinate);
+            break;
+        case ARTICULATION_JOINT_PRISMATIC:
+            link->translation = link->axis;
+            vec3_multiply_by(&link->translation, coordinate);
+            break;
+        default:
+            return ARTICULATION_ERROR_PARAMS;
+    }
+    link->coordinate = coordinate;
+    return ARTICULATION_SUCCESS;
+}
+
+/**
+ * Finds each link's transform from its parent, its motion subspace, and
+ * its velocity
+ */
+PRIVATE_FUNC void articulation_compute_velocities(const articulation_t *articulation) {
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        const articulation_link_t *link = &articulation->links[i];
+        articulation_workspace_t *work = &articulation->workspace[i];
+
+        // the link's frame is rotated by the joint's rotation, so parent
+        // coordinates are brought into it by the inverse rotation
+        mat3x3_t link_to_parent;
+        mat3x3_from_quaternion(link_to_parent, link->rotation);
+        mat3x3_transpose(work->parent_to_link.rotation, link_to_parent);
+        work->parent_to_link.translation = link->joint_position;
+        vec3_add_to(&work->parent_to_link.translation, link->translation, 1);
+
+        // revolute and prismatic axes don't move as their joints do, so
+        // every subspace is constant in the link's frame
+        memset(work->subspace, 0, (sizeof work->subspace));
+        work->dof = articulation_joint_dof(link->joint_kind);
+        switch (link->joint_kind) {
+            case ARTICULATION_JOINT_REVOLUTE:
+            case ARTICULATION_JOINT_PRISMATIC: {
+                const size_t offset = link->joint_kind == ARTICULATION_JOINT_REVOLUTE ? 0 : 3;
+                for (size_t r = 0; r < 3; r++) {
+                    work->subspace[r + offset][0] = link->axis.raw[r];
+                }
+                break;
+            }
+            case ARTICULATION_JOINT_SPHERICAL:
+            case ARTICULATION_JOINT_FLOATING:
+                for (size_t d = 0; d < work->dof; d++) {
+                    work->subspace[d][d] = 1;
+                }
+                break;
+        }
+
+        spatial_vector_t joint_velocity;
+        for (size_t r = 0; r < 6; r++) {
+            joint_velocity[r] = 0;
+            for (size_t d = 0; d < work->dof; d++) {
+                joint_velocity[r] += work->subspace[r][d] * link->velocity[d];
+            }
+        }
+        if (link->parent == ARTICULATION_NO_PARENT) {
+            memcpy(work->velocity, joint_velocity, (sizeof joint_velocity));
+        } else {
+            spatial_transform_motion(work->velocity, &work->parent_to_link, articulation->workspace[link->parent].velocity);
+            for (size_t r = 0; r < 6; r++) {
+                work->velocity[r] += joint_velocity[r];
+            }
+        }
+        spatial_cross_motion(work->bias_acceleration, work->velocity, joint_velocity);
+    }
+}
+
+/**
+ * Runs the articulated-body algorithm, finding every joint's acceleration.
+ * Damping is applied implicitly (against the velocity at the end of the
+ * step), so it stays stable however strong it is
+ * @return false if any joint can't be accelerated
+ */
+PRIVATE_FUNC bool articulation_compute_accelerations(articulation_t *articulation, phy_real_t dt) {
+    // with no forces, every link's bias force is just v x Iv
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        articulation_link_t *link = &articulation->links[i];
+        articulation_workspace_t *work = &articulation->workspace[i];
+        articulation_link_inertia(work->articulated_inertia, link);
+        spatial_vector_t momentum;
+        spatial_matrix_apply(momentum, work->articulated_inertia, work->velocity);
+        spatial_cross_force(work->bias_force, work->velocity, momentum);
+
+        // bring outside forces into the link's frame, around its origin
+        mat3x3_t link_to_world;
+        mat3x3_from_quaternion(link_to_world, link->world_rotation);
+        vec3_t force = mat3x3_transpose_times_vec3(link_to_world, link->net_force);
+        vec3_t torque = mat3x3_transpose_times_vec3(link_to_world, link->net_torque);
+        vec3_t moment;
+        vec3_cross_product(&moment, link->center_of_mass, force);
+        vec3_add_to(&torque, moment, 1);
+        spatial_vector_t external;
+        spatial_vector_set(external, torque, force);
+        for (size_t r = 0; r < 6; r++) {
+            work->bias_force[r] -= external[r];
+        }
+    }
+
+    // sweep from the leaves inwards, folding each link into its parent
+    for (size_t i = articulation->link_count; i-- > 0;) {
+        const articulation_link_t *link = &articulation->links[i];
+        articulation_workspace_t *work = &articulation->workspace[i];
+        const size_t dof = work->dof;
+
+        spatial_matrix_t joint_inertia;
+        for (size_t r = 0; r < 6; r++) {
+            for (size_t d = 0; d < dof; d++) {
+                phy_real_t sum = 0;
+                for (size_t k = 0; k < 6; k++) {
+                    sum += work->articulated_inertia[r][k] * work->subspace[k][d];
+                }
+                work->inertia_subspace[r][d] = sum;
+            }
+        }
+        for (size_t a = 0; a < dof; a++) {
+            phy_real_t bias = 0;
+            for (size_t k = 0; k < 6; k++) {
+                bias += work->subspace[k][a] * work->bias_force[k];
+            }
+            work->joint_forces[a] = link->joint_force[a] - link->damping * link->velocity[a] - bias;
+            for (size_t b = 0; b < dof; b++) {
+                phy_real_t sum = 0;
+                for (size_t k = 0; k < 6; k++) {
+                    sum += work->subspace[k][a] * work->inertia_subspace[k][b];
+                }
+                joint_inertia[a][b] = sum;
+            }
+            joint_inertia[a][a] += link->damping * dt;
+        }
+        if (!articulation_invert(work->inverse_joint_inertia, joint_inertia, dof)) {
+            return false;
+        }
+
+        if (link->parent == ARTICULATION_NO_PARENT) {
+            continue;
+        }
+
+        // U D^-1, then the inertia and bias force the parent feels
+        spatial_matrix_t gain;
+        for (size_t r = 0; r < 6; r++) {
+            for (size_t d = 0; d < dof; d++) {
+                phy_real_t sum = 0;
+                for (size_t k = 0; k < dof; k++) {
+                    sum += work->inertia_subspace[r][k] * work->inverse_joint_inertia[k][d];
+                }
+                gain[r][d] = sum;
+            }
+        }
+        spatial_matrix_t inertia;
+        for (size_t r = 0; r < 6; r++) {
+            for (size_t c = 0; c < 6; c++) {
+                phy_real_t sum = 0;
+                for (size_t d = 0; d < dof; d++) {
+                    sum += gain[r][d] * work->inertia_subspace[c][d];
+                }
+                inertia[r][c] = work->articulated_inertia[r][c] - sum;
+            }
+        }
+        spatial_vector_t bias;
+        spatial_matrix_apply(bias, inertia, work->bias_acceleration);
+        for (size_t r = 0; r < 6; r++) {
+            bias[r] += work->bias_force[r];
+            for (size_t d = 0; d < dof; d++) {
+                bias[r] += gain[r][d] * work->joint_forces[d];
+            }
+        }
+
+        articulation_workspace_t *parent = &articulation->workspace[link->parent];
+        spatial_matrix_t transform, moved;
+        spatial_transform_to_matrix(transform, &work->parent_to_link);
+        for (size_t r = 0; r < 6; r++) {
+            for (size_t c = 0; c < 6; c++) {
+                phy_real_t sum = 0;
+                for (size_t k = 0; k < 6; k++) {
+                    sum += inertia[r][k] * transform[k][c];
+                }
+                moved[r][c] = sum;
+            }
+        }
+        for (size_t r = 0; r < 6; r++) {
+            for (size_t c = 0; c < 6; c++) {
+                phy_real_t sum = 0;
+                for (size_t k = 0; k < 6; k++) {
+                    sum += transform[k][r] * moved[k][c];
+                }
+                parent->articulated_inertia[r][c] += sum;
+            }
+        }
+        spatial_vector_t parent_bias;
+        spatial_transform_force_back(parent_bias, &work->parent_to_link, bias);
+        for (size_t r = 0; r < 6; r++) {
+            parent->bias_force[r] += parent_bias[r];
+        }
+    }
+
+    // sweep back outwards.  Gravity is an upward acceleration of the world
+    spatial_vector_t world_acceleration;
+    vec3_t up = articulation->gravity;
+    vec3_multiply_by(&up, -1);
+    spatial_vector_set(world_acceleration, VEC3_ZERO, up);
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        const articulation_link_t *link = &articulation->links[i];
+        articulation_workspace_t *work = &articulation->workspace[i];
+        const phy_real_t *parent_acceleration = link->parent == ARTICULATION_NO_PARENT
+            ? world_acceleration : articulation->workspace[link->parent].acceleration;
+
+        spatial_transform_motion(work->acceleration, &work->parent_to_link, parent_acceleration);
+        for (size_t r = 0; r < 6; r++) {
+            work->acceleration[r] += work->bias_acceleration[r];
+        }
+        spatial_vector_t remaining;
+        for (size_t d = 0; d < work->dof; d++) {
+            remaining[d] = work->joint_forces[d];
+            for (size_t k = 0; k < 6; k++) {
+                remaining[d] -= work->inertia_subspace[k][d] * work->acceleration[k];
+            }
+        }
+        for (size_t d = 0; d < work->dof; d++) {
+            work->joint_accelerations[d] = 0;
+            for (size_t k = 0; k < work->dof; k++) {
+                work->joint_accelerations[d] += work->inverse_joint_inertia[d][k] * remaining[k];
+            }
+        }
+        for (size_t r = 0; r < 6; r++) {
+            for (size_t d = 0; d < work->dof; d++) {
+                work->acceleration[r] += work->subspace[r][d] * work->joint_accelerations[d];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Rotates a quaternion by an angular velocity (in the rotated frame) for dt
+ */
+PRIVATE_FUNC void articulation_integrate_rotation(quaternion_t *rotation, vec3_t angular_velocity, phy_real_t dt) {
+    phy_real_t speed = vec3_magnitude(angular_velocity);
+    if (speed * dt < PHYSICS_EPSILON) {
+        return;
+    }
+    vec3_multiply_by(&angular_velocity, 1 / speed);
+    quaternion_t step = quaternion_make(angular_velocity.x, angular_velocity.y, angular_velocity.z, speed * dt);
+    *rotation = vec4a_to_vec4(vec4a_unit(quaternion_a_product(vec4a_from_vec4(*rotation), vec4a_from_vec4(step))));
+}
+
+/**
+ * Moves every link forward by a single substep
+ * @return false if any joint can't be accelerated
+ */
+PRIVATE_FUNC bool articulation_substep(articulation_t *articulation, phy_real_t dt) {
+    articulation_compute_velocities(articulation);
+    if (!articulation_compute_accelerations(articulation, dt)) {
+        return false;
+    }
+
+    // semi-implicit Euler: velocities first, then positions from them
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        articulation_link_t *link = &articulation->links[i];
+        const articulation_workspace_t *work = &articulation->workspace[i];
+        for (size_t d = 0; d < work->dof; d++) {
+            link->velocity[d] += work->joint_accelerations[d] * dt;
+        }
+        vec3_t angular = vec3_make(link->velocity[0], link->velocity[1], link->velocity[2]);
+        switch (link->joint_kind) {
+            case ARTICULATION_JOINT_REVOLUTE:
+            case ARTICULATION_JOINT_PRISMATIC:
+                articulation_set_coordinate(articulation, i, link->coordinate + link->velocity[0] * dt);
+                break;
+            case ARTICULATION_JOINT_SPHERICAL:
+                articulation_integrate_rotation(&link->rotation, angular, dt);
+                break;
+            case ARTICULATION_JOINT_FLOATING: {
+                articulation_integrate_rotation(&link->rotation, angular, dt);
+                vec3_t linear;
+                vec3_rotate_by_quaternion(&linear, vec3_make(link->velocity[3], link->velocity[4], link->velocity[5]), link->rotation);
+                vec3_add_to(&link->translation, linear, dt);
+                break;
+            }
+        }
+    }
+
+    // outside forces are given in world space, so they need the links'
+    // new orientations for the next substep
+    articulation_update_transforms(articulation);
+    return true;
+}
+
+int articulation_step(articulation_t *articulation, phy_real_t dt, size_t substep_count) {
+    safe_assert(articulation != NULL, ARTICULATION_ERROR_PARAMS);
+    safe_assert(dt > 0 && substep_count > 0, ARTICULATION_ERROR_PARAMS);
+
+    int result = ARTICULATION_SUCCESS;
+    const phy_real_t substep_dt = dt / substep_count;
+    for (size_t substep = 0; substep < substep_count && result == ARTICULATION_SUCCESS; substep++) {
+        if (!articulation_substep(articulation, substep_dt)) {
+            result = ARTICULATION_ERROR_PARAMS;
+        }
+    }
+
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        vec3_clear(&articulation->links[i].net_force);
+        vec3_clear(&articulation->links[i].net_torque);
+    }
+    return result;
+}
+
+void articulation_update_transforms(articulation_t *articulation) {
+    safe_assert(articulation != NULL,);
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        articulation_link_t *link = &articulation->links[i];
+        vec3_t offset = link->joint_position;
+        vec3_add_to(&offset, link->translation, 1);
+        if (link->parent == ARTICULATION_NO_PARENT) {
+            link->world_position = offset;
+            link->world_rotation = link->rotation;
+            continue;
+        }
+        const articulation_link_t *parent = &articulation->links[link->parent];
+        // the parent's rotation is loaded once, for both the offset and the product
+        quaternion_a_t parent_rotation = vec4a_from_vec4(parent->world_rotation);
+        link->world_position = vec3_rotate_by_quaternion_a(offset, parent_rotation);
+        vec3_add_to(&link->world_position, parent->world_position, 1);
+        link->world_rotation = vec4a_to_vec4(quaternion_a_product(parent_rotation, vec4a_from_vec4(link->rotation)));
+    }
+}
+
+phy_real_t articulation_kinetic_energy(const articulation_t *articulation) {
+    safe_assert(articulation != NULL, 0);
+    articulation_compute_velocities(articulation);
+    phy_real_t energy = 0;
+    for (size_t i = 0; i < articulation->link_count; i++) {
+        const articulation_workspace_t *work = &articulation->workspace[i];
+        spatial_matrix_t inertia;
+        spatial_vector_t momentum;
+        articulation_link_inertia(inertia, &articulation->links[i]);
+        spatial_matrix_apply(momentum, inertia, work->velocity);
+        for (size_t r = 0; r < 6; r++) {
+            energy += 0.5 * work->velocity[r] * momentum[r];
+        }
+    }
+    return energy;
+}
+
+void articulation_destroy(articulation_t *articulation) {
+    if (articulation == NULL) {
+        return;
+    }
+    free(articulation->links);
+    free(articulation->workspace);
+    free(articulation);
+}
@@ -1,11 +1,11 @@
 #include "sim/body.h"
 
+#include <math.h>
 #include "common/defines.h"
-
-#define PHY_GRAVITATIONAL_CONSTANT 1 /* 6.67430E-11 */
+#include "common/vec4a.h"
 
 void body_make(body_t *body,
- vec3_t position, vec3_t rotation,
+ vec3_t position, quaternion_t rotation,
  vec3_t velocity, vec3_t angular_velocity,
  phy_real_t mass,
  phy_real_t static_friction, phy_real_t kinetic_friction)
@@ -13,14 +13,85 @@ void body_make(body_t *body,
     safe_assert(body != NULL,);
 
     body->position = position;
-    body->rotation = rotation;
+    body_set_rotation(body, rotation);
     body->velocity = velocity;
     body->angular_velocity = angular_velocity;
     body->mass = mass;
+    mat3x3_make_diagonal(body->inertia, vec3_make(mass, mass, mass));
+    mat3x3_make_diagonal(body->inverse_inertia, vec3_make(1.0/mass, 1.0/mass, 1.0/mass));
     body->static_friction = static_friction;
     body->kinetic_friction = kinetic_friction;
     vec3_clear(&body->net_force);
     vec3_clear(&body->net_torque);
+    body->flags = 0;
+}
+
+void body_set_rotation(body_t *body, quaternion_t rotation) {
+    safe_assert(body != NULL,);
+
+    vec4_unit(&rotation);
+    body->rotation = rotation;
+    body_update_rotation_matrix(body);
+}
+
+void body_update_rotation_matrix(body_t *body) {
+    safe_assert(body != NULL,);
+
+    mat3x3_from_quaternion(body->rotation_matrix, body->rotation);
+}
+
+bool body_set_inertia(body_t *body, mat3x3_t inertia) {
+    safe_assert(body != NULL, false);
+
+    if (!mat3x3_invert(body->inverse_inertia, inertia)) {
+        return false;
+    }
+    mat3x3_copy(body->inertia, inertia);
+    return true;
+}
+
+vec3_t phy_body_get_angular_acceleration(const body_t *body, vec3_t torque) {
+    safe_assert(body != NULL, VEC3_ZERO);
+
+    // I_world^-1 = R I^-1 R^T, so bring the torque into the body's frame,
+    // apply the inverse inertia there, then bring the result back out
+    vec3_t local, acceleration;
+    for (size_t row = 0; row < 3; row++) {
+        local.raw[row] = 0;
+        for (size_t column = 0; column < 3; column++) {
+            local.raw[row] += body->rotation_matrix[column][row] * torque.raw[column];
+        }
+    }
+    for (size_t row = 0; row < 3; row++) {
+        acceleration.raw[row] = 0;
+        for (size_t column = 0; column < 3; column++) {
+            acceleration.raw[row] += body->inverse_inertia[row][column] * local.raw[column];
+        }
+    }
+    for (size_t row = 0; row < 3; row++) {
+        local.raw[row] = 0;
+        for (size_t column = 0; column < 3; column++) {
+            local.raw[row] += body->rotation_matrix[row][column] * acceleration.raw[column];
+        }
+    }
+    return local;
+}
+
+void phy_body_integrate_rotation(body_t *body, vec3_t torque, phy_real_t dt) {
+    safe_assert(body != NULL,);
+
+    vec3_add_to(&body->angular_velocity, phy_body_get_angular_acceleration(body, torque), dt);
+
+    // turn by the angular velocity's magnitude around its direction.
+    // The angular velocity is in world space, so the turn comes first
+    phy_real_t speed = vec3_magnitude(body->angular_velocity);
+    if (speed * dt > 0) {
+        vec3_t axis = body->angular_velocity;
+        vec3_multiply_by(&axis, 1.0/speed);
+        quaternion_t turn = quaternion_make(axis.x, axis.y, axis.z, speed * dt);
+        body->rotation = vec4a_to_vec4(quaternion_a_product(vec4a_from_vec4(turn), vec4a_from_vec4(body->rotation)));
+    }
+    body_set_rotation(body, body->rotation);
 }
 
 void phy_body_add_force(body_t *body, vec3_t force) {
@@ -48,14 +119,17 @@ void phy_body_add_force_and_torque(body_t *body, vec3_t force, vec3_t applied_at
 }
 
 void phy_body_add_gravity_force(body_t *a, body_t *b) {
+    phy_body_add_gravity_force_periodic(a, b, NULL);
+}
+
+void phy_body_add_gravity_force_periodic(body_t *a, body_t *b, const periodic_box_t *box) {
     safe_assert(a != NULL && b != NULL,);
 
+    vec3_t force_a_b = periodic_box_get_displacement(box, a->position, b->position);
     phy_real_t gravity =
         (PHY_GRAVITATIONAL_CONSTANT * a->mass * b->mass) /
-        vec3_distance_sqr(a->position, b->position);
+        vec3_magnitude_sqr(force_a_b);
 
-    vec3_t force_a_b = b->position;
-    vec3_add_to(&force_a_b, a->position, -1.0);
     vec3_unit(&force_a_b);
     vec3_multiply_by(&force_a_b, gravity);
 
@@ -66,6 +140,30 @@ void phy_body_add_gravity_force(body_t *a, body_t *b) {
     phy_body_add_force(b, force_b_a);
 }
 
+void phy_body_add_pair_force(body_t *a, body_t *b, const pair_potential_t *potential) {
+    phy_body_add_pair_force_periodic(a, b, potential, NULL);
+}
+
+void phy_body_add_pair_force_periodic(body_t *a, body_t *b, const pair_potential_t *potential, const periodic_box_t *box) {
+    safe_assert(a != NULL && b != NULL && potential != NULL,);
+
+    vec3_t force_a_b = periodic_box_get_displacement(box, b->position, a->position);
+    phy_real_t distance_sqr = vec3_magnitude_sqr(force_a_b);
+    if (distance_sqr >= potential->cutoff * potential->cutoff || distance_sqr < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        return;
+    }
+
+    // the potential gives force over distance, so scaling the (unnormalized)
+    // offset gives the force without a square root
+    vec3_multiply_by(&force_a_b, potential->force(potential->params, distance_sqr));
+
+    vec3_t force_b_a = force_a_b;
+    vec3_multiply_by(&force_b_a, -1.0);
+
+    phy_body_add_force(a, force_a_b);
+    phy_body_add_force(b, force_b_a);
+}
+
 /**
  * Given a normal force by a on b,
  * adds collision-based forces to just a
@@ -196,7 +294,13 @@ void phy_body_step(body_t *body) {
     vec3_add_to(&body->velocity, body->net_force, 1.0/body->mass);
     vec3_clear(&body->net_force);
     vec3_add_to(&body->position, body->velocity, 1.0);
-    vec3_add_to(&body->angular_velocity, body->net_torque, 1.0/body->mass);
+    phy_body_integrate_rotation(body, body->net_torque, 1.0);
     vec3_clear(&body->net_torque);
-    vec3_add_to(&body->rotation, body->angular_velocity, 1.0);
+}
+
+void phy_body_step_periodic(body_t *body, const periodic_box_t *box) {
+    safe_assert(body != NULL && box != NULL,);
+
+    phy_body_step(body);
+    body->position = periodic_box_wrap(box, body->position);
 }
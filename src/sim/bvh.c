@@ -0,0 +1,365 @@
+#include "sim/bvh.h"
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <float.h>
+#include "common/math.h"
+#include "common/simd.h"
+
+/**
+ * The number of nodes a BVH starts out with room for
+ */
+#define BVH_DEFAULT_NODE_CAPACITY 8
+
+/**
+ * Everything needed to build a BVH that isn't part of the BVH itself
+ */
+struct BvhBuilder {
+    bvh_t *bvh;
+    const bbox_t *bounds;
+    vec3_t *centroids;
+};
+typedef struct BvhBuilder bvh_builder_t;
+
+/**
+ * Everything bvh_query_bbox() needs while visiting leaves
+ */
+struct BvhQuery {
+    uint32_t *items;
+    size_t max_items;
+    size_t found;
+};
+typedef struct BvhQuery bvh_query_t;
+
+/**
+ * Gets a new, empty node from the BVH, growing the node array if needed
+ * @return The index of the new node, or BVH_EMPTY on failure
+ */
+PRIVATE_FUNC uint32_t bvh_alloc_node(bvh_t *bvh) {
+    if (bvh->node_count >= bvh->node_capacity) {
+        size_t new_capacity = bvh->node_capacity * 2;
+        bvh_node_t *new_nodes = reallocarray(bvh->nodes, new_capacity, (sizeof *bvh->nodes));
+        if (new_nodes == NULL) {
+            return BVH_EMPTY;
+        }
+        bvh->nodes = new_nodes;
+        bvh->node_capacity = new_capacity;
+    }
+
+    bvh_node_t *node = &bvh->nodes[bvh->node_count];
+    for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+        // empty slots get inverted bounds so nothing ever overlaps them
+        node->min_x[slot] = node->min_y[slot] = node->min_z[slot] = FLT_MAX;
+        node->max_x[slot] = node->max_y[slot] = node->max_z[slot] = -FLT_MAX;
+        node->child[slot] = BVH_EMPTY;
+        node->item_count[slot] = 0;
+    }
+    return bvh->node_count++;
+}
+
+/**
+ * Expands a slot's bounds to cover a box
+ */
+PRIVATE_FUNC void bvh_node_expand_slot(bvh_node_t *node, size_t slot, vec3_t box_min, vec3_t box_max) {
+    node->min_x[slot] = min(node->min_x[slot], box_min.x);
+    node->min_y[slot] = min(node->min_y[slot], box_min.y);
+    node->min_z[slot] = min(node->min_z[slot], box_min.z);
+    node->max_x[slot] = max(node->max_x[slot], box_max.x);
+    node->max_y[slot] = max(node->max_y[slot], box_max.y);
+    node->max_z[slot] = max(node->max_z[slot], box_max.z);
+}
+
+/**
+ * Finds the axis along which a set of items' centroids are most spread out
+ */
+PRIVATE_FUNC size_t bvh_widest_axis(const bvh_builder_t *builder, const uint32_t *items, size_t count) {
+    vec3_t lowest = vec3_make(FLT_MAX, FLT_MAX, FLT_MAX);
+    vec3_t highest = vec3_make(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t i = 0; i < count; i++) {
+        vec3_t centroid = builder->centroids[items[i]];
+        for (size_t axis = 0; axis < 3; axis++) {
+            lowest.raw[axis] = min(lowest.raw[axis], centroid.raw[axis]);
+            highest.raw[axis] = max(highest.raw[axis], centroid.raw[axis]);
+        }
+    }
+
+    size_t widest = 0;
+    for (size_t axis = 1; axis < 3; axis++) {
+        if (highest.raw[axis] - lowest.raw[axis] > highest.raw[widest] - lowest.raw[widest]) {
+            widest = axis;
+        }
+    }
+    return widest;
+}
+
+/**
+ * Rearranges items so that the item with the nth-smallest centroid along
+ * the given axis is at index nth, with everything before it smaller and
+ * everything after it larger (quickselect)
+ */
+PRIVATE_FUNC void bvh_partition(const bvh_builder_t *builder, uint32_t *items, size_t count, size_t nth, size_t axis) {
+    size_t low = 0;
+    size_t high = count - 1;
+    while (low < high) {
+        phy_real_t pivot = builder->centroids[items[low + (high - low) / 2]].raw[axis];
+        size_t i = low;
+        size_t j = high;
+        while (i <= j) {
+            while (builder->centroids[items[i]].raw[axis] < pivot) {
+                i++;
+            }
+            while (builder->centroids[items[j]].raw[axis] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                uint32_t tmp = items[i];
+                items[i] = items[j];
+                items[j] = tmp;
+                i++;
+                if (j == 0) {
+                    break;
+                }
+                j--;
+            }
+        }
+        // only keep searching the side that contains nth
+        if (nth <= j) {
+            high = j;
+        }
+        else if (nth >= i) {
+            low = i;
+        }
+        else {
+            return;
+        }
+    }
+}
+
+/**
+ * Fills in a node's slots from a range of items, splitting the range in
+ * half twice to get one group per slot, then recursing into any group too
+ * big to be a leaf
+ */
+PRIVATE_FUNC int bvh_build_node(bvh_builder_t *builder, uint32_t node_index, size_t begin, size_t end) {
+    bvh_t *bvh = builder->bvh;
+    uint32_t *items = bvh->items;
+
+    // split into 4 groups: [begin, quarter), [quarter, middle), ...
+    size_t middle = begin + (end - begin) / 2;
+    if (end - begin > 1) {
+        bvh_partition(builder, items + begin, end - begin, middle - begin, bvh_widest_axis(builder, items + begin, end - begin));
+    }
+    size_t first_quarter = begin + (middle - begin) / 2;
+    if (middle - begin > 1) {
+        bvh_partition(builder, items + begin, middle - begin, first_quarter - begin, bvh_widest_axis(builder, items + begin, middle - begin));
+    }
+    size_t last_quarter = middle + (end - middle) / 2;
+    if (end - middle > 1) {
+        bvh_partition(builder, items + middle, end - middle, last_quarter - middle, bvh_widest_axis(builder, items + middle, end - middle));
+    }
+    size_t group_bounds[BVH_WIDTH + 1] = { begin, first_quarter, middle, last_quarter, end };
+
+    for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+        size_t group_begin = group_bounds[slot];
+        size_t group_end = group_bounds[slot + 1];
+        if (group_begin == group_end) {
+            continue;
+        }
+
+        for (size_t i = group_begin; i < group_end; i++) {
+            bbox_t item_bounds = builder->bounds[items[i]];
+            bvh_node_expand_slot(&bvh->nodes[node_index], slot, bbox_get_min(item_bounds), bbox_get_max(item_bounds));
+        }
+
+        if (group_end - group_begin <= BVH_LEAF_SIZE) {
+            bvh->nodes[node_index].child[slot] = group_begin;
+            bvh->nodes[node_index].item_count[slot] = group_end - group_begin;
+            continue;
+        }
+
+        // careful -- allocating can move the node array, so always
+        // go through the index
+        uint32_t child_index = bvh_alloc_node(bvh);
+        if (child_index == BVH_EMPTY) {
+            return BVH_ERROR_ALLOC;
+        }
+        bvh->nodes[node_index].child[slot] = child_index;
+        int result = bvh_build_node(builder, child_index, group_begin, group_end);
+        if (result != BVH_SUCCESS) {
+            return result;
+        }
+    }
+
+    return BVH_SUCCESS;
+}
+
+bvh_t *bvh_create(const bbox_t *bounds, size_t count) {
+    if (bounds == NULL && count > 0) {
+        return NULL;
+    }
+
+    bvh_t *bvh = calloc(1, (sizeof *bvh));
+    if (bvh == NULL) {
+        return NULL;
+    }
+    bvh->nodes = calloc(BVH_DEFAULT_NODE_CAPACITY, (sizeof *bvh->nodes));
+    bvh->node_capacity = BVH_DEFAULT_NODE_CAPACITY;
+    // allocate at least one item so that an empty tree still has an array
+    bvh->items = calloc(count > 0 ? count : 1, (sizeof *bvh->items));
+    bvh->item_count = count;
+    vec3_t *centroids = calloc(count > 0 ? count : 1, (sizeof *centroids));
+    if (bvh->nodes == NULL || bvh->items == NULL || centroids == NULL) {
+        free(centroids);
+        bvh_destroy(bvh);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        bvh->items[i] = i;
+        centroids[i] = bbox_get_min(bounds[i]);
+        vec3_add_to(&centroids[i], bbox_get_max(bounds[i]), 1);
+        vec3_multiply_by(&centroids[i], 0.5);
+    }
+
+    bvh_builder_t builder = {
+        .bvh = bvh,
+        .bounds = bounds,
+        .centroids = centroids,
+    };
+    uint32_t root = bvh_alloc_node(bvh);
+    int result = bvh_build_node(&builder, root, 0, count);
+    free(centroids);
+    if (result != BVH_SUCCESS) {
+        bvh_destroy(bvh);
+        return NULL;
+    }
+    return bvh;
+}
+
+void bvh_refit(bvh_t *bvh, const bbox_t *bounds) {
+    safe_assert(bvh != NULL && bounds != NULL,);
+
+    // every node comes before its children, so walking backwards
+    // guarantees children are refit before their parents
+    for (size_t node_index = bvh->node_count; node_index-- > 0;) {
+        bvh_node_t *node = &bvh->nodes[node_index];
+        for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+            if (node->child[slot] == BVH_EMPTY) {
+                continue;
+            }
+            node->min_x[slot] = node->min_y[slot] = node->min_z[slot] = FLT_MAX;
+            node->max_x[slot] = node->max_y[slot] = node->max_z[slot] = -FLT_MAX;
+
+            if (node->item_count[slot] > 0) {
+                for (size_t i = 0; i < node->item_count[slot]; i++) {
+                    bbox_t item_bounds = bounds[bvh->items[node->child[slot] + i]];
+                    bvh_node_expand_slot(node, slot, bbox_get_min(item_bounds), bbox_get_max(item_bounds));
+                }
+            }
+            else {
+                const bvh_node_t *child = &bvh->nodes[node->child[slot]];
+                for (size_t child_slot = 0; child_slot < BVH_WIDTH; child_slot++) {
+                    if (child->child[child_slot] == BVH_EMPTY) {
+                        continue;
+                    }
+                    bvh_node_expand_slot(node, slot,
+                        vec3_make(child->min_x[child_slot], child->min_y[child_slot], child->min_z[child_slot]),
+                        vec3_make(child->max_x[child_slot], child->max_y[child_slot], child->max_z[child_slot]));
+                }
+            }
+        }
+    }
+}
+
+void bvh_visit_bbox(const bvh_t *bvh, bbox_t box, bvh_leaf_visitor_t visit, void *context) {
+    safe_assert(bvh != NULL && visit != NULL,);
+
+    vec3_t box_min = bbox_get_min(box);
+    vec3_t box_max = bbox_get_max(box);
+
+    uint32_t stack[BVH_MAX_DEPTH * BVH_WIDTH];
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const bvh_node_t *node = &bvh->nodes[stack[--stack_size]];
+        // test all of the node's children at once
+        uint32_t overlapping = simd4f_overlap_mask(
+            simd4f_load(node->min_x), simd4f_load(node->min_y), simd4f_load(node->min_z),
+            simd4f_load(node->max_x), simd4f_load(node->max_y), simd4f_load(node->max_z),
+            box_min, box_max);
+        for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+            // empty slots are skipped explicitly, since a box spanning all
+            // of space would still overlap their inverted bounds
+            if ((overlapping & (1u << slot)) == 0 || node->child[slot] == BVH_EMPTY) {
+                continue;
+            }
+
+            if (node->item_count[slot] == 0) {
+                stack[stack_size++] = node->child[slot];
+            }
+            else {
+                visit(context, &bvh->items[node->child[slot]], node->item_count[slot]);
+            }
+        }
+    }
+}
+
+PRIVATE_FUNC void bvh_query_visit(void *context, const uint32_t *items, size_t item_count) {
+    bvh_query_t *query = context;
+    for (size_t i = 0; i < item_count; i++) {
+        if (query->found < query->max_items) {
+            query->items[query->found] = items[i];
+        }
+        query->found++;
+    }
+}
+
+size_t bvh_query_bbox(const bvh_t *bvh, bbox_t box, uint32_t *items, size_t max_items) {
+    safe_assert(bvh != NULL, 0);
+    safe_assert(items != NULL || max_items == 0, 0);
+
+    bvh_query_t query = {
+        .items = items,
+        .max_items = max_items,
+        .found = 0,
+    };
+    bvh_visit_bbox(bvh, box, bvh_query_visit, &query);
+    return query.found;
+}
+
+void bvh_get_bounds(const bvh_t *bvh, bbox_t *box) {
+    safe_assert(bvh != NULL && box != NULL,);
+
+    vec3_t box_min = vec3_make(FLT_MAX, FLT_MAX, FLT_MAX);
+    vec3_t box_max = vec3_make(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    const bvh_node_t *root = &bvh->nodes[0];
+    for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+        if (root->child[slot] == BVH_EMPTY) {
+            continue;
+        }
+        box_min.x = min(box_min.x, root->min_x[slot]);
+        box_min.y = min(box_min.y, root->min_y[slot]);
+        box_min.z = min(box_min.z, root->min_z[slot]);
+        box_max.x = max(box_max.x, root->max_x[slot]);
+        box_max.y = max(box_max.y, root->max_y[slot]);
+        box_max.z = max(box_max.z, root->max_z[slot]);
+    }
+
+    box->position = VEC3_ZERO;
+    box->left = box_min.x;
+    box->right = box_max.x;
+    box->bottom = box_min.y;
+    box->top = box_max.y;
+    box->back = box_min.z;
+    box->front = box_max.z;
+}
+
+void bvh_destroy(bvh_t *bvh) {
+    if (bvh == NULL) {
+        return;
+    }
+    free(bvh->nodes);
+    free(bvh->items);
+    free(bvh);
+}
@@ -0,0 +1,91 @@
+#include "sim/capsule.h"
+
+#include "common/defines.h"
+#include "common/math.h"
+
+bool ccapsule_is_point_inside(ccapsule_t capsule, vec3_t point) {
+    vec3_t closest = point;
+    segment_clamp_point(ccapsule_get_segment(capsule), &closest);
+    return vec3_distance_sqr(closest, point) <= capsule.radius * capsule.radius;
+}
+
+void ccapsule_clamp_point_within_capsule(ccapsule_t capsule, vec3_t *point) {
+    safe_assert(point != NULL,);
+
+    vec3_t closest = *point;
+    segment_clamp_point(ccapsule_get_segment(capsule), &closest);
+
+    phy_real_t distance = vec3_distance_to(closest, *point);
+    if (distance <= capsule.radius) {
+        return; // already inside
+    }
+
+    // pull the point back along the line to the segment until it
+    // touches the surface
+    vec3_t offset = *point;
+    vec3_add_to(&offset, closest, -1);
+    vec3_multiply_by(&offset, capsule.radius / distance);
+    *point = closest;
+    vec3_add_to(point, offset, 1);
+}
+
+bool ccapsule_is_csphere_inside(ccapsule_t capsule, csphere_t sphere) {
+    // a capsule is just a sphere swept along a segment, so we can
+    // test the sphere against the closest point on that segment
+    vec3_t closest = sphere.center;
+    segment_clamp_point(ccapsule_get_segment(capsule), &closest);
+    phy_real_t radii_sum = capsule.radius + sphere.radius;
+    return vec3_distance_sqr(closest, sphere.center) <= radii_sum * radii_sum;
+}
+
+bool ccapsule_is_ccapsule_inside(ccapsule_t a, ccapsule_t b) {
+    phy_real_t radii_sum = a.radius + b.radius;
+    return segment_closest_points_segment(
+        ccapsule_get_segment(a), ccapsule_get_segment(b), NULL, NULL
+    ) <= radii_sum * radii_sum;
+}
+
+bool ccapsule_is_bbox_inside(ccapsule_t capsule, bbox_t box) {
+    return segment_closest_points_bbox(
+        ccapsule_get_segment(capsule), box, NULL, NULL
+    ) <= capsule.radius * capsule.radius;
+}
+
+bool ccapsule_is_ccube_inside(ccapsule_t capsule, ccube_t cube) {
+    // move the capsule into the cube's model space, where the cube
+    // is an AABB centered at the origin
+    ccube_apply_cube_transformations(cube, &capsule.start);
+    ccube_apply_cube_transformations(cube, &capsule.end);
+
+    bbox_t cube_box = {
+        .position = VEC3_ZERO,
+        .left = -cube.width / 2,
+        .right = cube.width / 2,
+        .bottom = -cube.height / 2,
+        .top = cube.height / 2,
+        .back = -cube.length / 2,
+        .front = cube.length / 2,
+    };
+    return ccapsule_is_bbox_inside(capsule, cube_box);
+}
+
+void ccapsule_get_bounds(ccapsule_t capsule, bbox_t *box) {
+    safe_assert(box != NULL,);
+
+    box->position = VEC3_ZERO;
+    box->left = min(capsule.start.x, capsule.end.x) - capsule.radius;
+    box->right = max(capsule.start.x, capsule.end.x) + capsule.radius;
+    box->bottom = min(capsule.start.y, capsule.end.y) - capsule.radius;
+    box->top = max(capsule.start.y, capsule.end.y) + capsule.radius;
+    box->back = min(capsule.start.z, capsule.end.z) - capsule.radius;
+    box->front = max(capsule.start.z, capsule.end.z) + capsule.radius;
+}
+
+vec3_t ccapsule_get_surface_normal(ccapsule_t capsule, vec3_t point_on_surface) {
+    vec3_t normal = point_on_surface;
+    vec3_t closest = point_on_surface;
+    segment_clamp_point(ccapsule_get_segment(capsule), &closest);
+    vec3_add_to(&normal, closest, -1);
+    vec3_unit(&normal);
+    return normal;
+}
@@ -0,0 +1,303 @@
+#include "sim/ccd.h"
+
+#include <float.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+/**
+ * How far shapes are nudged when estimating the contact normal
+ */
+#define CCD_NORMAL_STEP 1e-3
+
+/**
+ * A box with any orientation, so bounding boxes and cubes
+ * can be handled the same way
+ */
+struct CcdBox {
+    vec3_t center;
+    vec3_t axes[3];
+    vec3_t half_extents;
+};
+typedef struct CcdBox ccd_box_t;
+
+PRIVATE_FUNC ccd_box_t ccd_box_from_collider(collider_t collider) {
+    ccd_box_t box;
+    box.center = collider_get_center(collider);
+    box.axes[0] = vec3_make(1, 0, 0);
+    box.axes[1] = vec3_make(0, 1, 0);
+    box.axes[2] = vec3_make(0, 0, 1);
+
+    if (collider.kind == COLLIDER_BBOX) {
+        box.half_extents = bbox_get_max(collider.bbox);
+        vec3_add_to(&box.half_extents, box.center, -1);
+        return box;
+    }
+
+    // a cube's axes are its model space axes, brought into world space
+    ccube_t unmoved = collider.cube;
+    unmoved.position = VEC3_ZERO;
+    for (size_t axis = 0; axis < 3; axis++) {
+        ccube_undo_cube_transformations(unmoved, &box.axes[axis]);
+    }
+    box.half_extents = vec3_make(collider.cube.width / 2, collider.cube.height / 2, collider.cube.length / 2);
+    return box;
+}
+
+/**
+ * Finds how far a box extends from its center along an axis
+ */
+PRIVATE_FUNC phy_real_t ccd_box_projected_radius(const ccd_box_t *box, vec3_t axis) {
+    return
+        box->half_extents.x * fabs(vec3_dot_product(box->axes[0], axis)) +
+        box->half_extents.y * fabs(vec3_dot_product(box->axes[1], axis)) +
+        box->half_extents.z * fabs(vec3_dot_product(box->axes[2], axis));
+}
+
+/**
+ * Finds the largest gap between two boxes along any of their
+ * separating axes.  The true distance is never smaller than this
+ */
+PRIVATE_FUNC phy_real_t ccd_box_separation(const ccd_box_t *a, const ccd_box_t *b) {
+    vec3_t between = b->center;
+    vec3_add_to(&between, a->center, -1);
+
+    vec3_t axes[15];
+    for (size_t i = 0; i < 3; i++) {
+        axes[i] = a->axes[i];
+        axes[3 + i] = b->axes[i];
+        for (size_t j = 0; j < 3; j++) {
+            vec3_cross_product(&axes[6 + i * 3 + j], a->axes[i], b->axes[j]);
+        }
+    }
+
+    phy_real_t separation = -FLT_MAX;
+    for (size_t i = 0; i < 15; i++) {
+        vec3_t axis = axes[i];
+        if (vec3_magnitude_sqr(axis) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+            continue; // parallel edges don't make a usable axis
+        }
+        vec3_unit(&axis);
+        phy_real_t gap =
+            fabs(vec3_dot_product(between, axis)) -
+            ccd_box_projected_radius(a, axis) -
+            ccd_box_projected_radius(b, axis);
+        separation = max(separation, gap);
+    }
+    return separation;
+}
+
+phy_real_t ccd_separation(collider_t a, collider_t b) {
+    // separation doesn't depend on order, so make sure a
+    // is always the 'smaller' kind of collider
+    if (a.kind > b.kind) {
+        collider_t tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    if (a.kind == COLLIDER_SPHERE) {
+        return collider_signed_distance(b, a.sphere.center) - a.sphere.radius;
+    }
+    if (b.kind == COLLIDER_SPHERE) {
+        return collider_signed_distance(a, b.sphere.center) - b.sphere.radius;
+    }
+
+    if (b.kind == COLLIDER_CAPSULE) {
+        ccapsule_t capsule = b.capsule;
+        switch (a.kind) {
+            case COLLIDER_BBOX:
+                return sqrt(segment_closest_points_bbox(ccapsule_get_segment(capsule), a.bbox, NULL, NULL)) - capsule.radius;
+            case COLLIDER_CUBE: {
+                // move the capsule into the cube's model space, where the
+                // cube is an AABB centered at the origin
+                ccube_apply_cube_transformations(a.cube, &capsule.start);
+                ccube_apply_cube_transformations(a.cube, &capsule.end);
+                bbox_t cube_box = {
+                    .position = VEC3_ZERO,
+                    .left = -a.cube.width / 2,
+                    .right = a.cube.width / 2,
+                    .bottom = -a.cube.height / 2,
+                    .top = a.cube.height / 2,
+                    .back = -a.cube.length / 2,
+                    .front = a.cube.length / 2,
+                };
+                return sqrt(segment_closest_points_bbox(ccapsule_get_segment(capsule), cube_box, NULL, NULL)) - capsule.radius;
+            }
+            case COLLIDER_CAPSULE:
+                return sqrt(segment_closest_points_segment(
+                    ccapsule_get_segment(a.capsule), ccapsule_get_segment(capsule), NULL, NULL
+                )) - a.capsule.radius - capsule.radius;
+            default:
+                abort();
+        }
+    }
+
+    // only boxes and cubes are left
+    ccd_box_t box_a = ccd_box_from_collider(a);
+    ccd_box_t box_b = ccd_box_from_collider(b);
+    return ccd_box_separation(&box_a, &box_b);
+}
+
+/**
+ * Estimates the direction a shape must move to get away from a target
+ * by nudging it along each axis and watching how the separation changes
+ */
+PRIVATE_FUNC vec3_t ccd_separation_normal(collider_t shape, collider_t target) {
+    vec3_t normal;
+    for (size_t axis = 0; axis < 3; axis++) {
+        vec3_t nudge = VEC3_ZERO;
+        nudge.raw[axis] = CCD_NORMAL_STEP;
+        collider_t forward = shape;
+        collider_translate(&forward, nudge);
+        vec3_multiply_by(&nudge, -1);
+        collider_t backward = shape;
+        collider_translate(&backward, nudge);
+        normal.raw[axis] = ccd_separation(target, forward) - ccd_separation(target, backward);
+    }
+
+    if (vec3_magnitude_sqr(normal) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        // perfectly balanced (e.g. centers lined up inside each other);
+        // fall back to pushing the shapes' centers apart
+        normal = collider_get_center(shape);
+        vec3_add_to(&normal, collider_get_center(target), -1);
+        if (vec3_magnitude_sqr(normal) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+            return VEC3_ZERO;
+        }
+    }
+    vec3_unit(&normal);
+    return normal;
+}
+
+bool ccd_cast_collider(collider_t shape, vec3_t displacement, collider_t target, phy_real_t *toi, contact_t *contact) {
+    // conservative advancement: the separation never overestimates the
+    // distance, and the gap closes no faster than the shape moves along
+    // the separating direction, so advancing by the separation over that
+    // closing speed can never skip past the first contact
+    // running out of iterations still leaves every t reached before the
+    // contact, so the shape is stopped there rather than let through
+    phy_real_t t = 0;
+    collider_t moved = shape;
+    for (size_t i = 0; i < CCD_MAX_ITERATIONS; i++) {
+        phy_real_t separation = ccd_separation(target, moved);
+        if (separation <= CCD_TOLERANCE) {
+            break;
+        }
+        vec3_t normal = ccd_separation_normal(moved, target);
+        phy_real_t closing_speed = -vec3_dot_product(displacement, normal);
+        if (closing_speed < PHYSICS_EPSILON) {
+            return false; // not moving toward the target
+        }
+        t += separation / closing_speed;
+        if (t > 1) {
+            return false;
+        }
+        moved = shape;
+        vec3_t offset = displacement;
+        vec3_multiply_by(&offset, t);
+        collider_translate(&moved, offset);
+    }
+    // touching shapes that are already moving apart aren't a hit; since
+    // both shapes are convex, they won't get any closer later either
+    vec3_t normal = ccd_separation_normal(moved, target);
+    if (vec3_dot_product(normal, displacement) >= 0) {
+        return false;
+    }
+
+    if (toi != NULL) {
+        *toi = t;
+    }
+    if (contact != NULL) {
+        vec3_t against_normal = normal;
+        vec3_multiply_by(&against_normal, -1);
+        *contact = contact_make(
+            collider_get_support_point(moved, against_normal),
+            normal,
+            max(-ccd_separation(target, moved), 0)
+        );
+    }
+    return true;
+}
+
+/**
+ * Calculates the AABB covering a shape over its whole sweep
+ */
+PRIVATE_FUNC void ccd_get_swept_bounds(collider_t shape, vec3_t displacement, bbox_t *box) {
+    bbox_t start_bounds, end_bounds;
+    collider_get_bounds(shape, &start_bounds);
+    collider_translate(&shape, displacement);
+    collider_get_bounds(shape, &end_bounds);
+
+    vec3_t start_min = bbox_get_min(start_bounds);
+    vec3_t start_max = bbox_get_max(start_bounds);
+    vec3_t end_min = bbox_get_min(end_bounds);
+    vec3_t end_max = bbox_get_max(end_bounds);
+    box->position = VEC3_ZERO;
+    box->left = min(start_min.x, end_min.x);
+    box->right = max(start_max.x, end_max.x);
+    box->bottom = min(start_min.y, end_min.y);
+    box->top = max(start_max.y, end_max.y);
+    box->back = min(start_min.z, end_min.z);
+    box->front = max(start_max.z, end_max.z);
+}
+
+bool ccd_cast_colliders(collider_t shape, vec3_t displacement, const collider_t *targets, size_t target_count,
+    phy_real_t *toi, size_t *hit_target, contact_t *contact)
+{
+    safe_assert(targets != NULL || target_count == 0, false);
+
+    bbox_t swept_bounds;
+    ccd_get_swept_bounds(shape, displacement, &swept_bounds);
+
+    bool hit = false;
+    phy_real_t earliest = 1;
+    for (size_t i = 0; i < target_count; i++) {
+        // targets nowhere near the path can be skipped entirely
+        bbox_t target_bounds;
+        collider_get_bounds(targets[i], &target_bounds);
+        if (!bbox_is_bbox_inside(swept_bounds, target_bounds)) {
+            continue;
+        }
+
+        phy_real_t target_toi;
+        contact_t target_contact;
+        if (!ccd_cast_collider(shape, displacement, targets[i], &target_toi, &target_contact) || (hit && target_toi >= earliest)) {
+            continue;
+        }
+        hit = true;
+        earliest = target_toi;
+        if (hit_target != NULL) {
+            *hit_target = i;
+        }
+        if (contact != NULL) {
+            *contact = target_contact;
+        }
+    }
+
+    if (hit && toi != NULL) {
+        *toi = earliest;
+    }
+    return hit;
+}
+
+bool phy_body_step_continuous(body_t *body, collider_t *shape, const collider_t *obstacles, size_t obstacle_count, contact_t *contact) {
+    safe_assert(body != NULL && shape != NULL, false);
+
+    vec3_t start = body->position;
+    phy_body_step(body);
+    vec3_t displacement = body->position;
+    vec3_add_to(&displacement, start, -1);
+
+    phy_real_t toi;
+    if ((body->flags & BODY_FLAG_CONTINUOUS) &&
+        ccd_cast_colliders(*shape, displacement, obstacles, obstacle_count, &toi, NULL, contact)) {
+        // stop the body where it first touches the obstacle
+        vec3_multiply_by(&displacement, toi);
+        body->position = start;
+        vec3_add_to(&body->position, displacement, 1);
+        collider_translate(shape, displacement);
+        return true;
+    }
+
+    collider_translate(shape, displacement);
+    return false;
+}
@@ -0,0 +1,320 @@
+#include "sim/collider.h"
+
+#include "common/defines.h"
+#include "common/mat3x3.h"
+#include "common/math.h"
+
+bool collider_is_point_inside(collider_t collider, vec3_t point) {
+    switch (collider.kind) {
+        case COLLIDER_BBOX:
+            return bbox_is_point_inside(collider.bbox, point);
+        case COLLIDER_SPHERE:
+            return csphere_is_point_inside(collider.sphere, point);
+        case COLLIDER_CUBE:
+            return ccube_is_point_inside(collider.cube, point);
+        case COLLIDER_CAPSULE:
+            return ccapsule_is_point_inside(collider.capsule, point);
+        default:
+            abort();
+    }
+}
+
+bool collider_is_collider_inside(collider_t a, collider_t b) {
+    // every pair only needs to be implemented once, so make sure a
+    // is always the 'smaller' kind of collider
+    if (a.kind > b.kind) {
+        collider_t tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    switch (a.kind) {
+        case COLLIDER_BBOX:
+            switch (b.kind) {
+                case COLLIDER_BBOX:
+                    return bbox_is_bbox_inside(a.bbox, b.bbox);
+                case COLLIDER_SPHERE:
+                    return csphere_is_bbox_inside(b.sphere, a.bbox);
+                case COLLIDER_CUBE:
+                    return ccube_is_bbox_inside(b.cube, a.bbox);
+                case COLLIDER_CAPSULE:
+                    return ccapsule_is_bbox_inside(b.capsule, a.bbox);
+                default:
+                    abort();
+            }
+        case COLLIDER_SPHERE:
+            switch (b.kind) {
+                case COLLIDER_SPHERE:
+                    return csphere_is_csphere_inside(a.sphere, b.sphere);
+                case COLLIDER_CUBE:
+                    return ccube_is_sphere_inside(b.cube, a.sphere);
+                case COLLIDER_CAPSULE:
+                    return ccapsule_is_csphere_inside(b.capsule, a.sphere);
+                default:
+                    abort();
+            }
+        case COLLIDER_CUBE:
+            switch (b.kind) {
+                case COLLIDER_CUBE:
+                    return ccube_is_ccube_inside(a.cube, b.cube);
+                case COLLIDER_CAPSULE:
+                    return ccapsule_is_ccube_inside(b.capsule, a.cube);
+                default:
+                    abort();
+            }
+        case COLLIDER_CAPSULE:
+            return ccapsule_is_ccapsule_inside(a.capsule, b.capsule);
+        default:
+            abort();
+    }
+}
+
+/**
+ * Makes a bounding box out of a center and how far the box extends
+ * from that center along each axis
+ */
+PRIVATE_FUNC void collider_make_bounds(bbox_t *box, vec3_t center, vec3_t half_extents) {
+    box->position = center;
+    box->left = -half_extents.x;
+    box->right = half_extents.x;
+    box->bottom = -half_extents.y;
+    box->top = half_extents.y;
+    box->back = -half_extents.z;
+    box->front = half_extents.z;
+}
+
+/**
+ * Finds how far a rotated box extends along each world axis, given
+ * how far it extends along each of its own axes
+ */
+PRIVATE_FUNC vec3_t collider_rotate_half_extents(vec3_t half_extents, mat3x3_t matrix) {
+    // each of the box's axes, rotated, is a column of the rotation matrix
+    vec3_t result = VEC3_ZERO;
+    for (size_t axis = 0; axis < 3; axis++) {
+        for (size_t column = 0; column < 3; column++) {
+            result.raw[axis] += fabs(matrix[axis][column]) * half_extents.raw[column];
+        }
+    }
+    return result;
+}
+
+void collider_get_bounds(collider_t collider, bbox_t *box) {
+    safe_assert(box != NULL,);
+
+    switch (collider.kind) {
+        case COLLIDER_BBOX:
+            *box = collider.bbox;
+            break;
+        case COLLIDER_SPHERE: {
+            phy_real_t radius = collider.sphere.radius;
+            collider_make_bounds(box, collider.sphere.center, vec3_make(radius, radius, radius));
+            break;
+        }
+        case COLLIDER_CUBE: {
+            // a cube's rotation matrix takes its axes into world space
+            vec3_t half_extents = vec3_make(
+                collider.cube.width / 2,
+                collider.cube.height / 2,
+                collider.cube.length / 2
+            );
+            collider_make_bounds(box, collider.cube.position, collider_rotate_half_extents(half_extents, collider.cube.rotation_matrix));
+            break;
+        }
+        case COLLIDER_CAPSULE:
+            ccapsule_get_bounds(collider.capsule, box);
+            break;
+        default:
+            abort();
+    }
+}
+
+/**
+ * Moves a single point from local space into world space
+ */
+PRIVATE_FUNC void collider_transform_point(vec3_t *point, vec3_t position, quaternion_t rotation) {
+    vec3_rotate_by_quaternion(point, *point, rotation);
+    vec3_add_to(point, position, 1);
+}
+
+void collider_transform(collider_t *collider, vec3_t position, quaternion_t rotation) {
+    safe_assert(collider != NULL,);
+
+    switch (collider->kind) {
+        case COLLIDER_BBOX: {
+            // turn the box into a cube so it can be rotated
+            bbox_t box = collider->bbox;
+            vec3_t box_min = bbox_get_min(box);
+            vec3_t box_max = bbox_get_max(box);
+            vec3_t center = box_min;
+            vec3_add_to(&center, box_max, 1);
+            vec3_multiply_by(&center, 0.5);
+            *collider = collider_from_cube(ccube_make(
+                center, QUATERNION_NOROTATION,
+                box_max.z - box_min.z, box_max.x - box_min.x, box_max.y - box_min.y
+            ));
+        }
+        // fall through -- the box is now a cube
+        case COLLIDER_CUBE: {
+            collider_transform_point(&collider->cube.position, position, rotation);
+            // the cube's rotation goes from world space into model space,
+            // so undo the new rotation before applying the cube's own
+            quaternion_t inverse = quaternion_unit_inverse(rotation);
+            quaternion_t cube_rotation;
+            quaternion_product(&cube_rotation, collider->cube.rotation, inverse);
+            ccube_set_rotation(&collider->cube, cube_rotation);
+            break;
+        }
+        case COLLIDER_SPHERE:
+            collider_transform_point(&collider->sphere.center, position, rotation);
+            break;
+        case COLLIDER_CAPSULE:
+            collider_transform_point(&collider->capsule.start, position, rotation);
+            collider_transform_point(&collider->capsule.end, position, rotation);
+            break;
+        default:
+            abort();
+    }
+}
+
+vec3_t collider_get_center(collider_t collider) {
+    switch (collider.kind) {
+        case COLLIDER_BBOX: {
+            vec3_t center = bbox_get_min(collider.bbox);
+            vec3_add_to(&center, bbox_get_max(collider.bbox), 1);
+            vec3_multiply_by(&center, 0.5);
+            return center;
+        }
+        case COLLIDER_SPHERE:
+            return collider.sphere.center;
+        case COLLIDER_CUBE:
+            return collider.cube.position;
+        case COLLIDER_CAPSULE: {
+            vec3_t center = collider.capsule.start;
+            vec3_add_to(&center, collider.capsule.end, 1);
+            vec3_multiply_by(&center, 0.5);
+            return center;
+        }
+        default:
+            abort();
+    }
+}
+
+/**
+ * Finds the signed distance from a point to a box centered at the origin
+ */
+PRIVATE_FUNC phy_real_t collider_centered_box_distance(vec3_t point, vec3_t half_extents) {
+    // how far outside each pair of faces the point is
+    vec3_t outside = vec3_make(
+        fabs(point.x) - half_extents.x,
+        fabs(point.y) - half_extents.y,
+        fabs(point.z) - half_extents.z
+    );
+    vec3_t clamped_outside = vec3_make(max(outside.x, 0), max(outside.y, 0), max(outside.z, 0));
+    // inside the box, the distance is to the nearest face
+    phy_real_t inside = min(max(outside.x, max(outside.y, outside.z)), 0);
+    return vec3_magnitude(clamped_outside) + inside;
+}
+
+phy_real_t collider_signed_distance(collider_t collider, vec3_t point) {
+    switch (collider.kind) {
+        case COLLIDER_BBOX: {
+            vec3_t center = collider_get_center(collider);
+            vec3_t half_extents = bbox_get_max(collider.bbox);
+            vec3_add_to(&half_extents, center, -1);
+            vec3_add_to(&point, center, -1);
+            return collider_centered_box_distance(point, half_extents);
+        }
+        case COLLIDER_SPHERE:
+            return vec3_distance_to(collider.sphere.center, point) - collider.sphere.radius;
+        case COLLIDER_CUBE:
+            ccube_apply_cube_transformations(collider.cube, &point);
+            return collider_centered_box_distance(point, vec3_make(
+                collider.cube.width / 2, collider.cube.height / 2, collider.cube.length / 2
+            ));
+        case COLLIDER_CAPSULE: {
+            vec3_t closest = point;
+            segment_clamp_point(ccapsule_get_segment(collider.capsule), &closest);
+            return vec3_distance_to(closest, point) - collider.capsule.radius;
+        }
+        default:
+            abort();
+    }
+}
+
+void collider_translate(collider_t *collider, vec3_t offset) {
+    safe_assert(collider != NULL,);
+
+    switch (collider->kind) {
+        case COLLIDER_BBOX:
+            vec3_add_to(&collider->bbox.position, offset, 1);
+            break;
+        case COLLIDER_SPHERE:
+            vec3_add_to(&collider->sphere.center, offset, 1);
+            break;
+        case COLLIDER_CUBE:
+            vec3_add_to(&collider->cube.position, offset, 1);
+            break;
+        case COLLIDER_CAPSULE:
+            vec3_add_to(&collider->capsule.start, offset, 1);
+            vec3_add_to(&collider->capsule.end, offset, 1);
+            break;
+        default:
+            abort();
+    }
+}
+
+/**
+ * Gets the corner of a box centered at the origin furthest in a given direction
+ */
+PRIVATE_FUNC vec3_t collider_centered_box_support(vec3_t half_extents, vec3_t direction) {
+    return vec3_make(
+        direction.x >= 0 ? half_extents.x : -half_extents.x,
+        direction.y >= 0 ? half_extents.y : -half_extents.y,
+        direction.z >= 0 ? half_extents.z : -half_extents.z
+    );
+}
+
+vec3_t collider_get_support_point(collider_t collider, vec3_t direction) {
+    switch (collider.kind) {
+        case COLLIDER_BBOX: {
+            vec3_t box_min = bbox_get_min(collider.bbox);
+            vec3_t box_max = bbox_get_max(collider.bbox);
+            return vec3_make(
+                direction.x >= 0 ? box_max.x : box_min.x,
+                direction.y >= 0 ? box_max.y : box_min.y,
+                direction.z >= 0 ? box_max.z : box_min.z
+            );
+        }
+        case COLLIDER_SPHERE: {
+            vec3_t support = collider.sphere.center;
+            if (vec3_magnitude_sqr(direction) > PHYSICS_EPSILON * PHYSICS_EPSILON) {
+                vec3_unit(&direction);
+                vec3_add_to(&support, direction, collider.sphere.radius);
+            }
+            return support;
+        }
+        case COLLIDER_CUBE: {
+            // find the corner in model space, then bring it back
+            ccube_t unmoved = collider.cube;
+            unmoved.position = VEC3_ZERO;
+            ccube_apply_cube_transformations(unmoved, &direction);
+            vec3_t support = collider_centered_box_support(vec3_make(
+                collider.cube.width / 2, collider.cube.height / 2, collider.cube.length / 2
+            ), direction);
+            ccube_undo_cube_transformations(collider.cube, &support);
+            return support;
+        }
+        case COLLIDER_CAPSULE: {
+            vec3_t support = vec3_dot_product(collider.capsule.start, direction) >= vec3_dot_product(collider.capsule.end, direction)
+                ? collider.capsule.start
+                : collider.capsule.end;
+            if (vec3_magnitude_sqr(direction) > PHYSICS_EPSILON * PHYSICS_EPSILON) {
+                vec3_unit(&direction);
+                vec3_add_to(&support, direction, collider.capsule.radius);
+            }
+            return support;
+        }
+        default:
+            abort();
+    }
+}
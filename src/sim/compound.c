@@ -0,0 +1,210 @@
+#include "sim/compound.h"
+
+#include <stdlib.h>
+#include <malloc.h>
+#include "common/defines.h"
+
+/**
+ * How many candidate children a query collects on the stack before
+ * giving up and checking every child instead
+ */
+#define COMPOUND_QUERY_BUFFER_SIZE 64
+
+compound_t *compound_create(size_t initial_capacity) {
+    if (initial_capacity == 0) {
+        initial_capacity = 1;
+    }
+
+    compound_t *compound = calloc(1, (sizeof *compound));
+    if (compound == NULL) {
+        return NULL;
+    }
+    compound->local_children = calloc(initial_capacity, (sizeof *compound->local_children));
+    compound->world_children = calloc(initial_capacity, (sizeof *compound->world_children));
+    if (compound->local_children == NULL || compound->world_children == NULL) {
+        compound_destroy(compound);
+        return NULL;
+    }
+    compound->child_count = 0;
+    compound->child_capacity = initial_capacity;
+    compound->bvh = NULL;
+    compound->position = VEC3_ZERO;
+    compound->rotation = QUATERNION_NOROTATION;
+
+    return compound;
+}
+
+int compound_add_child(compound_t *compound, collider_t shape, vec3_t local_position, quaternion_t local_rotation) {
+    safe_assert(compound != NULL, COMPOUND_ERROR_PARAMS);
+
+    if (compound->child_count >= compound->child_capacity) {
+        size_t new_capacity = compound->child_capacity * 2;
+        collider_t *local_children = reallocarray(compound->local_children, new_capacity, (sizeof *local_children));
+        if (local_children == NULL) {
+            return COMPOUND_ERROR_ALLOC;
+        }
+        compound->local_children = local_children;
+        collider_t *world_children = reallocarray(compound->world_children, new_capacity, (sizeof *world_children));
+        if (world_children == NULL) {
+            return COMPOUND_ERROR_ALLOC;
+        }
+        compound->world_children = world_children;
+        compound->child_capacity = new_capacity;
+    }
+
+    collider_transform(&shape, local_position, local_rotation);
+    compound->local_children[compound->child_count] = shape;
+    compound->world_children[compound->child_count] = shape;
+    collider_transform(&compound->world_children[compound->child_count], compound->position, compound->rotation);
+    compound->child_count++;
+
+    // the old tree doesn't know about this child
+    bvh_destroy(compound->bvh);
+    compound->bvh = NULL;
+
+    return COMPOUND_SUCCESS;
+}
+
+int compound_build(compound_t *compound) {
+    safe_assert(compound != NULL, COMPOUND_ERROR_PARAMS);
+
+    bbox_t *bounds = calloc(compound->child_count > 0 ? compound->child_count : 1, (sizeof *bounds));
+    if (bounds == NULL) {
+        return COMPOUND_ERROR_ALLOC;
+    }
+    for (size_t i = 0; i < compound->child_count; i++) {
+        collider_get_bounds(compound->local_children[i], &bounds[i]);
+    }
+
+    bvh_destroy(compound->bvh);
+    compound->bvh = bvh_create(bounds, compound->child_count);
+    free(bounds);
+    if (compound->bvh == NULL) {
+        return COMPOUND_ERROR_ALLOC;
+    }
+    return COMPOUND_SUCCESS;
+}
+
+void compound_set_transform(compound_t *compound, vec3_t position, quaternion_t rotation) {
+    safe_assert(compound != NULL,);
+
+    compound->position = position;
+    compound->rotation = rotation;
+    for (size_t i = 0; i < compound->child_count; i++) {
+        compound->world_children[i] = compound->local_children[i];
+        collider_transform(&compound->world_children[i], position, rotation);
+    }
+}
+
+void compound_set_transform_from_body(compound_t *compound, const body_t *body) {
+    safe_assert(compound != NULL && body != NULL,);
+
+    compound_set_transform(compound, body->position, body->rotation);
+}
+
+/**
+ * Finds the bounds of a box after it has been moved by the given transform
+ */
+PRIVATE_FUNC void compound_transform_bounds(bbox_t *box, vec3_t position, quaternion_t rotation) {
+    // treat the box as a collider so that we can reuse the
+    // collider's transform and bounds logic
+    collider_t as_collider = collider_from_bbox(*box);
+    collider_transform(&as_collider, position, rotation);
+    collider_get_bounds(as_collider, box);
+}
+
+/**
+ * Finds the bounds of a world-space box in the compound's model space
+ */
+PRIVATE_FUNC void compound_bounds_to_local(const compound_t *compound, bbox_t *box) {
+    // local = inverse(rotation) * (world - position)
+    quaternion_t inverse = quaternion_unit_inverse(compound->rotation);
+    vec3_t offset;
+    vec3_rotate_by_quaternion(&offset, compound->position, inverse);
+    vec3_multiply_by(&offset, -1);
+    compound_transform_bounds(box, offset, inverse);
+}
+
+void compound_get_bounds(const compound_t *compound, bbox_t *box) {
+    safe_assert(compound != NULL && compound->bvh != NULL && box != NULL,);
+
+    bvh_get_bounds(compound->bvh, box);
+    compound_transform_bounds(box, compound->position, compound->rotation);
+}
+
+size_t compound_query_bbox(const compound_t *compound, bbox_t box, uint32_t *children, size_t max_children) {
+    safe_assert(compound != NULL && compound->bvh != NULL, 0);
+
+    compound_bounds_to_local(compound, &box);
+    return bvh_query_bbox(compound->bvh, box, children, max_children);
+}
+
+bool compound_is_collider_inside(const compound_t *compound, collider_t other, size_t *hit_child) {
+    safe_assert(compound != NULL && compound->bvh != NULL, false);
+
+    bbox_t other_bounds;
+    collider_get_bounds(other, &other_bounds);
+
+    uint32_t candidates[COMPOUND_QUERY_BUFFER_SIZE];
+    size_t candidate_count = compound_query_bbox(compound, other_bounds, candidates, COMPOUND_QUERY_BUFFER_SIZE);
+
+    if (candidate_count > COMPOUND_QUERY_BUFFER_SIZE) {
+        // too many candidates to hold onto; just check everything
+        for (size_t i = 0; i < compound->child_count; i++) {
+            if (collider_is_collider_inside(compound->world_children[i], other)) {
+                if (hit_child != NULL) {
+                    *hit_child = i;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // only the children whose bounds overlap need the real check
+    for (size_t i = 0; i < candidate_count; i++) {
+        if (collider_is_collider_inside(compound->world_children[candidates[i]], other)) {
+            if (hit_child != NULL) {
+                *hit_child = candidates[i];
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool compound_is_compound_inside(const compound_t *a, const compound_t *b, size_t *hit_a, size_t *hit_b) {
+    safe_assert(a != NULL && b != NULL && a->bvh != NULL && b->bvh != NULL, false);
+
+    // only children of a that overlap b's bounds could possibly hit b
+    bbox_t b_bounds;
+    compound_get_bounds(b, &b_bounds);
+
+    uint32_t candidates[COMPOUND_QUERY_BUFFER_SIZE];
+    size_t candidate_count = compound_query_bbox(a, b_bounds, candidates, COMPOUND_QUERY_BUFFER_SIZE);
+    bool check_everything = candidate_count > COMPOUND_QUERY_BUFFER_SIZE;
+    if (check_everything) {
+        candidate_count = a->child_count;
+    }
+
+    for (size_t i = 0; i < candidate_count; i++) {
+        size_t a_child = check_everything ? i : candidates[i];
+        if (compound_is_collider_inside(b, a->world_children[a_child], hit_b)) {
+            if (hit_a != NULL) {
+                *hit_a = a_child;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void compound_destroy(compound_t *compound) {
+    if (compound == NULL) {
+        return;
+    }
+    bvh_destroy(compound->bvh);
+    free(compound->local_children);
+    free(compound->world_children);
+    free(compound);
+}
@@ -14,13 +14,18 @@ void spring_create(spring_t *spring, body_t *a, vec3_t a_endpoint, body_t *b, ve
 }
 
 void spring_apply_constraint(spring_t spring) {
+    spring_apply_constraint_periodic(spring, NULL);
+}
+
+void spring_apply_constraint_periodic(spring_t spring, const periodic_box_t *box) {
     safe_assert(spring.a != NULL && spring.b != NULL,);
 
     // get the spring force on a, then negate to apply to b
-    vec3_t spring_force_on_a = spring.b->position;
-    vec3_add_to(&spring_force_on_a, spring.b_endpoint, 1);
-    vec3_add_to(&spring_force_on_a, spring.a->position, -1);
-    vec3_add_to(&spring_force_on_a, spring.a_endpoint, -1);
+    vec3_t a_endpoint = spring.a->position;
+    vec3_add_to(&a_endpoint, spring.a_endpoint, 1);
+    vec3_t b_endpoint = spring.b->position;
+    vec3_add_to(&b_endpoint, spring.b_endpoint, 1);
+    vec3_t spring_force_on_a = periodic_box_get_displacement(box, a_endpoint, b_endpoint);
 
     // right now, spring_force_on_a stores the distance between the two
     // endpoints, so we can use its current magnitude to calculate the
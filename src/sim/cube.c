@@ -1,30 +1,46 @@
 #include "sim/cube.h"
 
+#include <stdatomic.h>
 #include "common/defines.h"
 #include "common/math.h"
+#include "common/mat3x3.h"
 
+#ifdef USE_CUBE_STATS
+static _Atomic uint64_t test_count = 0;
+static _Atomic uint64_t early_rejection_count = 0;
 /**
- * Given a vector in world space, translates and rotates it
- * so that it is in the cube's model space.
- * Allows the point to treat the cube like an AABB centered at
- * the origin.
+ * Bumps one of the counters above.  Relaxed, since they're only ever read as totals
  */
-PRIVATE_FUNC void ccube_apply_cube_transformations(ccube_t cube, vec3_t *point) {
+#define ccube_count(counter) atomic_fetch_add_explicit(&(counter), 1, memory_order_relaxed)
+#else
+#define ccube_count(counter) ((void)0)
+#endif
+
+/**
+ * [internal] checks if a cube's bounding sphere is too far from a point
+ * for anything within radius of it to touch the cube.  Counts the test
+ */
+PRIVATE_FUNC bool ccube_is_out_of_reach(ccube_t cube, vec3_t point, phy_real_t radius) {
+    ccube_count(test_count);
+    // the epsilon keeps rounding from rejecting a point exactly on a corner
+    phy_real_t reach = ccube_get_bounding_radius(cube) + radius + PHYSICS_EPSILON;
+    if (vec3_distance_sqr(cube.position, point) > reach * reach) {
+        ccube_count(early_rejection_count);
+        return true;
+    }
+    return false;
+}
+
+void ccube_apply_cube_transformations(ccube_t cube, vec3_t *point) {
     // transform point so that it's relative to cube position
     vec3_add_to(point, cube.position, -1);
     // now that it's relative to the cube, we can rotate it
-    vec3_rotate_by_quaternion(point, *point, cube.rotation);
+    *point = mat3x3_transpose_times_vec3(cube.rotation_matrix, *point);
 }
 
-/**
- * Given a vector in the cube's model space, translates and rotates it
- * so that it is in world space.
- */
-PRIVATE_FUNC void ccube_undo_cube_transformations(ccube_t cube, vec3_t *point) {
+void ccube_undo_cube_transformations(ccube_t cube, vec3_t *point) {
     // undo rotation first
-    quaternion_t inverse = cube.rotation;
-    quaternion_conjugate(&inverse); // take the inverse to cancel out the cube's rotation
-    vec3_rotate_by_quaternion(point, *point, inverse);
+    *point = mat3x3_times_vec3(cube.rotation_matrix, *point);
 
     // next, undo transformation
     vec3_add_to(point, cube.position, 1);
@@ -43,26 +59,41 @@ bool ccube_is_point_inside(ccube_t cube, vec3_t point) {
         fabs(point.z) <= halflength;
 }
 
-void ccube_clamp_point_within_cube(ccube_t cube, vec3_t *point) {
-    ccube_apply_cube_transformations(cube, point);
+/**
+ * Clamps a point that is already in a cube's model space
+ */
+PRIVATE_FUNC void ccube_clamp_model_point(ccube_t cube, vec3_t *point) {
     phy_real_t halflength = cube.length / 2;
     phy_real_t halfwidth = cube.width / 2;
     phy_real_t halfheight = cube.height / 2;
     point->x = clamp(point->x, -halfwidth, halfwidth);
     point->y = clamp(point->y, -halfheight, halfheight);
     point->z = clamp(point->z, -halflength, halflength);
-    ccube_undo_cube_transformations(cube, point);
+}
+
+void ccube_clamp_point_within_cube(ccube_t cube, vec3_t *point) {
+    vec3_add_to(point, cube.position, -1);
+    *point = mat3x3_transpose_times_vec3(cube.rotation_matrix, *point);
+    ccube_clamp_model_point(cube, point);
+    *point = mat3x3_times_vec3(cube.rotation_matrix, *point);
+    vec3_add_to(point, cube.position, 1);
 }
 
 bool ccube_is_bbox_inside(ccube_t cube, bbox_t box) {
     // check if the closest point on the AABB is inside the cube
     vec3_t closest_to_cube_center = cube.position;
     bbox_clamp_point_within_bounds(box, &closest_to_cube_center);
+    if (ccube_is_out_of_reach(cube, closest_to_cube_center, 0)) {
+        return false;
+    }
     return ccube_is_point_inside(cube, closest_to_cube_center);
 }
 
 
 bool ccube_is_sphere_inside(ccube_t cube, csphere_t sphere) {
+    if (ccube_is_out_of_reach(cube, sphere.center, sphere.radius)) {
+        return false;
+    }
     // check if the point on the sphere closest to the cube's
     // center is inside the cube
     vec3_t closest_to_cube_center = cube.position;
@@ -71,10 +102,13 @@ bool ccube_is_sphere_inside(ccube_t cube, csphere_t sphere) {
 }
 
 bool ccube_is_ccube_inside(ccube_t a, ccube_t b) {
+    if (ccube_is_out_of_reach(a, b.position, ccube_get_bounding_radius(b))) {
+        return false;
+    }
     // cancel out a's position and rotation so we can treat this like a cube-bbox check
     ccube_apply_cube_transformations(a, &b.position);
     a.position = VEC3_ZERO;
-    a.rotation = QUATERNION_NOROTATION;
+    ccube_set_rotation(&a, QUATERNION_NOROTATION);
 
     // Do the cube-bbox check.  We inline it here so we don't have to
     // initialize an actual bbox
@@ -83,11 +117,30 @@ bool ccube_is_ccube_inside(ccube_t a, ccube_t b) {
     return ccube_is_point_inside(b, a_closest_b);
 }
 
+ccube_stats_t ccube_get_stats(void) {
+#ifdef USE_CUBE_STATS
+    return (ccube_stats_t){
+        .tests = atomic_load_explicit(&test_count, memory_order_relaxed),
+        .early_rejections = atomic_load_explicit(&early_rejection_count, memory_order_relaxed),
+    };
+#else
+    return (ccube_stats_t){ 0 };
+#endif
+}
+
+void ccube_reset_stats(void) {
+#ifdef USE_CUBE_STATS
+    atomic_store_explicit(&test_count, 0, memory_order_relaxed);
+    atomic_store_explicit(&early_rejection_count, 0, memory_order_relaxed);
+#endif
+}
+
 vec3_t ccube_get_surface_normal(ccube_t cube, vec3_t point_on_surface) {
     // clamp the point and transform it so that it is relative to the cube's
     // center and within the cube's extents
-    ccube_clamp_point_within_cube(cube, &point_on_surface);
-    ccube_apply_cube_transformations(cube, &point_on_surface);
+    vec3_add_to(&point_on_surface, cube.position, -1);
+    point_on_surface = mat3x3_transpose_times_vec3(cube.rotation_matrix, point_on_surface);
+    ccube_clamp_model_point(cube, &point_on_surface);
 
     // now that we've applied transformations, we can treat this as a bounding
     // box operation
@@ -96,8 +149,7 @@ vec3_t ccube_get_surface_normal(ccube_t cube, vec3_t point_on_surface) {
     vec3_t surface_normal = bbox_get_surface_normal(cube_box, point_on_surface);
 
     // undo the rotation, but not the translation
-    cube.position = VEC3_ZERO;
-    ccube_undo_cube_transformations(cube, &surface_normal);
+    surface_normal = mat3x3_times_vec3(cube.rotation_matrix, surface_normal);
 
     vec3_unit(&surface_normal);  // to make sure it's actually a UNIT normal
 
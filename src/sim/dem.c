@@ -0,0 +1,785 @@
+#include "sim/dem.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/math.h"
+#include "common/simd.h"
+
+/**
+ * How many particles a system starts out with room for, if none are asked for
+ */
+#define DEM_DEFAULT_CAPACITY 64
+
+/**
+ * How many contacts per particle a system starts out with room for
+ */
+#define DEM_DEFAULT_CONTACTS_PER_PARTICLE 8
+
+/**
+ * How many particles a thread takes at a time
+ */
+#define DEM_CHUNK_SIZE 1024
+
+/**
+ * The number of per-particle arrays of reals a system has
+ */
+#define DEM_REAL_ARRAY_COUNT 18
+
+/**
+ * Squared distances are clamped to at least this before taking their
+ * square root, so particles sitting exactly on top of each other don't
+ * divide by zero
+ */
+#define DEM_MIN_DISTANCE_SQR 1e-12
+
+/**
+ * Everything the per-particle passes of a step need on each thread
+ */
+struct DemStep {
+    dem_system_t *system;
+    phy_real_t dt;
+};
+typedef struct DemStep dem_step_t;
+
+/**
+ * Gets every per-particle array of reals, so they can all be grown together
+ */
+PRIVATE_FUNC void dem_get_real_arrays(dem_system_t *system, phy_real_t **arrays[DEM_REAL_ARRAY_COUNT]) {
+    phy_real_t **all[DEM_REAL_ARRAY_COUNT] = {
+        &system->position_x, &system->position_y, &system->position_z,
+        &system->velocity_x, &system->velocity_y, &system->velocity_z,
+        &system->angular_velocity_x, &system->angular_velocity_y, &system->angular_velocity_z,
+        &system->force_x, &system->force_y, &system->force_z,
+        &system->torque_x, &system->torque_y, &system->torque_z,
+        &system->radius, &system->inverse_mass, &system->inverse_inertia,
+    };
+    memcpy(arrays, all, (sizeof all));
+}
+
+/**
+ * Makes room for a given number of particles
+ */
+PRIVATE_FUNC int dem_system_reserve_particles(dem_system_t *system, size_t capacity) {
+    if (capacity <= system->particle_capacity && system->position_x != NULL) {
+        return DEM_SUCCESS;
+    }
+
+    phy_real_t **arrays[DEM_REAL_ARRAY_COUNT];
+    dem_get_real_arrays(system, arrays);
+    for (size_t i = 0; i < DEM_REAL_ARRAY_COUNT; i++) {
+        phy_real_t *array = reallocarray(*arrays[i], capacity, (sizeof *array));
+        if (array == NULL) {
+            return DEM_ERROR_ALLOC;
+        }
+        *arrays[i] = array;
+    }
+
+    uint32_t **index_arrays[] = { &system->ids };
+    for (size_t i = 0; i < (sizeof index_arrays) / (sizeof *index_arrays); i++) {
+        uint32_t *array = reallocarray(*index_arrays[i], capacity, (sizeof *array));
+        if (array == NULL) {
+            return DEM_ERROR_ALLOC;
+        }
+        *index_arrays[i] = array;
+    }
+
+    uint32_t **offset_arrays[] = { &system->contact_offsets, &system->previous_offsets };
+    for (size_t i = 0; i < (sizeof offset_arrays) / (sizeof *offset_arrays); i++) {
+        uint32_t *array = reallocarray(*offset_arrays[i], capacity + 1, (sizeof *array));
+        if (array == NULL) {
+            return DEM_ERROR_ALLOC;
+        }
+        if (*offset_arrays[i] == NULL) {
+            // no contacts have been found yet
+            array[0] = 0;
+        }
+        *offset_arrays[i] = array;
+    }
+
+    system->particle_capacity = capacity;
+    return DEM_SUCCESS;
+}
+
+/**
+ * Makes room for a given number of contacts in a set of contact arrays
+ */
+PRIVATE_FUNC int dem_reserve_contacts(uint32_t **others, phy_real_t **shear_x, phy_real_t **shear_y, phy_real_t **shear_z,
+    size_t *capacity, size_t count)
+{
+    if (count <= *capacity && *others != NULL) {
+        return DEM_SUCCESS;
+    }
+
+    size_t new_capacity = count > 0 ? count + count / 2 : 1;
+    uint32_t *new_others = reallocarray(*others, new_capacity, (sizeof *new_others));
+    if (new_others == NULL) {
+        return DEM_ERROR_ALLOC;
+    }
+    *others = new_others;
+    phy_real_t **shears[] = { shear_x, shear_y, shear_z };
+    for (size_t i = 0; i < 3; i++) {
+        phy_real_t *shear = reallocarray(*shears[i], new_capacity, (sizeof *shear));
+        if (shear == NULL) {
+            return DEM_ERROR_ALLOC;
+        }
+        *shears[i] = shear;
+    }
+    *capacity = new_capacity;
+    return DEM_SUCCESS;
+}
+
+dem_system_t *dem_system_create(size_t capacity, dem_material_t material, vec3_t gravity) {
+    dem_system_t *system = calloc(1, (sizeof *system));
+    if (system == NULL) {
+        return NULL;
+    }
+    system->material = material;
+    system->gravity = gravity;
+    system->grid = particle_grid_create();
+
+    capacity = capacity > 0 ? capacity : DEM_DEFAULT_CAPACITY;
+    size_t contact_capacity = capacity * DEM_DEFAULT_CONTACTS_PER_PARTICLE;
+    if (system->grid == NULL || dem_system_reserve_particles(system, capacity) != DEM_SUCCESS ||
+        dem_reserve_contacts(&system->contact_others, &system->contact_shear_x, &system->contact_shear_y,
+            &system->contact_shear_z, &system->contact_capacity, contact_capacity) != DEM_SUCCESS ||
+        dem_reserve_contacts(&system->previous_others, &system->previous_shear_x, &system->previous_shear_y,
+            &system->previous_shear_z, &system->previous_capacity, contact_capacity) != DEM_SUCCESS)
+    {
+        dem_system_destroy(system);
+        return NULL;
+    }
+    return system;
+}
+
+int dem_system_add_sphere(dem_system_t *system, csphere_t sphere, phy_real_t density, vec3_t velocity) {
+    safe_assert(system != NULL && sphere.radius > 0 && density >= 0, DEM_ERROR_PARAMS);
+    safe_assert(system->particle_count < UINT32_MAX, DEM_ERROR_PARAMS);
+
+    if (system->particle_count >= system->particle_capacity) {
+        int result = dem_system_reserve_particles(system, system->particle_capacity * 2);
+        if (result != DEM_SUCCESS) {
+            return result;
+        }
+    }
+
+    size_t i = system->particle_count;
+    system->position_x[i] = sphere.center.x;
+    system->position_y[i] = sphere.center.y;
+    system->position_z[i] = sphere.center.z;
+    system->velocity_x[i] = velocity.x;
+    system->velocity_y[i] = velocity.y;
+    system->velocity_z[i] = velocity.z;
+    system->angular_velocity_x[i] = system->angular_velocity_y[i] = system->angular_velocity_z[i] = 0;
+    system->force_x[i] = system->force_y[i] = system->force_z[i] = 0;
+    system->torque_x[i] = system->torque_y[i] = system->torque_z[i] = 0;
+    system->radius[i] = sphere.radius;
+    system->ids[i] = i;
+
+    // solid sphere: m = 4/3 pi r^3 density, I = 2/5 m r^2
+    phy_real_t mass = 4.0 / 3.0 * PHYSICS_PI * sphere.radius * sphere.radius * sphere.radius * density;
+    system->inverse_mass[i] = mass > 0 ? 1 / mass : 0;
+    system->inverse_inertia[i] = mass > 0 ? 1 / (0.4 * mass * sphere.radius * sphere.radius) : 0;
+    system->max_radius = max(system->max_radius, sphere.radius);
+
+    system->particle_count++;
+    return DEM_SUCCESS;
+}
+
+csphere_t dem_system_get_sphere(const dem_system_t *system, size_t index) {
+    safe_assert(system != NULL && index < system->particle_count, csphere_make(VEC3_ZERO, 0));
+
+    vec3_t center = vec3_make(system->position_x[index], system->position_y[index], system->position_z[index]);
+    return csphere_make(center, system->radius[index]);
+}
+
+void dem_system_set_bounds(dem_system_t *system, const bbox_t *bounds) {
+    safe_assert(system != NULL,);
+
+    system->has_bounds = bounds != NULL;
+    if (bounds != NULL) {
+        system->bounds = *bounds;
+    }
+}
+
+/**
+ * Sorts every particle into the grid.  A cell has to be at least as wide
+ * as the largest contact, so every contact is between particles in
+ * neighboring cells
+ */
+PRIVATE_FUNC int dem_system_build_grid(dem_system_t *system, threadpool_t *pool) {
+    phy_real_t cell_size = system->max_radius > 0 ? 2 * system->max_radius : 1;
+    int result = particle_grid_build(system->grid, system->position_x, system->position_y, system->position_z,
+        system->particle_count, cell_size, pool);
+    if (result == PARTICLE_GRID_ERROR_PARAMS) {
+        return DEM_ERROR_PARAMS;
+    }
+    return result == PARTICLE_GRID_SUCCESS ? DEM_SUCCESS : DEM_ERROR_ALLOC;
+}
+
+/**
+ * Finds every particle touching a particle
+ * @param others Populated with the particles found, if not NULL
+ * @return The number of particles found
+ */
+PRIVATE_FUNC uint32_t dem_find_contacts_of(const dem_system_t *system, size_t i, uint32_t *others) {
+    phy_real_t x = system->position_x[i];
+    phy_real_t y = system->position_y[i];
+    phy_real_t z = system->position_z[i];
+    phy_real_t radius = system->radius[i];
+
+    uint32_t run_begins[PARTICLE_GRID_MAX_RUNS], run_ends[PARTICLE_GRID_MAX_RUNS];
+    size_t run_count = particle_grid_get_neighbor_runs(system->grid, vec3_make(x, y, z), run_begins, run_ends);
+    const uint32_t *cell_particles = system->grid->cell_particles;
+    uint32_t found = 0;
+    for (size_t run = 0; run < run_count; run++) {
+        for (uint32_t p = run_begins[run]; p < run_ends[run]; p++) {
+            uint32_t j = cell_particles[p];
+            if (j == i) {
+                continue;
+            }
+            phy_real_t offset_x = system->position_x[j] - x;
+            phy_real_t offset_y = system->position_y[j] - y;
+            phy_real_t offset_z = system->position_z[j] - z;
+            phy_real_t reach = radius + system->radius[j];
+            if (offset_x * offset_x + offset_y * offset_y + offset_z * offset_z < reach * reach) {
+                if (others != NULL) {
+                    others[found] = j;
+                }
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * Sorts a particle's contacts by the other particle's index
+ * @param shear The contacts' shear, stored per-axis, which is moved along
+ * with the contacts (can be null)
+ */
+PRIVATE_FUNC void dem_sort_contacts(uint32_t *others, phy_real_t *shear[3], uint32_t count) {
+    // rows are short, so insertion sort is plenty
+    for (uint32_t a = 1; a < count; a++) {
+        uint32_t other = others[a];
+        phy_real_t other_shear[3] = { 0, 0, 0 };
+        for (size_t axis = 0; axis < 3 && shear != NULL; axis++) {
+            other_shear[axis] = shear[axis][a];
+        }
+        uint32_t b = a;
+        for (; b > 0 && others[b - 1] > other; b--) {
+            others[b] = others[b - 1];
+            for (size_t axis = 0; axis < 3 && shear != NULL; axis++) {
+                shear[axis][b] = shear[axis][b - 1];
+            }
+        }
+        others[b] = other;
+        for (size_t axis = 0; axis < 3 && shear != NULL; axis++) {
+            shear[axis][b] = other_shear[axis];
+        }
+    }
+}
+
+PRIVATE_FUNC void dem_count_contacts_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    dem_system_t *system = ((dem_step_t *)context)->system;
+
+    for (size_t i = begin; i < end; i++) {
+        system->contact_offsets[i + 1] = dem_find_contacts_of(system, i, NULL);
+    }
+}
+
+PRIVATE_FUNC void dem_fill_contacts_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    dem_system_t *system = ((dem_step_t *)context)->system;
+
+    for (size_t i = begin; i < end; i++) {
+        uint32_t first = system->contact_offsets[i];
+        uint32_t *others = &system->contact_others[first];
+        uint32_t count = dem_find_contacts_of(system, i, others);
+
+        dem_sort_contacts(others, NULL, count);
+
+        // carry over the shear of contacts that already existed; both
+        // rows are sorted, so they can be walked together
+        uint32_t previous = 0, previous_end = 0;
+        if (i < system->previous_particle_count) {
+            previous = system->previous_offsets[i];
+            previous_end = system->previous_offsets[i + 1];
+        }
+        for (uint32_t c = 0; c < count; c++) {
+            while (previous < previous_end && system->previous_others[previous] < others[c]) {
+                previous++;
+            }
+            bool existed = previous < previous_end && system->previous_others[previous] == others[c];
+            system->contact_shear_x[first + c] = existed ? system->previous_shear_x[previous] : 0;
+            system->contact_shear_y[first + c] = existed ? system->previous_shear_y[previous] : 0;
+            system->contact_shear_z[first + c] = existed ? system->previous_shear_z[previous] : 0;
+        }
+    }
+}
+
+/**
+ * Swaps the current and previous contacts
+ */
+PRIVATE_FUNC void dem_system_swap_contacts(dem_system_t *system) {
+    uint32_t *offsets = system->contact_offsets;
+    system->contact_offsets = system->previous_offsets;
+    system->previous_offsets = offsets;
+
+    uint32_t *others = system->contact_others;
+    system->contact_others = system->previous_others;
+    system->previous_others = others;
+
+    phy_real_t *shear_x = system->contact_shear_x;
+    phy_real_t *shear_y = system->contact_shear_y;
+    phy_real_t *shear_z = system->contact_shear_z;
+    system->contact_shear_x = system->previous_shear_x;
+    system->contact_shear_y = system->previous_shear_y;
+    system->contact_shear_z = system->previous_shear_z;
+    system->previous_shear_x = shear_x;
+    system->previous_shear_y = shear_y;
+    system->previous_shear_z = shear_z;
+
+    size_t capacity = system->contact_capacity;
+    system->contact_capacity = system->previous_capacity;
+    system->previous_capacity = capacity;
+}
+
+/**
+ * Finds every contact, keeping the shear of contacts that already existed
+ */
+PRIVATE_FUNC int dem_system_find_contacts(dem_system_t *system, threadpool_t *pool) {
+    dem_step_t step = { .system = system };
+    threadpool_parallel_for(pool, system->particle_count, DEM_CHUNK_SIZE, dem_count_contacts_task, &step);
+
+    size_t total = 0;
+    system->contact_offsets[0] = 0;
+    for (size_t i = 0; i < system->particle_count; i++) {
+        total += system->contact_offsets[i + 1];
+        if (total > UINT32_MAX) {
+            return DEM_ERROR_ALLOC;
+        }
+        system->contact_offsets[i + 1] = total;
+    }
+    int result = dem_reserve_contacts(&system->contact_others, &system->contact_shear_x, &system->contact_shear_y,
+        &system->contact_shear_z, &system->contact_capacity, total);
+    if (result != DEM_SUCCESS) {
+        return result;
+    }
+
+    threadpool_parallel_for(pool, system->particle_count, DEM_CHUNK_SIZE, dem_fill_contacts_task, &step);
+    system->contact_count = total;
+    return DEM_SUCCESS;
+}
+
+/**
+ * Adds up the lanes of a SIMD register
+ */
+PRIVATE_FUNC phy_real_t dem_sum_lanes(simd4f_t value) {
+    float lanes[SIMD_WIDTH];
+    simd4f_store(lanes, value);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+/**
+ * Adds the force and torque on a particle from every particle it touches,
+ * SIMD_WIDTH contacts at a time, and updates each contact's shear
+ */
+PRIVATE_FUNC void dem_add_contact_forces(dem_system_t *system, size_t i, phy_real_t dt, phy_real_t force[3], phy_real_t torque[3]) {
+    const dem_material_t *material = &system->material;
+    simd4f_t zero = simd4f_set1(0);
+    simd4f_t one = simd4f_set1(1);
+    simd4f_t min_distance_sqr = simd4f_set1(DEM_MIN_DISTANCE_SQR);
+    simd4f_t normal_stiffness = simd4f_set1(material->normal_stiffness);
+    simd4f_t normal_damping = simd4f_set1(material->normal_damping);
+    simd4f_t tangential_stiffness = simd4f_set1(material->tangential_stiffness);
+    simd4f_t tangential_damping = simd4f_set1(material->tangential_damping);
+    simd4f_t inverse_tangential_stiffness = simd4f_set1(material->tangential_stiffness > 0 ? 1 / material->tangential_stiffness : 0);
+    simd4f_t friction = simd4f_set1(material->friction);
+    simd4f_t step = simd4f_set1(dt);
+
+    simd4f_t position_ix = simd4f_set1(system->position_x[i]);
+    simd4f_t position_iy = simd4f_set1(system->position_y[i]);
+    simd4f_t position_iz = simd4f_set1(system->position_z[i]);
+    simd4f_t velocity_ix = simd4f_set1(system->velocity_x[i]);
+    simd4f_t velocity_iy = simd4f_set1(system->velocity_y[i]);
+    simd4f_t velocity_iz = simd4f_set1(system->velocity_z[i]);
+    simd4f_t angular_ix = simd4f_set1(system->angular_velocity_x[i]);
+    simd4f_t angular_iy = simd4f_set1(system->angular_velocity_y[i]);
+    simd4f_t angular_iz = simd4f_set1(system->angular_velocity_z[i]);
+    simd4f_t radius_i = simd4f_set1(system->radius[i]);
+
+    simd4f_t sum_force_x = zero, sum_force_y = zero, sum_force_z = zero;
+    simd4f_t sum_torque_x = zero, sum_torque_y = zero, sum_torque_z = zero;
+    uint32_t end = system->contact_offsets[i + 1];
+    for (uint32_t begin = system->contact_offsets[i]; begin < end; begin += SIMD_WIDTH) {
+        // gather the other particles into lanes; unused lanes get a
+        // particle too small to touch anything
+        float other_position[3][SIMD_WIDTH];
+        float other_velocity[3][SIMD_WIDTH];
+        float other_angular_velocity[3][SIMD_WIDTH];
+        float other_radius[SIMD_WIDTH];
+        float shear[3][SIMD_WIDTH];
+        size_t lanes = end - begin < SIMD_WIDTH ? end - begin : SIMD_WIDTH;
+        for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            if (lane >= lanes) {
+                other_position[0][lane] = system->position_x[i] + 1;
+                other_position[1][lane] = system->position_y[i];
+                other_position[2][lane] = system->position_z[i];
+                other_radius[lane] = -system->radius[i] - 1;
+                for (size_t axis = 0; axis < 3; axis++) {
+                    other_velocity[axis][lane] = other_angular_velocity[axis][lane] = shear[axis][lane] = 0;
+                }
+                continue;
+            }
+            uint32_t j = system->contact_others[begin + lane];
+            other_position[0][lane] = system->position_x[j];
+            other_position[1][lane] = system->position_y[j];
+            other_position[2][lane] = system->position_z[j];
+            other_velocity[0][lane] = system->velocity_x[j];
+            other_velocity[1][lane] = system->velocity_y[j];
+            other_velocity[2][lane] = system->velocity_z[j];
+            other_angular_velocity[0][lane] = system->angular_velocity_x[j];
+            other_angular_velocity[1][lane] = system->angular_velocity_y[j];
+            other_angular_velocity[2][lane] = system->angular_velocity_z[j];
+            other_radius[lane] = system->radius[j];
+            shear[0][lane] = system->contact_shear_x[begin + lane];
+            shear[1][lane] = system->contact_shear_y[begin + lane];
+            shear[2][lane] = system->contact_shear_z[begin + lane];
+        }
+        simd4f_t radius_j = simd4f_load(other_radius);
+
+        // the normal points from the other particle towards this one
+        simd4f_t offset_x = simd4f_sub(position_ix, simd4f_load(other_position[0]));
+        simd4f_t offset_y = simd4f_sub(position_iy, simd4f_load(other_position[1]));
+        simd4f_t offset_z = simd4f_sub(position_iz, simd4f_load(other_position[2]));
+        simd4f_t distance_sqr = simd4f_add(simd4f_add(simd4f_mul(offset_x, offset_x), simd4f_mul(offset_y, offset_y)), simd4f_mul(offset_z, offset_z));
+        simd4f_t distance = simd4f_sqrt(simd4f_max(distance_sqr, min_distance_sqr));
+        simd4f_t inverse_distance = simd4f_div(one, distance);
+        simd4f_t normal_x = simd4f_mul(offset_x, inverse_distance);
+        simd4f_t normal_y = simd4f_mul(offset_y, inverse_distance);
+        simd4f_t normal_z = simd4f_mul(offset_z, inverse_distance);
+        simd4f_t overlap = simd4f_sub(simd4f_add(radius_i, radius_j), distance);
+        simd4f_t touching = simd4f_greater_equal(overlap, zero);
+
+        // relative velocity where the particles touch:
+        // (v_i - v_j) - (r_i w_i + r_j w_j) x n
+        simd4f_t spin_x = simd4f_add(simd4f_mul(radius_i, angular_ix), simd4f_mul(radius_j, simd4f_load(other_angular_velocity[0])));
+        simd4f_t spin_y = simd4f_add(simd4f_mul(radius_i, angular_iy), simd4f_mul(radius_j, simd4f_load(other_angular_velocity[1])));
+        simd4f_t spin_z = simd4f_add(simd4f_mul(radius_i, angular_iz), simd4f_mul(radius_j, simd4f_load(other_angular_velocity[2])));
+        simd4f_t velocity_x = simd4f_sub(simd4f_sub(velocity_ix, simd4f_load(other_velocity[0])),
+            simd4f_sub(simd4f_mul(spin_y, normal_z), simd4f_mul(spin_z, normal_y)));
+        simd4f_t velocity_y = simd4f_sub(simd4f_sub(velocity_iy, simd4f_load(other_velocity[1])),
+            simd4f_sub(simd4f_mul(spin_z, normal_x), simd4f_mul(spin_x, normal_z)));
+        simd4f_t velocity_z = simd4f_sub(simd4f_sub(velocity_iz, simd4f_load(other_velocity[2])),
+            simd4f_sub(simd4f_mul(spin_x, normal_y), simd4f_mul(spin_y, normal_x)));
+        simd4f_t normal_velocity = simd4f_add(simd4f_add(simd4f_mul(velocity_x, normal_x), simd4f_mul(velocity_y, normal_y)), simd4f_mul(velocity_z, normal_z));
+        simd4f_t tangent_velocity_x = simd4f_sub(velocity_x, simd4f_mul(normal_velocity, normal_x));
+        simd4f_t tangent_velocity_y = simd4f_sub(velocity_y, simd4f_mul(normal_velocity, normal_y));
+        simd4f_t tangent_velocity_z = simd4f_sub(velocity_z, simd4f_mul(normal_velocity, normal_z));
+
+        // normal force: spring-dashpot, which can push but never pull
+        simd4f_t normal_force = simd4f_max(
+            simd4f_sub(simd4f_mul(normal_stiffness, overlap), simd4f_mul(normal_damping, normal_velocity)), zero);
+
+        // shear: drop whatever no longer lies in the contact plane
+        // (the particles may have rolled), then add this step's sliding
+        simd4f_t shear_x = simd4f_load(shear[0]);
+        simd4f_t shear_y = simd4f_load(shear[1]);
+        simd4f_t shear_z = simd4f_load(shear[2]);
+        simd4f_t shear_normal = simd4f_add(simd4f_add(simd4f_mul(shear_x, normal_x), simd4f_mul(shear_y, normal_y)), simd4f_mul(shear_z, normal_z));
+        shear_x = simd4f_add(simd4f_sub(shear_x, simd4f_mul(shear_normal, normal_x)), simd4f_mul(tangent_velocity_x, step));
+        shear_y = simd4f_add(simd4f_sub(shear_y, simd4f_mul(shear_normal, normal_y)), simd4f_mul(tangent_velocity_y, step));
+        shear_z = simd4f_add(simd4f_sub(shear_z, simd4f_mul(shear_normal, normal_z)), simd4f_mul(tangent_velocity_z, step));
+
+        // tangential force: spring-dashpot, capped by Coulomb friction.
+        // Past the cap the contact slips, and the spring is shortened to match
+        simd4f_t tangent_force_x = simd4f_sub(zero, simd4f_add(simd4f_mul(tangential_stiffness, shear_x), simd4f_mul(tangential_damping, tangent_velocity_x)));
+        simd4f_t tangent_force_y = simd4f_sub(zero, simd4f_add(simd4f_mul(tangential_stiffness, shear_y), simd4f_mul(tangential_damping, tangent_velocity_y)));
+        simd4f_t tangent_force_z = simd4f_sub(zero, simd4f_add(simd4f_mul(tangential_stiffness, shear_z), simd4f_mul(tangential_damping, tangent_velocity_z)));
+        simd4f_t tangent_force_sqr = simd4f_add(simd4f_add(simd4f_mul(tangent_force_x, tangent_force_x), simd4f_mul(tangent_force_y, tangent_force_y)), simd4f_mul(tangent_force_z, tangent_force_z));
+        simd4f_t limit = simd4f_mul(friction, normal_force);
+        simd4f_t slipping = simd4f_greater_equal(tangent_force_sqr, simd4f_mul(limit, limit));
+        simd4f_t scale = simd4f_select(slipping,
+            simd4f_div(limit, simd4f_sqrt(simd4f_max(tangent_force_sqr, min_distance_sqr))), one);
+        tangent_force_x = simd4f_mul(tangent_force_x, scale);
+        tangent_force_y = simd4f_mul(tangent_force_y, scale);
+        tangent_force_z = simd4f_mul(tangent_force_z, scale);
+        shear_x = simd4f_select(slipping, simd4f_mul(simd4f_sub(zero, simd4f_add(tangent_force_x, simd4f_mul(tangential_damping, tangent_velocity_x))), inverse_tangential_stiffness), shear_x);
+        shear_y = simd4f_select(slipping, simd4f_mul(simd4f_sub(zero, simd4f_add(tangent_force_y, simd4f_mul(tangential_damping, tangent_velocity_y))), inverse_tangential_stiffness), shear_y);
+        shear_z = simd4f_select(slipping, simd4f_mul(simd4f_sub(zero, simd4f_add(tangent_force_z, simd4f_mul(tangential_damping, tangent_velocity_z))), inverse_tangential_stiffness), shear_z);
+
+        // force = normal force + tangential force; the tangential force
+        // acts at -r_i n, giving a torque of -r_i (n x F_t)
+        simd4f_t force_x = simd4f_add(simd4f_mul(normal_force, normal_x), tangent_force_x);
+        simd4f_t force_y = simd4f_add(simd4f_mul(normal_force, normal_y), tangent_force_y);
+        simd4f_t force_z = simd4f_add(simd4f_mul(normal_force, normal_z), tangent_force_z);
+        simd4f_t torque_x = simd4f_mul(radius_i, simd4f_sub(simd4f_mul(normal_z, tangent_force_y), simd4f_mul(normal_y, tangent_force_z)));
+        simd4f_t torque_y = simd4f_mul(radius_i, simd4f_sub(simd4f_mul(normal_x, tangent_force_z), simd4f_mul(normal_z, tangent_force_x)));
+        simd4f_t torque_z = simd4f_mul(radius_i, simd4f_sub(simd4f_mul(normal_y, tangent_force_x), simd4f_mul(normal_x, tangent_force_y)));
+
+        sum_force_x = simd4f_add(sum_force_x, simd4f_select(touching, force_x, zero));
+        sum_force_y = simd4f_add(sum_force_y, simd4f_select(touching, force_y, zero));
+        sum_force_z = simd4f_add(sum_force_z, simd4f_select(touching, force_z, zero));
+        sum_torque_x = simd4f_add(sum_torque_x, simd4f_select(touching, torque_x, zero));
+        sum_torque_y = simd4f_add(sum_torque_y, simd4f_select(touching, torque_y, zero));
+        sum_torque_z = simd4f_add(sum_torque_z, simd4f_select(touching, torque_z, zero));
+
+        simd4f_store(shear[0], simd4f_select(touching, shear_x, zero));
+        simd4f_store(shear[1], simd4f_select(touching, shear_y, zero));
+        simd4f_store(shear[2], simd4f_select(touching, shear_z, zero));
+        for (size_t lane = 0; lane < lanes; lane++) {
+            system->contact_shear_x[begin + lane] = shear[0][lane];
+            system->contact_shear_y[begin + lane] = shear[1][lane];
+            system->contact_shear_z[begin + lane] = shear[2][lane];
+        }
+    }
+
+    force[0] += dem_sum_lanes(sum_force_x);
+    force[1] += dem_sum_lanes(sum_force_y);
+    force[2] += dem_sum_lanes(sum_force_z);
+    torque[0] += dem_sum_lanes(sum_torque_x);
+    torque[1] += dem_sum_lanes(sum_torque_y);
+    torque[2] += dem_sum_lanes(sum_torque_z);
+}
+
+/**
+ * Adds the force and torque on a particle from a single wall
+ * @param normal The direction the wall pushes in
+ * @param overlap How far the particle is past the wall
+ */
+PRIVATE_FUNC void dem_add_wall_force(const dem_system_t *system, size_t i, vec3_t normal, phy_real_t overlap,
+    phy_real_t force[3], phy_real_t torque[3])
+{
+    if (overlap <= 0) {
+        return;
+    }
+    const dem_material_t *material = &system->material;
+    phy_real_t radius = system->radius[i];
+
+    // velocity where the particle touches the wall: v + w x (-r n)
+    vec3_t angular_velocity = vec3_make(system->angular_velocity_x[i], system->angular_velocity_y[i], system->angular_velocity_z[i]);
+    vec3_t spin;
+    vec3_cross_product(&spin, angular_velocity, normal);
+    vec3_t velocity = vec3_make(system->velocity_x[i], system->velocity_y[i], system->velocity_z[i]);
+    vec3_add_to(&velocity, spin, -radius);
+    phy_real_t normal_velocity = vec3_dot_product(velocity, normal);
+    vec3_t tangent_velocity = velocity;
+    vec3_add_to(&tangent_velocity, normal, -normal_velocity);
+
+    phy_real_t normal_force = max(material->normal_stiffness * overlap - material->normal_damping * normal_velocity, 0);
+
+    // walls don't keep any shear, so their friction is purely viscous
+    vec3_t tangent_force = tangent_velocity;
+    vec3_multiply_by(&tangent_force, -material->tangential_damping);
+    phy_real_t tangent_magnitude = vec3_magnitude(tangent_force);
+    phy_real_t limit = material->friction * normal_force;
+    if (tangent_magnitude > limit) {
+        vec3_multiply_by(&tangent_force, limit / tangent_magnitude);
+    }
+
+    vec3_t wall_torque;
+    vec3_cross_product(&wall_torque, normal, tangent_force);
+    for (size_t axis = 0; axis < 3; axis++) {
+        force[axis] += normal_force * normal.raw[axis] + tangent_force.raw[axis];
+        torque[axis] -= radius * wall_torque.raw[axis];
+    }
+}
+
+/**
+ * Adds the force and torque on a particle from every wall it's pushing against
+ */
+PRIVATE_FUNC void dem_add_wall_forces(const dem_system_t *system, size_t i, phy_real_t force[3], phy_real_t torque[3]) {
+    vec3_t bounds_min = bbox_get_min(system->bounds);
+    vec3_t bounds_max = bbox_get_max(system->bounds);
+    vec3_t position = vec3_make(system->position_x[i], system->position_y[i], system->position_z[i]);
+    phy_real_t radius = system->radius[i];
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        vec3_t normal = VEC3_ZERO;
+        normal.raw[axis] = 1;
+        dem_add_wall_force(system, i, normal, bounds_min.raw[axis] + radius - position.raw[axis], force, torque);
+        normal.raw[axis] = -1;
+        dem_add_wall_force(system, i, normal, position.raw[axis] + radius - bounds_max.raw[axis], force, torque);
+    }
+}
+
+PRIVATE_FUNC void dem_compute_forces_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    dem_step_t *step = context;
+    dem_system_t *system = step->system;
+
+    for (size_t i = begin; i < end; i++) {
+        phy_real_t force[3] = { 0, 0, 0 };
+        phy_real_t torque[3] = { 0, 0, 0 };
+        dem_add_contact_forces(system, i, step->dt, force, torque);
+        if (system->has_bounds) {
+            dem_add_wall_forces(system, i, force, torque);
+        }
+        if (system->inverse_mass[i] > 0) {
+            phy_real_t mass = 1 / system->inverse_mass[i];
+            for (size_t axis = 0; axis < 3; axis++) {
+                force[axis] += system->gravity.raw[axis] * mass;
+            }
+        }
+
+        system->force_x[i] = force[0];
+        system->force_y[i] = force[1];
+        system->force_z[i] = force[2];
+        system->torque_x[i] = torque[0];
+        system->torque_y[i] = torque[1];
+        system->torque_z[i] = torque[2];
+    }
+}
+
+PRIVATE_FUNC void dem_integrate_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    dem_step_t *step = context;
+    dem_system_t *system = step->system;
+    phy_real_t dt = step->dt;
+
+    // semi-implicit Euler: update velocities first, then move with the new velocities.
+    // Particles that never move have no inverse mass, so nothing changes for them
+    for (size_t i = begin; i < end; i++) {
+        phy_real_t inverse_mass = system->inverse_mass[i] * dt;
+        phy_real_t inverse_inertia = system->inverse_inertia[i] * dt;
+        system->velocity_x[i] += system->force_x[i] * inverse_mass;
+        system->velocity_y[i] += system->force_y[i] * inverse_mass;
+        system->velocity_z[i] += system->force_z[i] * inverse_mass;
+        system->angular_velocity_x[i] += system->torque_x[i] * inverse_inertia;
+        system->angular_velocity_y[i] += system->torque_y[i] * inverse_inertia;
+        system->angular_velocity_z[i] += system->torque_z[i] * inverse_inertia;
+        system->position_x[i] += system->velocity_x[i] * dt;
+        system->position_y[i] += system->velocity_y[i] * dt;
+        system->position_z[i] += system->velocity_z[i] * dt;
+    }
+}
+
+/**
+ * Moves a particle's contacts from the old order to the new order made by
+ * dem_system_sort(), putting them in the (free) previous contacts
+ * @param order The old index of each particle, in the new order
+ * @param new_indices The new index of each particle, in the old order
+ */
+PRIVATE_FUNC void dem_system_reorder_contacts(dem_system_t *system, const uint32_t *order, const uint32_t *new_indices) {
+    uint32_t written = 0;
+    for (size_t i = 0; i < system->particle_count; i++) {
+        system->previous_offsets[i] = written;
+        uint32_t old_index = order[i];
+        if (old_index >= system->previous_particle_count) {
+            continue;
+        }
+        uint32_t first = written;
+        for (uint32_t c = system->contact_offsets[old_index]; c < system->contact_offsets[old_index + 1]; c++) {
+            system->previous_others[written] = new_indices[system->contact_others[c]];
+            system->previous_shear_x[written] = system->contact_shear_x[c];
+            system->previous_shear_y[written] = system->contact_shear_y[c];
+            system->previous_shear_z[written] = system->contact_shear_z[c];
+            written++;
+        }
+        phy_real_t *shear[3] = { &system->previous_shear_x[first], &system->previous_shear_y[first], &system->previous_shear_z[first] };
+        dem_sort_contacts(&system->previous_others[first], shear, written - first);
+    }
+    system->previous_offsets[system->particle_count] = written;
+}
+
+int dem_system_sort(dem_system_t *system, threadpool_t *pool) {
+    safe_assert(system != NULL, DEM_ERROR_PARAMS);
+
+    int result = dem_system_build_grid(system, pool);
+    if (result != DEM_SUCCESS) {
+        return result;
+    }
+    result = dem_reserve_contacts(&system->previous_others, &system->previous_shear_x, &system->previous_shear_y,
+        &system->previous_shear_z, &system->previous_capacity, system->contact_offsets[system->previous_particle_count]);
+    if (result != DEM_SUCCESS) {
+        return result;
+    }
+    // big enough for one per-particle array of either type
+    void *scratch = calloc(system->particle_count > 0 ? system->particle_count : 1, max((sizeof (phy_real_t)), (sizeof (uint32_t))));
+    if (scratch == NULL) {
+        return DEM_ERROR_ALLOC;
+    }
+
+    // the grid holds the new order; the cell keys aren't needed
+    // anymore, so they can hold the reverse
+    const uint32_t *order = system->grid->cell_particles;
+    uint32_t *new_indices = system->grid->cell_keys;
+    for (size_t i = 0; i < system->particle_count; i++) {
+        new_indices[order[i]] = i;
+    }
+
+    phy_real_t **arrays[DEM_REAL_ARRAY_COUNT];
+    dem_get_real_arrays(system, arrays);
+    for (size_t a = 0; a < DEM_REAL_ARRAY_COUNT; a++) {
+        phy_real_t *sorted = scratch;
+        for (size_t i = 0; i < system->particle_count; i++) {
+            sorted[i] = (*arrays[a])[order[i]];
+        }
+        memcpy(*arrays[a], sorted, system->particle_count * (sizeof *sorted));
+    }
+    uint32_t *sorted_ids = scratch;
+    for (size_t i = 0; i < system->particle_count; i++) {
+        sorted_ids[i] = system->ids[order[i]];
+    }
+    memcpy(system->ids, sorted_ids, system->particle_count * (sizeof *sorted_ids));
+    free(scratch);
+
+    // the contacts' indices (and rows) have to move too, or their shear would be lost
+    dem_system_reorder_contacts(system, order, new_indices);
+    dem_system_swap_contacts(system);
+    system->previous_particle_count = system->particle_count;
+    return DEM_SUCCESS;
+}
+
+int dem_system_step(dem_system_t *system, phy_real_t dt, threadpool_t *pool) {
+    safe_assert(system != NULL && dt > 0, DEM_ERROR_PARAMS);
+
+    int result = dem_system_build_grid(system, pool);
+    if (result != DEM_SUCCESS) {
+        return result;
+    }
+
+    // last step's contacts become the previous contacts, so their
+    // shear can be carried over
+    dem_system_swap_contacts(system);
+    result = dem_system_find_contacts(system, pool);
+    if (result != DEM_SUCCESS) {
+        // put the last step's contacts back
+        dem_system_swap_contacts(system);
+        return result;
+    }
+    system->previous_particle_count = system->particle_count;
+
+    dem_step_t step = { .system = system, .dt = dt };
+    threadpool_parallel_for(pool, system->particle_count, DEM_CHUNK_SIZE, dem_compute_forces_task, &step);
+    threadpool_parallel_for(pool, system->particle_count, DEM_CHUNK_SIZE, dem_integrate_task, &step);
+    return DEM_SUCCESS;
+}
+
+void dem_system_destroy(dem_system_t *system) {
+    if (system == NULL) {
+        return;
+    }
+
+    phy_real_t **arrays[DEM_REAL_ARRAY_COUNT];
+    dem_get_real_arrays(system, arrays);
+    for (size_t i = 0; i < DEM_REAL_ARRAY_COUNT; i++) {
+        free(*arrays[i]);
+    }
+    free(system->ids);
+    particle_grid_destroy(system->grid);
+    free(system->contact_offsets);
+    free(system->contact_others);
+    free(system->contact_shear_x);
+    free(system->contact_shear_y);
+    free(system->contact_shear_z);
+    free(system->previous_offsets);
+    free(system->previous_others);
+    free(system->previous_shear_x);
+    free(system->previous_shear_y);
+    free(system->previous_shear_z);
+    free(system);
+}
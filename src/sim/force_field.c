@@ -0,0 +1,388 @@
+#include "sim/force_field.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/simd.h"
+
+/**
+ * How many fields a registry starts out with room for
+ */
+#define FORCE_FIELD_DEFAULT_CAPACITY 8
+
+/**
+ * How many bodies force_field_registry_apply() copies out at a time.
+ * A multiple of SIMD_WIDTH
+ */
+#define FORCE_FIELD_BODY_CHUNK 64
+
+/**
+ * Every uniform field and linear drag, added up: each body feels
+ * mass * acceleration + drag_flow - drag_coefficient * velocity
+ */
+struct ForceFieldFolded {
+    vec3_t acceleration;
+    phy_real_t drag_coefficient;
+    /**
+     * The sum of each linear drag's coefficient times its flow velocity
+     */
+    vec3_t drag_flow;
+};
+typedef struct ForceFieldFolded force_field_folded_t;
+
+/**
+ * Where the fused pass reads and writes each component, one array per
+ * component, starting from the first body (or particle) of the pass
+ */
+struct ForceFieldArrays {
+    const phy_real_t *position[3];
+    const phy_real_t *velocity[3];
+    const phy_real_t *mass;
+    phy_real_t *force[3];
+};
+typedef struct ForceFieldArrays force_field_arrays_t;
+
+force_field_registry_t *force_field_registry_create(void) {
+    force_field_registry_t *registry = calloc(1, (sizeof *registry));
+    if (registry == NULL) {
+        return NULL;
+    }
+    registry->fields = calloc(FORCE_FIELD_DEFAULT_CAPACITY, (sizeof *registry->fields));
+    if (registry->fields == NULL) {
+        free(registry);
+        return NULL;
+    }
+    registry->capacity = FORCE_FIELD_DEFAULT_CAPACITY;
+    return registry;
+}
+
+/**
+ * [internal] checks that a field can be registered, and normalizes its
+ * vortex axis
+ */
+PRIVATE_FUNC int force_field_validate(force_field_t *field) {
+    switch (field->kind) {
+    case FORCE_FIELD_UNIFORM:
+    case FORCE_FIELD_LINEAR_DRAG:
+    case FORCE_FIELD_QUADRATIC_DRAG:
+        break;
+    case FORCE_FIELD_VORTEX:
+        safe_assert(vec3_magnitude(field->vortex.axis) >= PHYSICS_EPSILON, FORCE_FIELD_ERROR_PARAMS);
+        vec3_unit(&field->vortex.axis);
+        break;
+    case FORCE_FIELD_GRID:
+        // interpolating needs two samples along every axis
+        safe_assert(field->grid.cell_size > 0, FORCE_FIELD_ERROR_PARAMS);
+        safe_assert(field->grid.size_x >= 2 && field->grid.size_y >= 2 && field->grid.size_z >= 2, FORCE_FIELD_ERROR_PARAMS);
+        safe_assert(field->grid.x != NULL && field->grid.y != NULL && field->grid.z != NULL, FORCE_FIELD_ERROR_PARAMS);
+        break;
+    default:
+        return FORCE_FIELD_ERROR_PARAMS;
+    }
+    return FORCE_FIELD_SUCCESS;
+}
+
+int force_field_registry_add(force_field_registry_t *registry, force_field_t field, size_t *index) {
+    safe_assert(registry != NULL, FORCE_FIELD_ERROR_PARAMS);
+
+    int result = force_field_validate(&field);
+    if (result != FORCE_FIELD_SUCCESS) {
+        return result;
+    }
+
+    if (registry->count >= registry->capacity) {
+        force_field_t *fields = reallocarray(registry->fields, registry->capacity * 2, (sizeof *fields));
+        if (fields == NULL) {
+            return FORCE_FIELD_ERROR_ALLOC;
+        }
+        registry->fields = fields;
+        registry->capacity *= 2;
+    }
+    if (index != NULL) {
+        *index = registry->count;
+    }
+    registry->fields[registry->count++] = field;
+    return FORCE_FIELD_SUCCESS;
+}
+
+const force_field_t *force_field_registry_get(const force_field_registry_t *registry, size_t index) {
+    safe_assert(registry != NULL && index < registry->count, NULL);
+    return &registry->fields[index];
+}
+
+int force_field_registry_set(force_field_registry_t *registry, size_t index, force_field_t field) {
+    safe_assert(registry != NULL && index < registry->count, FORCE_FIELD_ERROR_PARAMS);
+
+    int result = force_field_validate(&field);
+    if (result != FORCE_FIELD_SUCCESS) {
+        return result;
+    }
+    registry->fields[index] = field;
+    return FORCE_FIELD_SUCCESS;
+}
+
+int force_field_registry_set_enabled(force_field_registry_t *registry, size_t index, bool enabled) {
+    safe_assert(registry != NULL && index < registry->count, FORCE_FIELD_ERROR_PARAMS);
+    registry->fields[index].enabled = enabled;
+    return FORCE_FIELD_SUCCESS;
+}
+
+/**
+ * [internal] adds up every enabled uniform field and linear drag
+ * @return true if there are any other enabled fields, which have to be
+ * evaluated one by one
+ */
+PRIVATE_FUNC bool force_field_fold(const force_field_registry_t *registry, force_field_folded_t *folded) {
+    *folded = (force_field_folded_t){ .acceleration = VEC3_ZERO, .drag_flow = VEC3_ZERO };
+    bool has_others = false;
+    for (size_t i = 0; i < registry->count; i++) {
+        const force_field_t *field = &registry->fields[i];
+        if (!field->enabled) {
+            continue;
+        }
+        switch (field->kind) {
+        case FORCE_FIELD_UNIFORM:
+            vec3_add_to(&folded->acceleration, field->uniform.acceleration, 1);
+            break;
+        case FORCE_FIELD_LINEAR_DRAG:
+            folded->drag_coefficient += field->drag.coefficient;
+            vec3_add_to(&folded->drag_flow, field->drag.flow_velocity, field->drag.coefficient);
+            break;
+        default:
+            has_others = true;
+            break;
+        }
+    }
+    return has_others;
+}
+
+/**
+ * [internal] samples a grid field at one point
+ * @return false if the point is outside the grid
+ */
+PRIVATE_FUNC bool force_field_sample_grid(const force_field_t *field, const phy_real_t point[3], phy_real_t acceleration[3]) {
+    const size_t sizes[3] = { field->grid.size_x, field->grid.size_y, field->grid.size_z };
+    size_t cell[3];
+    phy_real_t weight[3];
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t coordinate = (point[axis] - field->grid.origin.raw[axis]) / field->grid.cell_size;
+        // also rejects NaNs
+        if (!(coordinate >= 0 && coordinate <= (phy_real_t)(sizes[axis] - 1))) {
+            return false;
+        }
+        cell[axis] = (size_t)coordinate;
+        // the far face belongs to the last cell
+        if (cell[axis] > sizes[axis] - 2) {
+            cell[axis] = sizes[axis] - 2;
+        }
+        weight[axis] = coordinate - (phy_real_t)cell[axis];
+    }
+
+    const phy_real_t *samples[3] = { field->grid.x, field->grid.y, field->grid.z };
+    acceleration[0] = acceleration[1] = acceleration[2] = 0;
+    for (size_t corner = 0; corner < 8; corner++) {
+        size_t i = cell[0] + (corner & 1), j = cell[1] + ((corner >> 1) & 1), k = cell[2] + ((corner >> 2) & 1);
+        phy_real_t corner_weight = ((corner & 1) ? weight[0] : 1 - weight[0])
+            * (((corner >> 1) & 1) ? weight[1] : 1 - weight[1])
+            * (((corner >> 2) & 1) ? weight[2] : 1 - weight[2]);
+        size_t sample = i + sizes[0] * (j + sizes[1] * k);
+        for (size_t axis = 0; axis < 3; axis++) {
+            acceleration[axis] += samples[axis][sample] * corner_weight;
+        }
+    }
+    return true;
+}
+
+/**
+ * [internal] adds one field's force on SIMD_WIDTH bodies to force
+ */
+PRIVATE_FUNC void force_field_add_one(const force_field_t *field, const simd4f_t position[3], const simd4f_t velocity[3],
+        simd4f_t mass, simd4f_t force[3]) {
+    switch (field->kind) {
+    case FORCE_FIELD_QUADRATIC_DRAG: {
+        simd4f_t relative[3];
+        for (size_t axis = 0; axis < 3; axis++) {
+            relative[axis] = simd4f_sub(velocity[axis], simd4f_set1(field->drag.flow_velocity.raw[axis]));
+        }
+        simd4f_t speed = simd4f_sqrt(simd4f_add(simd4f_add(simd4f_mul(relative[0], relative[0]),
+            simd4f_mul(relative[1], relative[1])), simd4f_mul(relative[2], relative[2])));
+        simd4f_t scale = simd4f_mul(speed, simd4f_set1(field->drag.coefficient));
+        for (size_t axis = 0; axis < 3; axis++) {
+            force[axis] = simd4f_sub(force[axis], simd4f_mul(relative[axis], scale));
+        }
+        break;
+    }
+    case FORCE_FIELD_VORTEX: {
+        simd4f_t axis_lanes[3], offset[3];
+        for (size_t axis = 0; axis < 3; axis++) {
+            axis_lanes[axis] = simd4f_set1(field->vortex.axis.raw[axis]);
+            offset[axis] = simd4f_sub(position[axis], simd4f_set1(field->vortex.center.raw[axis]));
+        }
+        // the part of the offset perpendicular to the line
+        simd4f_t along = simd4f_add(simd4f_add(simd4f_mul(offset[0], axis_lanes[0]),
+            simd4f_mul(offset[1], axis_lanes[1])), simd4f_mul(offset[2], axis_lanes[2]));
+        for (size_t axis = 0; axis < 3; axis++) {
+            offset[axis] = simd4f_sub(offset[axis], simd4f_mul(along, axis_lanes[axis]));
+        }
+        simd4f_t distance_sqr = simd4f_add(simd4f_add(simd4f_mul(offset[0], offset[0]),
+            simd4f_mul(offset[1], offset[1])), simd4f_mul(offset[2], offset[2]));
+        // on the line itself (with no core), the tangent is zero, so
+        // FLT_MIN just keeps 0 / 0 from producing a NaN
+        simd4f_t denominator = simd4f_max(simd4f_add(distance_sqr,
+            simd4f_set1(field->vortex.core_radius * field->vortex.core_radius)), simd4f_set1(FLT_MIN));
+        simd4f_t scale = simd4f_div(simd4f_mul(mass, simd4f_set1(field->vortex.strength)), denominator);
+        // axis cross offset points along the rotation, and is as long as offset
+        simd4f_t tangent[3] = {
+            simd4f_sub(simd4f_mul(axis_lanes[1], offset[2]), simd4f_mul(axis_lanes[2], offset[1])),
+            simd4f_sub(simd4f_mul(axis_lanes[2], offset[0]), simd4f_mul(axis_lanes[0], offset[2])),
+            simd4f_sub(simd4f_mul(axis_lanes[0], offset[1]), simd4f_mul(axis_lanes[1], offset[0])),
+        };
+        for (size_t axis = 0; axis < 3; axis++) {
+            force[axis] = simd4f_add(force[axis], simd4f_mul(tangent[axis], scale));
+        }
+        break;
+    }
+    case FORCE_FIELD_GRID: {
+        // every lane reads different samples, so this part is scalar
+        float positions[3][SIMD_WIDTH], accelerations[3][SIMD_WIDTH];
+        for (size_t axis = 0; axis < 3; axis++) {
+            simd4f_store(positions[axis], position[axis]);
+        }
+        for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            phy_real_t point[3] = { positions[0][lane], positions[1][lane], positions[2][lane] };
+            phy_real_t acceleration[3] = { 0, 0, 0 };
+            force_field_sample_grid(field, point, acceleration);
+            for (size_t axis = 0; axis < 3; axis++) {
+                accelerations[axis][lane] = acceleration[axis];
+            }
+        }
+        for (size_t axis = 0; axis < 3; axis++) {
+            force[axis] = simd4f_add(force[axis], simd4f_mul(mass, simd4f_load(accelerations[axis])));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * [internal] the fused pass: adds every enabled field's force to bodies
+ * 0 through count - 1 of arrays, SIMD_WIDTH at a time.  The arrays must
+ * be readable up to the next multiple of SIMD_WIDTH, but nothing past
+ * count is written
+ */
+PRIVATE_FUNC void force_field_apply_arrays(const force_field_registry_t *registry, const force_field_folded_t *folded,
+        bool has_others, const force_field_arrays_t *arrays, size_t count) {
+    static const float lane_indices[SIMD_WIDTH] = { 0, 1, 2, 3 };
+    simd4f_t drag_coefficient = simd4f_set1(folded->drag_coefficient);
+
+    for (size_t batch = 0; batch < count; batch += SIMD_WIDTH) {
+        simd4f_t position[3], velocity[3], force[3];
+        simd4f_t mass = simd4f_load(&arrays->mass[batch]);
+        for (size_t axis = 0; axis < 3; axis++) {
+            position[axis] = simd4f_load(&arrays->position[axis][batch]);
+            velocity[axis] = simd4f_load(&arrays->velocity[axis][batch]);
+            force[axis] = simd4f_add(simd4f_mul(mass, simd4f_set1(folded->acceleration.raw[axis])),
+                simd4f_sub(simd4f_set1(folded->drag_flow.raw[axis]), simd4f_mul(velocity[axis], drag_coefficient)));
+        }
+        if (has_others) {
+            for (size_t i = 0; i < registry->count; i++) {
+                if (registry->fields[i].enabled) {
+                    force_field_add_one(&registry->fields[i], position, velocity, mass, force);
+                }
+            }
+        }
+
+        size_t lane_count = count - batch < SIMD_WIDTH ? count - batch : SIMD_WIDTH;
+        if (lane_count == SIMD_WIDTH) {
+            for (size_t axis = 0; axis < 3; axis++) {
+                simd4f_store(&arrays->force[axis][batch], simd4f_add(simd4f_load(&arrays->force[axis][batch]), force[axis]));
+            }
+            continue;
+        }
+        // the last few lanes aren't real bodies, so leave them alone
+        simd4f_t valid = simd4f_less_equal(simd4f_load(lane_indices), simd4f_set1((float)lane_count - 1));
+        for (size_t axis = 0; axis < 3; axis++) {
+            float forces[SIMD_WIDTH];
+            simd4f_store(forces, simd4f_select(valid, force[axis], simd4f_set1(0)));
+            for (size_t lane = 0; lane < lane_count; lane++) {
+                arrays->force[axis][batch + lane] += forces[lane];
+            }
+        }
+    }
+}
+
+int force_field_registry_apply(const force_field_registry_t *registry, body_t *bodies, size_t count) {
+    safe_assert(registry != NULL && (bodies != NULL || count == 0), FORCE_FIELD_ERROR_PARAMS);
+
+    force_field_folded_t folded;
+    bool has_others = force_field_fold(registry, &folded);
+
+    // copy the bodies out a chunk at a time, so the pass can run on
+    // arrays without allocating a copy of the whole world
+    phy_real_t positions[3][FORCE_FIELD_BODY_CHUNK], velocities[3][FORCE_FIELD_BODY_CHUNK];
+    phy_real_t masses[FORCE_FIELD_BODY_CHUNK], forces[3][FORCE_FIELD_BODY_CHUNK];
+    force_field_arrays_t arrays = {
+        .position = { positions[0], positions[1], positions[2] },
+        .velocity = { velocities[0], velocities[1], velocities[2] },
+        .mass = masses,
+        .force = { forces[0], forces[1], forces[2] },
+    };
+    for (size_t begin = 0; begin < count; begin += FORCE_FIELD_BODY_CHUNK) {
+        size_t chunk = count - begin < FORCE_FIELD_BODY_CHUNK ? count - begin : FORCE_FIELD_BODY_CHUNK;
+        for (size_t i = 0; i < chunk; i++) {
+            const body_t *body = &bodies[begin + i];
+            for (size_t axis = 0; axis < 3; axis++) {
+                positions[axis][i] = body->position.raw[axis];
+                velocities[axis][i] = body->velocity.raw[axis];
+                forces[axis][i] = 0;
+            }
+            masses[i] = body->mass;
+        }
+        // the rest of the last SIMD_WIDTH block is read, but never written back
+        for (size_t i = chunk; i < FORCE_FIELD_BODY_CHUNK && i % SIMD_WIDTH != 0; i++) {
+            for (size_t axis = 0; axis < 3; axis++) {
+                positions[axis][i] = velocities[axis][i] = forces[axis][i] = 0;
+            }
+            masses[i] = 0;
+        }
+
+        force_field_apply_arrays(registry, &folded, has_others, &arrays, chunk);
+
+        for (size_t i = 0; i < chunk; i++) {
+            body_t *body = &bodies[begin + i];
+            vec3_add_to(&body->net_force, vec3_make(forces[0][i], forces[1][i], forces[2][i]), 1);
+            // linear drag slows spinning too, like phy_body_add_drag_force();
+            // a flow only carries bodies along, so it doesn't count here
+            vec3_add_to(&body->net_torque, body->angular_velocity, -folded.drag_coefficient);
+        }
+    }
+    return FORCE_FIELD_SUCCESS;
+}
+
+int force_field_registry_apply_particles(const force_field_registry_t *registry, particle_system_t *particles) {
+    safe_assert(registry != NULL && particles != NULL, FORCE_FIELD_ERROR_PARAMS);
+
+    force_field_folded_t folded;
+    bool has_others = force_field_fold(registry, &folded);
+    // the particles' arrays are padded, so the last block is always readable
+    force_field_arrays_t arrays = {
+        .position = { particles->position_x, particles->position_y, particles->position_z },
+        .velocity = { particles->velocity_x, particles->velocity_y, particles->velocity_z },
+        .mass = particles->mass,
+        .force = { particles->force_x, particles->force_y, particles->force_z },
+    };
+    force_field_apply_arrays(registry, &folded, has_others, &arrays, particles->count);
+    return FORCE_FIELD_SUCCESS;
+}
+
+void force_field_registry_destroy(force_field_registry_t *registry) {
+    if (registry == NULL) {
+        return;
+    }
+    free(registry->fields);
+    free(registry);
+}
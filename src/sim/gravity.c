@@ -0,0 +1,203 @@
+#include "sim/gravity.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include "common/cpu.h"
+#include "common/simd.h"
+
+#if defined(CPU_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+/**
+ * [internal] adds the pull of points begin through count - 1 on point i
+ * to (*sum_x, *sum_y, *sum_z), one point at a time.  Finishes off
+ * whatever the vectorized loops leave over
+ */
+PRIVATE_FUNC void gravity_sum_scalar(const phy_real_t *x, const phy_real_t *y, const phy_real_t *z, const phy_real_t *mass,
+        size_t i, size_t begin, size_t count, phy_real_t *sum_x, phy_real_t *sum_y, phy_real_t *sum_z) {
+    for (size_t j = begin; j < count; j++) {
+        phy_real_t dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+        phy_real_t distance_sqr = dx * dx + dy * dy + dz * dz;
+        if (distance_sqr < FLT_MIN) {
+            continue;
+        }
+        // G m_i m_j / r^2, along the unit vector d / r
+        phy_real_t inverse_distance = 1.0f / sqrtf(distance_sqr);
+        phy_real_t strength = mass[j] * inverse_distance * inverse_distance * inverse_distance;
+        *sum_x += dx * strength;
+        *sum_y += dy * strength;
+        *sum_z += dz * strength;
+    }
+}
+
+PRIVATE_FUNC void gravity_add_forces_baseline(const phy_real_t *x, const phy_real_t *y, const phy_real_t *z, const phy_real_t *mass,
+        size_t count, phy_real_t *force_x, phy_real_t *force_y, phy_real_t *force_z) {
+    const simd4f_t min_distance_sqr = simd4f_set1(FLT_MIN);
+    const simd4f_t one = simd4f_set1(1);
+    for (size_t i = 0; i < count; i++) {
+        simd4f_t xi = simd4f_set1(x[i]), yi = simd4f_set1(y[i]), zi = simd4f_set1(z[i]);
+        simd4f_t sum_x = simd4f_set1(0), sum_y = simd4f_set1(0), sum_z = simd4f_set1(0);
+        size_t j = 0;
+        for (; j + SIMD_WIDTH <= count; j += SIMD_WIDTH) {
+            simd4f_t dx = simd4f_sub(simd4f_load(&x[j]), xi);
+            simd4f_t dy = simd4f_sub(simd4f_load(&y[j]), yi);
+            simd4f_t dz = simd4f_sub(simd4f_load(&z[j]), zi);
+            simd4f_t distance_sqr = simd4f_add(simd4f_add(simd4f_mul(dx, dx), simd4f_mul(dy, dy)), simd4f_mul(dz, dz));
+            // the point itself (and anything on top of it) is masked out instead of dividing by zero
+            simd4f_t apart = simd4f_greater_equal(distance_sqr, min_distance_sqr);
+            distance_sqr = simd4f_select(apart, distance_sqr, one);
+            simd4f_t inverse_distance = simd4f_div(one, simd4f_sqrt(distance_sqr));
+            simd4f_t strength = simd4f_mul(simd4f_mul(simd4f_load(&mass[j]), inverse_distance),
+                simd4f_mul(inverse_distance, inverse_distance));
+            strength = simd4f_and(apart, strength);
+            sum_x = simd4f_add(sum_x, simd4f_mul(dx, strength));
+            sum_y = simd4f_add(sum_y, simd4f_mul(dy, strength));
+            sum_z = simd4f_add(sum_z, simd4f_mul(dz, strength));
+        }
+        float lanes_x[SIMD_WIDTH], lanes_y[SIMD_WIDTH], lanes_z[SIMD_WIDTH];
+        simd4f_store(lanes_x, sum_x);
+        simd4f_store(lanes_y, sum_y);
+        simd4f_store(lanes_z, sum_z);
+        phy_real_t total_x = 0, total_y = 0, total_z = 0;
+        for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            total_x += lanes_x[lane];
+            total_y += lanes_y[lane];
+            total_z += lanes_z[lane];
+        }
+        gravity_sum_scalar(x, y, z, mass, i, j, count, &total_x, &total_y, &total_z);
+        phy_real_t scale = PHY_GRAVITATIONAL_CONSTANT * mass[i];
+        force_x[i] += total_x * scale;
+        force_y[i] += total_y * scale;
+        force_z[i] += total_z * scale;
+    }
+}
+
+#if defined(CPU_X86_DISPATCH)
+
+/**
+ * [internal] sums the lanes of an AVX vector
+ */
+PRIVATE_FUNC CPU_TARGET_AVX2 float gravity_sum_avx(__m256 value) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX2 void gravity_add_forces_avx2(const phy_real_t *x, const phy_real_t *y, const phy_real_t *z, const phy_real_t *mass,
+        size_t count, phy_real_t *force_x, phy_real_t *force_y, phy_real_t *force_z) {
+    const __m256 min_distance_sqr = _mm256_set1_ps(FLT_MIN);
+    const __m256 one = _mm256_set1_ps(1);
+    for (size_t i = 0; i < count; i++) {
+        __m256 xi = _mm256_set1_ps(x[i]), yi = _mm256_set1_ps(y[i]), zi = _mm256_set1_ps(z[i]);
+        __m256 sum_x = _mm256_setzero_ps(), sum_y = _mm256_setzero_ps(), sum_z = _mm256_setzero_ps();
+        size_t j = 0;
+        for (; j + 8 <= count; j += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&x[j]), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&y[j]), yi);
+            __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&z[j]), zi);
+            __m256 distance_sqr = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+            __m256 apart = _mm256_cmp_ps(distance_sqr, min_distance_sqr, _CMP_GE_OQ);
+            distance_sqr = _mm256_blendv_ps(one, distance_sqr, apart);
+            __m256 inverse_distance = _mm256_div_ps(one, _mm256_sqrt_ps(distance_sqr));
+            __m256 strength = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&mass[j]), inverse_distance),
+                _mm256_mul_ps(inverse_distance, inverse_distance));
+            strength = _mm256_and_ps(apart, strength);
+            sum_x = _mm256_fmadd_ps(dx, strength, sum_x);
+            sum_y = _mm256_fmadd_ps(dy, strength, sum_y);
+            sum_z = _mm256_fmadd_ps(dz, strength, sum_z);
+        }
+        phy_real_t total_x = gravity_sum_avx(sum_x), total_y = gravity_sum_avx(sum_y), total_z = gravity_sum_avx(sum_z);
+        gravity_sum_scalar(x, y, z, mass, i, j, count, &total_x, &total_y, &total_z);
+        phy_real_t scale = PHY_GRAVITATIONAL_CONSTANT * mass[i];
+        force_x[i] += total_x * scale;
+        force_y[i] += total_y * scale;
+        force_z[i] += total_z * scale;
+    }
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX512 void gravity_add_forces_avx512(const phy_real_t *x, const phy_real_t *y, const phy_real_t *z, const phy_real_t *mass,
+        size_t count, phy_real_t *force_x, phy_real_t *force_y, phy_real_t *force_z) {
+    const __m512 min_distance_sqr = _mm512_set1_ps(FLT_MIN);
+    const __m512 one = _mm512_set1_ps(1);
+    for (size_t i = 0; i < count; i++) {
+        __m512 xi = _mm512_set1_ps(x[i]), yi = _mm512_set1_ps(y[i]), zi = _mm512_set1_ps(z[i]);
+        __m512 sum_x = _mm512_setzero_ps(), sum_y = _mm512_setzero_ps(), sum_z = _mm512_setzero_ps();
+        size_t j = 0;
+        for (; j + 16 <= count; j += 16) {
+            __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(&x[j]), xi);
+            __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(&y[j]), yi);
+            __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(&z[j]), zi);
+            __m512 distance_sqr = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+            __mmask16 apart = _mm512_cmp_ps_mask(distance_sqr, min_distance_sqr, _CMP_GE_OQ);
+            distance_sqr = _mm512_mask_blend_ps(apart, one, distance_sqr);
+            __m512 inverse_distance = _mm512_div_ps(one, _mm512_sqrt_ps(distance_sqr));
+            __m512 strength = _mm512_maskz_mul_ps(apart, _mm512_mul_ps(_mm512_loadu_ps(&mass[j]), inverse_distance),
+                _mm512_mul_ps(inverse_distance, inverse_distance));
+            sum_x = _mm512_fmadd_ps(dx, strength, sum_x);
+            sum_y = _mm512_fmadd_ps(dy, strength, sum_y);
+            sum_z = _mm512_fmadd_ps(dz, strength, sum_z);
+        }
+        phy_real_t total_x = _mm512_reduce_add_ps(sum_x);
+        phy_real_t total_y = _mm512_reduce_add_ps(sum_y);
+        phy_real_t total_z = _mm512_reduce_add_ps(sum_z);
+        gravity_sum_scalar(x, y, z, mass, i, j, count, &total_x, &total_y, &total_z);
+        phy_real_t scale = PHY_GRAVITATIONAL_CONSTANT * mass[i];
+        force_x[i] += total_x * scale;
+        force_y[i] += total_y * scale;
+        force_z[i] += total_z * scale;
+    }
+}
+
+#endif
+
+void gravity_add_forces(const phy_real_t *x, const phy_real_t *y, const phy_real_t *z, const phy_real_t *mass,
+        size_t count, phy_real_t *force_x, phy_real_t *force_y, phy_real_t *force_z) {
+    safe_assert(count == 0 || (x != NULL && y != NULL && z != NULL && mass != NULL),);
+    safe_assert(count == 0 || (force_x != NULL && force_y != NULL && force_z != NULL),);
+
+    switch (cpu_get_isa()) {
+#if defined(CPU_X86_DISPATCH)
+        case CPU_ISA_AVX512:
+            gravity_add_forces_avx512(x, y, z, mass, count, force_x, force_y, force_z);
+            return;
+        case CPU_ISA_AVX2:
+            gravity_add_forces_avx2(x, y, z, mass, count, force_x, force_y, force_z);
+            return;
+#endif
+        default:
+            gravity_add_forces_baseline(x, y, z, mass, count, force_x, force_y, force_z);
+            return;
+    }
+}
+
+int phy_bodies_add_gravity_forces(body_t *bodies, size_t count) {
+    safe_assert(bodies != NULL || count == 0, GRAVITY_ERROR_PARAMS);
+    if (count == 0) {
+        return GRAVITY_SUCCESS;
+    }
+
+    // one allocation, split into the 7 arrays the kernel needs
+    phy_real_t *scratch = calloc(7 * count, sizeof (phy_real_t));
+    if (scratch == NULL) {
+        return GRAVITY_ERROR_ALLOC;
+    }
+    phy_real_t *x = scratch, *y = x + count, *z = y + count, *mass = z + count;
+    phy_real_t *force_x = mass + count, *force_y = force_x + count, *force_z = force_y + count;
+    for (size_t i = 0; i < count; i++) {
+        x[i] = bodies[i].position.x;
+        y[i] = bodies[i].position.y;
+        z[i] = bodies[i].position.z;
+        mass[i] = bodies[i].mass;
+    }
+
+    gravity_add_forces(x, y, z, mass, count, force_x, force_y, force_z);
+
+    for (size_t i = 0; i < count; i++) {
+        vec3_add_to(&bodies[i].net_force, vec3_make(force_x[i], force_y[i], force_z[i]), 1);
+    }
+    free(scratch);
+    return GRAVITY_SUCCESS;
+}
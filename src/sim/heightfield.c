@@ -0,0 +1,187 @@
+#include "sim/heightfield.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+heightfield_t *heightfield_create(const phy_real_t *heights, size_t columns, size_t rows, vec3_t origin, phy_real_t cell_size) {
+    if (heights == NULL || columns < 2 || rows < 2 || cell_size <= 0) {
+        return NULL;
+    }
+
+    heightfield_t *field = calloc(1, (sizeof *field));
+    if (field == NULL) {
+        return NULL;
+    }
+    field->heights = calloc(columns * rows, (sizeof *field->heights));
+    if (field->heights == NULL) {
+        heightfield_destroy(field);
+        return NULL;
+    }
+    memcpy(field->heights, heights, columns * rows * (sizeof *heights));
+    field->columns = columns;
+    field->rows = rows;
+    field->origin = origin;
+    field->cell_size = cell_size;
+
+    field->min_height = field->max_height = heights[0];
+    for (size_t i = 1; i < columns * rows; i++) {
+        field->min_height = min(field->min_height, heights[i]);
+        field->max_height = max(field->max_height, heights[i]);
+    }
+
+    return field;
+}
+
+void heightfield_set_height(heightfield_t *field, size_t column, size_t row, phy_real_t height) {
+    safe_assert(field != NULL && column < field->columns && row < field->rows,);
+
+    heightfield_get_height(field, column, row) = height;
+    // the range only ever grows, so it may end up looser
+    // than it needs to be, but it is always correct
+    field->min_height = min(field->min_height, height);
+    field->max_height = max(field->max_height, height);
+}
+
+vec3_t heightfield_get_point(const heightfield_t *field, size_t column, size_t row) {
+    return vec3_make(
+        field->origin.x + column * field->cell_size,
+        field->origin.y + heightfield_get_height(field, column, row),
+        field->origin.z + row * field->cell_size
+    );
+}
+
+void heightfield_get_cell_triangles(const heightfield_t *field, size_t column, size_t row, triangle_t triangles[HEIGHTFIELD_CELL_TRIANGLES]) {
+    vec3_t near_left = heightfield_get_point(field, column, row);
+    vec3_t near_right = heightfield_get_point(field, column + 1, row);
+    vec3_t far_left = heightfield_get_point(field, column, row + 1);
+    vec3_t far_right = heightfield_get_point(field, column + 1, row + 1);
+
+    // both triangles share the diagonal from near_right to far_left
+    triangles[0] = triangle_make(near_left, far_left, near_right);
+    triangles[1] = triangle_make(near_right, far_left, far_right);
+}
+
+/**
+ * Finds the range of cells covering a range of coordinates along one axis
+ * @param low The lowest coordinate, relative to the heightfield's origin
+ * @param high The highest coordinate, relative to the heightfield's origin
+ * @param samples The number of samples along the axis
+ * @return false if the range misses the heightfield entirely
+ */
+PRIVATE_FUNC bool heightfield_cell_range(const heightfield_t *field, phy_real_t low, phy_real_t high, size_t samples, size_t *first, size_t *last) {
+    if (high < 0 || low > (samples - 1) * field->cell_size) {
+        return false;
+    }
+    // anything right on the far edge belongs to the last cell
+    phy_real_t first_cell = floor(low / field->cell_size);
+    phy_real_t last_cell = floor(high / field->cell_size);
+    *first = first_cell < 0 ? 0 : (size_t)min(first_cell, samples - 2);
+    *last = (size_t)min(last_cell, samples - 2);
+    return true;
+}
+
+bool heightfield_sample_height(const heightfield_t *field, phy_real_t x, phy_real_t z, phy_real_t *height) {
+    safe_assert(field != NULL && height != NULL, false);
+
+    x -= field->origin.x;
+    z -= field->origin.z;
+    size_t column, row, unused;
+    if (!heightfield_cell_range(field, x, x, field->columns, &column, &unused) ||
+        !heightfield_cell_range(field, z, z, field->rows, &row, &unused)) {
+        return false;
+    }
+    // how far across the cell the point is along each axis
+    phy_real_t across_x = x / field->cell_size - column;
+    phy_real_t across_z = z / field->cell_size - row;
+    if (across_x > 1 || across_z > 1) {
+        return false; // past the far edge
+    }
+
+    phy_real_t near_left = heightfield_get_height(field, column, row);
+    phy_real_t near_right = heightfield_get_height(field, column + 1, row);
+    phy_real_t far_left = heightfield_get_height(field, column, row + 1);
+    phy_real_t far_right = heightfield_get_height(field, column + 1, row + 1);
+
+    // interpolate across whichever triangle the point is over
+    if (across_x + across_z <= 1) {
+        *height = near_left + (near_right - near_left) * across_x + (far_left - near_left) * across_z;
+    }
+    else {
+        *height = far_right + (far_left - far_right) * (1 - across_x) + (near_right - far_right) * (1 - across_z);
+    }
+    *height += field->origin.y;
+    return true;
+}
+
+void heightfield_get_bounds(const heightfield_t *field, bbox_t *box) {
+    safe_assert(field != NULL && box != NULL,);
+
+    box->position = VEC3_ZERO;
+    box->left = field->origin.x;
+    box->right = field->origin.x + (field->columns - 1) * field->cell_size;
+    box->bottom = field->origin.y + field->min_height;
+    box->top = field->origin.y + field->max_height;
+    box->back = field->origin.z;
+    box->front = field->origin.z + (field->rows - 1) * field->cell_size;
+}
+
+size_t heightfield_collide_collider(const heightfield_t *field, collider_t collider, contact_t *contacts, size_t max_contacts) {
+    safe_assert(field != NULL, 0);
+    safe_assert(contacts != NULL || max_contacts == 0, 0);
+
+    bbox_t bounds;
+    collider_get_bounds(collider, &bounds);
+    vec3_t bounds_min = bbox_get_min(bounds);
+    vec3_t bounds_max = bbox_get_max(bounds);
+    if (bounds_min.y > field->origin.y + field->max_height || bounds_max.y < field->origin.y + field->min_height) {
+        return 0; // entirely above or below the terrain
+    }
+
+    // the collider's bounds map straight to the cells under it
+    size_t first_column, last_column, first_row, last_row;
+    if (!heightfield_cell_range(field, bounds_min.x - field->origin.x, bounds_max.x - field->origin.x, field->columns, &first_column, &last_column) ||
+        !heightfield_cell_range(field, bounds_min.z - field->origin.z, bounds_max.z - field->origin.z, field->rows, &first_row, &last_row)) {
+        return 0;
+    }
+
+    size_t found = 0;
+    for (size_t row = first_row; row <= last_row; row++) {
+        for (size_t column = first_column; column <= last_column; column++) {
+            // most cells are nowhere near the collider vertically,
+            // so check the cell's height range before its triangles
+            phy_real_t near_left = heightfield_get_height(field, column, row);
+            phy_real_t near_right = heightfield_get_height(field, column + 1, row);
+            phy_real_t far_left = heightfield_get_height(field, column, row + 1);
+            phy_real_t far_right = heightfield_get_height(field, column + 1, row + 1);
+            phy_real_t cell_low = field->origin.y + min(min(near_left, near_right), min(far_left, far_right));
+            phy_real_t cell_high = field->origin.y + max(max(near_left, near_right), max(far_left, far_right));
+            if (bounds_min.y > cell_high || bounds_max.y < cell_low) {
+                continue;
+            }
+
+            triangle_t triangles[HEIGHTFIELD_CELL_TRIANGLES];
+            heightfield_get_cell_triangles(field, column, row, triangles);
+            for (size_t i = 0; i < HEIGHTFIELD_CELL_TRIANGLES; i++) {
+                contact_t contact;
+                if (!triangle_collide_collider(triangles[i], collider, &contact)) {
+                    continue;
+                }
+                if (found < max_contacts) {
+                    contacts[found] = contact;
+                }
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+void heightfield_destroy(heightfield_t *field) {
+    if (field == NULL) {
+        return;
+    }
+    free(field->heights);
+    free(field);
+}
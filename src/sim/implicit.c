@@ -0,0 +1,577 @@
+#include "sim/implicit.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+/**
+ * How many bodies (or springs) a thread takes at a time
+ */
+#define IMPLICIT_CHUNK_SIZE 256
+
+/**
+ * The default for how close the solver gets before it stops
+ */
+#define IMPLICIT_DEFAULT_TOLERANCE 1e-5
+
+/**
+ * The default for the most iterations the solver runs per step
+ */
+#define IMPLICIT_DEFAULT_MAX_ITERATIONS 200
+
+/**
+ * The number of solver vectors a system has
+ */
+#define IMPLICIT_VECTOR_COUNT 7
+
+/**
+ * Everything the parallel passes of a step need on each thread
+ */
+struct ImplicitStep {
+    implicit_spring_system_t *system;
+    phy_real_t dt;
+    /**
+     * The step sizes of the current conjugate gradient iteration
+     */
+    phy_real_t alpha;
+    phy_real_t beta;
+};
+typedef struct ImplicitStep implicit_step_t;
+
+/**
+ * Checks whether the springs can move a body
+ */
+PRIVATE_FUNC bool implicit_is_fixed(const body_t *body) {
+    return !(body->mass > 0) || !isfinite(body->mass);
+}
+
+PRIVATE_FUNC int implicit_compare_bodies(const void *a, const void *b) {
+    uintptr_t body_a = (uintptr_t)*(body_t *const *)a;
+    uintptr_t body_b = (uintptr_t)*(body_t *const *)b;
+    return (body_a > body_b) - (body_a < body_b);
+}
+
+/**
+ * Finds which row of the matrix belongs to a body
+ */
+PRIVATE_FUNC uint32_t implicit_find_row(const implicit_spring_system_t *system, body_t *body) {
+    body_t **found = bsearch(&body, system->bodies, system->body_count, (sizeof *system->bodies), implicit_compare_bodies);
+    return found - system->bodies;
+}
+
+/**
+ * Finds which block of a row is in a given column
+ */
+PRIVATE_FUNC uint32_t implicit_find_block(const implicit_spring_system_t *system, uint32_t row, uint32_t column) {
+    for (uint32_t block = system->row_starts[row]; block < system->row_starts[row + 1]; block++) {
+        if (system->columns[block] == column) {
+            return block;
+        }
+    }
+    return UINT32_MAX;
+}
+
+/**
+ * Lists every body attached to a spring, and which springs each is attached to
+ */
+PRIVATE_FUNC int implicit_springs_find_bodies(implicit_spring_system_t *system) {
+    system->bodies = malloc((2 * system->spring_count + 1) * (sizeof *system->bodies));
+    system->spring_rows_a = malloc((system->spring_count + 1) * (sizeof *system->spring_rows_a));
+    system->spring_rows_b = malloc((system->spring_count + 1) * (sizeof *system->spring_rows_b));
+    if (system->bodies == NULL || system->spring_rows_a == NULL || system->spring_rows_b == NULL) {
+        return IMPLICIT_ERROR_ALLOC;
+    }
+
+    size_t count = 0;
+    for (size_t s = 0; s < system->spring_count; s++) {
+        system->bodies[count++] = system->springs[s].a;
+        system->bodies[count++] = system->springs[s].b;
+    }
+    qsort(system->bodies, count, (sizeof *system->bodies), implicit_compare_bodies);
+    system->body_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (system->body_count == 0 || system->bodies[system->body_count - 1] != system->bodies[i]) {
+            system->bodies[system->body_count++] = system->bodies[i];
+        }
+    }
+    if (system->body_count >= UINT32_MAX) {
+        return IMPLICIT_ERROR_PARAMS;
+    }
+    for (size_t s = 0; s < system->spring_count; s++) {
+        system->spring_rows_a[s] = implicit_find_row(system, system->springs[s].a);
+        system->spring_rows_b[s] = implicit_find_row(system, system->springs[s].b);
+    }
+
+    // each spring is listed under both of its bodies.  A spring attached
+    // to the same body twice can't move it, so it isn't listed at all
+    system->attached_starts = calloc(system->body_count + 1, (sizeof *system->attached_starts));
+    system->attached_springs = malloc((2 * system->spring_count + 1) * (sizeof *system->attached_springs));
+    system->attached_blocks = malloc((2 * system->spring_count + 1) * (sizeof *system->attached_blocks));
+    if (system->attached_starts == NULL || system->attached_springs == NULL || system->attached_blocks == NULL) {
+        return IMPLICIT_ERROR_ALLOC;
+    }
+    for (size_t s = 0; s < system->spring_count; s++) {
+        if (system->spring_rows_a[s] != system->spring_rows_b[s]) {
+            system->attached_starts[system->spring_rows_a[s] + 1]++;
+            system->attached_starts[system->spring_rows_b[s] + 1]++;
+        }
+    }
+    for (size_t row = 0; row < system->body_count; row++) {
+        system->attached_starts[row + 1] += system->attached_starts[row];
+    }
+    uint32_t *next = malloc((system->body_count + 1) * (sizeof *next));
+    if (next == NULL) {
+        return IMPLICIT_ERROR_ALLOC;
+    }
+    memcpy(next, system->attached_starts, system->body_count * (sizeof *next));
+    for (size_t s = 0; s < system->spring_count; s++) {
+        if (system->spring_rows_a[s] != system->spring_rows_b[s]) {
+            system->attached_springs[next[system->spring_rows_a[s]]++] = s;
+            system->attached_springs[next[system->spring_rows_b[s]]++] = s;
+        }
+    }
+    free(next);
+    return IMPLICIT_SUCCESS;
+}
+
+/**
+ * Adds a column to a row's sorted list of columns, unless it's already
+ * there (two springs between the same bodies share a block)
+ */
+PRIVATE_FUNC void implicit_insert_column(uint32_t *columns, size_t *column_count, uint32_t column) {
+    size_t position = *column_count;
+    while (position > 0 && columns[position - 1] > column) {
+        position--;
+    }
+    if (position > 0 && columns[position - 1] == column) {
+        return;
+    }
+    memmove(&columns[position + 1], &columns[position], (*column_count - position) * (sizeof *columns));
+    columns[position] = column;
+    (*column_count)++;
+}
+
+/**
+ * Lays out the matrix: one block on the diagonal of each row, and one
+ * for each other body the row's body is attached to
+ */
+PRIVATE_FUNC int implicit_springs_build_pattern(implicit_spring_system_t *system) {
+    size_t max_blocks = system->body_count + system->attached_starts[system->body_count];
+    system->row_starts = malloc((system->body_count + 1) * (sizeof *system->row_starts));
+    system->columns = malloc((max_blocks + 1) * (sizeof *system->columns));
+    if (system->row_starts == NULL || system->columns == NULL) {
+        return IMPLICIT_ERROR_ALLOC;
+    }
+
+    uint32_t block_count = 0;
+    for (uint32_t row = 0; row < system->body_count; row++) {
+        system->row_starts[row] = block_count;
+        uint32_t *row_columns = &system->columns[block_count];
+        size_t column_count = 0;
+        implicit_insert_column(row_columns, &column_count, row);
+        for (uint32_t a = system->attached_starts[row]; a < system->attached_starts[row + 1]; a++) {
+            uint32_t spring = system->attached_springs[a];
+            implicit_insert_column(row_columns, &column_count,
+                system->spring_rows_a[spring] == row ? system->spring_rows_b[spring] : system->spring_rows_a[spring]);
+        }
+        block_count += column_count;
+    }
+    system->row_starts[system->body_count] = block_count;
+
+    for (uint32_t row = 0; row < system->body_count; row++) {
+        for (uint32_t a = system->attached_starts[row]; a < system->attached_starts[row + 1]; a++) {
+            uint32_t spring = system->attached_springs[a];
+            uint32_t other = system->spring_rows_a[spring] == row ? system->spring_rows_b[spring] : system->spring_rows_a[spring];
+            system->attached_blocks[a] = implicit_find_block(system, row, other);
+        }
+    }
+
+    system->blocks = calloc((size_t)block_count * IMPLICIT_BLOCK_SIZE + 1, (sizeof *system->blocks));
+    return system->blocks != NULL ? IMPLICIT_SUCCESS : IMPLICIT_ERROR_ALLOC;
+}
+
+/**
+ * Gets every solver vector, so they can all be allocated together
+ */
+PRIVATE_FUNC void implicit_get_vectors(implicit_spring_system_t *system, phy_real_t **vectors[IMPLICIT_VECTOR_COUNT]) {
+    phy_real_t **all[IMPLICIT_VECTOR_COUNT] = {
+        &system->rhs, &system->velocity_changes, &system->residuals, &system->preconditioned,
+        &system->directions, &system->products, &system->torques,
+    };
+    memcpy(vectors, all, (sizeof all));
+}
+
+implicit_spring_system_t *implicit_springs_create(const spring_t *springs, size_t spring_count, const periodic_box_t *box) {
+    if (springs == NULL && spring_count > 0) {
+        return NULL;
+    }
+    for (size_t s = 0; s < spring_count; s++) {
+        if (springs[s].a == NULL || springs[s].b == NULL) {
+            return NULL;
+        }
+    }
+
+    implicit_spring_system_t *system = calloc(1, (sizeof *system));
+    if (system == NULL) {
+        return NULL;
+    }
+    system->springs = springs;
+    system->spring_count = spring_count;
+    system->periodic = box != NULL;
+    if (box != NULL) {
+        system->periodic_box = *box;
+    }
+    system->tolerance = IMPLICIT_DEFAULT_TOLERANCE;
+    system->max_iterations = IMPLICIT_DEFAULT_MAX_ITERATIONS;
+    if (implicit_springs_find_bodies(system) != IMPLICIT_SUCCESS || implicit_springs_build_pattern(system) != IMPLICIT_SUCCESS) {
+        implicit_springs_destroy(system);
+        return NULL;
+    }
+
+    phy_real_t **vectors[IMPLICIT_VECTOR_COUNT];
+    implicit_get_vectors(system, vectors);
+    for (size_t v = 0; v < IMPLICIT_VECTOR_COUNT; v++) {
+        *vectors[v] = calloc(3 * system->body_count + 1, (sizeof **vectors[v]));
+    }
+    system->inverse_diagonals = calloc(IMPLICIT_BLOCK_SIZE * system->body_count + 1, (sizeof *system->inverse_diagonals));
+    system->spring_forces = calloc(3 * spring_count + 1, (sizeof *system->spring_forces));
+    system->spring_jacobians = calloc(IMPLICIT_BLOCK_SIZE * spring_count + 1, (sizeof *system->spring_jacobians));
+    // two sums per chunk
+    system->partial_sums = calloc(2 * (system->body_count / IMPLICIT_CHUNK_SIZE + 1), (sizeof *system->partial_sums));
+    bool allocated = system->inverse_diagonals != NULL && system->spring_forces != NULL &&
+        system->spring_jacobians != NULL && system->partial_sums != NULL;
+    for (size_t v = 0; v < IMPLICIT_VECTOR_COUNT; v++) {
+        allocated = allocated && *vectors[v] != NULL;
+    }
+    if (!allocated) {
+        implicit_springs_destroy(system);
+        return NULL;
+    }
+    return system;
+}
+
+/**
+ * Multiplies a 3x3 block by a vector, adding the result (times a scale) to dest
+ */
+PRIVATE_FUNC void implicit_block_multiply_add(phy_real_t *dest, const phy_real_t *block, const phy_real_t *vector, phy_real_t scale) {
+    for (size_t row = 0; row < 3; row++) {
+        dest[row] += scale * (block[row * 3] * vector[0] + block[row * 3 + 1] * vector[1] + block[row * 3 + 2] * vector[2]);
+    }
+}
+
+/**
+ * Inverts a 3x3 block.  Blocks too close to singular become the identity,
+ * which just leaves that row unpreconditioned
+ */
+PRIVATE_FUNC void implicit_block_invert(phy_real_t *dest, const phy_real_t *block) {
+    phy_real_t cofactors[IMPLICIT_BLOCK_SIZE] = {
+        block[4] * block[8] - block[5] * block[7],
+        block[2] * block[7] - block[1] * block[8],
+        block[1] * block[5] - block[2] * block[4],
+        block[5] * block[6] - block[3] * block[8],
+        block[0] * block[8] - block[2] * block[6],
+        block[2] * block[3] - block[0] * block[5],
+        block[3] * block[7] - block[4] * block[6],
+        block[1] * block[6] - block[0] * block[7],
+        block[0] * block[4] - block[1] * block[3],
+    };
+    phy_real_t determinant = block[0] * cofactors[0] + block[1] * cofactors[3] + block[2] * cofactors[6];
+    if (fabs(determinant) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        memset(dest, 0, IMPLICIT_BLOCK_SIZE * (sizeof *dest));
+        dest[0] = dest[4] = dest[8] = 1;
+        return;
+    }
+    for (size_t i = 0; i < IMPLICIT_BLOCK_SIZE; i++) {
+        dest[i] = cofactors[i] / determinant;
+    }
+}
+
+PRIVATE_FUNC void implicit_spring_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    implicit_spring_system_t *system = ((implicit_step_t *)context)->system;
+
+    for (size_t s = begin; s < end; s++) {
+        spring_t spring = system->springs[s];
+        vec3_t a_endpoint = spring.a->position;
+        vec3_add_to(&a_endpoint, spring.a_endpoint, 1);
+        vec3_t b_endpoint = spring.b->position;
+        vec3_add_to(&b_endpoint, spring.b_endpoint, 1);
+        vec3_t offset = periodic_box_get_displacement(system->periodic ? &system->periodic_box : NULL, a_endpoint, b_endpoint);
+        phy_real_t length = vec3_magnitude(offset);
+        phy_real_t *force = &system->spring_forces[3 * s];
+        phy_real_t *jacobian = &system->spring_jacobians[IMPLICIT_BLOCK_SIZE * s];
+
+        if (length < PHYSICS_EPSILON) {
+            // no direction to push in, so the spring is as stiff every way
+            memset(force, 0, 3 * (sizeof *force));
+            memset(jacobian, 0, IMPLICIT_BLOCK_SIZE * (sizeof *jacobian));
+            jacobian[0] = jacobian[4] = jacobian[8] = spring.spring_constant;
+            continue;
+        }
+
+        // the same force as spring_apply_constraint()
+        vec3_t direction = offset;
+        vec3_multiply_by(&direction, 1 / length);
+        phy_real_t magnitude = (length - spring.equilibrium_distance) * spring.spring_constant;
+        for (size_t axis = 0; axis < 3; axis++) {
+            force[axis] = direction.raw[axis] * magnitude;
+        }
+
+        // stretching pulls back with the full stiffness, while turning is
+        // resisted by the spring's tension.  A compressed spring would
+        // push sideways, which makes the matrix indefinite, so that part
+        // is dropped
+        phy_real_t tension = max(1 - spring.equilibrium_distance / length, 0);
+        for (size_t row = 0; row < 3; row++) {
+            for (size_t column = 0; column < 3; column++) {
+                phy_real_t outer = direction.raw[row] * direction.raw[column];
+                jacobian[row * 3 + column] = spring.spring_constant * (outer + tension * ((row == column) - outer));
+            }
+        }
+    }
+}
+
+PRIVATE_FUNC void implicit_assemble_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    implicit_step_t *step = context;
+    implicit_spring_system_t *system = step->system;
+    phy_real_t dt = step->dt;
+
+    for (size_t row = begin; row < end; row++) {
+        body_t *body = system->bodies[row];
+        phy_real_t *rhs = &system->rhs[3 * row];
+        phy_real_t *torque = &system->torques[3 * row];
+        uint32_t diagonal = implicit_find_block(system, row, row);
+        phy_real_t *diagonal_block = &system->blocks[IMPLICIT_BLOCK_SIZE * diagonal];
+        memset(&system->blocks[IMPLICIT_BLOCK_SIZE * system->row_starts[row]], 0,
+            IMPLICIT_BLOCK_SIZE * (system->row_starts[row + 1] - system->row_starts[row]) * (sizeof *system->blocks));
+        memset(rhs, 0, 3 * (sizeof *rhs));
+        memset(torque, 0, 3 * (sizeof *torque));
+
+        // a fixed body's row just says its velocity doesn't change
+        if (implicit_is_fixed(body)) {
+            diagonal_block[0] = diagonal_block[4] = diagonal_block[8] = 1;
+            implicit_block_invert(&system->inverse_diagonals[IMPLICIT_BLOCK_SIZE * row], diagonal_block);
+            continue;
+        }
+
+        diagonal_block[0] = diagonal_block[4] = diagonal_block[8] = body->mass;
+        for (size_t axis = 0; axis < 3; axis++) {
+            rhs[axis] = dt * body->net_force.raw[axis];
+        }
+        for (uint32_t a = system->attached_starts[row]; a < system->attached_starts[row + 1]; a++) {
+            uint32_t spring = system->attached_springs[a];
+            bool is_a = system->spring_rows_a[spring] == row;
+            body_t *other = is_a ? system->springs[spring].b : system->springs[spring].a;
+            const phy_real_t *jacobian = &system->spring_jacobians[IMPLICIT_BLOCK_SIZE * spring];
+
+            // the spring's force now, plus how much it will change over
+            // the step if the bodies keep moving as they are
+            vec3_t force = vec3_make(system->spring_forces[3 * spring], system->spring_forces[3 * spring + 1], system->spring_forces[3 * spring + 2]);
+            vec3_multiply_by(&force, is_a ? 1 : -1);
+            vec3_t relative_velocity = body->velocity;
+            vec3_add_to(&relative_velocity, other->velocity, -1);
+            for (size_t axis = 0; axis < 3; axis++) {
+                rhs[axis] += dt * force.raw[axis];
+            }
+            implicit_block_multiply_add(rhs, jacobian, relative_velocity.raw, -dt * dt);
+
+            for (size_t i = 0; i < IMPLICIT_BLOCK_SIZE; i++) {
+                diagonal_block[i] += dt * dt * jacobian[i];
+            }
+            // a fixed body's velocity change is always zero, so leaving
+            // its column out keeps the matrix symmetric
+            if (!implicit_is_fixed(other)) {
+                phy_real_t *coupling = &system->blocks[IMPLICIT_BLOCK_SIZE * system->attached_blocks[a]];
+                for (size_t i = 0; i < IMPLICIT_BLOCK_SIZE; i++) {
+                    coupling[i] -= dt * dt * jacobian[i];
+                }
+            }
+
+            vec3_t spring_torque;
+            vec3_cross_product(&spring_torque, is_a ? system->springs[spring].a_endpoint : system->springs[spring].b_endpoint, force);
+            for (size_t axis = 0; axis < 3; axis++) {
+                torque[axis] += spring_torque.raw[axis];
+            }
+        }
+        implicit_block_invert(&system->inverse_diagonals[IMPLICIT_BLOCK_SIZE * row], diagonal_block);
+    }
+}
+
+/**
+ * Multiplies the matrix by the search direction, and sums up
+ * direction . product for each chunk
+ */
+PRIVATE_FUNC void implicit_multiply_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    implicit_spring_system_t *system = ((implicit_step_t *)context)->system;
+
+    for (size_t chunk = begin; chunk < end; chunk += IMPLICIT_CHUNK_SIZE) {
+        size_t chunk_end = chunk + IMPLICIT_CHUNK_SIZE < end ? chunk + IMPLICIT_CHUNK_SIZE : end;
+        double sum = 0;
+        for (size_t row = chunk; row < chunk_end; row++) {
+            phy_real_t *product = &system->products[3 * row];
+            memset(product, 0, 3 * (sizeof *product));
+            for (uint32_t block = system->row_starts[row]; block < system->row_starts[row + 1]; block++) {
+                implicit_block_multiply_add(product, &system->blocks[IMPLICIT_BLOCK_SIZE * block],
+                    &system->directions[3 * system->columns[block]], 1);
+            }
+            for (size_t axis = 0; axis < 3; axis++) {
+                sum += (double)system->directions[3 * row + axis] * product[axis];
+            }
+        }
+        system->partial_sums[2 * (chunk / IMPLICIT_CHUNK_SIZE)] = sum;
+    }
+}
+
+/**
+ * Takes a step along the search direction, preconditions the new
+ * residual, and sums up residual . preconditioned and residual . residual
+ * for each chunk
+ */
+PRIVATE_FUNC void implicit_update_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    implicit_step_t *step = context;
+    implicit_spring_system_t *system = step->system;
+
+    for (size_t chunk = begin; chunk < end; chunk += IMPLICIT_CHUNK_SIZE) {
+        size_t chunk_end = chunk + IMPLICIT_CHUNK_SIZE < end ? chunk + IMPLICIT_CHUNK_SIZE : end;
+        double preconditioned_sum = 0, residual_sum = 0;
+        for (size_t row = chunk; row < chunk_end; row++) {
+            phy_real_t *residual = &system->residuals[3 * row];
+            phy_real_t *preconditioned = &system->preconditioned[3 * row];
+            for (size_t axis = 0; axis < 3; axis++) {
+                system->velocity_changes[3 * row + axis] += step->alpha * system->directions[3 * row + axis];
+                residual[axis] -= step->alpha * system->products[3 * row + axis];
+            }
+            memset(preconditioned, 0, 3 * (sizeof *preconditioned));
+            implicit_block_multiply_add(preconditioned, &system->inverse_diagonals[IMPLICIT_BLOCK_SIZE * row], residual, 1);
+            for (size_t axis = 0; axis < 3; axis++) {
+                preconditioned_sum += (double)residual[axis] * preconditioned[axis];
+                residual_sum += (double)residual[axis] * residual[axis];
+            }
+        }
+        system->partial_sums[2 * (chunk / IMPLICIT_CHUNK_SIZE)] = preconditioned_sum;
+        system->partial_sums[2 * (chunk / IMPLICIT_CHUNK_SIZE) + 1] = residual_sum;
+    }
+}
+
+PRIVATE_FUNC void implicit_direction_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    implicit_step_t *step = context;
+    implicit_spring_system_t *system = step->system;
+
+    for (size_t i = 3 * begin; i < 3 * end; i++) {
+        system->directions[i] = system->preconditioned[i] + step->beta * system->directions[i];
+    }
+}
+
+PRIVATE_FUNC void implicit_integrate_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    implicit_step_t *step = context;
+    implicit_spring_system_t *system = step->system;
+    phy_real_t dt = step->dt;
+
+    for (size_t row = begin; row < end; row++) {
+        body_t *body = system->bodies[row];
+        if (implicit_is_fixed(body)) {
+            continue;
+        }
+
+        vec3_t torque = body->net_torque;
+        for (size_t axis = 0; axis < 3; axis++) {
+            body->velocity.raw[axis] += system->velocity_changes[3 * row + axis];
+            torque.raw[axis] += system->torques[3 * row + axis];
+        }
+        vec3_add_to(&body->position, body->velocity, dt);
+        phy_body_integrate_rotation(body, torque, dt);
+        vec3_clear(&body->net_force);
+        vec3_clear(&body->net_torque);
+        if (system->periodic) {
+            body->position = periodic_box_wrap(&system->periodic_box, body->position);
+        }
+    }
+}
+
+/**
+ * Adds up every chunk's partial sum (of one of the two kinds), in order
+ */
+PRIVATE_FUNC double implicit_sum_partials(const implicit_spring_system_t *system, size_t which) {
+    double sum = 0;
+    size_t chunk_count = (system->body_count + IMPLICIT_CHUNK_SIZE - 1) / IMPLICIT_CHUNK_SIZE;
+    for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+        sum += system->partial_sums[2 * chunk + which];
+    }
+    return sum;
+}
+
+int implicit_springs_step(implicit_spring_system_t *system, phy_real_t dt, threadpool_t *pool) {
+    safe_assert(system != NULL && dt > 0, IMPLICIT_ERROR_PARAMS);
+
+    implicit_step_t step = { .system = system, .dt = dt };
+    size_t body_count = system->body_count;
+    threadpool_parallel_for(pool, system->spring_count, IMPLICIT_CHUNK_SIZE, implicit_spring_task, &step);
+    threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_assemble_task, &step);
+
+    // preconditioned conjugate gradient, starting from no velocity change.
+    // A zero-length step from there gives the first preconditioned residual
+    memset(system->velocity_changes, 0, 3 * body_count * (sizeof *system->velocity_changes));
+    memset(system->directions, 0, 3 * body_count * (sizeof *system->directions));
+    memset(system->products, 0, 3 * body_count * (sizeof *system->products));
+    memcpy(system->residuals, system->rhs, 3 * body_count * (sizeof *system->residuals));
+    step.alpha = 0;
+    threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_update_task, &step);
+    double preconditioned_dot = implicit_sum_partials(system, 0);
+    double residual_dot = implicit_sum_partials(system, 1);
+    double target = (double)system->tolerance * system->tolerance * residual_dot;
+    step.beta = 0;
+    threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_direction_task, &step);
+
+    system->iterations = 0;
+    while (residual_dot > target && system->iterations < system->max_iterations) {
+        threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_multiply_task, &step);
+        double curvature = implicit_sum_partials(system, 0);
+        if (!(curvature > 0)) {
+            break;
+        }
+        step.alpha = preconditioned_dot / curvature;
+        threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_update_task, &step);
+        double next_preconditioned_dot = implicit_sum_partials(system, 0);
+        residual_dot = implicit_sum_partials(system, 1);
+        step.beta = next_preconditioned_dot / preconditioned_dot;
+        preconditioned_dot = next_preconditioned_dot;
+        threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_direction_task, &step);
+        system->iterations++;
+    }
+
+    threadpool_parallel_for(pool, body_count, IMPLICIT_CHUNK_SIZE, implicit_integrate_task, &step);
+    return IMPLICIT_SUCCESS;
+}
+
+void implicit_springs_destroy(implicit_spring_system_t *system) {
+    if (system == NULL) {
+        return;
+    }
+
+    phy_real_t **vectors[IMPLICIT_VECTOR_COUNT];
+    implicit_get_vectors(system, vectors);
+    for (size_t v = 0; v < IMPLICIT_VECTOR_COUNT; v++) {
+        free(*vectors[v]);
+    }
+    free(system->bodies);
+    free(system->row_starts);
+    free(system->columns);
+    free(system->blocks);
+    free(system->inverse_diagonals);
+    free(system->attached_starts);
+    free(system->attached_springs);
+    free(system->attached_blocks);
+    free(system->spring_rows_a);
+    free(system->spring_rows_b);
+    free(system->spring_forces);
+    free(system->spring_jacobians);
+    free(system->partial_sums);
+    free(system);
+}
@@ -0,0 +1,729 @@
+#include "sim/kdtree.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <float.h>
+#include "common/defines.h"
+#include "common/math.h"
+#include "common/simd.h"
+
+/**
+ * The most subtrees the top of the tree is split into when
+ * building with multiple threads
+ */
+#define KDTREE_MAX_TASKS 256
+
+/**
+ * How many subtrees to make per thread when building, so that
+ * threads that finish early have something else to pick up
+ */
+#define KDTREE_TASKS_PER_THREAD 4
+
+/**
+ * How many queries a thread takes at a time when running a batch
+ */
+#define KDTREE_QUERY_CHUNK_SIZE 64
+
+/**
+ * Everything needed to build a kd-tree that isn't part of the tree itself
+ */
+struct KdTreeBuilder {
+    kdtree_t *tree;
+    /**
+     * Nodes this deep are left for the thread pool to build
+     */
+    size_t task_depth;
+    uint32_t tasks[KDTREE_MAX_TASKS];
+    size_t task_count;
+};
+typedef struct KdTreeBuilder kdtree_builder_t;
+
+/**
+ * Everything kdtree_query_nearest_batch() needs on each thread
+ */
+struct KdTreeNearestBatch {
+    const kdtree_t *tree;
+    const vec3_t *points;
+    size_t k;
+    uint32_t *indices;
+    phy_real_t *distances_sqr;
+};
+typedef struct KdTreeNearestBatch kdtree_nearest_batch_t;
+
+/**
+ * Everything kdtree_query_radius_batch() needs on each thread
+ */
+struct KdTreeRadiusBatch {
+    const kdtree_t *tree;
+    const vec3_t *points;
+    phy_real_t radius;
+    uint32_t *indices;
+    size_t max_indices;
+    size_t *index_counts;
+};
+typedef struct KdTreeRadiusBatch kdtree_radius_batch_t;
+
+/**
+ * Gets a point from a strided array
+ */
+PRIVATE_FUNC vec3_t kdtree_get_position(const vec3_t *positions, size_t stride, size_t index) {
+    return *(const vec3_t *)((const char *)positions + index * stride);
+}
+
+/**
+ * Gets one of the tree's points
+ */
+PRIVATE_FUNC vec3_t kdtree_get_point(const kdtree_t *tree, size_t point) {
+    return vec3_make(tree->x[point], tree->y[point], tree->z[point]);
+}
+
+/**
+ * Stores one of the tree's points, wrapping it into the
+ * tree's periodic box if it has one
+ */
+PRIVATE_FUNC void kdtree_set_point(kdtree_t *tree, size_t point, vec3_t position) {
+    if (tree->periodic) {
+        position = periodic_box_wrap(&tree->periodic_box, position);
+    }
+    tree->x[point] = position.x;
+    tree->y[point] = position.y;
+    tree->z[point] = position.z;
+}
+
+/**
+ * Recalculates a node's bounds from the points under it
+ */
+PRIVATE_FUNC void kdtree_bound_points(kdtree_t *tree, kdtree_node_t *node) {
+    node->bounds_min = vec3_make(FLT_MAX, FLT_MAX, FLT_MAX);
+    node->bounds_max = vec3_make(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t i = node->begin; i < node->end; i++) {
+        vec3_t point = kdtree_get_point(tree, i);
+        for (size_t axis = 0; axis < 3; axis++) {
+            node->bounds_min.raw[axis] = min(node->bounds_min.raw[axis], point.raw[axis]);
+            node->bounds_max.raw[axis] = max(node->bounds_max.raw[axis], point.raw[axis]);
+        }
+    }
+}
+
+/**
+ * Swaps two of the tree's points
+ */
+PRIVATE_FUNC void kdtree_swap_points(kdtree_t *tree, size_t a, size_t b) {
+    phy_real_t *coordinates[3] = { tree->x, tree->y, tree->z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t tmp = coordinates[axis][a];
+        coordinates[axis][a] = coordinates[axis][b];
+        coordinates[axis][b] = tmp;
+    }
+    uint32_t tmp = tree->indices[a];
+    tree->indices[a] = tree->indices[b];
+    tree->indices[b] = tmp;
+}
+
+/**
+ * Rearranges a range of points so that the point with the nth-smallest
+ * coordinate along the given axis is at index nth, with everything before
+ * it smaller and everything after it larger (quickselect)
+ */
+PRIVATE_FUNC void kdtree_partition(kdtree_t *tree, size_t begin, size_t end, size_t nth, size_t axis) {
+    const phy_real_t *coordinates = axis == 0 ? tree->x : axis == 1 ? tree->y : tree->z;
+    size_t low = begin;
+    size_t high = end - 1;
+    while (low < high) {
+        phy_real_t pivot = coordinates[low + (high - low) / 2];
+        size_t i = low;
+        size_t j = high;
+        while (i <= j) {
+            while (coordinates[i] < pivot) {
+                i++;
+            }
+            while (coordinates[j] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                kdtree_swap_points(tree, i, j);
+                i++;
+                if (j == 0) {
+                    break;
+                }
+                j--;
+            }
+        }
+        // only keep searching the side that contains nth
+        if (nth <= j) {
+            high = j;
+        }
+        else if (nth >= i) {
+            low = i;
+        }
+        else {
+            return;
+        }
+    }
+}
+
+/**
+ * Splits a node's points in half along its widest axis, then does the
+ * same for each half until they are small enough to be leaves
+ * @param builder If not null, nodes at the builder's task depth are
+ * saved for later instead of being split
+ */
+PRIVATE_FUNC void kdtree_build_node(kdtree_t *tree, kdtree_builder_t *builder, uint32_t node_index, size_t depth) {
+    kdtree_node_t *node = &tree->nodes[node_index];
+    kdtree_bound_points(tree, node);
+    node->left = node->right = KDTREE_LEAF;
+    if (node->end - node->begin <= KDTREE_LEAF_SIZE) {
+        return;
+    }
+    if (builder != NULL && depth == builder->task_depth) {
+        builder->tasks[builder->task_count++] = node_index;
+        return;
+    }
+
+    size_t axis = 0;
+    for (size_t i = 1; i < 3; i++) {
+        if (node->bounds_max.raw[i] - node->bounds_min.raw[i] > node->bounds_max.raw[axis] - node->bounds_min.raw[axis]) {
+            axis = i;
+        }
+    }
+    size_t middle = node->begin + (node->end - node->begin) / 2;
+    kdtree_partition(tree, node->begin, node->end, middle, axis);
+
+    // children are always allocated together, so different threads
+    // building different subtrees never need to coordinate beyond this
+    uint32_t left = atomic_fetch_add(&tree->node_count, 2);
+    uint32_t right = left + 1;
+    node->left = left;
+    node->right = right;
+    tree->nodes[left].begin = node->begin;
+    tree->nodes[left].end = middle;
+    tree->nodes[right].begin = middle;
+    tree->nodes[right].end = node->end;
+    kdtree_build_node(tree, builder, left, depth + 1);
+    kdtree_build_node(tree, builder, right, depth + 1);
+}
+
+PRIVATE_FUNC void kdtree_build_tasks(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    kdtree_builder_t *builder = context;
+    for (size_t i = begin; i < end; i++) {
+        kdtree_build_node(builder->tree, NULL, builder->tasks[i], 0);
+    }
+}
+
+/**
+ * Builds the tree's nodes from its points, which must already be loaded
+ */
+PRIVATE_FUNC void kdtree_build(kdtree_t *tree, threadpool_t *pool) {
+    atomic_store(&tree->node_count, 1);
+    tree->nodes[0].begin = 0;
+    tree->nodes[0].end = tree->point_count;
+
+    size_t thread_count = threadpool_get_thread_count(pool);
+    if (thread_count == 1) {
+        kdtree_build_node(tree, NULL, 0, 0);
+        return;
+    }
+
+    // build the top of the tree here, until there are enough
+    // subtrees to keep every thread busy, then build those in parallel
+    kdtree_builder_t builder = {
+        .tree = tree,
+        .task_depth = 0,
+        .task_count = 0,
+    };
+    while (((size_t)1 << builder.task_depth) < thread_count * KDTREE_TASKS_PER_THREAD &&
+        ((size_t)2 << builder.task_depth) <= KDTREE_MAX_TASKS) {
+        builder.task_depth++;
+    }
+    kdtree_build_node(tree, &builder, 0, 0);
+    threadpool_parallel_for(pool, builder.task_count, 1, kdtree_build_tasks, &builder);
+}
+
+/**
+ * Loads points into the tree in their original order
+ */
+PRIVATE_FUNC void kdtree_load_points(kdtree_t *tree, const vec3_t *positions, size_t stride) {
+    for (size_t i = 0; i < tree->point_count; i++) {
+        kdtree_set_point(tree, i, kdtree_get_position(positions, stride, i));
+        tree->indices[i] = i;
+    }
+}
+
+kdtree_t *kdtree_create(const vec3_t *positions, size_t count, size_t stride, threadpool_t *pool) {
+    if ((positions == NULL && count > 0) || count > UINT32_MAX / 2) {
+        return NULL;
+    }
+
+    kdtree_t *tree = calloc(1, (sizeof *tree));
+    if (tree == NULL) {
+        return NULL;
+    }
+    // allocate at least one point so that an empty tree still has arrays
+    size_t point_capacity = count > 0 ? count : 1;
+    tree->x = calloc(point_capacity, (sizeof *tree->x));
+    tree->y = calloc(point_capacity, (sizeof *tree->y));
+    tree->z = calloc(point_capacity, (sizeof *tree->z));
+    tree->indices = calloc(point_capacity, (sizeof *tree->indices));
+    tree->point_count = count;
+    // every split leaves at least half a leaf's worth of points on each
+    // side, which limits how many leaves (and so nodes) there can be
+    tree->node_capacity = 2 * (count / ((KDTREE_LEAF_SIZE + 1) / 2) + 1);
+    tree->nodes = calloc(tree->node_capacity, (sizeof *tree->nodes));
+    if (tree->x == NULL || tree->y == NULL || tree->z == NULL || tree->indices == NULL || tree->nodes == NULL) {
+        kdtree_destroy(tree);
+        return NULL;
+    }
+
+    kdtree_load_points(tree, positions, stride);
+    kdtree_build(tree, pool);
+    return tree;
+}
+
+void kdtree_rebuild(kdtree_t *tree, const vec3_t *positions, size_t stride, threadpool_t *pool) {
+    safe_assert(tree != NULL && (positions != NULL || tree->point_count == 0),);
+
+    kdtree_load_points(tree, positions, stride);
+    kdtree_build(tree, pool);
+}
+
+/**
+ * Recalculates every node's bounds from the tree's points
+ */
+PRIVATE_FUNC void kdtree_refit_bounds(kdtree_t *tree) {
+    // every node comes before its children, so walking backwards
+    // guarantees children are refit before their parents
+    for (size_t node_index = atomic_load(&tree->node_count); node_index-- > 0;) {
+        kdtree_node_t *node = &tree->nodes[node_index];
+        if (node->left == KDTREE_LEAF) {
+            kdtree_bound_points(tree, node);
+            continue;
+        }
+        const kdtree_node_t *left = &tree->nodes[node->left];
+        const kdtree_node_t *right = &tree->nodes[node->right];
+        for (size_t axis = 0; axis < 3; axis++) {
+            node->bounds_min.raw[axis] = min(left->bounds_min.raw[axis], right->bounds_min.raw[axis]);
+            node->bounds_max.raw[axis] = max(left->bounds_max.raw[axis], right->bounds_max.raw[axis]);
+        }
+    }
+}
+
+void kdtree_refit(kdtree_t *tree, const vec3_t *positions, size_t stride) {
+    safe_assert(tree != NULL && (positions != NULL || tree->point_count == 0),);
+
+    for (size_t i = 0; i < tree->point_count; i++) {
+        kdtree_set_point(tree, i, kdtree_get_position(positions, stride, tree->indices[i]));
+    }
+    kdtree_refit_bounds(tree);
+}
+
+void kdtree_set_periodic_box(kdtree_t *tree, const periodic_box_t *box) {
+    safe_assert(tree != NULL,);
+
+    tree->periodic = box != NULL;
+    if (box == NULL) {
+        return;
+    }
+    tree->periodic_box = *box;
+    for (size_t i = 0; i < tree->point_count; i++) {
+        kdtree_set_point(tree, i, kdtree_get_point(tree, i));
+    }
+    kdtree_refit_bounds(tree);
+}
+
+/**
+ * Finds the squared distance from a point to the closest part of a node's bounds
+ */
+PRIVATE_FUNC phy_real_t kdtree_node_distance_sqr(const kdtree_node_t *node, vec3_t point) {
+    phy_real_t distance_sqr = 0;
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t outside = max(max(node->bounds_min.raw[axis] - point.raw[axis], point.raw[axis] - node->bounds_max.raw[axis]), 0);
+        distance_sqr += outside * outside;
+    }
+    return distance_sqr;
+}
+
+/**
+ * Finds the squared distance from a point to the furthest part of a node's bounds
+ */
+PRIVATE_FUNC phy_real_t kdtree_node_furthest_distance_sqr(const kdtree_node_t *node, vec3_t point) {
+    phy_real_t distance_sqr = 0;
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t furthest = max(fabs(point.raw[axis] - node->bounds_min.raw[axis]), fabs(point.raw[axis] - node->bounds_max.raw[axis]));
+        distance_sqr += furthest * furthest;
+    }
+    return distance_sqr;
+}
+
+/**
+ * Calculates the squared distance from a point to four of the tree's points at once
+ */
+PRIVATE_FUNC simd4f_t kdtree_distance_sqr4(const kdtree_t *tree, size_t first, simd4f_t point_x, simd4f_t point_y, simd4f_t point_z) {
+    simd4f_t dx = simd4f_sub(simd4f_load(&tree->x[first]), point_x);
+    simd4f_t dy = simd4f_sub(simd4f_load(&tree->y[first]), point_y);
+    simd4f_t dz = simd4f_sub(simd4f_load(&tree->z[first]), point_z);
+    return simd4f_add(simd4f_add(simd4f_mul(dx, dx), simd4f_mul(dy, dy)), simd4f_mul(dz, dz));
+}
+
+/**
+ * Moves an entry of a max-heap down until it is larger than its children
+ */
+PRIVATE_FUNC void kdtree_heap_sift_down_from(uint32_t *indices, phy_real_t *distances_sqr, size_t size, size_t parent) {
+    while (true) {
+        size_t largest = parent;
+        size_t left = 2 * parent + 1;
+        size_t right = left + 1;
+        if (left < size && distances_sqr[left] > distances_sqr[largest]) {
+            largest = left;
+        }
+        if (right < size && distances_sqr[right] > distances_sqr[largest]) {
+            largest = right;
+        }
+        if (largest == parent) {
+            return;
+        }
+        phy_real_t tmp_distance = distances_sqr[parent];
+        distances_sqr[parent] = distances_sqr[largest];
+        distances_sqr[largest] = tmp_distance;
+        uint32_t tmp_index = indices[parent];
+        indices[parent] = indices[largest];
+        indices[largest] = tmp_index;
+        parent = largest;
+    }
+}
+
+/**
+ * Moves the root of a max-heap down until it is larger than its children
+ */
+PRIVATE_FUNC void kdtree_heap_sift_down(uint32_t *indices, phy_real_t *distances_sqr, size_t size) {
+    kdtree_heap_sift_down_from(indices, distances_sqr, size, 0);
+}
+
+/**
+ * Adds a point to the max-heap of the nearest points found so far,
+ * pushing out the furthest one if the heap is full
+ * @param unique If set, a point already in the heap isn't added again;
+ * it just keeps whichever distance is smaller.  Needed when the same
+ * point can be reached through more than one periodic image
+ */
+PRIVATE_FUNC void kdtree_heap_offer(uint32_t *indices, phy_real_t *distances_sqr, size_t *size, size_t k, uint32_t index,
+        phy_real_t distance_sqr, bool unique) {
+    if (unique) {
+        for (size_t i = 0; i < *size; i++) {
+            if (indices[i] != index) {
+                continue;
+            }
+            if (distance_sqr < distances_sqr[i]) {
+                // a smaller key only ever has to move down a max-heap
+                distances_sqr[i] = distance_sqr;
+                kdtree_heap_sift_down_from(indices, distances_sqr, *size, i);
+            }
+            return;
+        }
+    }
+    if (*size < k) {
+        // sift up
+        size_t child = (*size)++;
+        while (child > 0 && distances_sqr[(child - 1) / 2] < distance_sqr) {
+            size_t parent = (child - 1) / 2;
+            distances_sqr[child] = distances_sqr[parent];
+            indices[child] = indices[parent];
+            child = parent;
+        }
+        distances_sqr[child] = distance_sqr;
+        indices[child] = index;
+        return;
+    }
+    if (distance_sqr >= distances_sqr[0]) {
+        return;
+    }
+    distances_sqr[0] = distance_sqr;
+    indices[0] = index;
+    kdtree_heap_sift_down(indices, distances_sqr, k);
+}
+
+/**
+ * Adds the points nearest to a location to a max-heap of the nearest
+ * points found so far
+ */
+PRIVATE_FUNC void kdtree_search_nearest(const kdtree_t *tree, vec3_t point, size_t k, uint32_t *indices, phy_real_t *distances_sqr,
+        size_t *found, bool unique) {
+    simd4f_t point_x = simd4f_set1(point.x);
+    simd4f_t point_y = simd4f_set1(point.y);
+    simd4f_t point_z = simd4f_set1(point.z);
+
+    // the stack remembers how close each node is, so nodes can be
+    // skipped if enough nearer points were found after they were pushed
+    uint32_t stack[KDTREE_MAX_DEPTH * 2];
+    phy_real_t stack_distances_sqr[KDTREE_MAX_DEPTH * 2];
+    size_t stack_size = 0;
+    stack[stack_size] = 0;
+    stack_distances_sqr[stack_size++] = kdtree_node_distance_sqr(&tree->nodes[0], point);
+
+    while (stack_size > 0) {
+        stack_size--;
+        if (*found == k && stack_distances_sqr[stack_size] >= distances_sqr[0]) {
+            continue;
+        }
+        const kdtree_node_t *node = &tree->nodes[stack[stack_size]];
+
+        if (node->left == KDTREE_LEAF) {
+            size_t i = node->begin;
+            for (; i + SIMD_WIDTH <= node->end; i += SIMD_WIDTH) {
+                phy_real_t lane_distances_sqr[SIMD_WIDTH];
+                simd4f_store(lane_distances_sqr, kdtree_distance_sqr4(tree, i, point_x, point_y, point_z));
+                for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+                    if (*found == k && lane_distances_sqr[lane] >= distances_sqr[0]) {
+                        continue;
+                    }
+                    kdtree_heap_offer(indices, distances_sqr, found, k, tree->indices[i + lane], lane_distances_sqr[lane], unique);
+                }
+            }
+            for (; i < node->end; i++) {
+                vec3_t offset = kdtree_get_point(tree, i);
+                vec3_add_to(&offset, point, -1);
+                kdtree_heap_offer(indices, distances_sqr, found, k, tree->indices[i], vec3_magnitude_sqr(offset), unique);
+            }
+            continue;
+        }
+
+        // push the nearer child last, so it is searched first
+        const kdtree_node_t *left = &tree->nodes[node->left];
+        const kdtree_node_t *right = &tree->nodes[node->right];
+        phy_real_t left_distance_sqr = kdtree_node_distance_sqr(left, point);
+        phy_real_t right_distance_sqr = kdtree_node_distance_sqr(right, point);
+        bool left_first = left_distance_sqr <= right_distance_sqr;
+        uint32_t children[2] = { left_first ? node->right : node->left, left_first ? node->left : node->right };
+        phy_real_t children_distance_sqr[2] = {
+            left_first ? right_distance_sqr : left_distance_sqr,
+            left_first ? left_distance_sqr : right_distance_sqr,
+        };
+        for (size_t child = 0; child < 2; child++) {
+            if (*found == k && children_distance_sqr[child] >= distances_sqr[0]) {
+                continue;
+            }
+            stack[stack_size] = children[child];
+            stack_distances_sqr[stack_size++] = children_distance_sqr[child];
+        }
+    }
+}
+
+/**
+ * Finds the ways a search around a point has to be shifted to
+ * reach across the faces of the tree's periodic box
+ * @param reach How far the search could extend from the point
+ */
+PRIVATE_FUNC size_t kdtree_get_search_images(const kdtree_t *tree, vec3_t point, phy_real_t reach, vec3_t shifts[PERIODIC_MAX_IMAGES]) {
+    if (!tree->periodic) {
+        shifts[0] = VEC3_ZERO;
+        return 1;
+    }
+    bbox_t search_bounds = {
+        .position = point,
+        .left = -reach,
+        .right = reach,
+        .bottom = -reach,
+        .top = reach,
+        .back = -reach,
+        .front = reach,
+    };
+    return periodic_box_get_images(&tree->periodic_box, search_bounds, shifts);
+}
+
+size_t kdtree_query_nearest(const kdtree_t *tree, vec3_t point, size_t k, uint32_t *indices, phy_real_t *distances_sqr) {
+    safe_assert(tree != NULL, 0);
+    safe_assert((indices != NULL && distances_sqr != NULL) || k == 0, 0);
+    if (k == 0 || tree->point_count == 0) {
+        return 0;
+    }
+
+    // under the minimum image convention, nothing is further than half
+    // the box away, so that's as far as the search needs to reach
+    vec3_t shifts[PERIODIC_MAX_IMAGES];
+    size_t image_count = 1;
+    if (tree->periodic) {
+        point = periodic_box_wrap(&tree->periodic_box, point);
+        phy_real_t half_size = max(max(tree->periodic_box.size.x, tree->periodic_box.size.y), tree->periodic_box.size.z) / 2;
+        image_count = kdtree_get_search_images(tree, point, half_size, shifts);
+    }
+    else {
+        shifts[0] = VEC3_ZERO;
+    }
+
+    // a small box can put more than one image of a point within reach,
+    // so each point keeps only its nearest (minimum image) distance
+    size_t found = 0;
+    for (size_t image = 0; image < image_count; image++) {
+        vec3_t image_point = point;
+        vec3_add_to(&image_point, shifts[image], 1);
+        kdtree_search_nearest(tree, image_point, k, indices, distances_sqr, &found, image_count > 1);
+    }
+
+    // heapsort, so the nearest point comes first
+    for (size_t size = found; size > 1; size--) {
+        phy_real_t tmp_distance = distances_sqr[0];
+        distances_sqr[0] = distances_sqr[size - 1];
+        distances_sqr[size - 1] = tmp_distance;
+        uint32_t tmp_index = indices[0];
+        indices[0] = indices[size - 1];
+        indices[size - 1] = tmp_index;
+        kdtree_heap_sift_down(indices, distances_sqr, size - 1);
+    }
+    return found;
+}
+
+/**
+ * Adds every point within a given distance of a location to a list
+ * @param found The number of points already in the list
+ * @return The number of points in the list afterwards
+ */
+PRIVATE_FUNC size_t kdtree_search_radius(const kdtree_t *tree, vec3_t point, phy_real_t radius, uint32_t *indices, size_t max_indices, size_t found) {
+    phy_real_t radius_sqr = radius * radius;
+    simd4f_t point_x = simd4f_set1(point.x);
+    simd4f_t point_y = simd4f_set1(point.y);
+    simd4f_t point_z = simd4f_set1(point.z);
+    simd4f_t radius_sqr4 = simd4f_set1(radius_sqr);
+
+    uint32_t stack[KDTREE_MAX_DEPTH * 2];
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const kdtree_node_t *node = &tree->nodes[stack[--stack_size]];
+        if (kdtree_node_distance_sqr(node, point) > radius_sqr) {
+            continue;
+        }
+
+        // nodes entirely inside the search don't need their points checked
+        if (kdtree_node_furthest_distance_sqr(node, point) <= radius_sqr) {
+            for (size_t i = node->begin; i < node->end; i++) {
+                if (found < max_indices) {
+                    indices[found] = tree->indices[i];
+                }
+                found++;
+            }
+            continue;
+        }
+
+        if (node->left != KDTREE_LEAF) {
+            stack[stack_size++] = node->left;
+            stack[stack_size++] = node->right;
+            continue;
+        }
+
+        size_t i = node->begin;
+        for (; i + SIMD_WIDTH <= node->end; i += SIMD_WIDTH) {
+            uint32_t inside = simd4f_mask_bits(simd4f_less_equal(
+                kdtree_distance_sqr4(tree, i, point_x, point_y, point_z), radius_sqr4));
+            for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+                if ((inside & (1u << lane)) == 0) {
+                    continue;
+                }
+                if (found < max_indices) {
+                    indices[found] = tree->indices[i + lane];
+                }
+                found++;
+            }
+        }
+        for (; i < node->end; i++) {
+            vec3_t offset = kdtree_get_point(tree, i);
+            vec3_add_to(&offset, point, -1);
+            if (vec3_magnitude_sqr(offset) > radius_sqr) {
+                continue;
+            }
+            if (found < max_indices) {
+                indices[found] = tree->indices[i];
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+size_t kdtree_query_radius(const kdtree_t *tree, vec3_t point, phy_real_t radius, uint32_t *indices, size_t max_indices) {
+    safe_assert(tree != NULL, 0);
+    safe_assert(indices != NULL || max_indices == 0, 0);
+    if (tree->point_count == 0) {
+        return 0;
+    }
+
+    if (tree->periodic) {
+        point = periodic_box_wrap(&tree->periodic_box, point);
+    }
+    vec3_t shifts[PERIODIC_MAX_IMAGES];
+    size_t image_count = kdtree_get_search_images(tree, point, radius, shifts);
+
+    size_t found = 0;
+    for (size_t image = 0; image < image_count; image++) {
+        vec3_t image_point = point;
+        vec3_add_to(&image_point, shifts[image], 1);
+        found = kdtree_search_radius(tree, image_point, radius, indices, max_indices, found);
+    }
+    return found;
+}
+
+PRIVATE_FUNC void kdtree_query_nearest_chunk(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    kdtree_nearest_batch_t *batch = context;
+    for (size_t i = begin; i < end; i++) {
+        kdtree_query_nearest(batch->tree, batch->points[i], batch->k, &batch->indices[i * batch->k], &batch->distances_sqr[i * batch->k]);
+    }
+}
+
+size_t kdtree_query_nearest_batch(const kdtree_t *tree, const vec3_t *points, size_t count, size_t k,
+    uint32_t *indices, phy_real_t *distances_sqr, threadpool_t *pool)
+{
+    safe_assert(tree != NULL, 0);
+    safe_assert(points != NULL || count == 0, 0);
+    safe_assert((indices != NULL && distances_sqr != NULL) || count == 0 || k == 0, 0);
+
+    kdtree_nearest_batch_t batch = {
+        .tree = tree,
+        .points = points,
+        .k = k,
+        .indices = indices,
+        .distances_sqr = distances_sqr,
+    };
+    threadpool_parallel_for(pool, count, KDTREE_QUERY_CHUNK_SIZE, kdtree_query_nearest_chunk, &batch);
+    return k < tree->point_count ? k : tree->point_count;
+}
+
+PRIVATE_FUNC void kdtree_query_radius_chunk(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    kdtree_radius_batch_t *batch = context;
+    for (size_t i = begin; i < end; i++) {
+        batch->index_counts[i] = kdtree_query_radius(batch->tree, batch->points[i], batch->radius,
+            batch->indices != NULL ? &batch->indices[i * batch->max_indices] : NULL, batch->max_indices);
+    }
+}
+
+void kdtree_query_radius_batch(const kdtree_t *tree, const vec3_t *points, size_t count, phy_real_t radius,
+    uint32_t *indices, size_t max_indices, size_t *index_counts, threadpool_t *pool)
+{
+    safe_assert(tree != NULL,);
+    safe_assert((points != NULL && index_counts != NULL) || count == 0,);
+    safe_assert(indices != NULL || max_indices == 0,);
+
+    kdtree_radius_batch_t batch = {
+        .tree = tree,
+        .points = points,
+        .radius = radius,
+        .indices = indices,
+        .max_indices = max_indices,
+        .index_counts = index_counts,
+    };
+    threadpool_parallel_for(pool, count, KDTREE_QUERY_CHUNK_SIZE, kdtree_query_radius_chunk, &batch);
+}
+
+void kdtree_destroy(kdtree_t *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    free(tree->x);
+    free(tree->y);
+    free(tree->z);
+    free(tree->indices);
+    free(tree->nodes);
+    free(tree);
+}
@@ -0,0 +1,219 @@
+#include "sim/neighbor.h"
+
+#include <stdlib.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+/**
+ * How many neighbors per point a list starts out with room for
+ */
+#define NEIGHBOR_DEFAULT_CAPACITY_PER_POINT 8
+
+/**
+ * Gets a point from a strided array
+ */
+PRIVATE_FUNC vec3_t neighbor_get_position(const vec3_t *positions, size_t stride, size_t index) {
+    return *(const vec3_t *)((const char *)positions + index * stride);
+}
+
+/**
+ * Makes sure the next update rebuilds the list
+ */
+PRIVATE_FUNC void neighbor_list_invalidate(neighbor_list_t *list) {
+    for (size_t i = 0; i < list->point_count; i++) {
+        list->reference_positions[i] = vec3_make(INFINITY, INFINITY, INFINITY);
+    }
+}
+
+void neighbor_list_set_periodic_box(neighbor_list_t *list, const periodic_box_t *box) {
+    safe_assert(list != NULL,);
+
+    list->periodic = box != NULL;
+    if (box != NULL) {
+        list->periodic_box = *box;
+    }
+    kdtree_set_periodic_box(list->tree, box);
+    neighbor_list_invalidate(list);
+}
+
+bool neighbor_list_needs_rebuild(const neighbor_list_t *list, const vec3_t *positions, size_t stride) {
+    safe_assert(list != NULL && (positions != NULL || list->point_count == 0), true);
+
+    // two points can only close the skin between them if
+    // at least one of them covers half of it
+    // (through the periodic box, so wrapping around doesn't count as moving)
+    const periodic_box_t *box = list->periodic ? &list->periodic_box : NULL;
+    phy_real_t limit = list->skin / 2;
+    for (size_t i = 0; i < list->point_count; i++) {
+        if (!isfinite(list->reference_positions[i].x)) {
+            return true;
+        }
+        vec3_t moved = periodic_box_get_displacement(box, list->reference_positions[i], neighbor_get_position(positions, stride, i));
+        if (vec3_magnitude_sqr(moved) > limit * limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Makes sure the list has room for at least one more neighbor
+ */
+PRIVATE_FUNC int neighbor_list_reserve(neighbor_list_t *list) {
+    if (list->neighbor_count < list->neighbor_capacity) {
+        return NEIGHBOR_SUCCESS;
+    }
+    size_t new_capacity = list->neighbor_capacity * 2;
+    uint32_t *new_neighbors = reallocarray(list->neighbors, new_capacity, (sizeof *list->neighbors));
+    if (new_neighbors == NULL) {
+        return NEIGHBOR_ERROR_ALLOC;
+    }
+    list->neighbors = new_neighbors;
+    list->neighbor_capacity = new_capacity;
+    return NEIGHBOR_SUCCESS;
+}
+
+/**
+ * Finds every point within range of a point, growing the
+ * scratch buffer if there are too many to fit
+ * @return The number of points found, or 0 on failure
+ */
+PRIVATE_FUNC size_t neighbor_list_query(neighbor_list_t *list, vec3_t point, phy_real_t range) {
+    size_t found = kdtree_query_radius(list->tree, point, range, list->scratch, list->scratch_capacity);
+    if (found <= list->scratch_capacity) {
+        return found;
+    }
+
+    uint32_t *new_scratch = reallocarray(list->scratch, found * 2, (sizeof *list->scratch));
+    if (new_scratch == NULL) {
+        return 0;
+    }
+    list->scratch = new_scratch;
+    list->scratch_capacity = found * 2;
+    return kdtree_query_radius(list->tree, point, range, list->scratch, list->scratch_capacity);
+}
+
+/**
+ * Finds every pair of points within range of each other
+ */
+PRIVATE_FUNC int neighbor_list_fill(neighbor_list_t *list, const vec3_t *positions, size_t stride) {
+    phy_real_t range = list->cutoff + list->skin;
+    for (size_t i = 0; i < list->point_count; i++) {
+        vec3_t position = neighbor_get_position(positions, stride, i);
+        list->reference_positions[i] = position;
+        list->offsets[i] = list->neighbor_count;
+
+        // every point finds at least itself, so finding nothing means
+        // the scratch buffer couldn't grow
+        size_t found = neighbor_list_query(list, position, range);
+        if (found == 0) {
+            return NEIGHBOR_ERROR_ALLOC;
+        }
+        for (size_t n = 0; n < found; n++) {
+            uint32_t neighbor = list->scratch[n];
+            if (neighbor <= i) {
+                continue;
+            }
+            if (neighbor_list_reserve(list) != NEIGHBOR_SUCCESS) {
+                return NEIGHBOR_ERROR_ALLOC;
+            }
+            list->neighbors[list->neighbor_count++] = neighbor;
+        }
+    }
+    list->offsets[list->point_count] = list->neighbor_count;
+    return NEIGHBOR_SUCCESS;
+}
+
+/**
+ * Fills in the list from a tree that is already built over positions
+ */
+PRIVATE_FUNC int neighbor_list_build(neighbor_list_t *list, const vec3_t *positions, size_t stride) {
+    list->build_count++;
+    list->neighbor_count = 0;
+
+    int result = neighbor_list_fill(list, positions, stride);
+    if (result != NEIGHBOR_SUCCESS) {
+        // leave the list empty, and make sure the next update rebuilds it
+        list->neighbor_count = 0;
+        for (size_t i = 0; i <= list->point_count; i++) {
+            list->offsets[i] = 0;
+        }
+        neighbor_list_invalidate(list);
+    }
+    return result;
+}
+
+int neighbor_list_rebuild(neighbor_list_t *list, const vec3_t *positions, size_t stride) {
+    safe_assert(list != NULL, NEIGHBOR_ERROR_PARAMS);
+    safe_assert(positions != NULL || list->point_count == 0, NEIGHBOR_ERROR_PARAMS);
+
+    kdtree_rebuild(list->tree, positions, stride, NULL);
+    return neighbor_list_build(list, positions, stride);
+}
+
+neighbor_list_t *neighbor_list_create(const vec3_t *positions, size_t count, size_t stride, phy_real_t cutoff, phy_real_t skin) {
+    if ((positions == NULL && count > 0) || cutoff < 0 || skin < 0 || count > UINT32_MAX) {
+        return NULL;
+    }
+
+    neighbor_list_t *list = calloc(1, (sizeof *list));
+    if (list == NULL) {
+        return NULL;
+    }
+    list->cutoff = cutoff;
+    list->skin = skin;
+    list->point_count = count;
+    list->offsets = calloc(count + 1, (sizeof *list->offsets));
+    list->neighbor_capacity = (count > 0 ? count : 1) * NEIGHBOR_DEFAULT_CAPACITY_PER_POINT;
+    list->neighbors = calloc(list->neighbor_capacity, (sizeof *list->neighbors));
+    list->reference_positions = calloc(count > 0 ? count : 1, (sizeof *list->reference_positions));
+    list->scratch_capacity = NEIGHBOR_DEFAULT_CAPACITY_PER_POINT * 2;
+    list->scratch = calloc(list->scratch_capacity, (sizeof *list->scratch));
+    list->tree = kdtree_create(positions, count, stride, NULL);
+    if (list->offsets == NULL || list->neighbors == NULL || list->reference_positions == NULL ||
+        list->scratch == NULL || list->tree == NULL) {
+        neighbor_list_destroy(list);
+        return NULL;
+    }
+
+    // the tree was just built, so only the list needs filling in
+    if (neighbor_list_build(list, positions, stride) != NEIGHBOR_SUCCESS) {
+        neighbor_list_destroy(list);
+        return NULL;
+    }
+    return list;
+}
+
+int neighbor_list_update(neighbor_list_t *list, const vec3_t *positions, size_t stride) {
+    safe_assert(list != NULL, NEIGHBOR_ERROR_PARAMS);
+
+    if (!neighbor_list_needs_rebuild(list, positions, stride)) {
+        return NEIGHBOR_SUCCESS;
+    }
+    return neighbor_list_rebuild(list, positions, stride);
+}
+
+void phy_bodies_add_pair_forces(body_t *bodies, const neighbor_list_t *list, const pair_potential_t *potential) {
+    safe_assert(list != NULL && potential != NULL,);
+    safe_assert(bodies != NULL || list->point_count == 0,);
+
+    const periodic_box_t *box = list->periodic ? &list->periodic_box : NULL;
+    for (size_t i = 0; i < list->point_count; i++) {
+        for (size_t n = list->offsets[i]; n < list->offsets[i + 1]; n++) {
+            phy_body_add_pair_force_periodic(&bodies[i], &bodies[list->neighbors[n]], potential, box);
+        }
+    }
+}
+
+void neighbor_list_destroy(neighbor_list_t *list) {
+    if (list == NULL) {
+        return;
+    }
+    free(list->offsets);
+    free(list->neighbors);
+    free(list->reference_positions);
+    free(list->scratch);
+    kdtree_destroy(list->tree);
+    free(list);
+}
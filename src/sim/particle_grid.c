@@ -0,0 +1,231 @@
+#include "sim/particle_grid.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+/**
+ * How many particles a thread takes at a time
+ */
+#define PARTICLE_GRID_CHUNK_SIZE 1024
+
+/**
+ * The most cells per particle.  Particles spread out further than
+ * this get bigger cells, to keep the grid's memory in check
+ */
+#define PARTICLE_GRID_MAX_CELLS_PER_PARTICLE 4
+
+/**
+ * The most cells allowed regardless of the particle count
+ */
+#define PARTICLE_GRID_MIN_CELLS 4096
+
+/**
+ * Everything particle_grid_build() needs on each thread
+ */
+struct ParticleGridBuild {
+    particle_grid_t *grid;
+    const phy_real_t *x;
+    const phy_real_t *y;
+    const phy_real_t *z;
+    /**
+     * The bounds of the particles each thread has seen so far
+     */
+    vec3_t mins[THREADPOOL_MAX_THREADS];
+    vec3_t maxes[THREADPOOL_MAX_THREADS];
+};
+typedef struct ParticleGridBuild particle_grid_build_t;
+
+particle_grid_t *particle_grid_create(void) {
+    return calloc(1, (sizeof (particle_grid_t)));
+}
+
+/**
+ * Finds which cell a point is in.  Points outside the grid are put in
+ * the nearest cell, which never pulls two neighbors apart
+ */
+PRIVATE_FUNC void particle_grid_get_cell(const particle_grid_t *grid, vec3_t point, size_t cell[3]) {
+    phy_real_t inverse_cell_size = 1 / grid->cell_size;
+    size_t grid_size[3] = { grid->size_x, grid->size_y, grid->size_z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t offset = floor((point.raw[axis] - grid->origin.raw[axis]) * inverse_cell_size);
+        cell[axis] = offset <= 0 ? 0 : min(offset, grid_size[axis] - 1);
+    }
+}
+
+/**
+ * Turns a cell into its number
+ */
+PRIVATE_FUNC uint32_t particle_grid_get_cell_key(const particle_grid_t *grid, size_t x, size_t y, size_t z) {
+    return x + grid->size_x * (y + grid->size_y * z);
+}
+
+PRIVATE_FUNC void particle_grid_find_bounds_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    particle_grid_build_t *build = context;
+
+    vec3_t bounds_min = build->mins[thread_index];
+    vec3_t bounds_max = build->maxes[thread_index];
+    for (size_t i = begin; i < end; i++) {
+        bounds_min.x = min(bounds_min.x, build->x[i]);
+        bounds_min.y = min(bounds_min.y, build->y[i]);
+        bounds_min.z = min(bounds_min.z, build->z[i]);
+        bounds_max.x = max(bounds_max.x, build->x[i]);
+        bounds_max.y = max(bounds_max.y, build->y[i]);
+        bounds_max.z = max(bounds_max.z, build->z[i]);
+    }
+    build->mins[thread_index] = bounds_min;
+    build->maxes[thread_index] = bounds_max;
+}
+
+PRIVATE_FUNC void particle_grid_compute_keys_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    particle_grid_build_t *build = context;
+    particle_grid_t *grid = build->grid;
+
+    for (size_t i = begin; i < end; i++) {
+        size_t cell[3];
+        particle_grid_get_cell(grid, vec3_make(build->x[i], build->y[i], build->z[i]), cell);
+        grid->cell_keys[i] = particle_grid_get_cell_key(grid, cell[0], cell[1], cell[2]);
+    }
+}
+
+/**
+ * Makes room for a given number of particles and cells
+ */
+PRIVATE_FUNC int particle_grid_reserve(particle_grid_t *grid, size_t particle_count, size_t cell_count) {
+    if (particle_count > grid->particle_capacity) {
+        uint32_t **arrays[] = { &grid->cell_keys, &grid->cell_particles };
+        for (size_t i = 0; i < (sizeof arrays) / (sizeof *arrays); i++) {
+            uint32_t *array = reallocarray(*arrays[i], particle_count, (sizeof *array));
+            if (array == NULL) {
+                return PARTICLE_GRID_ERROR_ALLOC;
+            }
+            *arrays[i] = array;
+        }
+        grid->particle_capacity = particle_count;
+    }
+    if (cell_count > grid->cell_capacity || grid->cell_starts == NULL) {
+        uint32_t *cell_starts = reallocarray(grid->cell_starts, cell_count + 1, (sizeof *cell_starts));
+        if (cell_starts == NULL) {
+            return PARTICLE_GRID_ERROR_ALLOC;
+        }
+        grid->cell_starts = cell_starts;
+        grid->cell_capacity = cell_count;
+    }
+    return PARTICLE_GRID_SUCCESS;
+}
+
+int particle_grid_build(particle_grid_t *grid, const phy_real_t *x, const phy_real_t *y, const phy_real_t *z,
+    size_t count, phy_real_t min_cell_size, threadpool_t *pool)
+{
+    safe_assert(grid != NULL && ((x != NULL && y != NULL && z != NULL) || count == 0), PARTICLE_GRID_ERROR_PARAMS);
+    safe_assert(min_cell_size > 0 && count < UINT32_MAX, PARTICLE_GRID_ERROR_PARAMS);
+
+    particle_grid_build_t build = { .grid = grid, .x = x, .y = y, .z = z };
+    for (size_t thread = 0; thread < THREADPOOL_MAX_THREADS; thread++) {
+        build.mins[thread] = vec3_make(INFINITY, INFINITY, INFINITY);
+        build.maxes[thread] = vec3_make(-INFINITY, -INFINITY, -INFINITY);
+    }
+    threadpool_parallel_for(pool, count, PARTICLE_GRID_CHUNK_SIZE, particle_grid_find_bounds_task, &build);
+    vec3_t bounds_min = build.mins[0];
+    vec3_t bounds_max = build.maxes[0];
+    for (size_t thread = 1; thread < THREADPOOL_MAX_THREADS; thread++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            bounds_min.raw[axis] = min(bounds_min.raw[axis], build.mins[thread].raw[axis]);
+            bounds_max.raw[axis] = max(bounds_max.raw[axis], build.maxes[thread].raw[axis]);
+        }
+    }
+    vec3_t extent = bounds_max;
+    vec3_add_to(&extent, bounds_min, -1);
+    if (count == 0) {
+        bounds_min = extent = VEC3_ZERO;
+    }
+    // a particle that's flown off to infinity (or become NaN) can't be put in any cell
+    if (!isfinite(extent.x) || !isfinite(extent.y) || !isfinite(extent.z)) {
+        return PARTICLE_GRID_ERROR_PARAMS;
+    }
+
+    // if the particles are spread out enough that the grid
+    // would get too big, the cells are made bigger instead
+    grid->cell_size = min_cell_size;
+    size_t max_cells = count * PARTICLE_GRID_MAX_CELLS_PER_PARTICLE + PARTICLE_GRID_MIN_CELLS;
+    double volume = ((double)extent.x + grid->cell_size) * ((double)extent.y + grid->cell_size) * ((double)extent.z + grid->cell_size);
+    if (volume / ((double)grid->cell_size * grid->cell_size * grid->cell_size) > max_cells) {
+        grid->cell_size = cbrt(volume / max_cells);
+    }
+    grid->origin = bounds_min;
+    grid->size_x = (size_t)(extent.x / grid->cell_size) + 1;
+    grid->size_y = (size_t)(extent.y / grid->cell_size) + 1;
+    grid->size_z = (size_t)(extent.z / grid->cell_size) + 1;
+    size_t cell_count = grid->size_x * grid->size_y * grid->size_z;
+    if (cell_count >= UINT32_MAX) {
+        return PARTICLE_GRID_ERROR_ALLOC;
+    }
+    int result = particle_grid_reserve(grid, count, cell_count);
+    if (result != PARTICLE_GRID_SUCCESS) {
+        return result;
+    }
+    grid->particle_count = count;
+
+    threadpool_parallel_for(pool, count, PARTICLE_GRID_CHUNK_SIZE, particle_grid_compute_keys_task, &build);
+
+    // counting sort: count each cell, turn the counts into where each
+    // cell ends, then fill every cell from its end backwards
+    memset(grid->cell_starts, 0, (cell_count + 1) * (sizeof *grid->cell_starts));
+    for (size_t i = 0; i < count; i++) {
+        grid->cell_starts[grid->cell_keys[i]]++;
+    }
+    uint32_t total = 0;
+    for (size_t cell = 0; cell < cell_count; cell++) {
+        total += grid->cell_starts[cell];
+        grid->cell_starts[cell] = total;
+    }
+    grid->cell_starts[cell_count] = total;
+    for (size_t i = count; i-- > 0;) {
+        grid->cell_particles[--grid->cell_starts[grid->cell_keys[i]]] = i;
+    }
+    return PARTICLE_GRID_SUCCESS;
+}
+
+size_t particle_grid_get_neighbor_runs(const particle_grid_t *grid, vec3_t point,
+    uint32_t run_begins[PARTICLE_GRID_MAX_RUNS], uint32_t run_ends[PARTICLE_GRID_MAX_RUNS])
+{
+    safe_assert(grid != NULL && run_begins != NULL && run_ends != NULL, 0);
+    if (grid->particle_count == 0) {
+        return 0;
+    }
+
+    size_t cell[3];
+    particle_grid_get_cell(grid, point, cell);
+
+    // neighboring cells along x are next to each other in the grid,
+    // so each row of them is one run of particles
+    size_t first_x = cell[0] > 0 ? cell[0] - 1 : 0;
+    size_t last_x = cell[0] + 1 < grid->size_x ? cell[0] + 1 : cell[0];
+    size_t first_y = cell[1] > 0 ? cell[1] - 1 : 0;
+    size_t last_y = cell[1] + 1 < grid->size_y ? cell[1] + 1 : cell[1];
+    size_t first_z = cell[2] > 0 ? cell[2] - 1 : 0;
+    size_t last_z = cell[2] + 1 < grid->size_z ? cell[2] + 1 : cell[2];
+    size_t run_count = 0;
+    for (size_t cell_z = first_z; cell_z <= last_z; cell_z++) {
+        for (size_t cell_y = first_y; cell_y <= last_y; cell_y++) {
+            run_begins[run_count] = grid->cell_starts[particle_grid_get_cell_key(grid, first_x, cell_y, cell_z)];
+            run_ends[run_count] = grid->cell_starts[particle_grid_get_cell_key(grid, last_x, cell_y, cell_z) + 1];
+            run_count++;
+        }
+    }
+    return run_count;
+}
+
+void particle_grid_destroy(particle_grid_t *grid) {
+    if (grid == NULL) {
+        return;
+    }
+
+    free(grid->cell_keys);
+    free(grid->cell_starts);
+    free(grid->cell_particles);
+    free(grid);
+}
@@ -0,0 +1,286 @@
+#include "sim/particles.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "common/defines.h"
+#include "common/cpu.h"
+#include "common/simd.h"
+#include "sim/gravity.h"
+
+#if defined(CPU_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+/**
+ * The number of per-particle arrays a system has
+ */
+#define PARTICLES_ARRAY_COUNT 10
+
+/**
+ * The number of the system's particles (real or padding) the kernels touch
+ */
+#define particle_system_padded_count(system) \
+    (((system)->count + PARTICLES_ALIGNMENT - 1) / PARTICLES_ALIGNMENT * PARTICLES_ALIGNMENT)
+
+/**
+ * [internal] gets every per-particle array, in the order they are laid
+ * out in the system's block of memory
+ */
+PRIVATE_FUNC void particle_system_get_arrays(particle_system_t *system, phy_real_t **arrays[PARTICLES_ARRAY_COUNT]) {
+    phy_real_t **all[PARTICLES_ARRAY_COUNT] = {
+        &system->position_x, &system->position_y, &system->position_z,
+        &system->velocity_x, &system->velocity_y, &system->velocity_z,
+        &system->mass,
+        &system->force_x, &system->force_y, &system->force_z,
+    };
+    memcpy(arrays, all, (sizeof all));
+}
+
+/**
+ * [internal] turns particles begin through end - 1 into padding
+ */
+PRIVATE_FUNC void particle_system_pad_range(particle_system_t *system, size_t begin, size_t end) {
+    phy_real_t **arrays[PARTICLES_ARRAY_COUNT];
+    particle_system_get_arrays(system, arrays);
+    for (size_t array = 0; array < PARTICLES_ARRAY_COUNT; array++) {
+        memset(*arrays[array] + begin, 0, (end - begin) * sizeof (phy_real_t));
+    }
+    // a mass of one keeps the step from dividing by zero
+    for (size_t i = begin; i < end; i++) {
+        system->mass[i] = 1;
+    }
+}
+
+PRIVATE_FUNC int particle_system_reserve(particle_system_t *system, size_t capacity) {
+    if (capacity <= system->capacity) {
+        return PARTICLES_SUCCESS;
+    }
+    size_t new_capacity = system->capacity > 0 ? system->capacity : PARTICLES_ALIGNMENT;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    // one block, with every array as aligned as the block since the
+    // capacity is a multiple of PARTICLES_ALIGNMENT
+    phy_real_t *block = aligned_alloc(64, PARTICLES_ARRAY_COUNT * new_capacity * sizeof (phy_real_t));
+    if (block == NULL) {
+        return PARTICLES_ERROR_ALLOC;
+    }
+
+    phy_real_t *old_block = system->position_x;
+    size_t old_capacity = system->capacity;
+    phy_real_t **arrays[PARTICLES_ARRAY_COUNT];
+    particle_system_get_arrays(system, arrays);
+    for (size_t array = 0; array < PARTICLES_ARRAY_COUNT; array++) {
+        *arrays[array] = block + array * new_capacity;
+        if (old_block != NULL) {
+            memcpy(*arrays[array], old_block + array * old_capacity, system->count * sizeof (phy_real_t));
+        }
+    }
+    system->capacity = new_capacity;
+    particle_system_pad_range(system, system->count, new_capacity);
+    free(old_block);
+    return PARTICLES_SUCCESS;
+}
+
+particle_system_t *particle_system_create(size_t capacity) {
+    particle_system_t *system = calloc(1, sizeof (particle_system_t));
+    if (system == NULL) {
+        return NULL;
+    }
+    if (particle_system_reserve(system, capacity > 0 ? capacity : 1) != PARTICLES_SUCCESS) {
+        free(system);
+        return NULL;
+    }
+    return system;
+}
+
+int particle_system_add(particle_system_t *system, vec3_t position, vec3_t velocity, phy_real_t mass) {
+    safe_assert(system != NULL && mass > 0, PARTICLES_ERROR_PARAMS);
+    safe_assert(system->count < UINT32_MAX, PARTICLES_ERROR_PARAMS);
+
+    int result = particle_system_reserve(system, system->count + 1);
+    if (result != PARTICLES_SUCCESS) {
+        return result;
+    }
+    size_t i = system->count++;
+    system->position_x[i] = position.x;
+    system->position_y[i] = position.y;
+    system->position_z[i] = position.z;
+    system->velocity_x[i] = velocity.x;
+    system->velocity_y[i] = velocity.y;
+    system->velocity_z[i] = velocity.z;
+    system->mass[i] = mass;
+    return PARTICLES_SUCCESS;
+}
+
+int particle_system_add_body(particle_system_t *system, const body_t *body) {
+    safe_assert(body != NULL, PARTICLES_ERROR_PARAMS);
+    return particle_system_add(system, body->position, body->velocity, body->mass);
+}
+
+void particle_system_add_force(particle_system_t *system, size_t index, vec3_t force) {
+    safe_assert(system != NULL && index < system->count,);
+    system->force_x[index] += force.x;
+    system->force_y[index] += force.y;
+    system->force_z[index] += force.z;
+}
+
+void particle_system_add_gravity_forces(particle_system_t *system) {
+    safe_assert(system != NULL,);
+    gravity_add_forces(system->position_x, system->position_y, system->position_z, system->mass, system->count,
+        system->force_x, system->force_y, system->force_z);
+}
+
+void particle_system_add_drag_force(particle_system_t *system, phy_real_t drag_coefficient) {
+    safe_assert(system != NULL,);
+
+    // padding particles never move, so they never feel any drag
+    simd4f_t coefficient = simd4f_set1(-drag_coefficient);
+    size_t padded_count = particle_system_padded_count(system);
+    for (size_t i = 0; i < padded_count; i += SIMD_WIDTH) {
+        simd4f_store(&system->force_x[i], simd4f_add(simd4f_load(&system->force_x[i]), simd4f_mul(simd4f_load(&system->velocity_x[i]), coefficient)));
+        simd4f_store(&system->force_y[i], simd4f_add(simd4f_load(&system->force_y[i]), simd4f_mul(simd4f_load(&system->velocity_y[i]), coefficient)));
+        simd4f_store(&system->force_z[i], simd4f_add(simd4f_load(&system->force_z[i]), simd4f_mul(simd4f_load(&system->velocity_z[i]), coefficient)));
+    }
+}
+
+/**
+ * [internal] steps one axis of SIMD_WIDTH particles, starting at i, and
+ * clears their forces
+ */
+PRIVATE_FUNC void particle_system_step_axis(phy_real_t *position, phy_real_t *velocity, phy_real_t *force,
+        size_t i, simd4f_t dt_over_mass, simd4f_t dt) {
+    simd4f_t new_velocity = simd4f_add(simd4f_load(&velocity[i]), simd4f_mul(simd4f_load(&force[i]), dt_over_mass));
+    simd4f_store(&velocity[i], new_velocity);
+    simd4f_store(&position[i], simd4f_add(simd4f_load(&position[i]), simd4f_mul(new_velocity, dt)));
+    simd4f_store(&force[i], simd4f_set1(0));
+}
+
+PRIVATE_FUNC void particle_system_integrate_baseline(particle_system_t *system, phy_real_t dt, size_t padded_count) {
+    simd4f_t dt_lanes = simd4f_set1(dt);
+    for (size_t i = 0; i < padded_count; i += SIMD_WIDTH) {
+        simd4f_t dt_over_mass = simd4f_div(dt_lanes, simd4f_load(&system->mass[i]));
+        particle_system_step_axis(system->position_x, system->velocity_x, system->force_x, i, dt_over_mass, dt_lanes);
+        particle_system_step_axis(system->position_y, system->velocity_y, system->force_y, i, dt_over_mass, dt_lanes);
+        particle_system_step_axis(system->position_z, system->velocity_z, system->force_z, i, dt_over_mass, dt_lanes);
+    }
+}
+
+#if defined(CPU_X86_DISPATCH)
+
+PRIVATE_FUNC CPU_TARGET_AVX2 void particle_system_integrate_avx2(particle_system_t *system, phy_real_t dt, size_t padded_count) {
+    phy_real_t *positions[3] = { system->position_x, system->position_y, system->position_z };
+    phy_real_t *velocities[3] = { system->velocity_x, system->velocity_y, system->velocity_z };
+    phy_real_t *forces[3] = { system->force_x, system->force_y, system->force_z };
+    const __m256 dt_lanes = _mm256_set1_ps(dt);
+    for (size_t i = 0; i < padded_count; i += 8) {
+        __m256 dt_over_mass = _mm256_div_ps(dt_lanes, _mm256_load_ps(&system->mass[i]));
+        for (size_t axis = 0; axis < 3; axis++) {
+            __m256 velocity = _mm256_fmadd_ps(_mm256_load_ps(&forces[axis][i]), dt_over_mass, _mm256_load_ps(&velocities[axis][i]));
+            _mm256_store_ps(&velocities[axis][i], velocity);
+            _mm256_store_ps(&positions[axis][i], _mm256_fmadd_ps(velocity, dt_lanes, _mm256_load_ps(&positions[axis][i])));
+            _mm256_store_ps(&forces[axis][i], _mm256_setzero_ps());
+        }
+    }
+}
+
+PRIVATE_FUNC CPU_TARGET_AVX512 void particle_system_integrate_avx512(particle_system_t *system, phy_real_t dt, size_t padded_count) {
+    phy_real_t *positions[3] = { system->position_x, system->position_y, system->position_z };
+    phy_real_t *velocities[3] = { system->velocity_x, system->velocity_y, system->velocity_z };
+    phy_real_t *forces[3] = { system->force_x, system->force_y, system->force_z };
+    const __m512 dt_lanes = _mm512_set1_ps(dt);
+    for (size_t i = 0; i < padded_count; i += 16) {
+        __m512 dt_over_mass = _mm512_div_ps(dt_lanes, _mm512_load_ps(&system->mass[i]));
+        for (size_t axis = 0; axis < 3; axis++) {
+            __m512 velocity = _mm512_fmadd_ps(_mm512_load_ps(&forces[axis][i]), dt_over_mass, _mm512_load_ps(&velocities[axis][i]));
+            _mm512_store_ps(&velocities[axis][i], velocity);
+            _mm512_store_ps(&positions[axis][i], _mm512_fmadd_ps(velocity, dt_lanes, _mm512_load_ps(&positions[axis][i])));
+            _mm512_store_ps(&forces[axis][i], _mm512_setzero_ps());
+        }
+    }
+}
+
+#endif
+
+/**
+ * [internal] wraps SIMD_WIDTH coordinates back into [origin, origin + size),
+ * the same way periodic_box_wrap() does
+ */
+PRIVATE_FUNC simd4f_t particle_system_wrap_axis(simd4f_t coordinate, phy_real_t origin, phy_real_t size) {
+    simd4f_t size_lanes = simd4f_set1(size);
+    simd4f_t offset = simd4f_sub(coordinate, simd4f_set1(origin));
+    // floor(), from rounding to nearest
+    simd4f_t images = simd4f_div(offset, size_lanes);
+    simd4f_t rounded = simd4f_round(images);
+    images = simd4f_select(simd4f_less_equal(rounded, images), rounded, simd4f_sub(rounded, simd4f_set1(1)));
+    offset = simd4f_sub(offset, simd4f_mul(size_lanes, images));
+    // rounding can land exactly on the far face, which belongs to the next image
+    offset = simd4f_select(simd4f_greater_equal(offset, size_lanes), simd4f_set1(0), offset);
+    return simd4f_add(simd4f_set1(origin), offset);
+}
+
+/**
+ * [internal] steps every particle (padding included), wrapping them
+ * into box if it isn't null
+ */
+PRIVATE_FUNC void particle_system_step_wrapped(particle_system_t *system, phy_real_t dt, const periodic_box_t *box) {
+    // the arrays are 64-byte aligned and padded to PARTICLES_ALIGNMENT,
+    // so every kernel can use aligned loads and skip the tail
+    size_t padded_count = particle_system_padded_count(system);
+    switch (cpu_get_isa()) {
+#if defined(CPU_X86_DISPATCH)
+        case CPU_ISA_AVX512:
+            particle_system_integrate_avx512(system, dt, padded_count);
+            break;
+        case CPU_ISA_AVX2:
+            particle_system_integrate_avx2(system, dt, padded_count);
+            break;
+#endif
+        default:
+            particle_system_integrate_baseline(system, dt, padded_count);
+            break;
+    }
+    if (box == NULL) {
+        return;
+    }
+
+    phy_real_t *positions[3] = { system->position_x, system->position_y, system->position_z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        if (box->size.raw[axis] <= 0) {
+            continue;
+        }
+        for (size_t i = 0; i < system->count; i += SIMD_WIDTH) {
+            simd4f_t wrapped = particle_system_wrap_axis(simd4f_load(&positions[axis][i]), box->origin.raw[axis], box->size.raw[axis]);
+            simd4f_store(&positions[axis][i], wrapped);
+        }
+    }
+    // wrapping can move padding particles off the origin; put them back
+    // so they keep matching particle_system_pad_range()
+    if (padded_count > system->count) {
+        particle_system_pad_range(system, system->count, padded_count);
+    }
+}
+
+void particle_system_step(particle_system_t *system, phy_real_t dt) {
+    safe_assert(system != NULL,);
+    particle_system_step_wrapped(system, dt, NULL);
+}
+
+void particle_system_step_periodic(particle_system_t *system, phy_real_t dt, const periodic_box_t *box) {
+    safe_assert(system != NULL && box != NULL,);
+    particle_system_step_wrapped(system, dt, box);
+}
+
+void particle_system_clear(particle_system_t *system) {
+    safe_assert(system != NULL,);
+    particle_system_pad_range(system, 0, system->count);
+    system->count = 0;
+}
+
+void particle_system_destroy(particle_system_t *system) {
+    if (system == NULL) {
+        return;
+    }
+    free(system->position_x);
+    free(system);
+}
@@ -0,0 +1,74 @@
+#include "sim/periodic.h"
+
+#include "common/defines.h"
+#include "common/math.h"
+
+vec3_t periodic_box_wrap(const periodic_box_t *box, vec3_t point) {
+    safe_assert(box != NULL, point);
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t size = box->size.raw[axis];
+        if (size <= 0) {
+            continue;
+        }
+        phy_real_t offset = point.raw[axis] - box->origin.raw[axis];
+        offset -= size * floor(offset / size);
+        // rounding can land exactly on the far face, which belongs to the next image
+        if (offset >= size) {
+            offset = 0;
+        }
+        point.raw[axis] = box->origin.raw[axis] + offset;
+    }
+    return point;
+}
+
+vec3_t periodic_box_get_displacement(const periodic_box_t *box, vec3_t from, vec3_t to) {
+    vec3_t displacement = to;
+    vec3_add_to(&displacement, from, -1);
+    if (box == NULL) {
+        return displacement;
+    }
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t size = box->size.raw[axis];
+        if (size > 0) {
+            displacement.raw[axis] -= size * round(displacement.raw[axis] / size);
+        }
+    }
+    return displacement;
+}
+
+size_t periodic_box_get_images(const periodic_box_t *box, bbox_t bounds, vec3_t shifts[PERIODIC_MAX_IMAGES]) {
+    safe_assert(box != NULL && shifts != NULL, 0);
+
+    // work out which shifts are needed along each axis on its own,
+    // then combine them
+    vec3_t bounds_min = bbox_get_min(bounds);
+    vec3_t bounds_max = bbox_get_max(bounds);
+    phy_real_t axis_shifts[3][3];
+    size_t axis_shift_counts[3];
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t size = box->size.raw[axis];
+        axis_shifts[axis][0] = 0;
+        axis_shift_counts[axis] = 1;
+        if (size <= 0) {
+            continue;
+        }
+        if (bounds_min.raw[axis] < box->origin.raw[axis]) {
+            axis_shifts[axis][axis_shift_counts[axis]++] = size;
+        }
+        if (bounds_max.raw[axis] > box->origin.raw[axis] + size) {
+            axis_shifts[axis][axis_shift_counts[axis]++] = -size;
+        }
+    }
+
+    size_t count = 0;
+    for (size_t x = 0; x < axis_shift_counts[0]; x++) {
+        for (size_t y = 0; y < axis_shift_counts[1]; y++) {
+            for (size_t z = 0; z < axis_shift_counts[2]; z++) {
+                shifts[count++] = vec3_make(axis_shifts[0][x], axis_shifts[1][y], axis_shifts[2][z]);
+            }
+        }
+    }
+    return count;
+}
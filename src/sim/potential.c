@@ -0,0 +1,28 @@
+#include "sim/potential.h"
+
+#include "common/math.h"
+
+phy_real_t pair_potential_lennard_jones(const void *params, phy_real_t distance_sqr) {
+    const lennard_jones_params_t *lj = params;
+    // F(r) / r = 24 epsilon (2 (sigma/r)^12 - (sigma/r)^6) / r^2,
+    // which only needs even powers of r
+    phy_real_t inverse_sqr = 1 / distance_sqr;
+    phy_real_t ratio6 = lj->sigma * lj->sigma * inverse_sqr;
+    ratio6 = ratio6 * ratio6 * ratio6;
+    return 24 * lj->epsilon * (2 * ratio6 * ratio6 - ratio6) * inverse_sqr;
+}
+
+phy_real_t pair_potential_soft_repulsion(const void *params, phy_real_t distance_sqr) {
+    const soft_repulsion_params_t *soft = params;
+    if (distance_sqr >= soft->range * soft->range) {
+        return 0;
+    }
+    phy_real_t distance = sqrt(distance_sqr);
+    return soft->stiffness * (soft->range - distance) / distance;
+}
+
+phy_real_t pair_potential_cohesion(const void *params, phy_real_t distance_sqr) {
+    const cohesion_params_t *cohesion = params;
+    phy_real_t distance = sqrt(distance_sqr);
+    return cohesion->stiffness * (cohesion->rest_distance - distance) / distance;
+}
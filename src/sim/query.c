@@ -0,0 +1,383 @@
+#include "sim/query.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "common/defines.h"
+#include "common/math.h"
+#include "common/simd.h"
+
+_Static_assert(QUERY_PACKET_SIZE == SIMD_WIDTH, "each ray in a packet needs its own SIMD lane");
+
+/**
+ * How many packets a thread takes at a time when casting rays
+ */
+#define QUERY_RAY_CHUNK_SIZE 16
+
+/**
+ * How many shapes a thread takes at a time when checking overlaps
+ */
+#define QUERY_OVERLAP_CHUNK_SIZE 64
+
+/**
+ * Direction components smaller than this are nudged away from zero
+ * before being inverted, so slab tests never divide by zero
+ */
+#define QUERY_MIN_DIRECTION 1e-20
+
+/**
+ * A group of rays walking the BVH together.  Everything is stored
+ * per-axis so that all of the rays can be tested against a box at once
+ */
+struct QueryRayPacket {
+    phy_real_t origin_x[QUERY_PACKET_SIZE];
+    phy_real_t origin_y[QUERY_PACKET_SIZE];
+    phy_real_t origin_z[QUERY_PACKET_SIZE];
+    phy_real_t inverse_direction_x[QUERY_PACKET_SIZE];
+    phy_real_t inverse_direction_y[QUERY_PACKET_SIZE];
+    phy_real_t inverse_direction_z[QUERY_PACKET_SIZE];
+    /**
+     * How far along each ray its closest hit so far is.  Anything
+     * further away can be skipped
+     */
+    phy_real_t closest[QUERY_PACKET_SIZE];
+    /**
+     * Which lanes hold a ray; the last packet of a batch may not be full
+     */
+    uint32_t lanes;
+};
+typedef struct QueryRayPacket query_ray_packet_t;
+
+/**
+ * Everything query_scene_cast_rays() needs on each thread
+ */
+struct QueryRayBatch {
+    const query_scene_t *scene;
+    const ray_t *rays;
+    size_t ray_count;
+    ray_hit_t *hits;
+};
+typedef struct QueryRayBatch query_ray_batch_t;
+
+/**
+ * Everything query_scene_overlap_colliders() needs on each thread
+ */
+struct QueryOverlapBatch {
+    const query_scene_t *scene;
+    const collider_t *shapes;
+    uint32_t *results;
+    size_t max_results;
+    size_t *result_counts;
+};
+typedef struct QueryOverlapBatch query_overlap_batch_t;
+
+/**
+ * Everything needed while visiting leaves for a single overlap query
+ */
+struct QueryOverlap {
+    const query_scene_t *scene;
+    collider_t shape;
+    bbox_t shape_bounds;
+    uint32_t *results;
+    size_t max_results;
+    size_t found;
+};
+typedef struct QueryOverlap query_overlap_t;
+
+/**
+ * Recalculates the bounds of every collider in the scene
+ */
+PRIVATE_FUNC void query_scene_update_bounds(query_scene_t *scene) {
+    for (size_t i = 0; i < scene->collider_count; i++) {
+        collider_get_bounds(scene->colliders[i], &scene->bounds[i]);
+    }
+}
+
+query_scene_t *query_scene_create(const collider_t *colliders, size_t count) {
+    if (colliders == NULL && count > 0) {
+        return NULL;
+    }
+
+    query_scene_t *scene = calloc(1, (sizeof *scene));
+    if (scene == NULL) {
+        return NULL;
+    }
+    scene->colliders = calloc(count > 0 ? count : 1, (sizeof *scene->colliders));
+    scene->bounds = calloc(count > 0 ? count : 1, (sizeof *scene->bounds));
+    if (scene->colliders == NULL || scene->bounds == NULL) {
+        query_scene_destroy(scene);
+        return NULL;
+    }
+    if (count > 0) {
+        memcpy(scene->colliders, colliders, count * (sizeof *colliders));
+    }
+    scene->collider_count = count;
+    query_scene_update_bounds(scene);
+
+    scene->bvh = bvh_create(scene->bounds, count);
+    if (scene->bvh == NULL) {
+        query_scene_destroy(scene);
+        return NULL;
+    }
+    return scene;
+}
+
+void query_scene_update(query_scene_t *scene, const collider_t *colliders) {
+    safe_assert(scene != NULL && (colliders != NULL || scene->collider_count == 0),);
+
+    if (scene->collider_count > 0) {
+        memcpy(scene->colliders, colliders, scene->collider_count * (sizeof *colliders));
+    }
+    query_scene_update_bounds(scene);
+    bvh_refit(scene->bvh, scene->bounds);
+}
+
+void query_scene_set_periodic_box(query_scene_t *scene, const periodic_box_t *box) {
+    safe_assert(scene != NULL,);
+
+    scene->periodic = box != NULL;
+    if (box != NULL) {
+        scene->periodic_box = *box;
+    }
+}
+
+/**
+ * Fills a packet with up to QUERY_PACKET_SIZE rays
+ */
+PRIVATE_FUNC void query_make_ray_packet(const ray_t *rays, size_t ray_count, query_ray_packet_t *packet) {
+    packet->lanes = 0;
+    for (size_t lane = 0; lane < QUERY_PACKET_SIZE; lane++) {
+        if (lane >= ray_count) {
+            // empty lanes never hit anything, since no box is closer than -1
+            packet->origin_x[lane] = packet->origin_y[lane] = packet->origin_z[lane] = 0;
+            packet->inverse_direction_x[lane] = packet->inverse_direction_y[lane] = packet->inverse_direction_z[lane] = 0;
+            packet->closest[lane] = -1;
+            continue;
+        }
+
+        ray_t ray = rays[lane];
+        vec3_t inverse_direction;
+        for (size_t axis = 0; axis < 3; axis++) {
+            phy_real_t component = ray.direction.raw[axis];
+            if (fabs(component) < QUERY_MIN_DIRECTION) {
+                component = component < 0 ? -QUERY_MIN_DIRECTION : QUERY_MIN_DIRECTION;
+            }
+            inverse_direction.raw[axis] = 1.0 / component;
+        }
+        packet->origin_x[lane] = ray.origin.x;
+        packet->origin_y[lane] = ray.origin.y;
+        packet->origin_z[lane] = ray.origin.z;
+        packet->inverse_direction_x[lane] = inverse_direction.x;
+        packet->inverse_direction_y[lane] = inverse_direction.y;
+        packet->inverse_direction_z[lane] = inverse_direction.z;
+        packet->closest[lane] = ray.max_distance;
+        packet->lanes |= 1u << lane;
+    }
+}
+
+/**
+ * Finds which of a packet's rays pass through a node's child,
+ * no further away than their closest hit so far (slab test)
+ */
+PRIVATE_FUNC uint32_t query_packet_slot_mask(const bvh_node_t *node, size_t slot,
+    simd4f_t origin_x, simd4f_t origin_y, simd4f_t origin_z,
+    simd4f_t inverse_x, simd4f_t inverse_y, simd4f_t inverse_z, simd4f_t closest)
+{
+    simd4f_t near_x = simd4f_mul(simd4f_sub(simd4f_set1(node->min_x[slot]), origin_x), inverse_x);
+    simd4f_t far_x = simd4f_mul(simd4f_sub(simd4f_set1(node->max_x[slot]), origin_x), inverse_x);
+    simd4f_t near_y = simd4f_mul(simd4f_sub(simd4f_set1(node->min_y[slot]), origin_y), inverse_y);
+    simd4f_t far_y = simd4f_mul(simd4f_sub(simd4f_set1(node->max_y[slot]), origin_y), inverse_y);
+    simd4f_t near_z = simd4f_mul(simd4f_sub(simd4f_set1(node->min_z[slot]), origin_z), inverse_z);
+    simd4f_t far_z = simd4f_mul(simd4f_sub(simd4f_set1(node->max_z[slot]), origin_z), inverse_z);
+
+    simd4f_t enter = simd4f_max(
+        simd4f_max(simd4f_min(near_x, far_x), simd4f_min(near_y, far_y)),
+        simd4f_min(near_z, far_z));
+    simd4f_t leave = simd4f_min(
+        simd4f_min(simd4f_max(near_x, far_x), simd4f_max(near_y, far_y)),
+        simd4f_max(near_z, far_z));
+    // nothing behind the ray, or past its closest hit, counts
+    enter = simd4f_max(enter, simd4f_set1(0));
+    leave = simd4f_min(leave, closest);
+    return simd4f_mask_bits(simd4f_less_equal(enter, leave));
+}
+
+/**
+ * Walks the scene's BVH with a whole packet of rays, recording each
+ * ray's closest hit
+ */
+PRIVATE_FUNC void query_cast_packet(const query_scene_t *scene, const ray_t *rays, query_ray_packet_t *packet, ray_hit_t *hits) {
+    const bvh_t *bvh = scene->bvh;
+
+    // each entry on the stack remembers which rays made it that far,
+    // so rays that missed a node's parent don't get tested against it
+    uint32_t stack[BVH_MAX_DEPTH * BVH_WIDTH];
+    uint8_t stack_lanes[BVH_MAX_DEPTH * BVH_WIDTH];
+    size_t stack_size = 0;
+    stack[stack_size] = 0;
+    stack_lanes[stack_size++] = packet->lanes;
+
+    simd4f_t origin_x = simd4f_load(packet->origin_x);
+    simd4f_t origin_y = simd4f_load(packet->origin_y);
+    simd4f_t origin_z = simd4f_load(packet->origin_z);
+    simd4f_t inverse_x = simd4f_load(packet->inverse_direction_x);
+    simd4f_t inverse_y = simd4f_load(packet->inverse_direction_y);
+    simd4f_t inverse_z = simd4f_load(packet->inverse_direction_z);
+
+    while (stack_size > 0) {
+        stack_size--;
+        const bvh_node_t *node = &bvh->nodes[stack[stack_size]];
+        uint32_t node_lanes = stack_lanes[stack_size];
+        // reloaded per node, since hits along the way shorten the rays
+        simd4f_t closest = simd4f_load(packet->closest);
+
+        for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+            if (node->child[slot] == BVH_EMPTY) {
+                continue;
+            }
+            uint32_t lanes = node_lanes & query_packet_slot_mask(node, slot,
+                origin_x, origin_y, origin_z, inverse_x, inverse_y, inverse_z, closest);
+            if (lanes == 0) {
+                continue;
+            }
+
+            if (node->item_count[slot] == 0) {
+                stack[stack_size] = node->child[slot];
+                stack_lanes[stack_size++] = lanes;
+                continue;
+            }
+
+            for (size_t i = 0; i < node->item_count[slot]; i++) {
+                uint32_t item = bvh->items[node->child[slot] + i];
+                for (size_t lane = 0; lane < QUERY_PACKET_SIZE; lane++) {
+                    if ((lanes & (1u << lane)) == 0) {
+                        continue;
+                    }
+                    ray_t ray = rays[lane];
+                    ray.max_distance = packet->closest[lane];
+                    phy_real_t distance;
+                    vec3_t normal;
+                    if (!ray_intersects_collider(ray, scene->colliders[item], &distance, &normal)) {
+                        continue;
+                    }
+                    // ties go to whichever collider was found first
+                    if (hits[lane].collider != QUERY_NO_HIT && distance >= hits[lane].distance) {
+                        continue;
+                    }
+                    packet->closest[lane] = distance;
+                    hits[lane].collider = item;
+                    hits[lane].distance = distance;
+                    hits[lane].point = ray_point_at(ray, distance);
+                    hits[lane].normal = normal;
+                }
+            }
+            closest = simd4f_load(packet->closest);
+        }
+    }
+}
+
+PRIVATE_FUNC void query_cast_packets(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    query_ray_batch_t *batch = context;
+    for (size_t packet_index = begin; packet_index < end; packet_index++) {
+        size_t first_ray = packet_index * QUERY_PACKET_SIZE;
+        size_t ray_count = min(batch->ray_count - first_ray, QUERY_PACKET_SIZE);
+        for (size_t i = 0; i < ray_count; i++) {
+            batch->hits[first_ray + i].collider = QUERY_NO_HIT;
+        }
+
+        query_ray_packet_t packet;
+        query_make_ray_packet(&batch->rays[first_ray], ray_count, &packet);
+        query_cast_packet(batch->scene, &batch->rays[first_ray], &packet, &batch->hits[first_ray]);
+    }
+}
+
+void query_scene_cast_rays(const query_scene_t *scene, const ray_t *rays, size_t count, ray_hit_t *hits, threadpool_t *pool) {
+    safe_assert(scene != NULL,);
+    safe_assert((rays != NULL && hits != NULL) || count == 0,);
+
+    query_ray_batch_t batch = {
+        .scene = scene,
+        .rays = rays,
+        .ray_count = count,
+        .hits = hits,
+    };
+    size_t packet_count = (count + QUERY_PACKET_SIZE - 1) / QUERY_PACKET_SIZE;
+    threadpool_parallel_for(pool, packet_count, QUERY_RAY_CHUNK_SIZE, query_cast_packets, &batch);
+}
+
+PRIVATE_FUNC void query_overlap_visit(void *context, const uint32_t *items, size_t item_count) {
+    query_overlap_t *overlap = context;
+    for (size_t i = 0; i < item_count; i++) {
+        // leaves are only bounded as a whole, so check each
+        // item's own bounds before the exact test
+        uint32_t item = items[i];
+        if (!bbox_is_bbox_inside(overlap->shape_bounds, overlap->scene->bounds[item]) ||
+            !collider_is_collider_inside(overlap->shape, overlap->scene->colliders[item])) {
+            continue;
+        }
+        if (overlap->found < overlap->max_results) {
+            overlap->results[overlap->found] = item;
+        }
+        overlap->found++;
+    }
+}
+
+PRIVATE_FUNC void query_overlap_shapes(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    query_overlap_batch_t *batch = context;
+    for (size_t i = begin; i < end; i++) {
+        query_overlap_t overlap = {
+            .scene = batch->scene,
+            .shape = batch->shapes[i],
+            .results = batch->results != NULL ? &batch->results[i * batch->max_results] : NULL,
+            .max_results = batch->max_results,
+            .found = 0,
+        };
+        collider_get_bounds(overlap.shape, &overlap.shape_bounds);
+        if (!batch->scene->periodic) {
+            bvh_visit_bbox(batch->scene->bvh, overlap.shape_bounds, query_overlap_visit, &overlap);
+            batch->result_counts[i] = overlap.found;
+            continue;
+        }
+
+        // check each image of the shape that pokes through one of the box's faces
+        vec3_t shifts[PERIODIC_MAX_IMAGES];
+        size_t image_count = periodic_box_get_images(&batch->scene->periodic_box, overlap.shape_bounds, shifts);
+        collider_t shape = overlap.shape;
+        for (size_t image = 0; image < image_count; image++) {
+            overlap.shape = shape;
+            collider_translate(&overlap.shape, shifts[image]);
+            collider_get_bounds(overlap.shape, &overlap.shape_bounds);
+            bvh_visit_bbox(batch->scene->bvh, overlap.shape_bounds, query_overlap_visit, &overlap);
+        }
+        batch->result_counts[i] = overlap.found;
+    }
+}
+
+void query_scene_overlap_colliders(const query_scene_t *scene, const collider_t *shapes, size_t count,
+    uint32_t *results, size_t max_results, size_t *result_counts, threadpool_t *pool)
+{
+    safe_assert(scene != NULL,);
+    safe_assert((shapes != NULL && result_counts != NULL) || count == 0,);
+    safe_assert(results != NULL || max_results == 0,);
+
+    query_overlap_batch_t batch = {
+        .scene = scene,
+        .shapes = shapes,
+        .results = results,
+        .max_results = max_results,
+        .result_counts = result_counts,
+    };
+    threadpool_parallel_for(pool, count, QUERY_OVERLAP_CHUNK_SIZE, query_overlap_shapes, &batch);
+}
+
+void query_scene_destroy(query_scene_t *scene) {
+    if (scene == NULL) {
+        return;
+    }
+    bvh_destroy(scene->bvh);
+    free(scene->colliders);
+    free(scene->bounds);
+    free(scene);
+}
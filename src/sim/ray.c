@@ -0,0 +1,213 @@
+#include "sim/ray.h"
+
+#include <float.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+vec3_t ray_point_at(ray_t ray, phy_real_t distance) {
+    vec3_t point = ray.origin;
+    vec3_add_to(&point, ray.direction, distance);
+    return point;
+}
+
+/**
+ * Finds where a ray enters an axis-aligned box (slab test), along with
+ * the normal of the face it enters through
+ */
+PRIVATE_FUNC bool ray_intersects_box(vec3_t origin, vec3_t direction, phy_real_t max_distance,
+    vec3_t box_min, vec3_t box_max, phy_real_t *distance, vec3_t *normal)
+{
+    phy_real_t t_min = 0;
+    phy_real_t t_max = max_distance;
+    // -1 means the ray starts inside the box
+    int entry_axis = -1;
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t start = origin.raw[axis];
+        if (fabs(direction.raw[axis]) < PHYSICS_EPSILON) {
+            // parallel to this slab, so we have to start inside it
+            if (start < box_min.raw[axis] || start > box_max.raw[axis]) {
+                return false;
+            }
+            continue;
+        }
+        phy_real_t inverse_direction = 1.0 / direction.raw[axis];
+        phy_real_t t_near = (box_min.raw[axis] - start) * inverse_direction;
+        phy_real_t t_far = (box_max.raw[axis] - start) * inverse_direction;
+        if (t_near > t_far) {
+            phy_real_t tmp = t_near;
+            t_near = t_far;
+            t_far = tmp;
+        }
+        if (t_near > t_min) {
+            t_min = t_near;
+            entry_axis = axis;
+        }
+        t_max = min(t_max, t_far);
+        if (t_min > t_max) {
+            return false;
+        }
+    }
+
+    if (distance != NULL) {
+        *distance = t_min;
+    }
+    if (normal != NULL) {
+        if (entry_axis < 0) {
+            *normal = direction;
+            vec3_multiply_by(normal, -1);
+        }
+        else {
+            // the face we enter through faces back toward the ray
+            *normal = VEC3_ZERO;
+            normal->raw[entry_axis] = direction.raw[entry_axis] > 0 ? -1 : 1;
+        }
+    }
+    return true;
+}
+
+/**
+ * Finds where a ray enters a sphere, assuming the ray starts outside it.
+ * Solved in double precision, since the terms cancel badly when the
+ * ray starts far from the sphere
+ * @return The distance to the hit, or -1 if the ray misses
+ */
+PRIVATE_FUNC phy_real_t ray_sphere_distance(vec3_t origin, vec3_t direction, vec3_t center, phy_real_t radius) {
+    vec3_t offset = origin;
+    vec3_add_to(&offset, center, -1);
+    double b = (double)offset.x * direction.x + (double)offset.y * direction.y + (double)offset.z * direction.z;
+    if (b > 0) {
+        return -1; // pointing away from the sphere
+    }
+    double c = (double)offset.x * offset.x + (double)offset.y * offset.y + (double)offset.z * offset.z - (double)radius * radius;
+    double discriminant = b * b - c;
+    if (discriminant < 0) {
+        return -1;
+    }
+    return max(-b - sqrt(discriminant), 0);
+}
+
+/**
+ * Finds where a ray enters the curved side of a capsule (an uncapped
+ * cylinder), assuming the ray starts outside it.  Also solved in
+ * double precision, for the same reason as spheres
+ * @return The distance to the hit, or -1 if the ray misses
+ */
+PRIVATE_FUNC phy_real_t ray_cylinder_distance(vec3_t origin, vec3_t direction, ccapsule_t capsule) {
+    double axis[3], offset[3];
+    double axis_sqr = 0, axis_direction = 0, axis_offset = 0, offset_direction = 0, offset_sqr = 0;
+    for (size_t i = 0; i < 3; i++) {
+        axis[i] = (double)capsule.end.raw[i] - capsule.start.raw[i];
+        offset[i] = (double)origin.raw[i] - capsule.start.raw[i];
+        axis_sqr += axis[i] * axis[i];
+        axis_direction += axis[i] * direction.raw[i];
+        axis_offset += axis[i] * offset[i];
+        offset_direction += offset[i] * direction.raw[i];
+        offset_sqr += offset[i] * offset[i];
+    }
+
+    // solve |(p - start) x axis|^2 = radius^2 |axis|^2 for p along the ray
+    double a = axis_sqr - axis_direction * axis_direction;
+    if (a < PHYSICS_EPSILON) {
+        return -1; // parallel to the axis, so only the caps can be hit
+    }
+    double b = axis_sqr * offset_direction - axis_offset * axis_direction;
+    double c = axis_sqr * offset_sqr - axis_offset * axis_offset - (double)capsule.radius * capsule.radius * axis_sqr;
+    double discriminant = b * b - a * c;
+    if (discriminant < 0) {
+        return -1;
+    }
+    double t = (-b - sqrt(discriminant)) / a;
+    if (t < 0) {
+        return -1;
+    }
+    // the hit has to be between the caps
+    double along_axis = axis_offset + t * axis_direction;
+    if (along_axis < 0 || along_axis > axis_sqr) {
+        return -1;
+    }
+    return t;
+}
+
+bool ray_intersects_collider(ray_t ray, collider_t collider, phy_real_t *distance, vec3_t *normal) {
+    switch (collider.kind) {
+        case COLLIDER_BBOX:
+            return ray_intersects_box(ray.origin, ray.direction, ray.max_distance,
+                bbox_get_min(collider.bbox), bbox_get_max(collider.bbox), distance, normal);
+        case COLLIDER_CUBE: {
+            // in the cube's model space, the cube is an AABB centered at the origin
+            ccube_t unmoved = collider.cube;
+            unmoved.position = VEC3_ZERO;
+            vec3_t origin = ray.origin;
+            vec3_t direction = ray.direction;
+            ccube_apply_cube_transformations(collider.cube, &origin);
+            ccube_apply_cube_transformations(unmoved, &direction);
+
+            vec3_t half_extents = vec3_make(collider.cube.width / 2, collider.cube.height / 2, collider.cube.length / 2);
+            vec3_t box_min = half_extents;
+            vec3_multiply_by(&box_min, -1);
+            if (!ray_intersects_box(origin, direction, ray.max_distance, box_min, half_extents, distance, normal)) {
+                return false;
+            }
+            if (normal != NULL) {
+                ccube_undo_cube_transformations(unmoved, normal);
+            }
+            return true;
+        }
+        default:
+            break;
+    }
+
+    // rounded shapes
+    phy_real_t t;
+    if (collider_is_point_inside(collider, ray.origin)) {
+        t = 0;
+    }
+    else if (collider.kind == COLLIDER_SPHERE) {
+        t = ray_sphere_distance(ray.origin, ray.direction, collider.sphere.center, collider.sphere.radius);
+    }
+    else if (collider.kind == COLLIDER_CAPSULE) {
+        // a capsule is its two end spheres plus the cylinder between them,
+        // so the first hit on any of them is the first hit on the capsule
+        ccapsule_t capsule = collider.capsule;
+        t = FLT_MAX;
+        phy_real_t part_hits[] = {
+            ray_sphere_distance(ray.origin, ray.direction, capsule.start, capsule.radius),
+            ray_sphere_distance(ray.origin, ray.direction, capsule.end, capsule.radius),
+            ray_cylinder_distance(ray.origin, ray.direction, capsule),
+        };
+        for (size_t i = 0; i < (sizeof part_hits) / (sizeof *part_hits); i++) {
+            if (part_hits[i] >= 0) {
+                t = min(t, part_hits[i]);
+            }
+        }
+        if (t == FLT_MAX) {
+            t = -1;
+        }
+    }
+    else {
+        abort();
+    }
+    if (t < 0 || t > ray.max_distance) {
+        return false;
+    }
+
+    if (distance != NULL) {
+        *distance = t;
+    }
+    if (normal != NULL) {
+        if (t == 0) {
+            *normal = ray.direction;
+            vec3_multiply_by(normal, -1);
+            return true;
+        }
+        vec3_t hit = ray_point_at(ray, t);
+        vec3_t surface_center = collider.kind == COLLIDER_SPHERE ? collider.sphere.center : hit;
+        if (collider.kind == COLLIDER_CAPSULE) {
+            segment_clamp_point(ccapsule_get_segment(collider.capsule), &surface_center);
+        }
+        *normal = hit;
+        vec3_add_to(normal, surface_center, -1);
+        vec3_unit(normal);
+    }
+    return true;
+}
@@ -0,0 +1,386 @@
+#include "sim/sdf.h"
+
+#include <stdlib.h>
+#include "common/defines.h"
+#include "common/math.h"
+
+/**
+ * How far rays used to decide if a sample is inside a mesh lean away
+ * from the x-axis, per unit traveled.  Tilting the ray makes it very
+ * unlikely to pass exactly through an edge shared by two triangles,
+ * which would be counted as two crossings
+ */
+#define SDF_RAY_TILT_Y 0.000913
+#define SDF_RAY_TILT_Z 0.000571
+
+/**
+ * Gets the index of a sample in a field's distance array
+ */
+#define SDF_INDEX(field, x, y, z) ((((z) * (field)->size_y) + (y)) * (field)->size_x + (x))
+
+/**
+ * Where a point falls within the grid
+ */
+struct SdfLocation {
+    /**
+     * The sample at the cell's lowest corner
+     */
+    size_t cell[3];
+    /**
+     * How far across the cell the point is along each axis, from 0 to 1
+     */
+    vec3_t fraction;
+    /**
+     * How far the point is from the grid, or 0 if it is inside
+     */
+    vec3_t outside;
+};
+typedef struct SdfLocation sdf_location_t;
+
+sdf_t *sdf_create(vec3_t origin, size_t size_x, size_t size_y, size_t size_z, phy_real_t cell_size, phy_real_t max_distance) {
+    if (size_x < 2 || size_y < 2 || size_z < 2 || cell_size <= 0 || max_distance <= 0) {
+        return NULL;
+    }
+
+    sdf_t *field = calloc(1, (sizeof *field));
+    if (field == NULL) {
+        return NULL;
+    }
+    field->distances = calloc(size_x * size_y * size_z, (sizeof *field->distances));
+    if (field->distances == NULL) {
+        sdf_destroy(field);
+        return NULL;
+    }
+    for (size_t i = 0; i < size_x * size_y * size_z; i++) {
+        field->distances[i] = SDF_QUANTIZED_MAX;
+    }
+    field->size_x = size_x;
+    field->size_y = size_y;
+    field->size_z = size_z;
+    field->origin = origin;
+    field->cell_size = cell_size;
+    field->max_distance = max_distance;
+
+    return field;
+}
+
+PRIVATE_FUNC int16_t sdf_quantize(const sdf_t *field, phy_real_t distance) {
+    return (int16_t)round(clamp(distance / field->max_distance, -1, 1) * SDF_QUANTIZED_MAX);
+}
+
+PRIVATE_FUNC phy_real_t sdf_dequantize(const sdf_t *field, int16_t distance) {
+    return distance * (field->max_distance / SDF_QUANTIZED_MAX);
+}
+
+/**
+ * Gets the position of a sample in world space
+ */
+PRIVATE_FUNC vec3_t sdf_get_sample_position(const sdf_t *field, size_t x, size_t y, size_t z) {
+    return vec3_make(
+        field->origin.x + x * field->cell_size,
+        field->origin.y + y * field->cell_size,
+        field->origin.z + z * field->cell_size
+    );
+}
+
+/**
+ * Finds the range of samples whose positions lie within a box
+ * @return false if no samples lie within the box
+ */
+PRIVATE_FUNC bool sdf_sample_range(const sdf_t *field, vec3_t box_min, vec3_t box_max, size_t first[3], size_t last[3]) {
+    size_t sizes[3] = { field->size_x, field->size_y, field->size_z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t low = ceil((box_min.raw[axis] - field->origin.raw[axis]) / field->cell_size);
+        phy_real_t high = floor((box_max.raw[axis] - field->origin.raw[axis]) / field->cell_size);
+        if (high < 0 || low > sizes[axis] - 1 || low > high) {
+            return false;
+        }
+        first[axis] = (size_t)max(low, 0);
+        last[axis] = (size_t)min(high, sizes[axis] - 1);
+    }
+    return true;
+}
+
+/**
+ * Stores a distance in a sample, unless the sample is already closer to
+ * another surface.  This makes the field the union of everything added
+ */
+PRIVATE_FUNC void sdf_merge_sample(sdf_t *field, size_t x, size_t y, size_t z, phy_real_t distance) {
+    int16_t quantized = sdf_quantize(field, distance);
+    int16_t *sample = &field->distances[SDF_INDEX(field, x, y, z)];
+    if (quantized < *sample) {
+        *sample = quantized;
+    }
+}
+
+int sdf_add_collider(sdf_t *field, collider_t collider) {
+    safe_assert(field != NULL, SDF_ERROR_PARAMS);
+
+    // samples further than max_distance from the shape are
+    // already as far away as the field can store
+    bbox_t bounds;
+    collider_get_bounds(collider, &bounds);
+    vec3_t padding = vec3_make(field->max_distance, field->max_distance, field->max_distance);
+    vec3_t box_min = bbox_get_min(bounds);
+    vec3_add_to(&box_min, padding, -1);
+    vec3_t box_max = bbox_get_max(bounds);
+    vec3_add_to(&box_max, padding, 1);
+
+    size_t first[3], last[3];
+    if (!sdf_sample_range(field, box_min, box_max, first, last)) {
+        return SDF_SUCCESS;
+    }
+    for (size_t z = first[2]; z <= last[2]; z++) {
+        for (size_t y = first[1]; y <= last[1]; y++) {
+            for (size_t x = first[0]; x <= last[0]; x++) {
+                vec3_t position = sdf_get_sample_position(field, x, y, z);
+                sdf_merge_sample(field, x, y, z, collider_signed_distance(collider, position));
+            }
+        }
+    }
+    return SDF_SUCCESS;
+}
+
+/**
+ * Checks if a point is inside a closed mesh by counting how many
+ * triangles a ray from the point crosses
+ */
+PRIVATE_FUNC bool sdf_is_inside_trimesh(const trimesh_t *mesh, vec3_t point, uint32_t *candidates) {
+    vec3_t mesh_max = bbox_get_max(mesh->bounds);
+    phy_real_t ray_length = mesh_max.x - point.x + 1;
+    segment_t ray = segment_make(point, vec3_make(
+        point.x + ray_length,
+        point.y + ray_length * SDF_RAY_TILT_Y,
+        point.z + ray_length * SDF_RAY_TILT_Z
+    ));
+
+    bbox_t ray_bounds = {
+        .position = VEC3_ZERO,
+        .left = ray.start.x,
+        .right = ray.end.x,
+        .bottom = ray.start.y,
+        .top = ray.end.y,
+        .back = ray.start.z,
+        .front = ray.end.z,
+    };
+    size_t candidate_count = trimesh_query_bbox(mesh, ray_bounds, candidates, mesh->triangle_count);
+
+    size_t crossings = 0;
+    for (size_t i = 0; i < candidate_count; i++) {
+        if (triangle_intersects_segment(trimesh_get_triangle(mesh, candidates[i]), ray, NULL)) {
+            crossings++;
+        }
+    }
+    return crossings % 2 == 1;
+}
+
+int sdf_add_trimesh(sdf_t *field, const trimesh_t *mesh) {
+    safe_assert(field != NULL && mesh != NULL, SDF_ERROR_PARAMS);
+    if (mesh->triangle_count == 0) {
+        return SDF_SUCCESS;
+    }
+
+    // every query can return at most every triangle, so
+    // one buffer of that size is always enough
+    uint32_t *candidates = calloc(mesh->triangle_count, (sizeof *candidates));
+    if (candidates == NULL) {
+        return SDF_ERROR_ALLOC;
+    }
+
+    vec3_t padding = vec3_make(field->max_distance, field->max_distance, field->max_distance);
+    vec3_t box_min = bbox_get_min(mesh->bounds);
+    vec3_add_to(&box_min, padding, -1);
+    vec3_t box_max = bbox_get_max(mesh->bounds);
+    vec3_add_to(&box_max, padding, 1);
+
+    size_t first[3], last[3];
+    if (!sdf_sample_range(field, box_min, box_max, first, last)) {
+        free(candidates);
+        return SDF_SUCCESS;
+    }
+    for (size_t z = first[2]; z <= last[2]; z++) {
+        for (size_t y = first[1]; y <= last[1]; y++) {
+            for (size_t x = first[0]; x <= last[0]; x++) {
+                vec3_t position = sdf_get_sample_position(field, x, y, z);
+
+                // only triangles within max_distance can be closer than
+                // what the field can store anyway
+                bbox_t search = {
+                    .position = position,
+                    .left = -field->max_distance,
+                    .right = field->max_distance,
+                    .bottom = -field->max_distance,
+                    .top = field->max_distance,
+                    .back = -field->max_distance,
+                    .front = field->max_distance,
+                };
+                size_t candidate_count = trimesh_query_bbox(mesh, search, candidates, mesh->triangle_count);
+                phy_real_t distance_sqr = field->max_distance * field->max_distance;
+                for (size_t i = 0; i < candidate_count; i++) {
+                    vec3_t closest = position;
+                    triangle_clamp_point(trimesh_get_triangle(mesh, candidates[i]), &closest);
+                    distance_sqr = min(distance_sqr, vec3_distance_sqr(closest, position));
+                }
+
+                phy_real_t distance = sqrt(distance_sqr);
+                if (sdf_is_inside_trimesh(mesh, position, candidates)) {
+                    distance = -distance;
+                }
+                sdf_merge_sample(field, x, y, z, distance);
+            }
+        }
+    }
+
+    free(candidates);
+    return SDF_SUCCESS;
+}
+
+/**
+ * Finds which cell of the grid a point is in, clamping points
+ * outside the grid to its edge
+ */
+PRIVATE_FUNC sdf_location_t sdf_locate(const sdf_t *field, vec3_t point) {
+    sdf_location_t location;
+    size_t sizes[3] = { field->size_x, field->size_y, field->size_z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t grid_position = (point.raw[axis] - field->origin.raw[axis]) / field->cell_size;
+        phy_real_t clamped = clamp(grid_position, 0, sizes[axis] - 1);
+        location.outside.raw[axis] = (grid_position - clamped) * field->cell_size;
+        location.cell[axis] = (size_t)min(floor(clamped), sizes[axis] - 2);
+        location.fraction.raw[axis] = clamped - location.cell[axis];
+    }
+    return location;
+}
+
+/**
+ * Gets the distances at the eight corners of a cell.  Corner i is
+ * offset by (i & 1, (i >> 1) & 1, (i >> 2) & 1) samples
+ */
+PRIVATE_FUNC void sdf_get_corners(const sdf_t *field, const sdf_location_t *location, phy_real_t corners[8]) {
+    const int16_t *base = &field->distances[SDF_INDEX(field, location->cell[0], location->cell[1], location->cell[2])];
+    size_t row = field->size_x;
+    size_t slice = field->size_x * field->size_y;
+    corners[0] = sdf_dequantize(field, base[0]);
+    corners[1] = sdf_dequantize(field, base[1]);
+    corners[2] = sdf_dequantize(field, base[row]);
+    corners[3] = sdf_dequantize(field, base[row + 1]);
+    corners[4] = sdf_dequantize(field, base[slice]);
+    corners[5] = sdf_dequantize(field, base[slice + 1]);
+    corners[6] = sdf_dequantize(field, base[slice + row]);
+    corners[7] = sdf_dequantize(field, base[slice + row + 1]);
+}
+
+phy_real_t sdf_sample(const sdf_t *field, vec3_t point) {
+    safe_assert(field != NULL, 0);
+
+    sdf_location_t location = sdf_locate(field, point);
+    phy_real_t corners[8];
+    sdf_get_corners(field, &location, corners);
+
+    vec3_t f = location.fraction;
+    phy_real_t near_bottom = corners[0] + (corners[1] - corners[0]) * f.x;
+    phy_real_t near_top = corners[2] + (corners[3] - corners[2]) * f.x;
+    phy_real_t far_bottom = corners[4] + (corners[5] - corners[4]) * f.x;
+    phy_real_t far_top = corners[6] + (corners[7] - corners[6]) * f.x;
+    phy_real_t near = near_bottom + (near_top - near_bottom) * f.y;
+    phy_real_t far = far_bottom + (far_top - far_bottom) * f.y;
+    return near + (far - near) * f.z + vec3_magnitude(location.outside);
+}
+
+vec3_t sdf_get_gradient(const sdf_t *field, vec3_t point) {
+    safe_assert(field != NULL, VEC3_ZERO);
+
+    sdf_location_t location = sdf_locate(field, point);
+    vec3_t gradient;
+    if (vec3_magnitude_sqr(location.outside) > PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        // outside the grid, distance grows fastest heading away from it
+        gradient = location.outside;
+    }
+    else {
+        phy_real_t corners[8];
+        sdf_get_corners(field, &location, corners);
+
+        // the derivative of the trilinear interpolation along each axis
+        vec3_t f = location.fraction;
+        gradient.x =
+            (corners[1] - corners[0]) * (1 - f.y) * (1 - f.z) +
+            (corners[3] - corners[2]) * f.y * (1 - f.z) +
+            (corners[5] - corners[4]) * (1 - f.y) * f.z +
+            (corners[7] - corners[6]) * f.y * f.z;
+        gradient.y =
+            (corners[2] - corners[0]) * (1 - f.x) * (1 - f.z) +
+            (corners[3] - corners[1]) * f.x * (1 - f.z) +
+            (corners[6] - corners[4]) * (1 - f.x) * f.z +
+            (corners[7] - corners[5]) * f.x * f.z;
+        gradient.z =
+            (corners[4] - corners[0]) * (1 - f.x) * (1 - f.y) +
+            (corners[5] - corners[1]) * f.x * (1 - f.y) +
+            (corners[6] - corners[2]) * (1 - f.x) * f.y +
+            (corners[7] - corners[3]) * f.x * f.y;
+    }
+
+    if (vec3_magnitude_sqr(gradient) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        return VEC3_ZERO;
+    }
+    vec3_unit(&gradient);
+    return gradient;
+}
+
+bool sdf_collide_csphere(const sdf_t *field, csphere_t sphere, contact_t *contact) {
+    safe_assert(field != NULL, false);
+
+    phy_real_t distance = sdf_sample(field, sphere.center);
+    if (distance > sphere.radius) {
+        return false;
+    }
+
+    if (contact != NULL) {
+        vec3_t normal = sdf_get_gradient(field, sphere.center);
+        // the surface is roughly distance away, against the gradient
+        vec3_t point = sphere.center;
+        vec3_add_to(&point, normal, -distance);
+        *contact = contact_make(point, normal, sphere.radius - distance);
+    }
+    return true;
+}
+
+size_t sdf_collide_particles(const sdf_t *field, const vec3_t *positions, size_t count, phy_real_t radius,
+    contact_t *contacts, uint32_t *particles, size_t max_contacts)
+{
+    safe_assert(field != NULL && (positions != NULL || count == 0), 0);
+    safe_assert((contacts != NULL && particles != NULL) || max_contacts == 0, 0);
+
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        contact_t contact;
+        if (!sdf_collide_csphere(field, csphere_make(positions[i], radius), &contact)) {
+            continue;
+        }
+        if (found < max_contacts) {
+            contacts[found] = contact;
+            particles[found] = i;
+        }
+        found++;
+    }
+    return found;
+}
+
+void sdf_get_bounds(const sdf_t *field, bbox_t *box) {
+    safe_assert(field != NULL && box != NULL,);
+
+    box->position = VEC3_ZERO;
+    box->left = field->origin.x;
+    box->right = field->origin.x + (field->size_x - 1) * field->cell_size;
+    box->bottom = field->origin.y;
+    box->top = field->origin.y + (field->size_y - 1) * field->cell_size;
+    box->back = field->origin.z;
+    box->front = field->origin.z + (field->size_z - 1) * field->cell_size;
+}
+
+void sdf_destroy(sdf_t *field) {
+    if (field == NULL) {
+        return;
+    }
+    free(field->distances);
+    free(field);
+}
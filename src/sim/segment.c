@@ -0,0 +1,199 @@
+#include "sim/segment.h"
+
+#include "common/defines.h"
+#include "common/math.h"
+
+vec3_t segment_point_at(segment_t segment, phy_real_t t) {
+    vec3_t point = segment.start;
+    vec3_add_to(&point, segment.end, t);
+    vec3_add_to(&point, segment.start, -t);
+    return point;
+}
+
+phy_real_t segment_closest_parameter(segment_t segment, vec3_t point) {
+    vec3_t direction = segment.end;
+    vec3_add_to(&direction, segment.start, -1);
+    phy_real_t length_sqr = vec3_magnitude_sqr(direction);
+    if (length_sqr < PHYSICS_EPSILON) {
+        // degenerate segment; every point on it is the start
+        return 0;
+    }
+
+    vec3_add_to(&point, segment.start, -1);
+    return clamp(vec3_dot_product(point, direction) / length_sqr, 0, 1);
+}
+
+void segment_clamp_point(segment_t segment, vec3_t *point) {
+    safe_assert(point != NULL,);
+
+    *point = segment_point_at(segment, segment_closest_parameter(segment, *point));
+}
+
+// closest points between segments taken and modified from
+// Real-Time Collision Detection (Ericson), section 5.1.9
+phy_real_t segment_closest_points_segment(segment_t a, segment_t b, vec3_t *on_a, vec3_t *on_b) {
+    vec3_t direction_a = a.end;
+    vec3_add_to(&direction_a, a.start, -1);
+    vec3_t direction_b = b.end;
+    vec3_add_to(&direction_b, b.start, -1);
+    vec3_t between_starts = a.start;
+    vec3_add_to(&between_starts, b.start, -1);
+
+    phy_real_t length_sqr_a = vec3_magnitude_sqr(direction_a);
+    phy_real_t length_sqr_b = vec3_magnitude_sqr(direction_b);
+    phy_real_t b_dot_between = vec3_dot_product(direction_b, between_starts);
+
+    // s is the parameter along a, t is the parameter along b
+    phy_real_t s, t;
+    if (length_sqr_a < PHYSICS_EPSILON && length_sqr_b < PHYSICS_EPSILON) {
+        // both segments are really just points
+        s = 0;
+        t = 0;
+    }
+    else if (length_sqr_a < PHYSICS_EPSILON) {
+        // a is a point; just find the closest point on b
+        s = 0;
+        t = clamp(b_dot_between / length_sqr_b, 0, 1);
+    }
+    else {
+        phy_real_t a_dot_between = vec3_dot_product(direction_a, between_starts);
+        if (length_sqr_b < PHYSICS_EPSILON) {
+            // b is a point; just find the closest point on a
+            t = 0;
+            s = clamp(-a_dot_between / length_sqr_a, 0, 1);
+        }
+        else {
+            phy_real_t a_dot_b = vec3_dot_product(direction_a, direction_b);
+            phy_real_t denominator = length_sqr_a * length_sqr_b - a_dot_b * a_dot_b;
+
+            // if the segments are parallel, any s works; pick the start
+            s = 0;
+            if (denominator > PHYSICS_EPSILON) {
+                s = clamp((a_dot_b * b_dot_between - a_dot_between * length_sqr_b) / denominator, 0, 1);
+            }
+
+            // find the t matching s, then fix up s if t had to be clamped
+            t = (a_dot_b * s + b_dot_between) / length_sqr_b;
+            if (t < 0) {
+                t = 0;
+                s = clamp(-a_dot_between / length_sqr_a, 0, 1);
+            }
+            else if (t > 1) {
+                t = 1;
+                s = clamp((a_dot_b - a_dot_between) / length_sqr_a, 0, 1);
+            }
+        }
+    }
+
+    vec3_t closest_a = segment_point_at(a, s);
+    vec3_t closest_b = segment_point_at(b, t);
+    if (on_a != NULL) {
+        *on_a = closest_a;
+    }
+    if (on_b != NULL) {
+        *on_b = closest_b;
+    }
+    return vec3_distance_sqr(closest_a, closest_b);
+}
+
+bool segment_intersects_bbox(segment_t segment, bbox_t box, phy_real_t *t_enter) {
+    vec3_t box_min = bbox_get_min(box);
+    vec3_t box_max = bbox_get_max(box);
+    vec3_t direction = segment.end;
+    vec3_add_to(&direction, segment.start, -1);
+
+    // slab test: shrink [t_min, t_max] by each pair of planes in turn
+    phy_real_t t_min = 0;
+    phy_real_t t_max = 1;
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t start = segment.start.raw[axis];
+        if (fabs(direction.raw[axis]) < PHYSICS_EPSILON) {
+            // parallel to this slab, so we have to start inside it
+            if (start < box_min.raw[axis] || start > box_max.raw[axis]) {
+                return false;
+            }
+            continue;
+        }
+        phy_real_t inverse_direction = 1.0 / direction.raw[axis];
+        phy_real_t t_near = (box_min.raw[axis] - start) * inverse_direction;
+        phy_real_t t_far = (box_max.raw[axis] - start) * inverse_direction;
+        if (t_near > t_far) {
+            phy_real_t tmp = t_near;
+            t_near = t_far;
+            t_far = tmp;
+        }
+        t_min = max(t_min, t_near);
+        t_max = min(t_max, t_far);
+        if (t_min > t_max) {
+            return false;
+        }
+    }
+
+    if (t_enter != NULL) {
+        *t_enter = t_min;
+    }
+    return true;
+}
+
+phy_real_t segment_closest_points_bbox(segment_t segment, bbox_t box, vec3_t *on_segment, vec3_t *on_box) {
+    phy_real_t t_enter;
+    if (segment_intersects_bbox(segment, box, &t_enter)) {
+        vec3_t entry = segment_point_at(segment, t_enter);
+        if (on_segment != NULL) {
+            *on_segment = entry;
+        }
+        if (on_box != NULL) {
+            *on_box = entry;
+        }
+        return 0;
+    }
+
+    // The segment is outside the box, so the closest pair is either one of
+    // the segment's endpoints against the box, or the segment against one
+    // of the box's 12 edges.  (If the closest point on the box was inside a
+    // face, the segment would be parallel to that face, and sliding along
+    // it would reach an endpoint or an edge at the same distance)
+    vec3_t best_segment = segment.start;
+    vec3_t best_box = segment.start;
+    bbox_clamp_point_within_bounds(box, &best_box);
+    phy_real_t best_distance_sqr = vec3_distance_sqr(best_segment, best_box);
+
+    vec3_t end_on_box = segment.end;
+    bbox_clamp_point_within_bounds(box, &end_on_box);
+    phy_real_t end_distance_sqr = vec3_distance_sqr(segment.end, end_on_box);
+    if (end_distance_sqr < best_distance_sqr) {
+        best_segment = segment.end;
+        best_box = end_on_box;
+        best_distance_sqr = end_distance_sqr;
+    }
+
+    vec3_t corners[2] = { bbox_get_min(box), bbox_get_max(box) };
+    for (size_t axis = 0; axis < 3; axis++) {
+        // the two axes the edge doesn't run along
+        size_t other1 = (axis + 1) % 3;
+        size_t other2 = (axis + 2) % 3;
+        for (size_t corner = 0; corner < 4; corner++) {
+            segment_t edge;
+            edge.start.raw[axis] = corners[0].raw[axis];
+            edge.end.raw[axis] = corners[1].raw[axis];
+            edge.start.raw[other1] = edge.end.raw[other1] = corners[corner & 1].raw[other1];
+            edge.start.raw[other2] = edge.end.raw[other2] = corners[corner >> 1].raw[other2];
+
+            vec3_t on_edge, on_self;
+            phy_real_t distance_sqr = segment_closest_points_segment(segment, edge, &on_self, &on_edge);
+            if (distance_sqr < best_distance_sqr) {
+                best_segment = on_self;
+                best_box = on_edge;
+                best_distance_sqr = distance_sqr;
+            }
+        }
+    }
+
+    if (on_segment != NULL) {
+        *on_segment = best_segment;
+    }
+    if (on_box != NULL) {
+        *on_box = best_box;
+    }
+    return best_distance_sqr;
+}
@@ -0,0 +1,588 @@
+#include "sim/sph.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/math.h"
+#include "common/simd.h"
+
+/**
+ * How many particles a fluid starts out with room for
+ */
+#define SPH_DEFAULT_CAPACITY 1024
+
+/**
+ * How many particles a thread takes at a time
+ */
+#define SPH_CHUNK_SIZE 256
+
+/**
+ * The number of per-particle arrays of reals a fluid has
+ */
+#define SPH_REAL_ARRAY_COUNT 11
+
+/**
+ * The exponent of the Tait equation of state, as used for water
+ */
+#define SPH_ADIABATIC_INDEX 7
+
+/**
+ * The fraction of the smoothing length a pressure wave (or a particle)
+ * may cross in a single step
+ */
+#define SPH_COURANT_NUMBER 0.2
+
+/**
+ * Squared distances are clamped to at least this before taking their
+ * square root, so a particle's contribution to itself is zero rather
+ * than zero divided by zero
+ */
+#define SPH_MIN_DISTANCE_SQR 1e-12
+
+/**
+ * How far a coupled collider's signed distance is sampled on either side
+ * of a particle to find the collider's normal, relative to the spacing
+ */
+#define SPH_NORMAL_SAMPLE_DISTANCE 0.01
+
+/**
+ * Everything the per-particle passes of a step need on each thread
+ */
+struct SphStep {
+    sph_fluid_t *fluid;
+    phy_real_t dt;
+    const sph_coupling_t *coupling;
+    /**
+     * The force and torque each thread has added to each coupled body,
+     * laid out thread by thread
+     */
+    vec3_t *body_forces;
+    vec3_t *body_torques;
+};
+typedef struct SphStep sph_step_t;
+
+/**
+ * Gets every per-particle array of reals, so they can all be grown together
+ */
+PRIVATE_FUNC void sph_get_real_arrays(sph_fluid_t *fluid, phy_real_t **arrays[SPH_REAL_ARRAY_COUNT]) {
+    phy_real_t **all[SPH_REAL_ARRAY_COUNT] = {
+        &fluid->position_x, &fluid->position_y, &fluid->position_z,
+        &fluid->velocity_x, &fluid->velocity_y, &fluid->velocity_z,
+        &fluid->density, &fluid->pressure,
+        &fluid->acceleration_x, &fluid->acceleration_y, &fluid->acceleration_z,
+    };
+    memcpy(arrays, all, (sizeof all));
+}
+
+/**
+ * Makes room for a given number of particles.  Every array gets
+ * SIMD_WIDTH extra (zeroed) entries, so reading a full SIMD register
+ * from the last few particles stays in bounds
+ */
+PRIVATE_FUNC int sph_fluid_reserve_particles(sph_fluid_t *fluid, size_t capacity) {
+    size_t padded = capacity + SIMD_WIDTH;
+    phy_real_t **arrays[SPH_REAL_ARRAY_COUNT];
+    sph_get_real_arrays(fluid, arrays);
+    for (size_t i = 0; i < SPH_REAL_ARRAY_COUNT; i++) {
+        phy_real_t *array = reallocarray(*arrays[i], padded, (sizeof *array));
+        if (array == NULL) {
+            return SPH_ERROR_ALLOC;
+        }
+        memset(&array[fluid->particle_count], 0, (padded - fluid->particle_count) * (sizeof *array));
+        *arrays[i] = array;
+    }
+
+    uint32_t *ids = reallocarray(fluid->ids, capacity, (sizeof *ids));
+    if (ids == NULL) {
+        return SPH_ERROR_ALLOC;
+    }
+    fluid->ids = ids;
+    // big enough for one per-particle array of either type
+    void *scratch = reallocarray(fluid->scratch, padded, (sizeof (phy_real_t)) > (sizeof (uint32_t)) ? (sizeof (phy_real_t)) : (sizeof (uint32_t)));
+    if (scratch == NULL) {
+        return SPH_ERROR_ALLOC;
+    }
+    fluid->scratch = scratch;
+
+    // the coupling buffers are only made when they're first needed
+    free(fluid->coupling_shapes);
+    free(fluid->coupling_results);
+    free(fluid->coupling_counts);
+    fluid->coupling_shapes = NULL;
+    fluid->coupling_results = NULL;
+    fluid->coupling_counts = NULL;
+
+    fluid->particle_capacity = capacity;
+    return SPH_SUCCESS;
+}
+
+sph_fluid_t *sph_fluid_create(sph_params_t params, vec3_t gravity) {
+    if (params.particle_spacing <= 0 || params.rest_density <= 0 || params.speed_of_sound <= 0 || params.viscosity < 0) {
+        return NULL;
+    }
+
+    sph_fluid_t *fluid = calloc(1, (sizeof *fluid));
+    if (fluid == NULL) {
+        return NULL;
+    }
+    fluid->params = params;
+    fluid->smoothing_length = 2 * params.particle_spacing;
+    fluid->particle_mass = params.rest_density * params.particle_spacing * params.particle_spacing * params.particle_spacing;
+    fluid->gravity = gravity;
+    fluid->grid = particle_grid_create();
+    if (fluid->grid == NULL || sph_fluid_reserve_particles(fluid, SPH_DEFAULT_CAPACITY) != SPH_SUCCESS) {
+        sph_fluid_destroy(fluid);
+        return NULL;
+    }
+    return fluid;
+}
+
+int sph_fluid_add_particle(sph_fluid_t *fluid, vec3_t position, vec3_t velocity) {
+    safe_assert(fluid != NULL && fluid->particle_count < UINT32_MAX, SPH_ERROR_PARAMS);
+
+    if (fluid->particle_count >= fluid->particle_capacity) {
+        int result = sph_fluid_reserve_particles(fluid, fluid->particle_capacity * 2);
+        if (result != SPH_SUCCESS) {
+            return result;
+        }
+    }
+
+    size_t i = fluid->particle_count;
+    fluid->position_x[i] = position.x;
+    fluid->position_y[i] = position.y;
+    fluid->position_z[i] = position.z;
+    fluid->velocity_x[i] = velocity.x;
+    fluid->velocity_y[i] = velocity.y;
+    fluid->velocity_z[i] = velocity.z;
+    fluid->density[i] = fluid->params.rest_density;
+    fluid->pressure[i] = 0;
+    fluid->acceleration_x[i] = fluid->acceleration_y[i] = fluid->acceleration_z[i] = 0;
+    fluid->ids[i] = i;
+    fluid->particle_count++;
+    return SPH_SUCCESS;
+}
+
+void sph_fluid_set_bounds(sph_fluid_t *fluid, const bbox_t *bounds) {
+    safe_assert(fluid != NULL,);
+
+    fluid->has_bounds = bounds != NULL;
+    if (bounds != NULL) {
+        fluid->bounds = *bounds;
+    }
+}
+
+phy_real_t sph_fluid_get_max_step(const sph_fluid_t *fluid) {
+    safe_assert(fluid != NULL, 0);
+
+    phy_real_t max_speed_sqr = 0;
+    for (size_t i = 0; i < fluid->particle_count; i++) {
+        phy_real_t speed_sqr = fluid->velocity_x[i] * fluid->velocity_x[i] +
+            fluid->velocity_y[i] * fluid->velocity_y[i] +
+            fluid->velocity_z[i] * fluid->velocity_z[i];
+        max_speed_sqr = max(max_speed_sqr, speed_sqr);
+    }
+
+    // nothing (particles or pressure waves) may cross more than a
+    // fraction of a particle's reach per step, and viscosity can't
+    // diffuse momentum further than that either
+    phy_real_t h = fluid->smoothing_length;
+    phy_real_t max_step = SPH_COURANT_NUMBER * h / (fluid->params.speed_of_sound + sqrt(max_speed_sqr));
+    if (fluid->params.viscosity > 0) {
+        max_step = min(max_step, 0.125 * h * h * fluid->params.rest_density / fluid->params.viscosity);
+    }
+    return max_step;
+}
+
+/**
+ * Sorts the particles by grid cell, so each cell's particles are
+ * next to each other
+ */
+PRIVATE_FUNC void sph_fluid_reorder(sph_fluid_t *fluid) {
+    const uint32_t *order = fluid->grid->cell_particles;
+    phy_real_t **arrays[SPH_REAL_ARRAY_COUNT];
+    sph_get_real_arrays(fluid, arrays);
+
+    // only positions and velocities carry over between steps;
+    // everything else is recalculated
+    for (size_t a = 0; a < 6; a++) {
+        phy_real_t *sorted = fluid->scratch;
+        for (size_t i = 0; i < fluid->particle_count; i++) {
+            sorted[i] = (*arrays[a])[order[i]];
+        }
+        // swap the arrays rather than copying back, keeping the padding zeroed
+        memset(&sorted[fluid->particle_count], 0, SIMD_WIDTH * (sizeof *sorted));
+        fluid->scratch = *arrays[a];
+        *arrays[a] = sorted;
+    }
+    uint32_t *sorted_ids = fluid->scratch;
+    for (size_t i = 0; i < fluid->particle_count; i++) {
+        sorted_ids[i] = fluid->ids[order[i]];
+    }
+    memcpy(fluid->ids, sorted_ids, fluid->particle_count * (sizeof *sorted_ids));
+}
+
+/**
+ * Gets a mask of the lanes that hold a particle, when reading
+ * SIMD_WIDTH particles with only remaining left in a run
+ */
+PRIVATE_FUNC simd4f_t sph_get_lane_mask(uint32_t remaining) {
+    static const float lane_indices[SIMD_WIDTH] = { 0, 1, 2, 3 };
+    return simd4f_less_equal(simd4f_load(lane_indices), simd4f_set1((float)remaining - 1));
+}
+
+/**
+ * Adds up the lanes of a SIMD register
+ */
+PRIVATE_FUNC phy_real_t sph_sum_lanes(simd4f_t value) {
+    float lanes[SIMD_WIDTH];
+    simd4f_store(lanes, value);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+PRIVATE_FUNC void sph_density_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    sph_fluid_t *fluid = ((sph_step_t *)context)->fluid;
+
+    // poly6 kernel: W(r) = 315 / (64 pi h^9) (h^2 - r^2)^3
+    phy_real_t h = fluid->smoothing_length;
+    phy_real_t h_sqr = h * h;
+    phy_real_t poly6 = 315.0 / (64.0 * PHYSICS_PI * pow(h, 9));
+    // Tait equation: p = B ((density / rest_density)^7 - 1), B = rest_density c^2 / 7
+    phy_real_t rest_density = fluid->params.rest_density;
+    phy_real_t bulk_modulus = rest_density * fluid->params.speed_of_sound * fluid->params.speed_of_sound / SPH_ADIABATIC_INDEX;
+    simd4f_t zero = simd4f_set1(0);
+    simd4f_t reach_sqr = simd4f_set1(h_sqr);
+
+    for (size_t i = begin; i < end; i++) {
+        simd4f_t x = simd4f_set1(fluid->position_x[i]);
+        simd4f_t y = simd4f_set1(fluid->position_y[i]);
+        simd4f_t z = simd4f_set1(fluid->position_z[i]);
+
+        uint32_t run_begins[PARTICLE_GRID_MAX_RUNS], run_ends[PARTICLE_GRID_MAX_RUNS];
+        size_t run_count = particle_grid_get_neighbor_runs(fluid->grid,
+            vec3_make(fluid->position_x[i], fluid->position_y[i], fluid->position_z[i]), run_begins, run_ends);
+        simd4f_t sum = zero;
+        for (size_t run = 0; run < run_count; run++) {
+            for (uint32_t j = run_begins[run]; j < run_ends[run]; j += SIMD_WIDTH) {
+                simd4f_t offset_x = simd4f_sub(x, simd4f_load(&fluid->position_x[j]));
+                simd4f_t offset_y = simd4f_sub(y, simd4f_load(&fluid->position_y[j]));
+                simd4f_t offset_z = simd4f_sub(z, simd4f_load(&fluid->position_z[j]));
+                simd4f_t distance_sqr = simd4f_add(simd4f_add(simd4f_mul(offset_x, offset_x), simd4f_mul(offset_y, offset_y)), simd4f_mul(offset_z, offset_z));
+                // anything out of reach contributes nothing
+                simd4f_t falloff = simd4f_max(simd4f_sub(reach_sqr, distance_sqr), zero);
+                simd4f_t weight = simd4f_mul(simd4f_mul(falloff, falloff), falloff);
+                sum = simd4f_add(sum, simd4f_select(sph_get_lane_mask(run_ends[run] - j), weight, zero));
+            }
+        }
+
+        phy_real_t density = fluid->particle_mass * poly6 * sph_sum_lanes(sum);
+        phy_real_t ratio = density / rest_density;
+        phy_real_t ratio_cubed = ratio * ratio * ratio;
+        fluid->density[i] = density;
+        // negative pressure would pull particles into clumps
+        fluid->pressure[i] = max(bulk_modulus * (ratio_cubed * ratio_cubed * ratio - 1), 0);
+    }
+}
+
+PRIVATE_FUNC void sph_force_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    sph_fluid_t *fluid = ((sph_step_t *)context)->fluid;
+
+    // spiky kernel gradient: -45 / (pi h^6) (h - r)^2 r / |r|
+    // viscosity kernel laplacian: 45 / (pi h^6) (h - r)
+    phy_real_t h = fluid->smoothing_length;
+    phy_real_t kernel = 45.0 / (PHYSICS_PI * pow(h, 6));
+    simd4f_t zero = simd4f_set1(0);
+    simd4f_t reach = simd4f_set1(h);
+    simd4f_t min_distance_sqr = simd4f_set1(SPH_MIN_DISTANCE_SQR);
+
+    for (size_t i = begin; i < end; i++) {
+        simd4f_t x = simd4f_set1(fluid->position_x[i]);
+        simd4f_t y = simd4f_set1(fluid->position_y[i]);
+        simd4f_t z = simd4f_set1(fluid->position_z[i]);
+        simd4f_t velocity_x = simd4f_set1(fluid->velocity_x[i]);
+        simd4f_t velocity_y = simd4f_set1(fluid->velocity_y[i]);
+        simd4f_t velocity_z = simd4f_set1(fluid->velocity_z[i]);
+        simd4f_t pressure_term = simd4f_set1(fluid->pressure[i] / (fluid->density[i] * fluid->density[i]));
+
+        uint32_t run_begins[PARTICLE_GRID_MAX_RUNS], run_ends[PARTICLE_GRID_MAX_RUNS];
+        size_t run_count = particle_grid_get_neighbor_runs(fluid->grid,
+            vec3_make(fluid->position_x[i], fluid->position_y[i], fluid->position_z[i]), run_begins, run_ends);
+        simd4f_t pressure_x = zero, pressure_y = zero, pressure_z = zero;
+        simd4f_t viscosity_x = zero, viscosity_y = zero, viscosity_z = zero;
+        for (size_t run = 0; run < run_count; run++) {
+            for (uint32_t j = run_begins[run]; j < run_ends[run]; j += SIMD_WIDTH) {
+                simd4f_t offset_x = simd4f_sub(x, simd4f_load(&fluid->position_x[j]));
+                simd4f_t offset_y = simd4f_sub(y, simd4f_load(&fluid->position_y[j]));
+                simd4f_t offset_z = simd4f_sub(z, simd4f_load(&fluid->position_z[j]));
+                simd4f_t distance_sqr = simd4f_add(simd4f_add(simd4f_mul(offset_x, offset_x), simd4f_mul(offset_y, offset_y)), simd4f_mul(offset_z, offset_z));
+                simd4f_t distance = simd4f_sqrt(simd4f_max(distance_sqr, min_distance_sqr));
+                // anything out of reach (or past the end of the run) contributes nothing.
+                // A particle's own offset is zero, so it doesn't push on itself either
+                simd4f_t falloff = simd4f_select(sph_get_lane_mask(run_ends[run] - j),
+                    simd4f_max(simd4f_sub(reach, distance), zero), zero);
+                // lanes past the end of the run read the (zeroed) padding, so
+                // density is kept off zero to keep them from turning into NaNs
+                simd4f_t density_j = simd4f_max(simd4f_load(&fluid->density[j]), min_distance_sqr);
+
+                // pressure: (p_i / density_i^2 + p_j / density_j^2) (h - r)^2 / r
+                simd4f_t pressure = simd4f_add(pressure_term,
+                    simd4f_div(simd4f_load(&fluid->pressure[j]), simd4f_mul(density_j, density_j)));
+                simd4f_t push = simd4f_div(simd4f_mul(pressure, simd4f_mul(falloff, falloff)), distance);
+                pressure_x = simd4f_add(pressure_x, simd4f_mul(push, offset_x));
+                pressure_y = simd4f_add(pressure_y, simd4f_mul(push, offset_y));
+                pressure_z = simd4f_add(pressure_z, simd4f_mul(push, offset_z));
+
+                // viscosity: (v_j - v_i) (h - r) / density_j
+                simd4f_t drag = simd4f_div(falloff, density_j);
+                viscosity_x = simd4f_add(viscosity_x, simd4f_mul(drag, simd4f_sub(simd4f_load(&fluid->velocity_x[j]), velocity_x)));
+                viscosity_y = simd4f_add(viscosity_y, simd4f_mul(drag, simd4f_sub(simd4f_load(&fluid->velocity_y[j]), velocity_y)));
+                viscosity_z = simd4f_add(viscosity_z, simd4f_mul(drag, simd4f_sub(simd4f_load(&fluid->velocity_z[j]), velocity_z)));
+            }
+        }
+
+        phy_real_t pressure_scale = fluid->particle_mass * kernel;
+        phy_real_t viscosity_scale = fluid->params.viscosity * fluid->particle_mass * kernel / fluid->density[i];
+        fluid->acceleration_x[i] = fluid->gravity.x + pressure_scale * sph_sum_lanes(pressure_x) + viscosity_scale * sph_sum_lanes(viscosity_x);
+        fluid->acceleration_y[i] = fluid->gravity.y + pressure_scale * sph_sum_lanes(pressure_y) + viscosity_scale * sph_sum_lanes(viscosity_y);
+        fluid->acceleration_z[i] = fluid->gravity.z + pressure_scale * sph_sum_lanes(pressure_z) + viscosity_scale * sph_sum_lanes(viscosity_z);
+    }
+}
+
+/**
+ * Finds the direction a collider's surface faces near a point, from
+ * how its signed distance changes around the point
+ */
+PRIVATE_FUNC vec3_t sph_get_collider_normal(collider_t collider, vec3_t point, phy_real_t sample_distance) {
+    vec3_t normal;
+    for (size_t axis = 0; axis < 3; axis++) {
+        vec3_t ahead = point, behind = point;
+        ahead.raw[axis] += sample_distance;
+        behind.raw[axis] -= sample_distance;
+        normal.raw[axis] = collider_signed_distance(collider, ahead) - collider_signed_distance(collider, behind);
+    }
+    vec3_unit(&normal);
+    return normal;
+}
+
+PRIVATE_FUNC void sph_coupling_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    sph_step_t *step = context;
+    sph_fluid_t *fluid = step->fluid;
+    const sph_coupling_t *coupling = step->coupling;
+    size_t collider_count = coupling->scene->collider_count;
+    vec3_t *body_forces = &step->body_forces[thread_index * collider_count];
+    vec3_t *body_torques = &step->body_torques[thread_index * collider_count];
+    phy_real_t radius = fluid->params.particle_spacing / 2;
+
+    for (size_t i = begin; i < end; i++) {
+        size_t count = min(fluid->coupling_counts[i], SPH_MAX_COLLIDERS_PER_PARTICLE);
+        vec3_t position = vec3_make(fluid->position_x[i], fluid->position_y[i], fluid->position_z[i]);
+        vec3_t velocity = vec3_make(fluid->velocity_x[i], fluid->velocity_y[i], fluid->velocity_z[i]);
+        for (size_t c = 0; c < count; c++) {
+            uint32_t index = fluid->coupling_results[i * SPH_MAX_COLLIDERS_PER_PARTICLE + c];
+            collider_t collider = coupling->scene->colliders[index];
+            phy_real_t depth = radius - collider_signed_distance(collider, position);
+            if (depth <= 0) {
+                continue;
+            }
+            vec3_t normal = sph_get_collider_normal(collider, position, fluid->params.particle_spacing * SPH_NORMAL_SAMPLE_DISTANCE);
+            if (vec3_magnitude_sqr(normal) < PHYSICS_EPSILON) {
+                continue;
+            }
+
+            // measure the particle's speed relative to the body's surface
+            body_t *body = coupling->bodies != NULL ? &coupling->bodies[index] : NULL;
+            vec3_t relative_velocity = velocity;
+            vec3_t lever = position;
+            if (body != NULL) {
+                vec3_add_to(&lever, body->position, -1);
+                vec3_t spin;
+                vec3_cross_product(&spin, body->angular_velocity, lever);
+                vec3_add_to(&relative_velocity, body->velocity, -1);
+                vec3_add_to(&relative_velocity, spin, -1);
+            }
+            phy_real_t normal_speed = vec3_dot_product(relative_velocity, normal);
+            phy_real_t push = max(coupling->stiffness * depth - coupling->damping * normal_speed, 0);
+            fluid->acceleration_x[i] += push * normal.x;
+            fluid->acceleration_y[i] += push * normal.y;
+            fluid->acceleration_z[i] += push * normal.z;
+
+            // the body gets pushed back just as hard
+            if (body != NULL) {
+                vec3_t force = normal;
+                vec3_multiply_by(&force, -push * fluid->particle_mass);
+                vec3_t torque;
+                vec3_cross_product(&torque, lever, force);
+                vec3_add_to(&body_forces[index], force, 1);
+                vec3_add_to(&body_torques[index], torque, 1);
+            }
+        }
+    }
+}
+
+/**
+ * Pushes particles out of the coupled colliders, and pushes the
+ * colliders' bodies back
+ */
+PRIVATE_FUNC int sph_fluid_couple(sph_fluid_t *fluid, const sph_coupling_t *coupling, threadpool_t *pool) {
+    const query_scene_t *scene = coupling->scene;
+    if (fluid->coupling_shapes == NULL) {
+        fluid->coupling_shapes = calloc(fluid->particle_capacity, (sizeof *fluid->coupling_shapes));
+        fluid->coupling_results = calloc(fluid->particle_capacity * SPH_MAX_COLLIDERS_PER_PARTICLE, (sizeof *fluid->coupling_results));
+        fluid->coupling_counts = calloc(fluid->particle_capacity, (sizeof *fluid->coupling_counts));
+    }
+    size_t thread_count = threadpool_get_thread_count(pool);
+    vec3_t *body_forces = calloc(thread_count * scene->collider_count + 1, (sizeof *body_forces));
+    vec3_t *body_torques = calloc(thread_count * scene->collider_count + 1, (sizeof *body_torques));
+    if (fluid->coupling_shapes == NULL || fluid->coupling_results == NULL || fluid->coupling_counts == NULL ||
+        body_forces == NULL || body_torques == NULL)
+    {
+        free(body_forces);
+        free(body_torques);
+        return SPH_ERROR_ALLOC;
+    }
+
+    phy_real_t radius = fluid->params.particle_spacing / 2;
+    for (size_t i = 0; i < fluid->particle_count; i++) {
+        vec3_t position = vec3_make(fluid->position_x[i], fluid->position_y[i], fluid->position_z[i]);
+        fluid->coupling_shapes[i] = collider_from_sphere(csphere_make(position, radius));
+    }
+    query_scene_overlap_colliders(scene, fluid->coupling_shapes, fluid->particle_count,
+        fluid->coupling_results, SPH_MAX_COLLIDERS_PER_PARTICLE, fluid->coupling_counts, pool);
+
+    sph_step_t step = { .fluid = fluid, .coupling = coupling, .body_forces = body_forces, .body_torques = body_torques };
+    threadpool_parallel_for(pool, fluid->particle_count, SPH_CHUNK_SIZE, sph_coupling_task, &step);
+
+    if (coupling->bodies != NULL) {
+        for (size_t thread = 0; thread < thread_count; thread++) {
+            for (size_t b = 0; b < scene->collider_count; b++) {
+                phy_body_add_force(&coupling->bodies[b], body_forces[thread * scene->collider_count + b]);
+                phy_body_add_torque(&coupling->bodies[b], body_torques[thread * scene->collider_count + b]);
+            }
+        }
+    }
+    free(body_forces);
+    free(body_torques);
+    return SPH_SUCCESS;
+}
+
+/**
+ * Pushes particles near the bounds back inside, like a wall of fluid
+ * particles would.  The push is as stiff as the fluid itself and damped
+ * just enough to not bounce
+ */
+PRIVATE_FUNC void sph_fluid_push_from_bounds(sph_fluid_t *fluid, size_t begin, size_t end) {
+    phy_real_t radius = fluid->params.particle_spacing / 2;
+    phy_real_t frequency = fluid->params.speed_of_sound / fluid->smoothing_length;
+    phy_real_t stiffness = frequency * frequency;
+    phy_real_t damping = 2 * frequency;
+    vec3_t bounds_min = bbox_get_min(fluid->bounds);
+    vec3_t bounds_max = bbox_get_max(fluid->bounds);
+    phy_real_t *positions[3] = { fluid->position_x, fluid->position_y, fluid->position_z };
+    phy_real_t *velocities[3] = { fluid->velocity_x, fluid->velocity_y, fluid->velocity_z };
+    phy_real_t *accelerations[3] = { fluid->acceleration_x, fluid->acceleration_y, fluid->acceleration_z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        phy_real_t low = bounds_min.raw[axis] + radius;
+        phy_real_t high = bounds_max.raw[axis] - radius;
+        for (size_t i = begin; i < end; i++) {
+            phy_real_t depth = 0;
+            if (positions[axis][i] < low) {
+                depth = low - positions[axis][i];
+            }
+            else if (positions[axis][i] > high) {
+                depth = high - positions[axis][i];
+            }
+            if (depth != 0) {
+                accelerations[axis][i] += stiffness * depth - damping * velocities[axis][i];
+            }
+        }
+    }
+}
+
+PRIVATE_FUNC void sph_integrate_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    sph_step_t *step = context;
+    sph_fluid_t *fluid = step->fluid;
+    phy_real_t dt = step->dt;
+
+    if (fluid->has_bounds) {
+        sph_fluid_push_from_bounds(fluid, begin, end);
+    }
+
+    // semi-implicit Euler: update velocities first, then move with the new velocities
+    for (size_t i = begin; i < end; i++) {
+        fluid->velocity_x[i] += fluid->acceleration_x[i] * dt;
+        fluid->velocity_y[i] += fluid->acceleration_y[i] * dt;
+        fluid->velocity_z[i] += fluid->acceleration_z[i] * dt;
+        fluid->position_x[i] += fluid->velocity_x[i] * dt;
+        fluid->position_y[i] += fluid->velocity_y[i] * dt;
+        fluid->position_z[i] += fluid->velocity_z[i] * dt;
+    }
+
+    if (!fluid->has_bounds) {
+        return;
+    }
+    // anything moving fast enough to get through the walls anyway is
+    // put back on the wall it crossed, and stops moving through it
+    vec3_t bounds_min = bbox_get_min(fluid->bounds);
+    vec3_t bounds_max = bbox_get_max(fluid->bounds);
+    phy_real_t *positions[3] = { fluid->position_x, fluid->position_y, fluid->position_z };
+    phy_real_t *velocities[3] = { fluid->velocity_x, fluid->velocity_y, fluid->velocity_z };
+    for (size_t axis = 0; axis < 3; axis++) {
+        for (size_t i = begin; i < end; i++) {
+            if (positions[axis][i] < bounds_min.raw[axis]) {
+                positions[axis][i] = bounds_min.raw[axis];
+                velocities[axis][i] = max(velocities[axis][i], 0);
+            }
+            else if (positions[axis][i] > bounds_max.raw[axis]) {
+                positions[axis][i] = bounds_max.raw[axis];
+                velocities[axis][i] = min(velocities[axis][i], 0);
+            }
+        }
+    }
+}
+
+int sph_fluid_step(sph_fluid_t *fluid, phy_real_t dt, const sph_coupling_t *coupling, threadpool_t *pool) {
+    safe_assert(fluid != NULL && dt > 0, SPH_ERROR_PARAMS);
+    safe_assert(coupling == NULL || coupling->scene != NULL, SPH_ERROR_PARAMS);
+
+    int result = particle_grid_build(fluid->grid, fluid->position_x, fluid->position_y, fluid->position_z,
+        fluid->particle_count, fluid->smoothing_length, pool);
+    if (result != PARTICLE_GRID_SUCCESS) {
+        return result == PARTICLE_GRID_ERROR_PARAMS ? SPH_ERROR_PARAMS : SPH_ERROR_ALLOC;
+    }
+    // after this, each run of particles in the grid is a run of indices
+    sph_fluid_reorder(fluid);
+
+    sph_step_t step = { .fluid = fluid, .dt = dt, .coupling = coupling };
+    threadpool_parallel_for(pool, fluid->particle_count, SPH_CHUNK_SIZE, sph_density_task, &step);
+    threadpool_parallel_for(pool, fluid->particle_count, SPH_CHUNK_SIZE, sph_force_task, &step);
+    if (coupling != NULL) {
+        result = sph_fluid_couple(fluid, coupling, pool);
+        if (result != SPH_SUCCESS) {
+            return result;
+        }
+    }
+    threadpool_parallel_for(pool, fluid->particle_count, SPH_CHUNK_SIZE, sph_integrate_task, &step);
+    return SPH_SUCCESS;
+}
+
+void sph_fluid_destroy(sph_fluid_t *fluid) {
+    if (fluid == NULL) {
+        return;
+    }
+
+    phy_real_t **arrays[SPH_REAL_ARRAY_COUNT];
+    sph_get_real_arrays(fluid, arrays);
+    for (size_t i = 0; i < SPH_REAL_ARRAY_COUNT; i++) {
+        free(*arrays[i]);
+    }
+    free(fluid->ids);
+    free(fluid->scratch);
+    free(fluid->coupling_shapes);
+    free(fluid->coupling_results);
+    free(fluid->coupling_counts);
+    particle_grid_destroy(fluid->grid);
+    free(fluid);
+}
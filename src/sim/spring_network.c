@@ -0,0 +1,361 @@
+#include "sim/spring_network.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/simd.h"
+#include "common/coloring.h"
+
+/**
+ * How many springs a network starts out with room for, if not told
+ */
+#define SPRING_NETWORK_DEFAULT_CAPACITY 1024
+
+/**
+ * How many springs a thread takes at a time.  A multiple of SIMD_WIDTH
+ */
+#define SPRING_NETWORK_CHUNK_SIZE 512
+
+/**
+ * The number of per-spring arrays of reals a network has
+ */
+#define SPRING_NETWORK_REAL_ARRAY_COUNT 8
+
+/**
+ * Everything spring_network_apply() needs on each thread
+ */
+struct SpringNetworkApply {
+    spring_network_t *network;
+    body_t *bodies;
+    /**
+     * Used instead of bodies, if not null.  Particles don't rotate, so
+     * springs attached to them apply no torque
+     */
+    particle_system_t *particles;
+    const periodic_box_t *box;
+    /**
+     * The first spring of the color being applied
+     */
+    size_t color_start;
+};
+typedef struct SpringNetworkApply spring_network_apply_t;
+
+/**
+ * Gets every per-spring array of reals, so they can all be grown together
+ */
+PRIVATE_FUNC void spring_network_get_real_arrays(spring_network_t *network, phy_real_t **arrays[SPRING_NETWORK_REAL_ARRAY_COUNT]) {
+    phy_real_t **all[SPRING_NETWORK_REAL_ARRAY_COUNT] = {
+        &network->a_endpoint_x, &network->a_endpoint_y, &network->a_endpoint_z,
+        &network->b_endpoint_x, &network->b_endpoint_y, &network->b_endpoint_z,
+        &network->spring_constant, &network->equilibrium_distance,
+    };
+    memcpy(arrays, all, (sizeof all));
+}
+
+/**
+ * Makes room for a given number of springs.  Every array of reals gets
+ * SIMD_WIDTH extra entries, so reading a full SIMD register from the
+ * last few springs stays in bounds
+ */
+PRIVATE_FUNC int spring_network_reserve(spring_network_t *network, size_t capacity) {
+    phy_real_t **arrays[SPRING_NETWORK_REAL_ARRAY_COUNT];
+    spring_network_get_real_arrays(network, arrays);
+    for (size_t i = 0; i < SPRING_NETWORK_REAL_ARRAY_COUNT; i++) {
+        phy_real_t *array = reallocarray(*arrays[i], capacity + SIMD_WIDTH, (sizeof *array));
+        if (array == NULL) {
+            return SPRING_NETWORK_ERROR_ALLOC;
+        }
+        memset(&array[network->spring_count], 0, (capacity + SIMD_WIDTH - network->spring_count) * (sizeof *array));
+        *arrays[i] = array;
+    }
+    uint32_t **bodies[] = { &network->body_a, &network->body_b };
+    for (size_t i = 0; i < (sizeof bodies) / (sizeof *bodies); i++) {
+        uint32_t *array = reallocarray(*bodies[i], capacity, (sizeof *array));
+        if (array == NULL) {
+            return SPRING_NETWORK_ERROR_ALLOC;
+        }
+        *bodies[i] = array;
+    }
+    network->spring_capacity = capacity;
+    return SPRING_NETWORK_SUCCESS;
+}
+
+spring_network_t *spring_network_create(size_t capacity) {
+    spring_network_t *network = calloc(1, (sizeof *network));
+    if (network == NULL) {
+        return NULL;
+    }
+    if (spring_network_reserve(network, capacity > 0 ? capacity : SPRING_NETWORK_DEFAULT_CAPACITY) != SPRING_NETWORK_SUCCESS) {
+        spring_network_destroy(network);
+        return NULL;
+    }
+    return network;
+}
+
+int spring_network_add(spring_network_t *network, uint32_t a, vec3_t a_endpoint, uint32_t b, vec3_t b_endpoint,
+    phy_real_t spring_constant, phy_real_t equilibrium_distance)
+{
+    safe_assert(network != NULL && network->spring_count < UINT32_MAX, SPRING_NETWORK_ERROR_PARAMS);
+
+    if (network->spring_count >= network->spring_capacity) {
+        int result = spring_network_reserve(network, network->spring_capacity * 2);
+        if (result != SPRING_NETWORK_SUCCESS) {
+            return result;
+        }
+    }
+
+    size_t i = network->spring_count;
+    network->body_a[i] = a;
+    network->body_b[i] = b;
+    network->a_endpoint_x[i] = a_endpoint.x;
+    network->a_endpoint_y[i] = a_endpoint.y;
+    network->a_endpoint_z[i] = a_endpoint.z;
+    network->b_endpoint_x[i] = b_endpoint.x;
+    network->b_endpoint_y[i] = b_endpoint.y;
+    network->b_endpoint_z[i] = b_endpoint.z;
+    network->spring_constant[i] = spring_constant;
+    network->equilibrium_distance[i] = equilibrium_distance;
+    if (a > network->max_body_index) {
+        network->max_body_index = a;
+    }
+    if (b > network->max_body_index) {
+        network->max_body_index = b;
+    }
+    network->spring_count++;
+    network->needs_coloring = true;
+    return SPRING_NETWORK_SUCCESS;
+}
+
+int spring_network_add_spring(spring_network_t *network, spring_t spring, const body_t *bodies, size_t body_count) {
+    safe_assert(bodies != NULL && spring.a != NULL && spring.b != NULL, SPRING_NETWORK_ERROR_PARAMS);
+    safe_assert(spring.a >= bodies && spring.a < bodies + body_count, SPRING_NETWORK_ERROR_PARAMS);
+    safe_assert(spring.b >= bodies && spring.b < bodies + body_count, SPRING_NETWORK_ERROR_PARAMS);
+
+    return spring_network_add(network, spring.a - bodies, spring.a_endpoint, spring.b - bodies, spring.b_endpoint,
+        spring.spring_constant, spring.equilibrium_distance);
+}
+
+/**
+ * Colors a network's springs, and sorts them by color
+ */
+PRIVATE_FUNC int spring_network_color(spring_network_t *network, size_t body_count) {
+    size_t count = network->spring_count;
+    for (size_t i = 0; i < count; i++) {
+        if (network->body_a[i] >= body_count || network->body_b[i] >= body_count) {
+            return SPRING_NETWORK_ERROR_PARAMS;
+        }
+    }
+
+    uint32_t *colors = calloc(count + 1, (sizeof *colors));
+    uint32_t *order = calloc(count + 1, (sizeof *order));
+    phy_real_t *scratch = calloc(count + 1, (sizeof *scratch));
+    if (colors == NULL || order == NULL || scratch == NULL) {
+        free(colors);
+        free(order);
+        free(scratch);
+        return SPRING_NETWORK_ERROR_ALLOC;
+    }
+
+    const uint32_t *members[] = { network->body_a, network->body_b };
+    size_t color_count = 0;
+    int result = coloring_color(members, 2, count, body_count, colors, &color_count);
+    uint32_t *color_starts = NULL;
+    if (result == COLORING_SUCCESS) {
+        color_starts = reallocarray(network->color_starts, color_count + 1, (sizeof *color_starts));
+        result = color_starts != NULL ? coloring_sort(colors, count, color_count, order, color_starts) : COLORING_ERROR_ALLOC;
+    }
+    if (color_starts != NULL) {
+        network->color_starts = color_starts;
+    }
+    if (result != COLORING_SUCCESS) {
+        free(colors);
+        free(order);
+        free(scratch);
+        return result == COLORING_ERROR_ALLOC ? SPRING_NETWORK_ERROR_ALLOC : SPRING_NETWORK_ERROR_PARAMS;
+    }
+
+    // reorder every field by color.  The colors are no longer needed, so
+    // they make room for reordering the body indices
+    uint32_t *bodies[] = { network->body_a, network->body_b };
+    for (size_t a = 0; a < (sizeof bodies) / (sizeof *bodies); a++) {
+        for (size_t i = 0; i < count; i++) {
+            colors[i] = bodies[a][order[i]];
+        }
+        memcpy(bodies[a], colors, count * (sizeof *colors));
+    }
+    phy_real_t **arrays[SPRING_NETWORK_REAL_ARRAY_COUNT];
+    spring_network_get_real_arrays(network, arrays);
+    for (size_t a = 0; a < SPRING_NETWORK_REAL_ARRAY_COUNT; a++) {
+        for (size_t i = 0; i < count; i++) {
+            scratch[i] = (*arrays[a])[order[i]];
+        }
+        memcpy(*arrays[a], scratch, count * (sizeof *scratch));
+    }
+
+    network->color_count = color_count;
+    network->needs_coloring = false;
+    free(colors);
+    free(order);
+    free(scratch);
+    return SPRING_NETWORK_SUCCESS;
+}
+
+/**
+ * Finds a, cross b, for SIMD_WIDTH vectors at a time
+ */
+PRIVATE_FUNC void spring_network_cross(simd4f_t dest[3], const simd4f_t a[3], const simd4f_t b[3]) {
+    dest[0] = simd4f_sub(simd4f_mul(a[1], b[2]), simd4f_mul(a[2], b[1]));
+    dest[1] = simd4f_sub(simd4f_mul(a[2], b[0]), simd4f_mul(a[0], b[2]));
+    dest[2] = simd4f_sub(simd4f_mul(a[0], b[1]), simd4f_mul(a[1], b[0]));
+}
+
+PRIVATE_FUNC void spring_network_apply_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    spring_network_apply_t *apply = context;
+    spring_network_t *network = apply->network;
+    body_t *bodies = apply->bodies;
+    particle_system_t *particles = apply->particles;
+    static const float lane_indices[SIMD_WIDTH] = { 0, 1, 2, 3 };
+    simd4f_t zero = simd4f_set1(0);
+    simd4f_t min_length = simd4f_set1(PHYSICS_EPSILON);
+
+    for (size_t batch = apply->color_start + begin; batch < apply->color_start + end; batch += SIMD_WIDTH) {
+        size_t lane_count = apply->color_start + end - batch < SIMD_WIDTH ? apply->color_start + end - batch : SIMD_WIDTH;
+        simd4f_t valid = simd4f_less_equal(simd4f_load(lane_indices), simd4f_set1((float)lane_count - 1));
+
+        // gather each spring's bodies' positions.  Lanes past the end get
+        // the last spring's bodies, and a stiffness of zero
+        float offsets[3][SIMD_WIDTH];
+        for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            size_t spring = batch + (lane < lane_count ? lane : lane_count - 1);
+            vec3_t a, b;
+            if (particles != NULL) {
+                a = particle_system_get_position(particles, network->body_a[spring]);
+                b = particle_system_get_position(particles, network->body_b[spring]);
+            }
+            else {
+                a = bodies[network->body_a[spring]].position;
+                b = bodies[network->body_b[spring]].position;
+            }
+            vec3_add_to(&a, vec3_make(network->a_endpoint_x[spring], network->a_endpoint_y[spring], network->a_endpoint_z[spring]), 1);
+            vec3_add_to(&b, vec3_make(network->b_endpoint_x[spring], network->b_endpoint_y[spring], network->b_endpoint_z[spring]), 1);
+            vec3_t offset = b;
+            vec3_add_to(&offset, a, -1);
+            if (apply->box != NULL) {
+                offset = periodic_box_get_displacement(apply->box, a, b);
+            }
+            for (size_t axis = 0; axis < 3; axis++) {
+                offsets[axis][lane] = offset.raw[axis];
+            }
+        }
+        simd4f_t offset[3] = { simd4f_load(offsets[0]), simd4f_load(offsets[1]), simd4f_load(offsets[2]) };
+
+        // the same force as spring_apply_constraint(), pulling a toward b
+        simd4f_t length = simd4f_sqrt(simd4f_add(simd4f_add(simd4f_mul(offset[0], offset[0]),
+            simd4f_mul(offset[1], offset[1])), simd4f_mul(offset[2], offset[2])));
+        simd4f_t stiffness = simd4f_select(valid, simd4f_load(&network->spring_constant[batch]), zero);
+        simd4f_t magnitude = simd4f_mul(simd4f_sub(length, simd4f_load(&network->equilibrium_distance[batch])), stiffness);
+        // a spring with no length has no direction to pull in
+        simd4f_t scale = simd4f_select(simd4f_greater_equal(length, min_length),
+            simd4f_div(magnitude, simd4f_max(length, min_length)), zero);
+        simd4f_t force[3] = { simd4f_mul(offset[0], scale), simd4f_mul(offset[1], scale), simd4f_mul(offset[2], scale) };
+
+        simd4f_t a_endpoint[3] = {
+            simd4f_load(&network->a_endpoint_x[batch]), simd4f_load(&network->a_endpoint_y[batch]), simd4f_load(&network->a_endpoint_z[batch]),
+        };
+        simd4f_t b_endpoint[3] = {
+            simd4f_load(&network->b_endpoint_x[batch]), simd4f_load(&network->b_endpoint_y[batch]), simd4f_load(&network->b_endpoint_z[batch]),
+        };
+        simd4f_t a_torque[3], b_torque[3];
+        spring_network_cross(a_torque, a_endpoint, force);
+        spring_network_cross(b_torque, b_endpoint, force);
+
+        float forces[3][SIMD_WIDTH], a_torques[3][SIMD_WIDTH], b_torques[3][SIMD_WIDTH];
+        for (size_t axis = 0; axis < 3; axis++) {
+            simd4f_store(forces[axis], force[axis]);
+            simd4f_store(a_torques[axis], a_torque[axis]);
+            simd4f_store(b_torques[axis], b_torque[axis]);
+        }
+
+        // springs of one color never share a body, so nothing else is
+        // writing to these bodies.  b gets the opposite force
+        if (particles != NULL) {
+            for (size_t lane = 0; lane < lane_count; lane++) {
+                uint32_t a = network->body_a[batch + lane], b = network->body_b[batch + lane];
+                particles->force_x[a] += forces[0][lane];
+                particles->force_y[a] += forces[1][lane];
+                particles->force_z[a] += forces[2][lane];
+                particles->force_x[b] -= forces[0][lane];
+                particles->force_y[b] -= forces[1][lane];
+                particles->force_z[b] -= forces[2][lane];
+            }
+            continue;
+        }
+        for (size_t lane = 0; lane < lane_count; lane++) {
+            body_t *a = &bodies[network->body_a[batch + lane]];
+            body_t *b = &bodies[network->body_b[batch + lane]];
+            for (size_t axis = 0; axis < 3; axis++) {
+                a->net_force.raw[axis] += forces[axis][lane];
+                a->net_torque.raw[axis] += a_torques[axis][lane];
+                b->net_force.raw[axis] -= forces[axis][lane];
+                b->net_torque.raw[axis] -= b_torques[axis][lane];
+            }
+        }
+    }
+}
+
+/**
+ * Applies every color of springs in turn, with the bodies (or particles) in apply
+ */
+PRIVATE_FUNC int spring_network_apply_colors(spring_network_t *network, size_t body_count, spring_network_apply_t *apply, threadpool_t *pool) {
+    // coloring only checks the indices when springs are added, but each
+    // call can pass a different array
+    if (network->spring_count > 0 && network->max_body_index >= body_count) {
+        return SPRING_NETWORK_ERROR_PARAMS;
+    }
+
+    if (network->needs_coloring) {
+        int result = spring_network_color(network, body_count);
+        if (result != SPRING_NETWORK_SUCCESS) {
+            return result;
+        }
+    }
+
+    for (size_t color = 0; color < network->color_count; color++) {
+        apply->color_start = network->color_starts[color];
+        threadpool_parallel_for(pool, network->color_starts[color + 1] - network->color_starts[color],
+            SPRING_NETWORK_CHUNK_SIZE, spring_network_apply_task, apply);
+    }
+    return SPRING_NETWORK_SUCCESS;
+}
+
+int spring_network_apply(spring_network_t *network, body_t *bodies, size_t body_count, const periodic_box_t *box, threadpool_t *pool) {
+    safe_assert(network != NULL && (bodies != NULL || network->spring_count == 0), SPRING_NETWORK_ERROR_PARAMS);
+
+    spring_network_apply_t apply = { .network = network, .bodies = bodies, .box = box };
+    return spring_network_apply_colors(network, body_count, &apply, pool);
+}
+
+int spring_network_apply_particles(spring_network_t *network, particle_system_t *particles, const periodic_box_t *box, threadpool_t *pool) {
+    safe_assert(network != NULL && particles != NULL, SPRING_NETWORK_ERROR_PARAMS);
+
+    spring_network_apply_t apply = { .network = network, .particles = particles, .box = box };
+    return spring_network_apply_colors(network, particles->count, &apply, pool);
+}
+
+void spring_network_destroy(spring_network_t *network) {
+    if (network == NULL) {
+        return;
+    }
+
+    phy_real_t **arrays[SPRING_NETWORK_REAL_ARRAY_COUNT];
+    spring_network_get_real_arrays(network, arrays);
+    for (size_t i = 0; i < SPRING_NETWORK_REAL_ARRAY_COUNT; i++) {
+        free(*arrays[i]);
+    }
+    free(network->body_a);
+    free(network->body_b);
+    free(network->color_starts);
+    free(network);
+}
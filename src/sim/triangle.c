@@ -0,0 +1,397 @@
+#include "sim/triangle.h"
+
+#include "common/defines.h"
+#include "common/math.h"
+
+/**
+ * Edge axes are only used for a box contact if they beat the best face
+ * axis by this factor.  Face normals give much steadier contacts for
+ * boxes resting on a surface, so they get the benefit of the doubt
+ */
+#define TRIANGLE_EDGE_AXIS_BIAS 0.95
+
+/**
+ * Gets the vector pointing from one point to another
+ */
+PRIVATE_FUNC vec3_t triangle_difference(vec3_t to, vec3_t from) {
+    vec3_add_to(&to, from, -1);
+    return to;
+}
+
+vec3_t triangle_get_normal(triangle_t triangle) {
+    vec3_t normal;
+    vec3_cross_product(&normal,
+        triangle_difference(triangle.b, triangle.a),
+        triangle_difference(triangle.c, triangle.a));
+    if (vec3_magnitude_sqr(normal) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        return VEC3_ZERO;
+    }
+    vec3_unit(&normal);
+    return normal;
+}
+
+// closest point on triangle taken and modified from
+// Real-Time Collision Detection (Ericson), section 5.1.5
+void triangle_clamp_point(triangle_t triangle, vec3_t *point) {
+    safe_assert(point != NULL,);
+
+    vec3_t ab = triangle_difference(triangle.b, triangle.a);
+    vec3_t ac = triangle_difference(triangle.c, triangle.a);
+
+    // check if the point is in the vertex region outside a
+    vec3_t ap = triangle_difference(*point, triangle.a);
+    phy_real_t d1 = vec3_dot_product(ab, ap);
+    phy_real_t d2 = vec3_dot_product(ac, ap);
+    if (d1 <= 0 && d2 <= 0) {
+        *point = triangle.a;
+        return;
+    }
+
+    // check if the point is in the vertex region outside b
+    vec3_t bp = triangle_difference(*point, triangle.b);
+    phy_real_t d3 = vec3_dot_product(ab, bp);
+    phy_real_t d4 = vec3_dot_product(ac, bp);
+    if (d3 >= 0 && d4 <= d3) {
+        *point = triangle.b;
+        return;
+    }
+
+    // check if the point is in the edge region of ab
+    phy_real_t vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        *point = triangle.a;
+        vec3_add_to(point, ab, d1 / (d1 - d3));
+        return;
+    }
+
+    // check if the point is in the vertex region outside c
+    vec3_t cp = triangle_difference(*point, triangle.c);
+    phy_real_t d5 = vec3_dot_product(ab, cp);
+    phy_real_t d6 = vec3_dot_product(ac, cp);
+    if (d6 >= 0 && d5 <= d6) {
+        *point = triangle.c;
+        return;
+    }
+
+    // check if the point is in the edge region of ac
+    phy_real_t vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        *point = triangle.a;
+        vec3_add_to(point, ac, d2 / (d2 - d6));
+        return;
+    }
+
+    // check if the point is in the edge region of bc
+    phy_real_t va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+        *point = triangle.b;
+        vec3_add_to(point, triangle_difference(triangle.c, triangle.b), (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        return;
+    }
+
+    // the point is inside the face; use its barycentric coordinates
+    phy_real_t denominator = 1 / (va + vb + vc);
+    *point = triangle.a;
+    vec3_add_to(point, ab, vb * denominator);
+    vec3_add_to(point, ac, vc * denominator);
+}
+
+// segment/triangle intersection based on the Moller-Trumbore algorithm
+bool triangle_intersects_segment(triangle_t triangle, segment_t segment, phy_real_t *t) {
+    vec3_t direction = triangle_difference(segment.end, segment.start);
+    vec3_t ab = triangle_difference(triangle.b, triangle.a);
+    vec3_t ac = triangle_difference(triangle.c, triangle.a);
+
+    vec3_t p;
+    vec3_cross_product(&p, direction, ac);
+    phy_real_t determinant = vec3_dot_product(ab, p);
+    if (determinant > -PHYSICS_EPSILON && determinant < PHYSICS_EPSILON) {
+        return false; // the segment is parallel to the triangle
+    }
+    phy_real_t inverse_determinant = 1 / determinant;
+
+    vec3_t from_a = triangle_difference(segment.start, triangle.a);
+    phy_real_t u = vec3_dot_product(from_a, p) * inverse_determinant;
+    if (u < 0 || u > 1) {
+        return false;
+    }
+
+    vec3_t q;
+    vec3_cross_product(&q, from_a, ab);
+    phy_real_t v = vec3_dot_product(direction, q) * inverse_determinant;
+    if (v < 0 || u + v > 1) {
+        return false;
+    }
+
+    phy_real_t hit = vec3_dot_product(ac, q) * inverse_determinant;
+    if (hit < 0 || hit > 1) {
+        return false;
+    }
+    if (t != NULL) {
+        *t = hit;
+    }
+    return true;
+}
+
+phy_real_t triangle_closest_points_segment(triangle_t triangle, segment_t segment, vec3_t *on_triangle, vec3_t *on_segment) {
+    phy_real_t t;
+    if (triangle_intersects_segment(triangle, segment, &t)) {
+        vec3_t hit = segment_point_at(segment, t);
+        if (on_triangle != NULL) {
+            *on_triangle = hit;
+        }
+        if (on_segment != NULL) {
+            *on_segment = hit;
+        }
+        return 0;
+    }
+
+    // otherwise, the closest points involve either one of the segment's
+    // endpoints or one of the triangle's edges
+    vec3_t best_on_triangle = segment.start;
+    triangle_clamp_point(triangle, &best_on_triangle);
+    vec3_t best_on_segment = segment.start;
+    phy_real_t best_distance_sqr = vec3_distance_sqr(best_on_triangle, best_on_segment);
+
+    vec3_t end_on_triangle = segment.end;
+    triangle_clamp_point(triangle, &end_on_triangle);
+    phy_real_t distance_sqr = vec3_distance_sqr(end_on_triangle, segment.end);
+    if (distance_sqr < best_distance_sqr) {
+        best_distance_sqr = distance_sqr;
+        best_on_triangle = end_on_triangle;
+        best_on_segment = segment.end;
+    }
+
+    segment_t edges[3] = {
+        segment_make(triangle.a, triangle.b),
+        segment_make(triangle.b, triangle.c),
+        segment_make(triangle.c, triangle.a),
+    };
+    for (size_t i = 0; i < 3; i++) {
+        vec3_t on_edge, on_this_segment;
+        distance_sqr = segment_closest_points_segment(edges[i], segment, &on_edge, &on_this_segment);
+        if (distance_sqr < best_distance_sqr) {
+            best_distance_sqr = distance_sqr;
+            best_on_triangle = on_edge;
+            best_on_segment = on_this_segment;
+        }
+    }
+
+    if (on_triangle != NULL) {
+        *on_triangle = best_on_triangle;
+    }
+    if (on_segment != NULL) {
+        *on_segment = best_on_segment;
+    }
+    return best_distance_sqr;
+}
+
+void triangle_get_bounds(triangle_t triangle, bbox_t *box) {
+    safe_assert(box != NULL,);
+
+    box->position = VEC3_ZERO;
+    box->left = min(triangle.a.x, min(triangle.b.x, triangle.c.x));
+    box->right = max(triangle.a.x, max(triangle.b.x, triangle.c.x));
+    box->bottom = min(triangle.a.y, min(triangle.b.y, triangle.c.y));
+    box->top = max(triangle.a.y, max(triangle.b.y, triangle.c.y));
+    box->back = min(triangle.a.z, min(triangle.b.z, triangle.c.z));
+    box->front = max(triangle.a.z, max(triangle.b.z, triangle.c.z));
+}
+
+/**
+ * Builds a contact for a shape whose closest point to the triangle is
+ * known, pushing it away along the line between the two points
+ */
+PRIVATE_FUNC void triangle_make_rounded_contact(triangle_t triangle, vec3_t on_triangle, vec3_t on_shape, phy_real_t radius, contact_t *contact) {
+    vec3_t offset = triangle_difference(on_shape, on_triangle);
+    phy_real_t distance = vec3_magnitude(offset);
+    if (distance > PHYSICS_EPSILON) {
+        vec3_multiply_by(&offset, 1 / distance);
+        *contact = contact_make(on_triangle, offset, radius - distance);
+    }
+    else {
+        // the shape's center is right on the triangle, so there
+        // is no line to push along; use the face instead
+        *contact = contact_make(on_triangle, triangle_get_normal(triangle), radius);
+    }
+}
+
+bool triangle_collide_csphere(triangle_t triangle, csphere_t sphere, contact_t *contact) {
+    vec3_t closest = sphere.center;
+    triangle_clamp_point(triangle, &closest);
+    if (vec3_distance_sqr(closest, sphere.center) > sphere.radius * sphere.radius) {
+        return false;
+    }
+
+    if (contact != NULL) {
+        triangle_make_rounded_contact(triangle, closest, sphere.center, sphere.radius, contact);
+    }
+    return true;
+}
+
+bool triangle_collide_ccapsule(triangle_t triangle, ccapsule_t capsule, contact_t *contact) {
+    vec3_t on_triangle, on_segment;
+    phy_real_t distance_sqr = triangle_closest_points_segment(triangle, ccapsule_get_segment(capsule), &on_triangle, &on_segment);
+    if (distance_sqr > capsule.radius * capsule.radius) {
+        return false;
+    }
+    if (contact == NULL) {
+        return true;
+    }
+
+    if (distance_sqr > PHYSICS_EPSILON * PHYSICS_EPSILON) {
+        triangle_make_rounded_contact(triangle, on_triangle, on_segment, capsule.radius, contact);
+        return true;
+    }
+
+    // the core segment touches the triangle, so push the capsule out
+    // whichever side has more of the segment on it
+    vec3_t normal = triangle_get_normal(triangle);
+    phy_real_t start_height = vec3_dot_product(triangle_difference(capsule.start, triangle.a), normal);
+    phy_real_t end_height = vec3_dot_product(triangle_difference(capsule.end, triangle.a), normal);
+    if (start_height + end_height >= 0) {
+        *contact = contact_make(on_triangle, normal, capsule.radius - min(start_height, end_height));
+    }
+    else {
+        vec3_multiply_by(&normal, -1);
+        *contact = contact_make(on_triangle, normal, capsule.radius + max(start_height, end_height));
+    }
+    return true;
+}
+
+/**
+ * Runs the separating axis test between a triangle and a box centered at
+ * the origin.  Populates the contact (if not null) relative to the box
+ * @param triangle The triangle, relative to the box's center
+ * @param half_extents Half of the box's size along each axis
+ */
+PRIVATE_FUNC bool triangle_collide_centered_box(triangle_t triangle, vec3_t half_extents, contact_t *contact) {
+    vec3_t edges[3] = {
+        triangle_difference(triangle.b, triangle.a),
+        triangle_difference(triangle.c, triangle.b),
+        triangle_difference(triangle.a, triangle.c),
+    };
+
+    // the face normal, the box's axes, then every edge crossed
+    // with every box axis
+    vec3_t axes[13];
+    vec3_cross_product(&axes[0], edges[0], edges[1]);
+    axes[1] = vec3_make(1, 0, 0);
+    axes[2] = vec3_make(0, 1, 0);
+    axes[3] = vec3_make(0, 0, 1);
+    for (size_t edge = 0; edge < 3; edge++) {
+        for (size_t box_axis = 0; box_axis < 3; box_axis++) {
+            vec3_cross_product(&axes[4 + edge * 3 + box_axis], axes[1 + box_axis], edges[edge]);
+        }
+    }
+
+    vec3_t best_normal = VEC3_ZERO;
+    phy_real_t best_depth = 0;
+    // edge axes are compared by their biased depth, but the contact
+    // reports the real one
+    phy_real_t best_biased_depth = 0;
+    bool found_axis = false;
+    for (size_t i = 0; i < 13; i++) {
+        vec3_t axis = axes[i];
+        if (vec3_magnitude_sqr(axis) < PHYSICS_EPSILON * PHYSICS_EPSILON) {
+            continue; // parallel edges don't make a usable axis
+        }
+        vec3_unit(&axis);
+
+        phy_real_t projected_a = vec3_dot_product(triangle.a, axis);
+        phy_real_t projected_b = vec3_dot_product(triangle.b, axis);
+        phy_real_t projected_c = vec3_dot_product(triangle.c, axis);
+        phy_real_t triangle_min = min(projected_a, min(projected_b, projected_c));
+        phy_real_t triangle_max = max(projected_a, max(projected_b, projected_c));
+        phy_real_t box_radius =
+            half_extents.x * fabs(axis.x) +
+            half_extents.y * fabs(axis.y) +
+            half_extents.z * fabs(axis.z);
+
+        // how far the box would need to move either way along the axis
+        phy_real_t depth_forward = triangle_max + box_radius;
+        phy_real_t depth_backward = box_radius - triangle_min;
+        if (depth_forward < 0 || depth_backward < 0) {
+            return false; // found a separating axis
+        }
+
+        phy_real_t depth = min(depth_forward, depth_backward);
+        if (depth_backward < depth_forward) {
+            vec3_multiply_by(&axis, -1);
+        }
+        phy_real_t biased_depth = i >= 4 ? depth / TRIANGLE_EDGE_AXIS_BIAS : depth;
+        if (!found_axis || biased_depth < best_biased_depth) {
+            found_axis = true;
+            best_biased_depth = biased_depth;
+            best_depth = depth;
+            best_normal = axis;
+        }
+    }
+
+    if (contact != NULL) {
+        // the point on the triangle nearest the box's center, pulled
+        // into the box, lies in the overlapping region
+        vec3_t point = VEC3_ZERO;
+        triangle_clamp_point(triangle, &point);
+        point.x = clamp(point.x, -half_extents.x, half_extents.x);
+        point.y = clamp(point.y, -half_extents.y, half_extents.y);
+        point.z = clamp(point.z, -half_extents.z, half_extents.z);
+        *contact = contact_make(point, best_normal, best_depth);
+    }
+    return found_axis;
+}
+
+bool triangle_collide_bbox(triangle_t triangle, bbox_t box, contact_t *contact) {
+    vec3_t box_min = bbox_get_min(box);
+    vec3_t box_max = bbox_get_max(box);
+    vec3_t center = box_min;
+    vec3_add_to(&center, box_max, 1);
+    vec3_multiply_by(&center, 0.5);
+    vec3_t half_extents = triangle_difference(box_max, center);
+
+    vec3_add_to(&triangle.a, center, -1);
+    vec3_add_to(&triangle.b, center, -1);
+    vec3_add_to(&triangle.c, center, -1);
+    if (!triangle_collide_centered_box(triangle, half_extents, contact)) {
+        return false;
+    }
+    if (contact != NULL) {
+        vec3_add_to(&contact->point, center, 1);
+    }
+    return true;
+}
+
+bool triangle_collide_ccube(triangle_t triangle, ccube_t cube, contact_t *contact) {
+    // move the triangle into the cube's model space, where the cube
+    // is an AABB centered at the origin
+    ccube_apply_cube_transformations(cube, &triangle.a);
+    ccube_apply_cube_transformations(cube, &triangle.b);
+    ccube_apply_cube_transformations(cube, &triangle.c);
+
+    vec3_t half_extents = vec3_make(cube.width / 2, cube.height / 2, cube.length / 2);
+    if (!triangle_collide_centered_box(triangle, half_extents, contact)) {
+        return false;
+    }
+    if (contact != NULL) {
+        ccube_undo_cube_transformations(cube, &contact->point);
+        // directions only get rotated, not moved
+        cube.position = VEC3_ZERO;
+        ccube_undo_cube_transformations(cube, &contact->normal);
+    }
+    return true;
+}
+
+bool triangle_collide_collider(triangle_t triangle, collider_t collider, contact_t *contact) {
+    switch (collider.kind) {
+        case COLLIDER_BBOX:
+            return triangle_collide_bbox(triangle, collider.bbox, contact);
+        case COLLIDER_SPHERE:
+            return triangle_collide_csphere(triangle, collider.sphere, contact);
+        case COLLIDER_CUBE:
+            return triangle_collide_ccube(triangle, collider.cube, contact);
+        case COLLIDER_CAPSULE:
+            return triangle_collide_ccapsule(triangle, collider.capsule, contact);
+        default:
+            abort();
+    }
+}
@@ -0,0 +1,277 @@
+#include "sim/trimesh.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "common/defines.h"
+#include "common/math.h"
+#include "common/simd.h"
+
+/**
+ * Called for every leaf a traversal reaches
+ * @param context Whatever was passed to the traversal
+ * @param first_triangle The index of the leaf's first triangle
+ * @param triangle_count The number of triangles in the leaf
+ */
+typedef void (*trimesh_leaf_visitor_t)(void *context, uint32_t first_triangle, size_t triangle_count);
+
+/**
+ * Everything trimesh_collide_collider() needs while visiting leaves
+ */
+struct TriangleMeshCollision {
+    const trimesh_t *mesh;
+    collider_t collider;
+    bbox_t collider_bounds;
+    contact_t *contacts;
+    size_t max_contacts;
+    size_t found;
+};
+typedef struct TriangleMeshCollision trimesh_collision_t;
+
+/**
+ * Everything trimesh_query_bbox() needs while visiting leaves
+ */
+struct TriangleMeshQuery {
+    uint32_t *triangles;
+    size_t max_triangles;
+    size_t found;
+};
+typedef struct TriangleMeshQuery trimesh_query_t;
+
+/**
+ * Converts a coordinate to its quantized form.  Rounds outward, with an
+ * extra step of padding, so quantized bounds always contain the originals
+ * @param round_up true for the maximum of a range, false for its minimum
+ */
+PRIVATE_FUNC uint16_t trimesh_quantize(phy_real_t value, phy_real_t origin, phy_real_t scale, bool round_up) {
+    phy_real_t quantized = (value - origin) / scale;
+    quantized = round_up ? ceil(quantized) + 1 : floor(quantized) - 1;
+    return (uint16_t)clamp(quantized, 0, TRIMESH_QUANTIZED_MAX);
+}
+
+/**
+ * Copies a node out of a full-precision BVH, quantizing its bounds
+ */
+PRIVATE_FUNC void trimesh_quantize_node(const trimesh_t *mesh, const bvh_node_t *source, trimesh_node_t *dest) {
+    for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+        dest->child[slot] = source->child[slot];
+        dest->triangle_count[slot] = source->item_count[slot];
+        if (source->child[slot] == BVH_EMPTY) {
+            dest->min_x[slot] = dest->min_y[slot] = dest->min_z[slot] = TRIMESH_QUANTIZED_MAX;
+            dest->max_x[slot] = dest->max_y[slot] = dest->max_z[slot] = 0;
+            continue;
+        }
+        dest->min_x[slot] = trimesh_quantize(source->min_x[slot], mesh->origin.x, mesh->scale.x, false);
+        dest->min_y[slot] = trimesh_quantize(source->min_y[slot], mesh->origin.y, mesh->scale.y, false);
+        dest->min_z[slot] = trimesh_quantize(source->min_z[slot], mesh->origin.z, mesh->scale.z, false);
+        dest->max_x[slot] = trimesh_quantize(source->max_x[slot], mesh->origin.x, mesh->scale.x, true);
+        dest->max_y[slot] = trimesh_quantize(source->max_y[slot], mesh->origin.y, mesh->scale.y, true);
+        dest->max_z[slot] = trimesh_quantize(source->max_z[slot], mesh->origin.z, mesh->scale.z, true);
+    }
+}
+
+trimesh_t *trimesh_create(const vec3_t *vertices, size_t vertex_count, const uint32_t *indices, size_t triangle_count) {
+    if ((vertices == NULL && vertex_count > 0) || (indices == NULL && triangle_count > 0)) {
+        return NULL;
+    }
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        if (indices[i] >= vertex_count) {
+            return NULL;
+        }
+    }
+
+    trimesh_t *mesh = calloc(1, (sizeof *mesh));
+    if (mesh == NULL) {
+        return NULL;
+    }
+    // allocate at least one of everything so that an empty mesh still has arrays
+    mesh->vertices = calloc(vertex_count > 0 ? vertex_count : 1, (sizeof *mesh->vertices));
+    mesh->indices = calloc(triangle_count > 0 ? triangle_count * 3 : 1, (sizeof *mesh->indices));
+    bbox_t *bounds = calloc(triangle_count > 0 ? triangle_count : 1, (sizeof *bounds));
+    if (mesh->vertices == NULL || mesh->indices == NULL || bounds == NULL) {
+        free(bounds);
+        trimesh_destroy(mesh);
+        return NULL;
+    }
+    memcpy(mesh->vertices, vertices, vertex_count * (sizeof *vertices));
+    mesh->vertex_count = vertex_count;
+    mesh->triangle_count = triangle_count;
+
+    for (size_t i = 0; i < triangle_count; i++) {
+        triangle_get_bounds(triangle_make(
+            vertices[indices[i * 3]],
+            vertices[indices[i * 3 + 1]],
+            vertices[indices[i * 3 + 2]]
+        ), &bounds[i]);
+    }
+
+    // build at full precision first, then squash the result down
+    bvh_t *bvh = bvh_create(bounds, triangle_count);
+    free(bounds);
+    if (bvh == NULL) {
+        trimesh_destroy(mesh);
+        return NULL;
+    }
+
+    // store the triangles in the tree's order, so leaves can point
+    // straight at them
+    for (size_t i = 0; i < triangle_count; i++) {
+        memcpy(&mesh->indices[i * 3], &indices[bvh->items[i] * 3], 3 * (sizeof *indices));
+    }
+
+    if (triangle_count > 0) {
+        bvh_get_bounds(bvh, &mesh->bounds);
+    }
+    else {
+        mesh->bounds = (bbox_t){ .position = VEC3_ZERO };
+    }
+    mesh->origin = bbox_get_min(mesh->bounds);
+    vec3_t extent = bbox_get_max(mesh->bounds);
+    vec3_add_to(&extent, mesh->origin, -1);
+    for (size_t axis = 0; axis < 3; axis++) {
+        // a flat mesh still needs a usable scale along its flat axis
+        mesh->scale.raw[axis] = extent.raw[axis] > PHYSICS_EPSILON ? extent.raw[axis] / TRIMESH_QUANTIZED_MAX : 1;
+    }
+
+    mesh->nodes = calloc(bvh->node_count, (sizeof *mesh->nodes));
+    if (mesh->nodes == NULL) {
+        bvh_destroy(bvh);
+        trimesh_destroy(mesh);
+        return NULL;
+    }
+    mesh->node_count = bvh->node_count;
+    for (size_t i = 0; i < bvh->node_count; i++) {
+        trimesh_quantize_node(mesh, &bvh->nodes[i], &mesh->nodes[i]);
+    }
+
+    bvh_destroy(bvh);
+    return mesh;
+}
+
+triangle_t trimesh_get_triangle(const trimesh_t *mesh, size_t index) {
+    const uint32_t *corners = &mesh->indices[index * 3];
+    return triangle_make(
+        mesh->vertices[corners[0]],
+        mesh->vertices[corners[1]],
+        mesh->vertices[corners[2]]
+    );
+}
+
+void trimesh_get_bounds(const trimesh_t *mesh, bbox_t *box) {
+    safe_assert(mesh != NULL && box != NULL,);
+
+    *box = mesh->bounds;
+}
+
+/**
+ * Walks the mesh's BVH, calling visit for every leaf that could overlap a box
+ */
+PRIVATE_FUNC void trimesh_visit_bbox(const trimesh_t *mesh, bbox_t box, trimesh_leaf_visitor_t visit, void *context) {
+    if (mesh->triangle_count == 0) {
+        return;
+    }
+
+    // move the box into quantized space once, instead of
+    // converting every node's bounds back to world space
+    vec3_t box_min = bbox_get_min(box);
+    vec3_t box_max = bbox_get_max(box);
+    for (size_t axis = 0; axis < 3; axis++) {
+        box_min.raw[axis] = (box_min.raw[axis] - mesh->origin.raw[axis]) / mesh->scale.raw[axis];
+        box_max.raw[axis] = (box_max.raw[axis] - mesh->origin.raw[axis]) / mesh->scale.raw[axis];
+    }
+
+    uint32_t stack[BVH_MAX_DEPTH * BVH_WIDTH];
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const trimesh_node_t *node = &mesh->nodes[stack[--stack_size]];
+        uint32_t overlapping = simd4f_overlap_mask(
+            simd4f_load_u16(node->min_x), simd4f_load_u16(node->min_y), simd4f_load_u16(node->min_z),
+            simd4f_load_u16(node->max_x), simd4f_load_u16(node->max_y), simd4f_load_u16(node->max_z),
+            box_min, box_max);
+        for (size_t slot = 0; slot < BVH_WIDTH; slot++) {
+            if ((overlapping & (1u << slot)) == 0 || node->child[slot] == BVH_EMPTY) {
+                continue;
+            }
+            if (node->triangle_count[slot] == 0) {
+                stack[stack_size++] = node->child[slot];
+            }
+            else {
+                visit(context, node->child[slot], node->triangle_count[slot]);
+            }
+        }
+    }
+}
+
+PRIVATE_FUNC void trimesh_query_visit(void *context, uint32_t first_triangle, size_t triangle_count) {
+    trimesh_query_t *query = context;
+    for (size_t i = 0; i < triangle_count; i++) {
+        if (query->found < query->max_triangles) {
+            query->triangles[query->found] = first_triangle + i;
+        }
+        query->found++;
+    }
+}
+
+size_t trimesh_query_bbox(const trimesh_t *mesh, bbox_t box, uint32_t *triangles, size_t max_triangles) {
+    safe_assert(mesh != NULL, 0);
+    safe_assert(triangles != NULL || max_triangles == 0, 0);
+
+    trimesh_query_t query = {
+        .triangles = triangles,
+        .max_triangles = max_triangles,
+        .found = 0,
+    };
+    trimesh_visit_bbox(mesh, box, trimesh_query_visit, &query);
+    return query.found;
+}
+
+PRIVATE_FUNC void trimesh_collide_visit(void *context, uint32_t first_triangle, size_t triangle_count) {
+    trimesh_collision_t *collision = context;
+    for (size_t i = first_triangle; i < first_triangle + triangle_count; i++) {
+        triangle_t triangle = trimesh_get_triangle(collision->mesh, i);
+
+        // leaves are only bounded as a whole, so cheaply rule out
+        // triangles that are nowhere near the collider first
+        bbox_t triangle_bounds;
+        triangle_get_bounds(triangle, &triangle_bounds);
+        if (!bbox_is_bbox_inside(triangle_bounds, collision->collider_bounds)) {
+            continue;
+        }
+
+        contact_t contact;
+        if (!triangle_collide_collider(triangle, collision->collider, &contact)) {
+            continue;
+        }
+        if (collision->found < collision->max_contacts) {
+            collision->contacts[collision->found] = contact;
+        }
+        collision->found++;
+    }
+}
+
+size_t trimesh_collide_collider(const trimesh_t *mesh, collider_t collider, contact_t *contacts, size_t max_contacts) {
+    safe_assert(mesh != NULL, 0);
+    safe_assert(contacts != NULL || max_contacts == 0, 0);
+
+    trimesh_collision_t collision = {
+        .mesh = mesh,
+        .collider = collider,
+        .contacts = contacts,
+        .max_contacts = max_contacts,
+        .found = 0,
+    };
+    collider_get_bounds(collider, &collision.collider_bounds);
+    trimesh_visit_bbox(mesh, collision.collider_bounds, trimesh_collide_visit, &collision);
+    return collision.found;
+}
+
+void trimesh_destroy(trimesh_t *mesh) {
+    if (mesh == NULL) {
+        return;
+    }
+    free(mesh->vertices);
+    free(mesh->indices);
+    free(mesh->nodes);
+    free(mesh);
+}
@@ -0,0 +1,536 @@
+#include "sim/xpbd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "common/defines.h"
+#include "common/math.h"
+#include "common/coloring.h"
+
+/**
+ * How many particles a system starts out with room for
+ */
+#define XPBD_DEFAULT_CAPACITY 256
+
+/**
+ * How many particles (or constraints) a thread takes at a time
+ */
+#define XPBD_CHUNK_SIZE 256
+
+/**
+ * The number of per-particle arrays a system has
+ */
+#define XPBD_PARTICLE_ARRAY_COUNT 10
+
+/**
+ * Constraints whose gradient is shorter than this are skipped, since
+ * they have no direction to push in (e.g. a triangle squashed flat)
+ */
+#define XPBD_MIN_GRADIENT_SQR 1e-12
+
+/**
+ * Solves a single constraint, moving its particles and updating its lambda
+ * @param system The system the constraint is in
+ * @param set The set the constraint is in
+ * @param index The constraint's index in the set
+ * @param alpha The constraint's compliance scale for this substep, 1 / dt^2
+ */
+typedef void (*xpbd_solve_func_t)(xpbd_system_t *system, xpbd_constraint_set_t *set, size_t index, phy_real_t alpha);
+
+/**
+ * Everything the parallel passes of a substep need on each thread
+ */
+struct XpbdSubstep {
+    xpbd_system_t *system;
+    phy_real_t dt;
+    xpbd_constraint_set_t *set;
+    xpbd_solve_func_t solve;
+    /**
+     * The first constraint of the color being solved
+     */
+    size_t color_start;
+};
+typedef struct XpbdSubstep xpbd_substep_t;
+
+/**
+ * Gets every per-particle array, so they can all be grown together
+ */
+PRIVATE_FUNC void xpbd_get_particle_arrays(xpbd_system_t *system, phy_real_t **arrays[XPBD_PARTICLE_ARRAY_COUNT]) {
+    phy_real_t **all[XPBD_PARTICLE_ARRAY_COUNT] = {
+        &system->position_x, &system->position_y, &system->position_z,
+        &system->previous_x, &system->previous_y, &system->previous_z,
+        &system->velocity_x, &system->velocity_y, &system->velocity_z,
+        &system->inverse_mass,
+    };
+    memcpy(arrays, all, (sizeof all));
+}
+
+/**
+ * Makes room for a given number of particles
+ */
+PRIVATE_FUNC int xpbd_system_reserve_particles(xpbd_system_t *system, size_t capacity) {
+    phy_real_t **arrays[XPBD_PARTICLE_ARRAY_COUNT];
+    xpbd_get_particle_arrays(system, arrays);
+    for (size_t i = 0; i < XPBD_PARTICLE_ARRAY_COUNT; i++) {
+        phy_real_t *array = reallocarray(*arrays[i], capacity, (sizeof *array));
+        if (array == NULL) {
+            return XPBD_ERROR_ALLOC;
+        }
+        *arrays[i] = array;
+    }
+    system->particle_capacity = capacity;
+    return XPBD_SUCCESS;
+}
+
+/**
+ * Makes room for a given number of constraints in a set
+ */
+PRIVATE_FUNC int xpbd_constraint_set_reserve(xpbd_constraint_set_t *set, size_t capacity) {
+    for (size_t p = 0; p < set->particle_count; p++) {
+        uint32_t *particles = reallocarray(set->particles[p], capacity, (sizeof *particles));
+        if (particles == NULL) {
+            return XPBD_ERROR_ALLOC;
+        }
+        set->particles[p] = particles;
+    }
+    phy_real_t **arrays[] = { &set->rest_value, &set->compliance, &set->lambda };
+    for (size_t i = 0; i < (sizeof arrays) / (sizeof *arrays); i++) {
+        phy_real_t *array = reallocarray(*arrays[i], capacity, (sizeof *array));
+        if (array == NULL) {
+            return XPBD_ERROR_ALLOC;
+        }
+        *arrays[i] = array;
+    }
+    set->capacity = capacity;
+    return XPBD_SUCCESS;
+}
+
+/**
+ * Adds a constraint to a set
+ */
+PRIVATE_FUNC int xpbd_constraint_set_add(xpbd_constraint_set_t *set, const uint32_t *particles, phy_real_t rest_value, phy_real_t compliance) {
+    if (set->count >= set->capacity) {
+        int result = xpbd_constraint_set_reserve(set, set->capacity > 0 ? set->capacity * 2 : XPBD_DEFAULT_CAPACITY);
+        if (result != XPBD_SUCCESS) {
+            return result;
+        }
+    }
+
+    size_t i = set->count;
+    for (size_t p = 0; p < set->particle_count; p++) {
+        set->particles[p][i] = particles[p];
+    }
+    set->rest_value[i] = rest_value;
+    set->compliance[i] = compliance;
+    set->lambda[i] = 0;
+    set->count++;
+    set->needs_coloring = true;
+    return XPBD_SUCCESS;
+}
+
+/**
+ * Colors a set's constraints, and sorts them by color
+ */
+PRIVATE_FUNC int xpbd_constraint_set_color(xpbd_constraint_set_t *set, size_t particle_count) {
+    uint32_t *colors = calloc(set->count + 1, (sizeof *colors));
+    uint32_t *order = calloc(set->count + 1, (sizeof *order));
+    phy_real_t *scratch = calloc(set->count + 1, (sizeof *scratch));
+    if (colors == NULL || order == NULL || scratch == NULL) {
+        free(colors);
+        free(order);
+        free(scratch);
+        return XPBD_ERROR_ALLOC;
+    }
+
+    size_t color_count = 0;
+    int result = coloring_color((const uint32_t *const *)set->particles, set->particle_count, set->count,
+        particle_count, colors, &color_count);
+    uint32_t *color_starts = NULL;
+    if (result == COLORING_SUCCESS) {
+        color_starts = reallocarray(set->color_starts, color_count + 1, (sizeof *color_starts));
+        result = color_starts != NULL ? coloring_sort(colors, set->count, color_count, order, color_starts) : COLORING_ERROR_ALLOC;
+    }
+    if (color_starts != NULL) {
+        set->color_starts = color_starts;
+    }
+    if (result != COLORING_SUCCESS) {
+        free(colors);
+        free(order);
+        free(scratch);
+        return result == COLORING_ERROR_ALLOC ? XPBD_ERROR_ALLOC : XPBD_ERROR_PARAMS;
+    }
+
+    // reorder every field by color.  The colors are no longer needed, so
+    // they make room for reordering the particle indices
+    for (size_t p = 0; p < set->particle_count; p++) {
+        for (size_t i = 0; i < set->count; i++) {
+            colors[i] = set->particles[p][order[i]];
+        }
+        memcpy(set->particles[p], colors, set->count * (sizeof *colors));
+    }
+    phy_real_t *arrays[] = { set->rest_value, set->compliance, set->lambda };
+    for (size_t a = 0; a < (sizeof arrays) / (sizeof *arrays); a++) {
+        for (size_t i = 0; i < set->count; i++) {
+            scratch[i] = arrays[a][order[i]];
+        }
+        memcpy(arrays[a], scratch, set->count * (sizeof *scratch));
+    }
+
+    set->color_count = color_count;
+    set->needs_coloring = false;
+    free(colors);
+    free(order);
+    free(scratch);
+    return XPBD_SUCCESS;
+}
+
+PRIVATE_FUNC void xpbd_constraint_set_destroy(xpbd_constraint_set_t *set) {
+    for (size_t p = 0; p < set->particle_count; p++) {
+        free(set->particles[p]);
+    }
+    free(set->rest_value);
+    free(set->compliance);
+    free(set->lambda);
+    free(set->color_starts);
+}
+
+xpbd_system_t *xpbd_system_create(vec3_t gravity) {
+    xpbd_system_t *system = calloc(1, (sizeof *system));
+    if (system == NULL) {
+        return NULL;
+    }
+    system->gravity = gravity;
+    system->distance.particle_count = 2;
+    system->bending.particle_count = 4;
+    system->volume.particle_count = 4;
+    if (xpbd_system_reserve_particles(system, XPBD_DEFAULT_CAPACITY) != XPBD_SUCCESS) {
+        xpbd_system_destroy(system);
+        return NULL;
+    }
+    return system;
+}
+
+int xpbd_system_add_particle(xpbd_system_t *system, vec3_t position, phy_real_t mass) {
+    safe_assert(system != NULL && mass >= 0 && system->particle_count < UINT32_MAX, XPBD_ERROR_PARAMS);
+
+    if (system->particle_count >= system->particle_capacity) {
+        int result = xpbd_system_reserve_particles(system, system->particle_capacity * 2);
+        if (result != XPBD_SUCCESS) {
+            return result;
+        }
+    }
+
+    size_t i = system->particle_count;
+    system->position_x[i] = system->previous_x[i] = position.x;
+    system->position_y[i] = system->previous_y[i] = position.y;
+    system->position_z[i] = system->previous_z[i] = position.z;
+    system->velocity_x[i] = system->velocity_y[i] = system->velocity_z[i] = 0;
+    system->inverse_mass[i] = mass > 0 ? 1 / mass : 0;
+    system->particle_count++;
+    return XPBD_SUCCESS;
+}
+
+/**
+ * Gets a particle's position
+ */
+PRIVATE_FUNC vec3_t xpbd_get_position(const xpbd_system_t *system, uint32_t index) {
+    return vec3_make(system->position_x[index], system->position_y[index], system->position_z[index]);
+}
+
+/**
+ * Moves a particle by a given amount
+ */
+PRIVATE_FUNC void xpbd_move(xpbd_system_t *system, uint32_t index, vec3_t offset, phy_real_t scale) {
+    system->position_x[index] += offset.x * scale;
+    system->position_y[index] += offset.y * scale;
+    system->position_z[index] += offset.z * scale;
+}
+
+/**
+ * Finds the angle between triangles (a, b, c) and (b, a, d), and how
+ * quickly it changes as each corner moves.  Returns false if either
+ * triangle is too thin to have a direction.
+ * See Bridson et al., "Simulation of Clothing with Folds and Wrinkles"
+ */
+PRIVATE_FUNC bool xpbd_get_dihedral_angle(vec3_t a, vec3_t b, vec3_t c, vec3_t d, phy_real_t *angle, vec3_t gradients[4]) {
+    vec3_t edge = b;
+    vec3_add_to(&edge, a, -1);
+    phy_real_t edge_length = vec3_magnitude(edge);
+
+    // both normals point away from the shared edge's right-hand side,
+    // so a flat pair of triangles has an angle of zero
+    vec3_t c_to_a = a, c_to_b = b, d_to_a = a, d_to_b = b;
+    vec3_add_to(&c_to_a, c, -1);
+    vec3_add_to(&c_to_b, c, -1);
+    vec3_add_to(&d_to_a, d, -1);
+    vec3_add_to(&d_to_b, d, -1);
+    vec3_t normal_c, normal_d;
+    vec3_cross_product(&normal_c, c_to_a, c_to_b);
+    vec3_cross_product(&normal_d, d_to_b, d_to_a);
+    phy_real_t area_c = vec3_magnitude_sqr(normal_c);
+    phy_real_t area_d = vec3_magnitude_sqr(normal_d);
+    if (edge_length * edge_length < XPBD_MIN_GRADIENT_SQR || area_c < XPBD_MIN_GRADIENT_SQR || area_d < XPBD_MIN_GRADIENT_SQR) {
+        return false;
+    }
+
+    vec3_t unit_c = normal_c, unit_d = normal_d, unit_edge = edge;
+    vec3_multiply_by(&unit_c, 1 / sqrt(area_c));
+    vec3_multiply_by(&unit_d, 1 / sqrt(area_d));
+    vec3_multiply_by(&unit_edge, 1 / edge_length);
+    vec3_t normal_cross;
+    vec3_cross_product(&normal_cross, unit_c, unit_d);
+    *angle = atan2(vec3_dot_product(normal_cross, unit_edge), vec3_dot_product(unit_c, unit_d));
+
+    // each triangle's normal, scaled by how far its far corner is from the edge
+    vec3_t scaled_c = normal_c, scaled_d = normal_d;
+    vec3_multiply_by(&scaled_c, 1 / area_c);
+    vec3_multiply_by(&scaled_d, 1 / area_d);
+    gradients[2] = scaled_c;
+    vec3_multiply_by(&gradients[2], -edge_length);
+    gradients[3] = scaled_d;
+    vec3_multiply_by(&gradients[3], -edge_length);
+    // the edge's ends make up the difference, split by where along the
+    // edge each far corner sits
+    phy_real_t c_along_b = vec3_dot_product(c_to_b, unit_edge);
+    phy_real_t d_along_b = vec3_dot_product(d_to_b, unit_edge);
+    phy_real_t c_along_a = vec3_dot_product(c_to_a, unit_edge);
+    phy_real_t d_along_a = vec3_dot_product(d_to_a, unit_edge);
+    gradients[0] = VEC3_ZERO;
+    vec3_add_to(&gradients[0], scaled_c, c_along_b);
+    vec3_add_to(&gradients[0], scaled_d, d_along_b);
+    gradients[1] = VEC3_ZERO;
+    vec3_add_to(&gradients[1], scaled_c, -c_along_a);
+    vec3_add_to(&gradients[1], scaled_d, -d_along_a);
+    return true;
+}
+
+/**
+ * Applies the XPBD update to a constraint, given its error and gradients
+ */
+PRIVATE_FUNC void xpbd_apply(xpbd_system_t *system, xpbd_constraint_set_t *set, size_t index, phy_real_t alpha,
+    phy_real_t error, const vec3_t *gradients)
+{
+    phy_real_t weight = 0;
+    for (size_t p = 0; p < set->particle_count; p++) {
+        weight += system->inverse_mass[set->particles[p][index]] * vec3_magnitude_sqr(gradients[p]);
+    }
+    phy_real_t scaled_compliance = set->compliance[index] * alpha;
+    if (weight + scaled_compliance < XPBD_MIN_GRADIENT_SQR) {
+        return;
+    }
+
+    phy_real_t delta_lambda = (-error - scaled_compliance * set->lambda[index]) / (weight + scaled_compliance);
+    set->lambda[index] += delta_lambda;
+    for (size_t p = 0; p < set->particle_count; p++) {
+        uint32_t particle = set->particles[p][index];
+        xpbd_move(system, particle, gradients[p], system->inverse_mass[particle] * delta_lambda);
+    }
+}
+
+PRIVATE_FUNC void xpbd_solve_distance(xpbd_system_t *system, xpbd_constraint_set_t *set, size_t index, phy_real_t alpha) {
+    vec3_t offset = xpbd_get_position(system, set->particles[0][index]);
+    vec3_add_to(&offset, xpbd_get_position(system, set->particles[1][index]), -1);
+    phy_real_t distance = vec3_magnitude(offset);
+    if (distance * distance < XPBD_MIN_GRADIENT_SQR) {
+        return;
+    }
+
+    vec3_t gradients[2] = { offset, offset };
+    vec3_multiply_by(&gradients[0], 1 / distance);
+    vec3_multiply_by(&gradients[1], -1 / distance);
+    xpbd_apply(system, set, index, alpha, distance - set->rest_value[index], gradients);
+}
+
+PRIVATE_FUNC void xpbd_solve_bending(xpbd_system_t *system, xpbd_constraint_set_t *set, size_t index, phy_real_t alpha) {
+    phy_real_t angle;
+    vec3_t gradients[4];
+    if (!xpbd_get_dihedral_angle(xpbd_get_position(system, set->particles[0][index]),
+        xpbd_get_position(system, set->particles[1][index]),
+        xpbd_get_position(system, set->particles[2][index]),
+        xpbd_get_position(system, set->particles[3][index]), &angle, gradients))
+    {
+        return;
+    }
+
+    // bend the short way around
+    phy_real_t error = angle - set->rest_value[index];
+    if (error > PHYSICS_PI) {
+        error -= 2 * PHYSICS_PI;
+    }
+    else if (error < -PHYSICS_PI) {
+        error += 2 * PHYSICS_PI;
+    }
+    xpbd_apply(system, set, index, alpha, error, gradients);
+}
+
+/**
+ * Finds a tetrahedron's signed volume, and how quickly it changes as
+ * each corner moves
+ */
+PRIVATE_FUNC phy_real_t xpbd_get_volume(vec3_t a, vec3_t b, vec3_t c, vec3_t d, vec3_t gradients[4]) {
+    vec3_t ab = b, ac = c, ad = d, bc = c, bd = d;
+    vec3_add_to(&ab, a, -1);
+    vec3_add_to(&ac, a, -1);
+    vec3_add_to(&ad, a, -1);
+    vec3_add_to(&bc, b, -1);
+    vec3_add_to(&bd, b, -1);
+
+    // moving a corner changes the volume by a sixth of the opposite face's (doubled) area
+    vec3_cross_product(&gradients[0], bd, bc);
+    vec3_cross_product(&gradients[1], ac, ad);
+    vec3_cross_product(&gradients[2], ad, ab);
+    vec3_cross_product(&gradients[3], ab, ac);
+    for (size_t p = 0; p < 4; p++) {
+        vec3_multiply_by(&gradients[p], 1.0 / 6.0);
+    }
+    return vec3_dot_product(gradients[3], ad);
+}
+
+PRIVATE_FUNC void xpbd_solve_volume(xpbd_system_t *system, xpbd_constraint_set_t *set, size_t index, phy_real_t alpha) {
+    vec3_t gradients[4];
+    phy_real_t volume = xpbd_get_volume(xpbd_get_position(system, set->particles[0][index]),
+        xpbd_get_position(system, set->particles[1][index]),
+        xpbd_get_position(system, set->particles[2][index]),
+        xpbd_get_position(system, set->particles[3][index]), gradients);
+    xpbd_apply(system, set, index, alpha, volume - set->rest_value[index], gradients);
+}
+
+int xpbd_system_add_distance(xpbd_system_t *system, uint32_t a, uint32_t b, phy_real_t compliance) {
+    safe_assert(system != NULL && compliance >= 0, XPBD_ERROR_PARAMS);
+    safe_assert(a < system->particle_count && b < system->particle_count && a != b, XPBD_ERROR_PARAMS);
+
+    vec3_t offset = xpbd_get_position(system, a);
+    vec3_add_to(&offset, xpbd_get_position(system, b), -1);
+    uint32_t particles[] = { a, b };
+    return xpbd_constraint_set_add(&system->distance, particles, vec3_magnitude(offset), compliance);
+}
+
+int xpbd_system_add_bending(xpbd_system_t *system, uint32_t a, uint32_t b, uint32_t c, uint32_t d, phy_real_t compliance) {
+    safe_assert(system != NULL && compliance >= 0, XPBD_ERROR_PARAMS);
+    safe_assert(a < system->particle_count && b < system->particle_count, XPBD_ERROR_PARAMS);
+    safe_assert(c < system->particle_count && d < system->particle_count, XPBD_ERROR_PARAMS);
+
+    phy_real_t angle;
+    vec3_t gradients[4];
+    if (!xpbd_get_dihedral_angle(xpbd_get_position(system, a), xpbd_get_position(system, b),
+        xpbd_get_position(system, c), xpbd_get_position(system, d), &angle, gradients))
+    {
+        return XPBD_ERROR_PARAMS;
+    }
+    uint32_t particles[] = { a, b, c, d };
+    return xpbd_constraint_set_add(&system->bending, particles, angle, compliance);
+}
+
+int xpbd_system_add_volume(xpbd_system_t *system, uint32_t a, uint32_t b, uint32_t c, uint32_t d, phy_real_t compliance) {
+    safe_assert(system != NULL && compliance >= 0, XPBD_ERROR_PARAMS);
+    safe_assert(a < system->particle_count && b < system->particle_count, XPBD_ERROR_PARAMS);
+    safe_assert(c < system->particle_count && d < system->particle_count, XPBD_ERROR_PARAMS);
+
+    vec3_t gradients[4];
+    phy_real_t volume = xpbd_get_volume(xpbd_get_position(system, a), xpbd_get_position(system, b),
+        xpbd_get_position(system, c), xpbd_get_position(system, d), gradients);
+    uint32_t particles[] = { a, b, c, d };
+    return xpbd_constraint_set_add(&system->volume, particles, volume, compliance);
+}
+
+PRIVATE_FUNC void xpbd_predict_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    xpbd_substep_t *substep = context;
+    xpbd_system_t *system = substep->system;
+    phy_real_t dt = substep->dt;
+
+    for (size_t i = begin; i < end; i++) {
+        system->previous_x[i] = system->position_x[i];
+        system->previous_y[i] = system->position_y[i];
+        system->previous_z[i] = system->position_z[i];
+        if (system->inverse_mass[i] == 0) {
+            continue;
+        }
+        system->velocity_x[i] += system->gravity.x * dt;
+        system->velocity_y[i] += system->gravity.y * dt;
+        system->velocity_z[i] += system->gravity.z * dt;
+        system->position_x[i] += system->velocity_x[i] * dt;
+        system->position_y[i] += system->velocity_y[i] * dt;
+        system->position_z[i] += system->velocity_z[i] * dt;
+    }
+}
+
+PRIVATE_FUNC void xpbd_solve_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    xpbd_substep_t *substep = context;
+    phy_real_t alpha = 1 / (substep->dt * substep->dt);
+
+    for (size_t i = begin; i < end; i++) {
+        substep->solve(substep->system, substep->set, substep->color_start + i, alpha);
+    }
+}
+
+PRIVATE_FUNC void xpbd_update_velocities_task(void *context, size_t begin, size_t end, size_t thread_index) {
+    (void)thread_index;
+    xpbd_substep_t *substep = context;
+    xpbd_system_t *system = substep->system;
+    phy_real_t inverse_dt = 1 / substep->dt;
+
+    // a particle's velocity is however far the constraints let it move
+    for (size_t i = begin; i < end; i++) {
+        if (system->inverse_mass[i] == 0) {
+            continue;
+        }
+        system->velocity_x[i] = (system->position_x[i] - system->previous_x[i]) * inverse_dt;
+        system->velocity_y[i] = (system->position_y[i] - system->previous_y[i]) * inverse_dt;
+        system->velocity_z[i] = (system->position_z[i] - system->previous_z[i]) * inverse_dt;
+    }
+}
+
+int xpbd_system_step(xpbd_system_t *system, phy_real_t dt, size_t substep_count, threadpool_t *pool) {
+    safe_assert(system != NULL && dt > 0 && substep_count > 0, XPBD_ERROR_PARAMS);
+
+    xpbd_constraint_set_t *sets[] = { &system->distance, &system->bending, &system->volume };
+    xpbd_solve_func_t solvers[] = { xpbd_solve_distance, xpbd_solve_bending, xpbd_solve_volume };
+    const size_t set_count = (sizeof sets) / (sizeof *sets);
+    for (size_t s = 0; s < set_count; s++) {
+        if (sets[s]->needs_coloring) {
+            int result = xpbd_constraint_set_color(sets[s], system->particle_count);
+            if (result != XPBD_SUCCESS) {
+                return result;
+            }
+        }
+    }
+
+    xpbd_substep_t substep = { .system = system, .dt = dt / substep_count };
+    for (size_t step = 0; step < substep_count; step++) {
+        threadpool_parallel_for(pool, system->particle_count, XPBD_CHUNK_SIZE, xpbd_predict_task, &substep);
+
+        // every constraint is solved once per substep, a color at a time
+        for (size_t s = 0; s < set_count; s++) {
+            xpbd_constraint_set_t *set = sets[s];
+            memset(set->lambda, 0, set->count * (sizeof *set->lambda));
+            substep.set = set;
+            substep.solve = solvers[s];
+            for (size_t color = 0; color < set->color_count; color++) {
+                substep.color_start = set->color_starts[color];
+                threadpool_parallel_for(pool, set->color_starts[color + 1] - set->color_starts[color],
+                    XPBD_CHUNK_SIZE, xpbd_solve_task, &substep);
+            }
+        }
+
+        threadpool_parallel_for(pool, system->particle_count, XPBD_CHUNK_SIZE, xpbd_update_velocities_task, &substep);
+    }
+    return XPBD_SUCCESS;
+}
+
+void xpbd_system_destroy(xpbd_system_t *system) {
+    if (system == NULL) {
+        return;
+    }
+
+    phy_real_t **arrays[XPBD_PARTICLE_ARRAY_COUNT];
+    xpbd_get_particle_arrays(system, arrays);
+    for (size_t i = 0; i < XPBD_PARTICLE_ARRAY_COUNT; i++) {
+        free(*arrays[i]);
+    }
+    xpbd_constraint_set_destroy(&system->distance);
+    xpbd_constraint_set_destroy(&system->bending);
+    xpbd_constraint_set_destroy(&system->volume);
+    free(system);
+}
@@ -8,8 +8,13 @@ void body_gen_transform(body_t *body, mat4 transform_matrix) {
     glm_mat4_identity(transform_matrix);
     glm_translate(transform_matrix, vec3_to_cglm(body->position));
 
+    // cglm matrices are column-major
     glm_mat4_identity(rotation);
-    glm_euler(vec3_to_cglm(body->rotation), rotation);
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            rotation[column][row] = body->rotation_matrix[row][column];
+        }
+    }
 
     glm_mat4_mul(transform_matrix, rotation, transform_matrix);
 }
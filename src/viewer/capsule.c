@@ -0,0 +1,104 @@
+#include "viewer/capsule.h"
+
+#include "common/defines.h"
+
+void ccapsule_make_transform(ccapsule_t capsule, mat4 transform) {
+    vec3_t center = capsule.start;
+    vec3_add_to(&center, capsule.end, 1);
+    vec3_multiply_by(&center, 0.5);
+
+    vec3_t direction = capsule.end;
+    vec3_add_to(&direction, capsule.start, -1);
+    vec3_unit(&direction);
+
+    glm_mat4_identity(transform);
+    glm_translate(transform, vec3_to_cglm(center));
+
+    if (vec3_magnitude_sqr(direction) > PHYSICS_EPSILON) {
+        // degenerate capsules are just spheres, so they don't need rotating
+        vec3 up = { 0, 1, 0 };
+        versor rotation;
+        mat4 rotation_matrix;
+        glm_quat_from_vecs(up, vec3_to_cglm(direction), rotation);
+        glm_quat_mat4(rotation, rotation_matrix);
+        glm_mat4_mul(transform, rotation_matrix, transform);
+    }
+}
+
+/**
+ * Gets the index of a vertex on one of the capsule's rings.  Ring 0
+ * is closest to the top pole; the last ring is closest to the bottom pole
+ */
+#define CCAPSULE_RING_VERTEX(ring, segment) \
+    (1 + (ring) * CCAPSULE_RING_SEGMENTS + ((segment) % CCAPSULE_RING_SEGMENTS))
+
+#define CCAPSULE_TOP_POLE 0
+#define CCAPSULE_BOTTOM_POLE (CCAPSULE_VERTEX_COUNT - 1)
+#define CCAPSULE_RING_COUNT (2 * CCAPSULE_HEMISPHERE_RINGS)
+
+/**
+ * Populates a vertex in a capsule's vertex array
+ */
+#define CCAPSULE_SET_VERTEX(vertex_array, location, x, y, z) {          \
+    vertex_array[((location) * 3) + VIEWER_VERTEX_OFFSET_X] = (x);      \
+    vertex_array[((location) * 3) + VIEWER_VERTEX_OFFSET_Y] = (y);      \
+    vertex_array[((location) * 3) + VIEWER_VERTEX_OFFSET_Z] = (z);      \
+}
+
+void ccapsule_gen_vertices(ccapsule_t capsule, GLfloat vertices[CCAPSULE_VERTEX_ARRAY_SIZE], GLuint indices[CCAPSULE_INDEX_ARRAY_SIZE]) {
+    safe_assert(vertices != NULL && indices != NULL,);
+
+    float half_length = vec3_distance_to(capsule.start, capsule.end) / 2;
+    float radius = capsule.radius;
+
+    // generate vertices; the capsule runs along the y-axis, centered
+    // at the origin, and ccapsule_make_transform() moves it into place
+    CCAPSULE_SET_VERTEX(vertices, CCAPSULE_TOP_POLE, 0, half_length + radius, 0);
+    CCAPSULE_SET_VERTEX(vertices, CCAPSULE_BOTTOM_POLE, 0, -half_length - radius, 0);
+
+    for (size_t ring = 0; ring < CCAPSULE_HEMISPHERE_RINGS; ring++) {
+        // angle from the pole; the last ring of each hemisphere sits
+        // on the equator, where the cylindrical part begins
+        float polar = GLM_PI_2f * (ring + 1) / CCAPSULE_HEMISPHERE_RINGS;
+        float ring_radius = radius * sinf(polar);
+        float ring_height = radius * cosf(polar);
+
+        for (size_t segment = 0; segment < CCAPSULE_RING_SEGMENTS; segment++) {
+            float azimuth = 2 * GLM_PIf * segment / CCAPSULE_RING_SEGMENTS;
+            float x = ring_radius * cosf(azimuth);
+            float z = ring_radius * sinf(azimuth);
+
+            // top hemisphere counts down from the pole, bottom
+            // hemisphere mirrors it and counts up from the other pole
+            size_t bottom_ring = CCAPSULE_RING_COUNT - 1 - ring;
+            CCAPSULE_SET_VERTEX(vertices, CCAPSULE_RING_VERTEX(ring, segment), x, half_length + ring_height, z);
+            CCAPSULE_SET_VERTEX(vertices, CCAPSULE_RING_VERTEX(bottom_ring, segment), x, -half_length - ring_height, z);
+        }
+    }
+
+    // generate indices
+    size_t i = 0;
+    for (size_t segment = 0; segment < CCAPSULE_RING_SEGMENTS; segment++) {
+        // top cap -- a fan around the top pole
+        indices[i++] = CCAPSULE_TOP_POLE;
+        indices[i++] = CCAPSULE_RING_VERTEX(0, segment + 1);
+        indices[i++] = CCAPSULE_RING_VERTEX(0, segment);
+
+        // bands between rings -- each quad is made up of two triangles.
+        // the band between the two equators is the cylindrical part
+        for (size_t ring = 0; ring + 1 < CCAPSULE_RING_COUNT; ring++) {
+            indices[i++] = CCAPSULE_RING_VERTEX(ring, segment);
+            indices[i++] = CCAPSULE_RING_VERTEX(ring, segment + 1);
+            indices[i++] = CCAPSULE_RING_VERTEX(ring + 1, segment);
+
+            indices[i++] = CCAPSULE_RING_VERTEX(ring + 1, segment);
+            indices[i++] = CCAPSULE_RING_VERTEX(ring, segment + 1);
+            indices[i++] = CCAPSULE_RING_VERTEX(ring + 1, segment + 1);
+        }
+
+        // bottom cap -- a fan around the bottom pole
+        indices[i++] = CCAPSULE_BOTTOM_POLE;
+        indices[i++] = CCAPSULE_RING_VERTEX(CCAPSULE_RING_COUNT - 1, segment);
+        indices[i++] = CCAPSULE_RING_VERTEX(CCAPSULE_RING_COUNT - 1, segment + 1);
+    }
+}
@@ -3,7 +3,9 @@
 #include "viewer/aabb.h"
 
 void ccube_make_transform(ccube_t cube, mat4 transform) {
-    glm_quat_mat4(vec4_to_cglm(cube.rotation), transform);
+    // the cube's rotation goes from world space into model space, so
+    // drawing it takes the inverse
+    glm_quat_mat4(vec4_to_cglm(quaternion_unit_inverse(cube.rotation)), transform);
     glm_translate(transform, vec3_to_cglm(cube.position));
 }
 
@@ -0,0 +1,43 @@
+#include "viewer/heightfield.h"
+
+#include "common/defines.h"
+
+void heightfield_make_transform(const heightfield_t *field, mat4 transform) {
+    (void)field;
+    glm_mat4_identity(transform);
+}
+
+void heightfield_gen_vertices(const heightfield_t *field, GLfloat *vertices, GLuint *indices) {
+    safe_assert(field != NULL && vertices != NULL && indices != NULL,);
+
+    // one vertex per sample, in the same order as the heights
+    for (size_t row = 0; row < field->rows; row++) {
+        for (size_t column = 0; column < field->columns; column++) {
+            vec3_t point = heightfield_get_point(field, column, row);
+            GLfloat *vertex = &vertices[(row * field->columns + column) * 3];
+            vertex[0] = point.x;
+            vertex[1] = point.y;
+            vertex[2] = point.z;
+        }
+    }
+
+    // two triangles per cell, split along the same diagonal as
+    // heightfield_get_cell_triangles()
+    GLuint *index = indices;
+    for (size_t row = 0; row + 1 < field->rows; row++) {
+        for (size_t column = 0; column + 1 < field->columns; column++) {
+            GLuint near_left = row * field->columns + column;
+            GLuint near_right = near_left + 1;
+            GLuint far_left = near_left + field->columns;
+            GLuint far_right = far_left + 1;
+
+            *index++ = near_left;
+            *index++ = far_left;
+            *index++ = near_right;
+
+            *index++ = near_right;
+            *index++ = far_left;
+            *index++ = far_right;
+        }
+    }
+}